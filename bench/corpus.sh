@@ -0,0 +1,67 @@
+#!/bin/sh
+# Write a generated VGo program with the given number of functions, the
+# shape of the large generated sources the compiler is run on: many small
+# functions with locals, calls to earlier functions, branches and loops, and
+# a struct and a few globals every so often. It passes the type checker, so
+# every pass of the compiler sees all of it.
+# usage: bench/corpus.sh [functions] > program.go
+FUNCTIONS=${1:-2000}
+
+cat <<HEADER
+package main
+
+import "fmt"
+
+const limit = 1000
+
+var total int
+
+func f0(a int, b int) int {
+	return a + b
+}
+
+HEADER
+
+i=1
+while [ $i -lt "$FUNCTIONS" ]
+do
+	if [ $((i % 50)) -eq 0 ]
+	then
+		cat <<STRUCT
+type record$i struct {
+	key$i int
+	weight$i float64
+	name$i string
+	valid$i bool
+}
+
+var seen$i [64]int
+
+STRUCT
+	fi
+	cat <<FUNCTION
+func f$i(a int, b int) int {
+	var c int
+	var d int
+	c = f$((i - 1))(1, $i)
+	d = 0
+	if a > b {
+		return a + b
+	}
+	for a < b {
+		a = b
+	}
+	return a - b
+}
+
+FUNCTION
+	i=$((i + 1))
+done
+
+cat <<MAIN
+func main() {
+	var r int
+	r = f$((FUNCTIONS - 1))(2, 10)
+	fmt.Println(r)
+}
+MAIN
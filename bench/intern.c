@@ -0,0 +1,258 @@
+/*
+ * Scaling of the identifier interner and the name registry in intern.c.
+ * The corpus is every identifier in the given source files, repeated until
+ * it has a few million tokens, or a generated one with the skew of real code
+ * (a few names used everywhere, a long tail used once or twice) when no
+ * files are given. Each thread count interns the whole token stream split
+ * between the threads into a fresh table, then looks every token up again,
+ * then registers the distinct names. Times are wall clock milliseconds.
+ * With fewer processors than threads the speedups only show the cost of
+ * sharing the tables, not how they scale.
+ * usage: make bench/intern && bench/intern [file.go ...]
+ */
+
+#include "../intern.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 32
+#define CORPUS_TOKENS 4000000
+
+char **tokens;
+int *tokenLengths;
+int numberOfTokens;
+
+struct Interner *interner;
+struct Registry *registry;
+char **distinct;
+int numberOfDistinct;
+
+pthread_barrier_t barrier;
+
+struct BenchThread
+{
+    int index;
+    int numberOfThreads;
+    int phase;
+    long long found;
+};
+
+double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+void addToken(char *text, int length)
+{
+    static int capacity = 0;
+    if (numberOfTokens == capacity)
+    {
+        capacity = capacity == 0 ? 1024 : capacity * 2;
+        tokens = realloc(tokens, capacity * sizeof(char *));
+        tokenLengths = realloc(tokenLengths, capacity * sizeof(int));
+    }
+    tokens[numberOfTokens] = text;
+    tokenLengths[numberOfTokens] = length;
+    numberOfTokens++;
+}
+
+void readCorpus(char *path)
+{
+    FILE *source = fopen(path, "r");
+    if (source == NULL)
+    {
+        printf("Unable to read %s\n", path);
+        exit(3);
+    }
+    fseek(source, 0, SEEK_END);
+    long size = ftell(source);
+    fseek(source, 0, SEEK_SET);
+    char *text = malloc(size + 1);
+    size = fread(text, 1, size, source);
+    text[size] = '\0';
+    fclose(source);
+
+    char *cursor = text;
+    while (*cursor != '\0')
+    {
+        if (isalpha((unsigned char)*cursor) || *cursor == '_')
+        {
+            char *start = cursor;
+            while (isalnum((unsigned char)*cursor) || *cursor == '_')
+            {
+                cursor++;
+            }
+            addToken(start, cursor - start);
+        }
+        else
+        {
+            cursor++;
+        }
+    }
+}
+
+void generateCorpus()
+{
+    // rank r is drawn about 1/r as often, 200000 names in all
+    static char *prefixes[] = {"count", "index", "buffer", "node", "value", "result", "total", "item", "left", "right"};
+    int names = 200000;
+    int i = 0;
+    srand(1);
+    for (i = 0; i < CORPUS_TOKENS; i++)
+    {
+        double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+        int rank = (int)(names * u * u * u);
+        char *name = malloc(32);
+        int length = snprintf(name, 32, "%s%d", prefixes[rank % 10], rank);
+        addToken(name, length);
+    }
+}
+
+void *runBenchThread(void *argument)
+{
+    struct BenchThread *thread = argument;
+    int i = 0;
+    int begin = 0;
+    int end = 0;
+    pthread_barrier_wait(&barrier);
+    if (thread->phase == 0)
+    {
+        // interleaved, so every thread keeps meeting the names the others insert
+        for (i = thread->index; i < numberOfTokens; i += thread->numberOfThreads)
+        {
+            internText(interner, tokens[i], tokenLengths[i]);
+        }
+    }
+    else if (thread->phase == 1)
+    {
+        for (i = thread->index; i < numberOfTokens; i += thread->numberOfThreads)
+        {
+            thread->found += findInternedText(interner, tokens[i], tokenLengths[i]) != NULL;
+        }
+    }
+    else
+    {
+        begin = (int)((long long)numberOfDistinct * thread->index / thread->numberOfThreads);
+        end = (int)((long long)numberOfDistinct * (thread->index + 1) / thread->numberOfThreads);
+        for (i = begin; i < end; i++)
+        {
+            registerName(registry, distinct[i], distinct[i]);
+        }
+    }
+    pthread_barrier_wait(&barrier);
+    return NULL;
+}
+
+// milliseconds for one phase on numberOfThreads threads
+double runPhase(int phase, int numberOfThreads, long long *found)
+{
+    pthread_t handles[MAX_THREADS];
+    struct BenchThread threads[MAX_THREADS];
+    int i = 0;
+    pthread_barrier_init(&barrier, NULL, numberOfThreads + 1);
+    for (i = 0; i < numberOfThreads; i++)
+    {
+        threads[i].index = i;
+        threads[i].numberOfThreads = numberOfThreads;
+        threads[i].phase = phase;
+        threads[i].found = 0;
+        pthread_create(&handles[i], NULL, runBenchThread, &threads[i]);
+    }
+    pthread_barrier_wait(&barrier);
+    double start = now();
+    pthread_barrier_wait(&barrier);
+    double end = now();
+    *found = 0;
+    for (i = 0; i < numberOfThreads; i++)
+    {
+        pthread_join(handles[i], NULL);
+        *found += threads[i].found;
+    }
+    pthread_barrier_destroy(&barrier);
+    return end - start;
+}
+
+int main(int argc, char **argv)
+{
+    int i = 0;
+    int threads = 0;
+    long long found = 0;
+    double base[3] = {0, 0, 0};
+    for (i = 1; i < argc; i++)
+    {
+        readCorpus(argv[i]);
+    }
+    if (numberOfTokens == 0)
+    {
+        generateCorpus();
+    }
+    for (i = 0; numberOfTokens < CORPUS_TOKENS && i < numberOfTokens; i++)
+    {
+        addToken(tokens[i], tokenLengths[i]);
+    }
+
+    // the distinct names, interned once for the registry phase
+    interner = createInterner(1024);
+    for (i = 0; i < numberOfTokens; i++)
+    {
+        internText(interner, tokens[i], tokenLengths[i]);
+    }
+    numberOfDistinct = interner->count;
+    distinct = malloc(numberOfDistinct * sizeof(char *));
+    numberOfDistinct = 0;
+    for (i = 0; i < interner->table->capacity; i++)
+    {
+        struct InternEntry *entry = interner->table->slots[i];
+        if (entry != NULL)
+        {
+            distinct[numberOfDistinct++] = entry->text;
+        }
+    }
+    printf("%d tokens, %d distinct names, %ld processors\n", numberOfTokens, numberOfDistinct, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-8s %10s %8s %10s %8s %10s %8s\n", "threads", "intern", "speedup", "lookup", "speedup", "register", "speedup");
+
+    for (threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        double times[3];
+        interner = createInterner(1024);
+        reserveInterner(interner, numberOfDistinct);
+        shareInterner(interner, 1);
+        times[0] = runPhase(0, threads, &found);
+        if (interner->count != numberOfDistinct)
+        {
+            printf("interned %d names, expected %d\n", interner->count, numberOfDistinct);
+            return 1;
+        }
+        times[1] = runPhase(1, threads, &found);
+        if (found != numberOfTokens)
+        {
+            printf("found %lld of %d tokens\n", found, numberOfTokens);
+            return 1;
+        }
+        registry = createRegistry(1024);
+        reserveRegistry(registry, numberOfDistinct);
+        shareRegistry(registry, 1);
+        times[2] = runPhase(2, threads, &found);
+        if (registry->count != numberOfDistinct)
+        {
+            printf("registered %d names, expected %d\n", registry->count, numberOfDistinct);
+            return 1;
+        }
+        if (threads == 1)
+        {
+            base[0] = times[0];
+            base[1] = times[1];
+            base[2] = times[2];
+        }
+        printf("%-8d %10.1f %8.2f %10.1f %8.2f %10.1f %8.2f\n", threads, times[0], base[0] / times[0], times[1], base[1] / times[1], times[2],
+               base[2] / times[2]);
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Numeric literal decoding in literal.c against the C library. The corpus is
+ * a generated table of the literals that show up in lookup tables and test
+ * vectors: decimal, hex and octal integers of every width, short decimals
+ * like 0.25, and long scientific constants with 17 significant digits. Every
+ * literal is decoded by both sides and the results must match bit for bit
+ * before any timing is printed. Times are wall clock milliseconds for the
+ * whole table, best of five.
+ * usage: make bench/literal && bench/literal [literals]
+ */
+
+#include "../literal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS 5
+
+char **integers;
+char **floats;
+int numberOfIntegers;
+int numberOfFloats;
+
+double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+unsigned long long randomBits()
+{
+    return (unsigned long long)rand() << 62 ^ (unsigned long long)rand() << 31 ^ (unsigned long long)rand();
+}
+
+void generateTable(int count)
+{
+    int i = 0;
+    integers = malloc(count * sizeof(char *));
+    floats = malloc(count * sizeof(char *));
+    srand(1);
+    for (i = 0; i < count; i++)
+    {
+        // widths from one digit up to the full 63 bits
+        unsigned long long value = randomBits() >> (1 + rand() % 63);
+        char *text = malloc(32);
+        switch (i % 3)
+        {
+        case 0:
+            snprintf(text, 32, "%llu", value);
+            break;
+
+        case 1:
+            snprintf(text, 32, "0x%llX", value);
+            break;
+
+        default:
+            snprintf(text, 32, "0%llo", value | 1);
+            break;
+        }
+        integers[numberOfIntegers++] = text;
+
+        text = malloc(40);
+        switch (i % 4)
+        {
+        case 0:
+            snprintf(text, 40, "%d.%02d", rand() % 1000, rand() % 100);
+            break;
+
+        case 1:
+            snprintf(text, 40, "%.16e", (double)rand() / RAND_MAX * 10);
+            *strchr(text, 'e') = '\0';
+            snprintf(text + strlen(text), 8, "e%d", rand() % 80 - 40);
+            break;
+
+        default:
+        {
+            // any finite double, printed so it reads back exactly
+            double value = 0;
+            unsigned long long bits = randomBits() & 0x7FEFFFFFFFFFFFFFULL;
+            memcpy(&value, &bits, sizeof(double));
+            snprintf(text, 40, "%.17e", value);
+            break;
+        }
+        }
+        floats[numberOfFloats++] = text;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int round = 0;
+    int i = 0;
+    double best[4] = {1e30, 1e30, 1e30, 1e30};
+    unsigned long long integerSum = 0;
+    double floatSum = 0;
+    generateTable(count);
+
+    for (i = 0; i < count; i++)
+    {
+        unsigned long long ours = 0;
+        double oursFloat = 0;
+        double theirsFloat = strtod(floats[i], NULL);
+        if (decodeIntegerLiteral(integers[i], &ours) != LITERAL_OK || ours != strtoull(integers[i], NULL, 0))
+        {
+            printf("%s decoded as %llu\n", integers[i], ours);
+            return 1;
+        }
+        if (decodeFloatLiteral(floats[i], &oursFloat) != LITERAL_OK || memcmp(&oursFloat, &theirsFloat, sizeof(double)) != 0)
+        {
+            printf("%s decoded as %.17g, strtod gives %.17g\n", floats[i], oursFloat, theirsFloat);
+            return 1;
+        }
+    }
+    printf("%d integer and %d float literals, all identical to strtoull and strtod\n", numberOfIntegers, numberOfFloats);
+
+    for (round = 0; round < ROUNDS; round++)
+    {
+        double times[4];
+        double start = now();
+        for (i = 0; i < count; i++)
+        {
+            unsigned long long value = 0;
+            decodeIntegerLiteral(integers[i], &value);
+            integerSum += value;
+        }
+        times[0] = now() - start;
+        start = now();
+        for (i = 0; i < count; i++)
+        {
+            integerSum += strtoull(integers[i], NULL, 0);
+        }
+        times[1] = now() - start;
+        start = now();
+        for (i = 0; i < count; i++)
+        {
+            double value = 0;
+            decodeFloatLiteral(floats[i], &value);
+            floatSum += value;
+        }
+        times[2] = now() - start;
+        start = now();
+        for (i = 0; i < count; i++)
+        {
+            floatSum += strtod(floats[i], NULL);
+        }
+        times[3] = now() - start;
+        for (i = 0; i < 4; i++)
+        {
+            best[i] = times[i] < best[i] ? times[i] : best[i];
+        }
+    }
+    printf("%-10s %12s %12s %8s\n", "", "literal.c", "libc", "speedup");
+    printf("%-10s %12.1f %12.1f %8.2f\n", "integers", best[0], best[1], best[1] / best[0]);
+    printf("%-10s %12.1f %12.1f %8.2f\n", "floats", best[2], best[3], best[3] / best[2]);
+    // keeps the loops from being optimized away
+    return integerSum == 0 && floatSum == 0;
+}
@@ -0,0 +1,22 @@
+package main
+
+import "fmt"
+
+func mix(n int) int {
+	var i, j, a, b, c int
+	a = 1
+	b = 7
+	c = 0
+	for i = 0; i < n; i++ {
+		for j = 0; j < 1000; j++ {
+			a = (a*31 + j) % 1000003
+			b = (b*7 + a/3) % 65521
+			c = c + a%256 - b%128
+		}
+	}
+	return a + b + c
+}
+
+func main() {
+	fmt.Println(mix(200000))
+}
@@ -0,0 +1,44 @@
+package main
+
+import "fmt"
+
+type body struct {
+	x  float64
+	y  float64
+	vx float64
+	vy float64
+}
+
+var bodies [8]body
+
+func step(dt float64) {
+	var i, j int
+	var dx, dy, d2 float64
+	for i = 0; i < 8; i++ {
+		for j = 0; j < 8; j++ {
+			if i != j {
+				dx = bodies[j].x - bodies[i].x
+				dy = bodies[j].y - bodies[i].y
+				d2 = dx*dx + dy*dy + 0.01
+				bodies[i].vx = bodies[i].vx + dt*dx/d2
+				bodies[i].vy = bodies[i].vy + dt*dy/d2
+			}
+		}
+	}
+	for i = 0; i < 8; i++ {
+		bodies[i].x = bodies[i].x + dt*bodies[i].vx
+		bodies[i].y = bodies[i].y + dt*bodies[i].vy
+	}
+}
+
+func main() {
+	var i int
+	for i = 0; i < 8; i++ {
+		bodies[i].x = float64(i)
+		bodies[i].y = float64(i * i % 5)
+	}
+	for i = 0; i < 2000000; i++ {
+		step(0.001)
+	}
+	fmt.Println(bodies[0].x, bodies[7].y)
+}
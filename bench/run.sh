@@ -0,0 +1,51 @@
+#!/bin/sh
+# Run every benchmark six ways: compiled with the register allocator, compiled
+# with -naive (every value in a stack slot), translated to C with -emit-c and
+# built by the system compiler, on the bytecode interpreter, on the interpreter
+# with -naive (no superinstructions) and on the interpreter with the template
+# jit. All must print the same thing; wall times are reported in ms.
+# usage: bench/run.sh [path to vgo]
+VGO=${1:-./vgo}
+DIR=$(dirname "$0")
+OUT=${TMPDIR:-/tmp}/vgo-bench
+mkdir -p "$OUT"
+
+now()
+{
+    date +%s%N
+}
+
+# time one command, leaving its output in $OUT/$name.$label.out
+measure()
+{
+    start=$(now)
+    "$@" > "$OUT/$name.$label.out"
+    end=$(now)
+    echo $(( (end - start) / 1000000 ))
+}
+
+printf "%-10s %10s %10s %10s %10s %10s %10s\n" benchmark native naive c vm vm-naive jit
+for source in "$DIR"/*.go
+do
+    name=$(basename "$source" .go)
+    "$VGO" -o "$OUT/$name" "$source" || exit 1
+    "$VGO" -naive -o "$OUT/$name.naive" "$source" || exit 1
+    "$VGO" -emit-c -o "$OUT/$name.emitc" "$source" || exit 1
+
+    label=native; native=$(measure "$OUT/$name")
+    label=naive; naive=$(measure "$OUT/$name.naive")
+    label=c; c=$(measure "$OUT/$name.emitc")
+    label=vm; vm=$(measure "$VGO" -run "$source")
+    label=vmnaive; vmnaive=$(measure "$VGO" -naive -run "$source")
+    label=jit; jit=$(measure "$VGO" -jit -run "$source")
+
+    for label in naive c vm vmnaive jit
+    do
+        if ! cmp -s "$OUT/$name.native.out" "$OUT/$name.$label.out"
+        then
+            echo "$name: $label output differs from native"
+            exit 1
+        fi
+    done
+    printf "%-10s %10d %10d %10d %10d %10d %10d\n" "$name" "$native" "$naive" "$c" "$vm" "$vmnaive" "$jit"
+done
@@ -0,0 +1,26 @@
+package main
+
+import "fmt"
+
+var composite [100000]bool
+
+func main() {
+	var i, j, count, round int
+	for round = 0; round < 1000; round++ {
+		for i = 0; i < 100000; i++ {
+			composite[i] = 1 > 2
+		}
+		count = 0
+		for i = 2; i < 100000; i++ {
+			if !composite[i] {
+				count = count + 1
+				j = i + i
+				for j < 100000 {
+					composite[j] = 1 < 2
+					j = j + i
+				}
+			}
+		}
+	}
+	fmt.Println(count)
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# The training run of make pgo: an instrumented vgo compiles the generated
+# corpus of bench/corpus.sh the ways it is used, a syntax check, a full check,
+# the IR build and a native build, then builds the benchmark and test
+# programs and runs the tests on the interpreter. Its profile is what the
+# rebuild lays out the scanner and parser tables and the passes by. Every
+# input has to compile, one that fails stops the training.
+# usage: bench/train.sh [path to instrumented vgo]
+VGO=${1:-./vgo}
+DIR=$(dirname "$0")
+OUT=${TMPDIR:-/tmp}/vgo-train
+mkdir -p "$OUT"
+
+"$DIR/corpus.sh" 4000 > "$OUT/corpus.go"
+"$VGO" -syntax-only "$OUT/corpus.go" || exit 1
+"$VGO" "$OUT/corpus.go" || exit 1
+"$VGO" -emit-ir "$OUT/corpus.go" > /dev/null || exit 1
+"$VGO" -o "$OUT/corpus" "$OUT/corpus.go" || exit 1
+for source in "$DIR"/*.go "$DIR"/../tests/*.go
+do
+    "$VGO" -o "$OUT/program" "$source" || exit 1
+done
+for source in "$DIR"/../tests/*.go
+do
+    "$VGO" -run "$source" > /dev/null || exit 1
+done
+exit 0
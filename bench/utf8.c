@@ -0,0 +1,133 @@
+/*
+ * UTF-8 validation in utf8.c, the SSSE3 blocks against the byte at a time
+ * check, with memcpy of the same buffer as the memory bandwidth to compare
+ * with. Two buffers of generated source: one all ASCII, the shape of almost
+ * every file, and one with names, strings and comments in Greek, CJK and
+ * emoji. Both sides must agree on every buffer, including copies with a byte
+ * broken at random, before any timing is printed. Times are GB/s, best of
+ * five passes over the buffer.
+ * usage: make bench/utf8 && bench/utf8 [megabytes]
+ */
+
+#include "../utf8.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS 5
+
+double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+unsigned char *generateSource(size_t size, int wide)
+{
+    static const char *asciiLines[] = {
+        "func f%d(a int, b int) int {\n",
+        "\tvar total int\n",
+        "\ttotal = f%d(1, 2)\n",
+        "\tif a > b {\n\t\treturn a + b\n\t}\n",
+        "\t// walk the rest of the table\n",
+        "\tfmt.Println(\"done %d\")\n",
+        "}\n\n"};
+    static const char *wideLines[] = {
+        "func größe%d(ä int, b int) int {\n",
+        "\tvar 合計 int\n",
+        "\t合計 = größe%d(1, 2)\n",
+        "\tif ä > b {\n\t\treturn ä + b\n\t}\n",
+        "\t// παράδειγμα, 例子 \xF0\x9F\x98\x80\n",
+        "\tfmt.Println(\"fertig %d\")\n",
+        "}\n\n"};
+    const char **lines = wide ? wideLines : asciiLines;
+    unsigned char *text = malloc(size + 128);
+    size_t length = 0;
+    int i = 0;
+    while (length < size)
+    {
+        length += sprintf((char *)text + length, lines[i % 7], i);
+        i++;
+    }
+    // blank out the line cut at size, so every buffer is the same size and valid
+    length = size;
+    while (text[length - 1] != '\n')
+    {
+        text[--length] = ' ';
+    }
+    text[size - 1] = '\n';
+    return text;
+}
+
+double best(double *times)
+{
+    double fastest = times[0];
+    int i;
+    for (i = 1; i < ROUNDS; i++)
+    {
+        fastest = times[i] < fastest ? times[i] : fastest;
+    }
+    return fastest;
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = (size_t)(argc > 1 ? atoi(argv[1]) : 64) << 20;
+    unsigned char *sources[2];
+    unsigned char *copy = malloc(size);
+    const char *names[2] = {"ascii", "mixed"};
+    int source = 0;
+    int i = 0;
+    int valid = 0;
+    srand(1);
+    for (source = 0; source < 2; source++)
+    {
+        sources[source] = generateSource(size, source);
+    }
+
+    for (source = 0; source < 2; source++)
+    {
+        if (!isValidUtf8(sources[source], size) || findInvalidUtf8(sources[source], size) >= 0)
+        {
+            printf("%s source reported invalid\n", names[source]);
+            return 1;
+        }
+        for (i = 0; i < 1000; i++)
+        {
+            // a short window with one byte broken, so both sides see every kind of error
+            size_t start = rand() % (size - 256);
+            size_t window = 1 + rand() % 255;
+            memcpy(copy, sources[source] + start, window);
+            copy[rand() % window] = rand() % 256;
+            if (isValidUtf8(copy, window) != (findInvalidUtf8(copy, window) < 0))
+            {
+                printf("%s window at %zu disagrees\n", names[source], start);
+                return 1;
+            }
+        }
+    }
+    printf("%d MB of each source, the two validators agree\n", (int)(size >> 20));
+
+    printf("%-8s %12s %12s %12s\n", "", "ssse3", "scalar", "memcpy");
+    for (source = 0; source < 2; source++)
+    {
+        double times[3][ROUNDS];
+        for (i = 0; i < ROUNDS; i++)
+        {
+            double start = now();
+            valid += isValidUtf8(sources[source], size);
+            times[0][i] = now() - start;
+            start = now();
+            valid += findInvalidUtf8(sources[source], size) < 0;
+            times[1][i] = now() - start;
+            start = now();
+            memcpy(copy, sources[source], size);
+            times[2][i] = now() - start;
+        }
+        printf("%-8s %12.2f %12.2f %12.2f\n", names[source], size / best(times[0]) / 1e6, size / best(times[1]) / 1e6, size / best(times[2]) / 1e6);
+    }
+    // keeps the loops from being optimized away
+    return valid == 0 && copy[0] == 0;
+}
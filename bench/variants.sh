@@ -0,0 +1,58 @@
+#!/bin/sh
+# Compile throughput of each build of vgo the makefile makes: the default
+# -g build, release (-O2), lto and pgo. Each times a syntax check, a full
+# check and the IR build of a generated corpus, best of three, and reports
+# milliseconds and megabytes of source per second.
+# usage: make variants-report, or bench/variants.sh [functions]
+DIR=$(dirname "$0")
+OUT=${TMPDIR:-/tmp}/vgo-variants
+mkdir -p "$OUT"
+"$DIR/corpus.sh" ${1:-4000} > "$OUT/corpus.go"
+BYTES=$(wc -c < "$OUT/corpus.go")
+
+now()
+{
+    date +%s%N
+}
+
+# the best of three runs in ms
+best()
+{
+    fastest=0
+    for run in 1 2 3
+    do
+        start=$(now)
+        "$@" > /dev/null || exit 1
+        end=$(now)
+        time=$(( (end - start) / 1000000 ))
+        if [ $fastest -eq 0 ] || [ $time -lt $fastest ]
+        then
+            fastest=$time
+        fi
+    done
+    echo $fastest
+}
+
+throughput()
+{
+    if [ "$1" -eq 0 ]
+    then
+        echo "-"
+    else
+        echo $(( BYTES * 1000 / $1 / 1048576 )).$(( BYTES * 1000 / $1 * 10 / 1048576 % 10 ))
+    fi
+}
+
+printf "%s: %d bytes\n" "$OUT/corpus.go" "$BYTES"
+printf "%-14s %10s %8s %10s %8s %10s %8s\n" build syntax MB/s check MB/s ir MB/s
+for build in vgo vgo-release vgo-lto vgo-pgo
+do
+    if [ ! -x "./$build" ]
+    then
+        continue
+    fi
+    syntax=$(best "./$build" -syntax-only "$OUT/corpus.go")
+    check=$(best "./$build" "$OUT/corpus.go")
+    ir=$(best "./$build" -emit-ir "$OUT/corpus.go")
+    printf "%-14s %10d %8s %10d %8s %10d %8s\n" "$build" "$syntax" "$(throughput "$syntax")" "$check" "$(throughput "$check")" "$ir" "$(throughput "$ir")"
+done
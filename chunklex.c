@@ -0,0 +1,408 @@
+#include "chunklex.h"
+#include "tree.h"
+#include "vgobison.tab.h"
+#include "globalutilities.h"
+#include "intern.h"
+#include "memreport.h"
+#include "parsedecl.h"
+#include "probes.h"
+#include "trace.h"
+#include "utf8.h"
+#include "workpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// smaller chunks than this are not worth a thread; override with -DLEX_CHUNK_SIZE to test the cuts
+#ifndef LEX_CHUNK_SIZE
+#define LEX_CHUNK_SIZE (4 << 20)
+#endif
+
+// set by -lex-threads=N
+int lexThreads = 0;
+// the file yylex is reading tokens from, NULL when it is the scanner's
+struct ChunkedSource *chunkedSource = NULL;
+
+struct ChunkedSource
+{
+    char *text;
+    long long length;
+    struct LexChunk *chunks;
+    int numberOfChunks;
+    // the offset in each chunk of its first invalid UTF-8 byte
+    long long *invalid;
+    // the chunks and relexed regions whose tokens the parser reads, in order
+    struct LexChunk **segments;
+    int numberOfSegments;
+    int segment;
+    int token;
+    // the last token handed to the parser and its line
+    struct Node *last;
+    int line;
+};
+
+struct LexChunk *createChunk(struct ChunkedSource *source, long long start, long long end)
+{
+    struct LexChunk *chunk = calloc(1, sizeof(struct LexChunk));
+    chunk->source = source;
+    chunk->start = start;
+    chunk->end = end;
+    chunk->cut = -1;
+    return chunk;
+}
+
+void addChunkToken(struct LexChunk *chunk, struct Node *token)
+{
+    if (chunk->numberOfTokens == chunk->capacity)
+    {
+        chunk->capacity = chunk->capacity == 0 ? 1024 : chunk->capacity * 2;
+        chunk->tokens = realloc(chunk->tokens, chunk->capacity * sizeof(struct Node *));
+    }
+    chunk->tokens[chunk->numberOfTokens] = token;
+    chunk->numberOfTokens++;
+    if (token->category == LNAME)
+    {
+        chunk->numberOfNames++;
+    }
+}
+
+/*
+ * The string, raw string or comment the scanner of chunk just started at
+ * start is cut when the match the scanner would have made on the whole file
+ * ends past the chunk. Otherwise the chunk's scanner saw what the whole
+ * file's would have, and its error, or its divide, stands.
+ */
+int isChunkCut(struct LexChunk *chunk, long long start, int line, int lastToken)
+{
+    char *text = chunk->source->text;
+    long long length = chunk->source->length;
+    long long end = -1;
+    char *close;
+    if (text[start] == '"')
+    {
+        // with no closing quote the string runs to the end of the file
+        close = memchr(text + start + 1, '"', length - start - 1);
+        end = close == NULL ? length : close - text + 1;
+    }
+    else if (text[start] == '`')
+    {
+        close = memchr(text + start + 1, '`', length - start - 1);
+        end = close == NULL ? -1 : close - text + 1;
+    }
+    else if (start + 1 < length && text[start] == '/' && text[start + 1] == '*')
+    {
+        // the comment can only end at the first / after it, and only when a * comes right before it
+        close = start + 2 < length ? memchr(text + start + 2, '/', length - start - 2) : NULL;
+        if (close != NULL && close - text >= start + 3 && close[-1] == '*')
+        {
+            end = close - text + 1;
+        }
+    }
+    if (end <= chunk->end)
+    {
+        return 0;
+    }
+    chunk->cut = start;
+    chunk->cutEnd = end;
+    chunk->cutLine = line;
+    chunk->cutLastToken = lastToken;
+    return 1;
+}
+
+void setChunkError(struct LexChunk *chunk, char *message, int line)
+{
+    chunk->error = message;
+    chunk->errorLine = line;
+}
+
+// the tokens of a chunk that a relexed region has replaced
+void discardChunk(struct LexChunk *chunk)
+{
+    int i = 0;
+    for (i = 0; i < chunk->numberOfTokens; i++)
+    {
+        struct Node *token = chunk->tokens[i];
+        if (token->data->text != insertedSemicolon)
+        {
+            countRelease(MEM_TOKEN_TEXT, strlen(token->data->text) + 1);
+            free(token->data->text);
+        }
+        countRelease(MEM_TOKEN_TEXT, strlen(token->data->filename) + 1);
+        countRelease(MEM_TOKEN, sizeof(struct Token));
+        countRelease(MEM_TREE_NODE, sizeof(struct Node));
+        free(token->data->filename);
+        free(token->data);
+        free(token);
+    }
+    free(chunk->tokens);
+    free(chunk->error);
+    chunk->tokens = NULL;
+    chunk->numberOfTokens = 0;
+    chunk->numberOfNames = 0;
+    chunk->error = NULL;
+}
+
+void checkChunkEncoding(int index, void *argument)
+{
+    struct ChunkedSource *source = argument;
+    struct LexChunk *chunk = &source->chunks[index];
+    char *next = source->text + chunk->start;
+    char *end = source->text + chunk->end;
+    source->invalid[index] = findInvalidUtf8((unsigned char *)next, end - next);
+    chunk->numberOfLines = 0;
+    while ((next = memchr(next, '\n', end - next)) != NULL)
+    {
+        chunk->numberOfLines++;
+        next++;
+    }
+}
+
+void lexChunk(int index, void *argument)
+{
+    struct ChunkedSource *source = argument;
+    // a chunk starts after a newline, which has already put in any semicolon
+    scanChunk(&source->chunks[index], source->text, 0);
+}
+
+void internChunkNames(int index, void *argument)
+{
+    struct ChunkedSource *source = argument;
+    struct LexChunk *chunk = source->segments[index];
+    int i = 0;
+    for (i = 0; i < chunk->numberOfTokens; i++)
+    {
+        struct Token *data = chunk->tokens[i]->data;
+        if (data->category == LNAME)
+        {
+            char *copy = data->text;
+            data->text = internIdentifier(copy);
+            countRelease(MEM_TOKEN_TEXT, strlen(copy) + 1);
+            free(copy);
+        }
+    }
+}
+
+void addSegment(struct ChunkedSource *source, struct LexChunk *chunk)
+{
+    source->segments = realloc(source->segments, (source->numberOfSegments + 1) * sizeof(struct LexChunk *));
+    source->segments[source->numberOfSegments] = chunk;
+    source->numberOfSegments++;
+}
+
+/*
+ * Puts the chunks in order for the parser. A chunk that was cut ends at the
+ * token that crossed into the next chunks; from that token to the end of the
+ * chunk the token ends in is lexed again here, one region after another until
+ * one ends where a chunk does. Nothing after the first lex error is kept, the
+ * parser stops there.
+ */
+void stitchChunks(struct ChunkedSource *source)
+{
+    int index = 0;
+    struct LexChunk *segment = &source->chunks[0];
+    while (1)
+    {
+        addSegment(source, segment);
+        if (segment->error != NULL)
+        {
+            return;
+        }
+        if (segment->cut < 0)
+        {
+            index++;
+            if (index == source->numberOfChunks)
+            {
+                return;
+            }
+            segment = &source->chunks[index];
+            continue;
+        }
+        // the region runs to the end of the chunk with the last byte of the cut token in it
+        while (index + 1 < source->numberOfChunks && source->chunks[index].end < segment->cutEnd)
+        {
+            index++;
+            discardChunk(&source->chunks[index]);
+        }
+        struct LexChunk *region = createChunk(source, segment->cut, source->chunks[index].end);
+        region->firstLine = segment->cutLine;
+        scanChunk(region, source->text, segment->cutLastToken);
+        segment = region;
+    }
+}
+
+int openChunkedSource(FILE *input)
+{
+    struct stat status;
+    if (fstat(fileno(input), &status) != 0 || !S_ISREG(status.st_mode) || status.st_size < 2 * (long long)LEX_CHUNK_SIZE)
+    {
+        return 0;
+    }
+    double start = traceEnabled ? traceClock() : 0;
+    // -parse-threads alone lexes in chunks too, the declarations are found in the chunks' tokens
+    int threads = lexThreads > 0 ? lexThreads : parseThreads;
+    struct ChunkedSource *source = calloc(1, sizeof(struct ChunkedSource));
+    source->text = malloc(status.st_size + 1);
+    source->length = fread(source->text, 1, status.st_size, input);
+    source->text[source->length] = '\0';
+
+    // split after newlines, so no chunk starts in the middle of a line
+    long long chunkSize = source->length / (threads * 4);
+    chunkSize = chunkSize < LEX_CHUNK_SIZE ? LEX_CHUNK_SIZE : chunkSize;
+    int capacity = (int)(source->length / chunkSize) + 1;
+    long long chunkStart = 0;
+    source->chunks = calloc(capacity, sizeof(struct LexChunk));
+    while (chunkStart < source->length)
+    {
+        long long chunkEnd = source->length;
+        char *newline = NULL;
+        if (chunkStart + chunkSize < source->length)
+        {
+            newline = memchr(source->text + chunkStart + chunkSize, '\n', source->length - chunkStart - chunkSize);
+        }
+        if (newline != NULL && source->numberOfChunks + 1 < capacity)
+        {
+            chunkEnd = newline - source->text + 1;
+        }
+        struct LexChunk *chunk = &source->chunks[source->numberOfChunks];
+        chunk->source = source;
+        chunk->start = chunkStart;
+        chunk->end = chunkEnd;
+        chunk->cut = -1;
+        source->numberOfChunks++;
+        chunkStart = chunkEnd;
+    }
+
+    // the encoding is checked and the lines counted before anything is lexed
+    source->invalid = malloc(source->numberOfChunks * sizeof(long long));
+    runWorkPool(source->numberOfChunks, threads, checkChunkEncoding, source);
+    int i = 0;
+    int line = 1;
+    for (i = 0; i < source->numberOfChunks; i++)
+    {
+        if (source->invalid[i] >= 0)
+        {
+            reportInvalidEncoding(source->chunks[i].start + source->invalid[i]);
+        }
+        source->chunks[i].firstLine = line;
+        line += source->chunks[i].numberOfLines;
+    }
+
+    runWorkPool(source->numberOfChunks, threads, lexChunk, source);
+    stitchChunks(source);
+
+    // the identifiers were copied, they are interned together now every chunk has them
+    int numberOfNames = 0;
+    for (i = 0; i < source->numberOfSegments; i++)
+    {
+        numberOfNames += source->segments[i]->numberOfNames;
+    }
+    reserveInterner(identifierTable(), numberOfNames);
+    shareInterner(identifierTable(), 1);
+    runWorkPool(source->numberOfSegments, threads, internChunkNames, source);
+    shareInterner(identifierTable(), 0);
+
+    source->line = 1;
+    chunkedSource = source;
+    if (traceEnabled)
+    {
+        lexingTime += traceClock() - start;
+        for (i = 0; i < source->numberOfSegments; i++)
+        {
+            lexedTokens += source->segments[i]->numberOfTokens;
+        }
+    }
+    return 1;
+}
+
+int nextChunkedToken(struct Node **token)
+{
+    struct ChunkedSource *source = chunkedSource;
+    while (source->segment < source->numberOfSegments)
+    {
+        struct LexChunk *chunk = source->segments[source->segment];
+        if (source->token < chunk->numberOfTokens)
+        {
+            source->last = chunk->tokens[source->token];
+            source->token++;
+            source->line = source->last->data->linenumber;
+            *token = source->last;
+            return source->last->category;
+        }
+        if (chunk->error != NULL)
+        {
+            PROBE_ERROR("lex", chunk->errorLine, chunk->error);
+            printf("%s", chunk->error);
+            exit(1);
+        }
+        source->segment++;
+        source->token = 0;
+    }
+    source->line = source->segments[source->numberOfSegments - 1]->lastLine;
+    *token = source->last;
+    return -1;
+}
+
+int chunkedSourceLine()
+{
+    return chunkedSource->line;
+}
+
+struct Node *chunkedSourceToken()
+{
+    return chunkedSource->last;
+}
+
+struct Node **chunkedTokens(int *numberOfTokens)
+{
+    struct ChunkedSource *source = chunkedSource;
+    struct Node **tokens;
+    int i = 0;
+    *numberOfTokens = 0;
+    for (i = 0; i < source->numberOfSegments; i++)
+    {
+        if (source->segments[i]->error != NULL)
+        {
+            return NULL;
+        }
+        *numberOfTokens += source->segments[i]->numberOfTokens;
+    }
+    if (*numberOfTokens == 0)
+    {
+        return NULL;
+    }
+    tokens = malloc(*numberOfTokens * sizeof(struct Node *));
+    *numberOfTokens = 0;
+    for (i = 0; i < source->numberOfSegments; i++)
+    {
+        memcpy(tokens + *numberOfTokens, source->segments[i]->tokens, source->segments[i]->numberOfTokens * sizeof(struct Node *));
+        *numberOfTokens += source->segments[i]->numberOfTokens;
+    }
+    return tokens;
+}
+
+// the tokens belong to the tree by now, only the arrays holding them go; a
+// lex error has exited before the chunks after it would need freeing
+void closeChunkedSource()
+{
+    struct ChunkedSource *source = chunkedSource;
+    int i = 0;
+    if (source == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < source->numberOfSegments; i++)
+    {
+        free(source->segments[i]->tokens);
+        if (source->segments[i] < source->chunks || source->segments[i] >= source->chunks + source->numberOfChunks)
+        {
+            free(source->segments[i]);
+        }
+    }
+    free(source->segments);
+    free(source->chunks);
+    free(source->invalid);
+    free(source->text);
+    free(source);
+    chunkedSource = NULL;
+}
@@ -0,0 +1,85 @@
+#ifndef CHUNKLEX
+#define CHUNKLEX
+
+#include <stdio.h>
+
+/*
+ * -lex-threads=N lexes a large file in chunks on N threads before it is
+ * parsed, and yylex hands the parser the chunks' tokens in order.
+ *
+ * The file is split after newlines. The only state the scanner carries over
+ * a newline is the last token, for semicolon insertion, and whether it is in
+ * the middle of a string, raw string or comment. Right after a newline the
+ * last token is never one that takes a semicolon, the newline has already
+ * taken it, so each chunk is lexed on the guess that it does not start inside
+ * a string or comment. Where a chunk ends in the middle of one, the guess for
+ * the chunks after it was wrong: the scanner stops at the token that started
+ * it, which is lexed again with the chunks it runs into, and their own tokens
+ * are dropped.
+ */
+
+struct Node;
+struct ChunkedSource;
+
+// the state the rules keep from one token to the next, one for each scanner
+struct LexState
+{
+    // a newline after a token that can end a statement is a semicolon
+    int lastToken;
+    // the token just scanned, for yylex to hand to the parser
+    struct Node *node;
+    // the offset in the file of the end of the token just scanned
+    long long offset;
+    // set on the scanners of -lex-threads, NULL on the one yyparse reads from
+    struct LexChunk *chunk;
+};
+
+struct LexChunk
+{
+    struct ChunkedSource *source;
+    // the bytes [start, end) of the file
+    long long start;
+    long long end;
+    int firstLine;
+    int numberOfLines;
+    // the line the scanner was on when it stopped
+    int lastLine;
+    struct Node **tokens;
+    int numberOfTokens;
+    int capacity;
+    // identifiers are copied while the chunks are lexed and interned after
+    int numberOfNames;
+    // a lex error, printed once the parser gets to it
+    char *error;
+    int errorLine;
+    // a string, raw string or comment starting at cut goes past the end of
+    // the chunk to cutEnd, the tokens stop before it
+    long long cut;
+    long long cutEnd;
+    int cutLine;
+    int cutLastToken;
+};
+
+extern int lexThreads;
+extern struct ChunkedSource *chunkedSource;
+
+// 1 when input was large enough to be lexed in chunks, otherwise it is left to the scanner
+int openChunkedSource(FILE *input);
+void closeChunkedSource();
+// yylex while a chunked source is open
+int nextChunkedToken(struct Node **token);
+int chunkedSourceLine();
+struct Node *chunkedSourceToken();
+// every token of the file in order, NULL when it has a lex error; the caller frees the array
+struct Node **chunkedTokens(int *numberOfTokens);
+
+// for the rules, on the scanners of -lex-threads
+void addChunkToken(struct LexChunk *chunk, struct Node *token);
+int isChunkCut(struct LexChunk *chunk, long long start, int line, int lastToken);
+void setChunkError(struct LexChunk *chunk, char *message, int line);
+
+// in vgolex.l, lexes one chunk on a scanner of its own
+void scanChunk(struct LexChunk *chunk, char *text, int lastToken);
+void reportInvalidEncoding(long long offset);
+
+#endif
@@ -0,0 +1,1524 @@
+#include "codegen.h"
+#include "package.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+/*
+ * Instruction selection from the optimized IR to x86-64 assembly, then the
+ * local C compiler assembles it and links it with runtime/vgort.c.
+ *
+ * Frame layout below %rbp: saved callee saved registers, parameter homes,
+ * aggregate slots, spill slots, and at %rsp the outgoing area used to stage
+ * call arguments and fmt.Println operands. rax, rcx, rdx, r11, xmm0, xmm1
+ * and xmm15 are scratch and never hold a value across instructions.
+ */
+
+// set by -S and -o
+int keepAssembly = 0;
+char *outputFile = NULL;
+
+char *registerNames[] = {"%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi", "%r8", "%r9", "%r10",
+                         "%r11", "%r12", "%r13", "%r14", "%r15", "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                         "%xmm6", "%xmm7", "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15"};
+int integerArgumentRegisters[] = {REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9};
+
+// condition codes for eq, ne, lt, le, gt, ge and their negations
+char *conditionCodes[] = {"e", "ne", "l", "le", "g", "ge"};
+char *inverseConditionCodes[] = {"ne", "e", "ge", "g", "le", "l"};
+
+struct AsmConstant
+{
+    int isString;
+    long long bits;
+    char *text;
+};
+
+struct AsmIndexPanic
+{
+    int label;
+    long long length;
+};
+
+FILE *asmOutput;
+struct IrFunction *asmFunction;
+struct Allocation asmAllocation;
+int asmFunctionIndex;
+int asmBlockIndex;
+int *asmSlotOffsets;
+int asmSavedBytes;
+int asmLabelCounter;
+int asmUsesDividePanic;
+int numberOfAsmIndexPanics;
+int asmIndexPanicCapacity;
+struct AsmIndexPanic *asmIndexPanics;
+
+// literal pool shared by every function of the module
+int numberOfAsmConstants;
+int asmConstantCapacity;
+struct AsmConstant *asmConstants;
+int asmConstantTableSize;
+int *asmConstantTable;
+
+void codegenError(char *message)
+{
+    printf("Unable to generate code: %s in function %s\n", message, asmFunction != NULL ? asmFunction->name : "?");
+    exit(3);
+}
+
+int isXmmRegister(int reg)
+{
+    return reg >= REG_XMM0;
+}
+
+int fitsImmediate(long long value)
+{
+    return value >= INT_MIN && value <= INT_MAX;
+}
+
+long long floatBits(double value)
+{
+    long long bits = 0;
+    memcpy(&bits, &value, sizeof(double));
+    return bits;
+}
+
+/*
+ * literal pool
+ */
+
+unsigned int hashAsmConstant(int isString, long long bits, char *text)
+{
+    unsigned long long h = isString ? 5381 : (unsigned long long)bits * 0x9E3779B97F4A7C15ULL;
+    if (isString)
+    {
+        for (; *text != '\0'; text++)
+        {
+            h = h * 33 + (unsigned char)*text;
+        }
+    }
+    return (unsigned int)(h ^ (h >> 32));
+}
+
+int sameAsmConstant(struct AsmConstant *constant, int isString, long long bits, char *text)
+{
+    if (constant->isString != isString)
+    {
+        return 0;
+    }
+    return isString ? strcmp(constant->text, text) == 0 : constant->bits == bits;
+}
+
+void insertAsmConstantIndex(int index)
+{
+    struct AsmConstant *constant = &asmConstants[index];
+    unsigned int slot = hashAsmConstant(constant->isString, constant->bits, constant->text) & (asmConstantTableSize - 1);
+    while (asmConstantTable[slot] >= 0)
+    {
+        slot = (slot + 1) & (asmConstantTableSize - 1);
+    }
+    asmConstantTable[slot] = index;
+}
+
+int asmConstantLabel(int isString, long long bits, char *text)
+{
+    int i = 0;
+    if (text == NULL)
+    {
+        text = "";
+    }
+    if (2 * (numberOfAsmConstants + 1) > asmConstantTableSize)
+    {
+        asmConstantTableSize = asmConstantTableSize == 0 ? 64 : asmConstantTableSize * 2;
+        asmConstantTable = realloc(asmConstantTable, asmConstantTableSize * sizeof(int));
+        for (i = 0; i < asmConstantTableSize; i++)
+        {
+            asmConstantTable[i] = -1;
+        }
+        for (i = 0; i < numberOfAsmConstants; i++)
+        {
+            insertAsmConstantIndex(i);
+        }
+    }
+    unsigned int slot = hashAsmConstant(isString, bits, text) & (asmConstantTableSize - 1);
+    while (asmConstantTable[slot] >= 0)
+    {
+        if (sameAsmConstant(&asmConstants[asmConstantTable[slot]], isString, bits, text))
+        {
+            return asmConstantTable[slot];
+        }
+        slot = (slot + 1) & (asmConstantTableSize - 1);
+    }
+    if (numberOfAsmConstants == asmConstantCapacity)
+    {
+        asmConstantCapacity = asmConstantCapacity == 0 ? 64 : asmConstantCapacity * 2;
+        asmConstants = realloc(asmConstants, asmConstantCapacity * sizeof(struct AsmConstant));
+    }
+    asmConstants[numberOfAsmConstants].isString = isString;
+    asmConstants[numberOfAsmConstants].bits = bits;
+    asmConstants[numberOfAsmConstants].text = text;
+    asmConstantTable[slot] = numberOfAsmConstants;
+    return numberOfAsmConstants++;
+}
+
+void emitAsmConstants()
+{
+    int i = 0;
+    if (numberOfAsmConstants == 0)
+    {
+        return;
+    }
+    fprintf(asmOutput, "\t.section .rodata\n");
+    for (i = 0; i < numberOfAsmConstants; i++)
+    {
+        struct AsmConstant *constant = &asmConstants[i];
+        if (!constant->isString)
+        {
+            fprintf(asmOutput, "\t.balign 8\n.LC%d:\n\t.quad %lld\n", i, constant->bits);
+            continue;
+        }
+        fprintf(asmOutput, ".LC%d:\n\t.string \"", i);
+        char *c = constant->text;
+        for (; *c != '\0'; c++)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                fprintf(asmOutput, "\\%c", *c);
+            }
+            else if (*c >= 32 && *c < 127)
+            {
+                fputc(*c, asmOutput);
+            }
+            else
+            {
+                fprintf(asmOutput, "\\%03o", (unsigned char)*c);
+            }
+        }
+        fprintf(asmOutput, "\"\n");
+    }
+    free(asmConstants);
+    free(asmConstantTable);
+    asmConstants = NULL;
+    asmConstantTable = NULL;
+    numberOfAsmConstants = 0;
+    asmConstantCapacity = 0;
+    asmConstantTableSize = 0;
+}
+
+/*
+ * operands
+ */
+
+struct Location *valueLocation(struct IrInstr *value)
+{
+    return &asmAllocation.locations[value->id];
+}
+
+int sameLocation(struct Location *a, struct Location *b)
+{
+    if (a->kind != b->kind)
+    {
+        return 0;
+    }
+    return a->kind == LOCATION_REGISTER ? a->reg == b->reg : a->offset == b->offset;
+}
+
+void locationText(struct Location *location, char *buffer)
+{
+    if (location->kind == LOCATION_REGISTER)
+    {
+        strcpy(buffer, registerNames[location->reg]);
+    }
+    else
+    {
+        sprintf(buffer, "%d(%%rbp)", location->offset);
+    }
+}
+
+// the register holding a value, or -1 when it lives in memory or is recomputed
+int valueRegister(struct IrInstr *value)
+{
+    if (value == NULL || isIrRematerialized(value) || valueLocation(value)->kind != LOCATION_REGISTER)
+    {
+        return -1;
+    }
+    return valueLocation(value)->reg;
+}
+
+int destinationRegister(struct IrInstr *instr, int scratch)
+{
+    int reg = valueRegister(instr);
+    return reg >= 0 ? reg : scratch;
+}
+
+void emitMove(struct Location *from, struct Location *to)
+{
+    // a 64 bit copy between registers and frame slots, floats travel as raw bits
+    char source[64];
+    char destination[64];
+    if (sameLocation(from, to))
+    {
+        return;
+    }
+    locationText(from, source);
+    locationText(to, destination);
+    if (from->kind == LOCATION_STACK && to->kind == LOCATION_STACK)
+    {
+        fprintf(asmOutput, "\tmovq %s, %%rax\n\tmovq %%rax, %s\n", source, destination);
+    }
+    else if (from->kind == LOCATION_REGISTER && to->kind == LOCATION_REGISTER)
+    {
+        if (isXmmRegister(from->reg) && isXmmRegister(to->reg))
+        {
+            fprintf(asmOutput, "\tmovapd %s, %s\n", source, destination);
+        }
+        else
+        {
+            fprintf(asmOutput, "\tmovq %s, %s\n", source, destination);
+        }
+    }
+    else
+    {
+        int reg = from->kind == LOCATION_REGISTER ? from->reg : to->reg;
+        fprintf(asmOutput, "\t%s %s, %s\n", isXmmRegister(reg) ? "movsd" : "movq", source, destination);
+    }
+}
+
+void loadImmediate(long long value, int reg)
+{
+    if (isXmmRegister(reg))
+    {
+        loadImmediate(value, REG_RAX);
+        fprintf(asmOutput, "\tmovq %%rax, %s\n", registerNames[reg]);
+    }
+    else if (fitsImmediate(value))
+    {
+        fprintf(asmOutput, "\tmovq $%lld, %s\n", value, registerNames[reg]);
+    }
+    else
+    {
+        fprintf(asmOutput, "\tmovabsq $%lld, %s\n", value, registerNames[reg]);
+    }
+}
+
+struct AsmAddress
+{
+    // a symbol relative to %rip, or a base register plus displacement
+    char *symbol;
+    int base;
+    long long offset;
+};
+
+void resolveAddress(struct IrInstr *address, int scratch, struct AsmAddress *result)
+{
+    result->symbol = NULL;
+    result->base = REG_RBP;
+    result->offset = 0;
+    if (isIrRematerialized(address))
+    {
+        while (address->op == IR_FIELD)
+        {
+            result->offset += address->ival;
+            address = address->args[0];
+        }
+        if (address->op == IR_SLOT)
+        {
+            result->offset += asmSlotOffsets[address->id];
+        }
+        else
+        {
+            result->symbol = address->sval;
+        }
+        return;
+    }
+    // a computed field address has its own location, its base may be dead by now
+    result->base = valueRegister(address);
+    if (result->base < 0)
+    {
+        struct Location target = {LOCATION_REGISTER, scratch, 0};
+        emitMove(valueLocation(address), &target);
+        result->base = scratch;
+    }
+}
+
+void addressText(struct AsmAddress *address, long long extra, char *buffer)
+{
+    long long offset = address->offset + extra;
+    if (address->symbol != NULL)
+    {
+        if (offset == 0)
+        {
+            sprintf(buffer, "vgo_%s(%%rip)", address->symbol);
+        }
+        else
+        {
+            sprintf(buffer, "vgo_%s%+lld(%%rip)", address->symbol, offset);
+        }
+    }
+    else if (offset == 0)
+    {
+        sprintf(buffer, "(%s)", registerNames[address->base]);
+    }
+    else
+    {
+        sprintf(buffer, "%lld(%s)", offset, registerNames[address->base]);
+    }
+}
+
+void loadValue(struct IrInstr *value, int reg)
+{
+    char buffer[160];
+    if (value == NULL)
+    {
+        // operands from removed dead paths are never read
+        loadImmediate(0, reg);
+        return;
+    }
+    if (value->op == IR_CONST)
+    {
+        if (value->type == IR_STRING)
+        {
+            fprintf(asmOutput, "\tleaq .LC%d(%%rip), %s\n", asmConstantLabel(1, 0, value->sval), registerNames[reg]);
+        }
+        else if (value->type == IR_FLOAT && isXmmRegister(reg))
+        {
+            if (floatBits(value->dval) == 0)
+            {
+                fprintf(asmOutput, "\txorpd %s, %s\n", registerNames[reg], registerNames[reg]);
+            }
+            else
+            {
+                fprintf(asmOutput, "\tmovsd .LC%d(%%rip), %s\n", asmConstantLabel(0, floatBits(value->dval), NULL), registerNames[reg]);
+            }
+        }
+        else
+        {
+            loadImmediate(value->type == IR_FLOAT ? floatBits(value->dval) : value->ival, reg);
+        }
+        return;
+    }
+    if (isIrRematerialized(value))
+    {
+        struct AsmAddress address;
+        resolveAddress(value, reg, &address);
+        addressText(&address, 0, buffer);
+        fprintf(asmOutput, "\tleaq %s, %s\n", buffer, registerNames[reg]);
+        return;
+    }
+    struct Location target = {LOCATION_REGISTER, reg, 0};
+    emitMove(valueLocation(value), &target);
+}
+
+void storeValue(struct IrInstr *value, int reg)
+{
+    struct Location source = {LOCATION_REGISTER, reg, 0};
+    emitMove(&source, valueLocation(value));
+}
+
+// a source operand for an arithmetic instruction: immediate, register, memory or pooled float
+void operandText(struct IrInstr *value, int scratch, char *buffer)
+{
+    if (value != NULL && value->op == IR_CONST && value->type != IR_STRING)
+    {
+        if (value->type == IR_FLOAT && isXmmRegister(scratch))
+        {
+            sprintf(buffer, ".LC%d(%%rip)", asmConstantLabel(0, floatBits(value->dval), NULL));
+            return;
+        }
+        if (value->type != IR_FLOAT && fitsImmediate(value->ival))
+        {
+            sprintf(buffer, "$%lld", value->ival);
+            return;
+        }
+    }
+    if (value == NULL || isIrRematerialized(value))
+    {
+        loadValue(value, scratch);
+        strcpy(buffer, registerNames[scratch]);
+        return;
+    }
+    locationText(valueLocation(value), buffer);
+}
+
+int newAsmLabel()
+{
+    return asmLabelCounter++;
+}
+
+void emitCallTo(char *name)
+{
+    fprintf(asmOutput, "\tcall %s\n", name);
+}
+
+/*
+ * instructions
+ */
+
+void emitIntegerArithmetic(struct IrInstr *instr, char *mnemonic)
+{
+    char operand[160];
+    int destination = destinationRegister(instr, REG_RAX);
+    if (valueRegister(instr->args[1]) == destination)
+    {
+        destination = REG_RAX;
+    }
+    loadValue(instr->args[0], destination);
+    operandText(instr->args[1], REG_RCX, operand);
+    fprintf(asmOutput, "\t%s %s, %s\n", mnemonic, operand, registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitFloatArithmetic(struct IrInstr *instr, char *mnemonic)
+{
+    char operand[160];
+    int destination = destinationRegister(instr, REG_XMM0);
+    if (valueRegister(instr->args[1]) == destination)
+    {
+        destination = REG_XMM0;
+    }
+    loadValue(instr->args[0], destination);
+    operandText(instr->args[1], REG_XMM1, operand);
+    fprintf(asmOutput, "\t%s %s, %s\n", mnemonic, operand, registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitDivision(struct IrInstr *instr)
+{
+    // Go defines the quotient of the most negative int by -1 as itself, idiv would trap
+    int isModulo = instr->op == IR_MOD;
+    struct IrInstr *divisor = instr->args[1];
+    loadValue(instr->args[0], REG_RAX);
+    if (divisor->op == IR_CONST && divisor->ival == -1)
+    {
+        if (isModulo)
+        {
+            fprintf(asmOutput, "\txorl %%edx, %%edx\n");
+        }
+        else
+        {
+            fprintf(asmOutput, "\tnegq %%rax\n");
+        }
+    }
+    else if (divisor->op == IR_CONST && divisor->ival != 0)
+    {
+        loadValue(divisor, REG_RCX);
+        fprintf(asmOutput, "\tcqto\n\tidivq %%rcx\n");
+    }
+    else
+    {
+        int negate = newAsmLabel();
+        int done = newAsmLabel();
+        asmUsesDividePanic = 1;
+        loadValue(divisor, REG_RCX);
+        fprintf(asmOutput, "\ttestq %%rcx, %%rcx\n\tje .Ldivide%d\n", asmFunctionIndex);
+        fprintf(asmOutput, "\tcmpq $-1, %%rcx\n\tje .L%d\n", negate);
+        fprintf(asmOutput, "\tcqto\n\tidivq %%rcx\n\tjmp .L%d\n", done);
+        fprintf(asmOutput, ".L%d:\n", negate);
+        fprintf(asmOutput, isModulo ? "\txorl %%edx, %%edx\n" : "\tnegq %%rax\n");
+        fprintf(asmOutput, ".L%d:\n", done);
+    }
+    storeValue(instr, isModulo ? REG_RDX : REG_RAX);
+}
+
+void emitRuntimeCall2(struct IrInstr *left, struct IrInstr *right, char *name)
+{
+    // stage through scratch registers so neither operand is overwritten by the other
+    loadValue(left, REG_RAX);
+    loadValue(right, REG_RCX);
+    fprintf(asmOutput, "\tmovq %%rax, %%rdi\n\tmovq %%rcx, %%rsi\n");
+    emitCallTo(name);
+}
+
+// sets the flags for a compare and returns the index of its condition code
+int emitCompareFlags(struct IrInstr *instr)
+{
+    char left[160];
+    char right[160];
+    struct IrInstr *a = instr->args[0];
+    struct IrInstr *b = instr->args[1];
+    int condition = instr->op - IR_EQ;
+    if (a->type == IR_STRING)
+    {
+        emitRuntimeCall2(a, b, "vgoCompareStrings");
+        fprintf(asmOutput, "\tcmpq $0, %%rax\n");
+        return condition;
+    }
+    if (a->op == IR_CONST || isIrRematerialized(a))
+    {
+        loadValue(a, REG_RAX);
+        strcpy(left, "%rax");
+    }
+    else
+    {
+        locationText(valueLocation(a), left);
+    }
+    operandText(b, REG_RCX, right);
+    if (left[0] != '%' && right[0] != '%' && right[0] != '$')
+    {
+        // both in memory
+        loadValue(a, REG_RAX);
+        strcpy(left, "%rax");
+    }
+    fprintf(asmOutput, "\tcmpq %s, %s\n", right, left);
+    return condition;
+}
+
+void emitFloatCompare(struct IrInstr *instr)
+{
+    // ucomisd reports unordered as all flags set, so every test below is false for NaN except ne
+    char operand[160];
+    struct IrInstr *a = instr->args[0];
+    struct IrInstr *b = instr->args[1];
+    int destination = destinationRegister(instr, REG_RAX);
+    if (instr->op == IR_LT || instr->op == IR_LE)
+    {
+        struct IrInstr *swap = a;
+        a = b;
+        b = swap;
+    }
+    int left = valueRegister(a);
+    if (left < 0 || !isXmmRegister(left))
+    {
+        left = REG_XMM0;
+        loadValue(a, left);
+    }
+    operandText(b, REG_XMM1, operand);
+    fprintf(asmOutput, "\tucomisd %s, %s\n", operand, registerNames[left]);
+    switch (instr->op)
+    {
+    case IR_EQ:
+        fprintf(asmOutput, "\tsete %%al\n\tsetnp %%cl\n\tandb %%cl, %%al\n");
+        break;
+
+    case IR_NE:
+        fprintf(asmOutput, "\tsetne %%al\n\tsetp %%cl\n\torb %%cl, %%al\n");
+        break;
+
+    case IR_LT:
+    case IR_GT:
+        fprintf(asmOutput, "\tseta %%al\n");
+        break;
+
+    default:
+        fprintf(asmOutput, "\tsetae %%al\n");
+        break;
+    }
+    fprintf(asmOutput, "\tmovzbq %%al, %s\n", registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitCompare(struct IrInstr *instr)
+{
+    if (asmAllocation.fused[instr->id])
+    {
+        return;
+    }
+    if (instr->args[0]->type == IR_FLOAT)
+    {
+        emitFloatCompare(instr);
+        return;
+    }
+    int destination = destinationRegister(instr, REG_RAX);
+    int condition = emitCompareFlags(instr);
+    fprintf(asmOutput, "\tset%s %%al\n\tmovzbq %%al, %s\n", conditionCodes[condition], registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitConversion(struct IrInstr *instr)
+{
+    char operand[160];
+    struct IrInstr *source = instr->args[0];
+    if (instr->op == IR_ITOF)
+    {
+        int destination = destinationRegister(instr, REG_XMM0);
+        operandText(source, REG_RAX, operand);
+        if (operand[0] == '$')
+        {
+            loadValue(source, REG_RAX);
+            strcpy(operand, "%rax");
+        }
+        fprintf(asmOutput, "\tcvtsi2sdq %s, %s\n", operand, registerNames[destination]);
+        storeValue(instr, destination);
+        return;
+    }
+    int destination = destinationRegister(instr, REG_RAX);
+    operandText(source, REG_XMM0, operand);
+    fprintf(asmOutput, "\tcvttsd2siq %s, %s\n", operand, registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitUnary(struct IrInstr *instr)
+{
+    if (instr->type == IR_FLOAT)
+    {
+        // flip the sign bit
+        loadValue(instr->args[0], REG_RAX);
+        fprintf(asmOutput, "\tbtcq $63, %%rax\n");
+        storeValue(instr, REG_RAX);
+        return;
+    }
+    int destination = destinationRegister(instr, REG_RAX);
+    loadValue(instr->args[0], destination);
+    fprintf(asmOutput, instr->op == IR_NEG ? "\tnegq %s\n" : "\txorq $1, %s\n", registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitFieldAddress(struct IrInstr *instr)
+{
+    char buffer[160];
+    struct AsmAddress address;
+    int destination = destinationRegister(instr, REG_RAX);
+    resolveAddress(instr->args[0], REG_R11, &address);
+    addressText(&address, instr->ival, buffer);
+    fprintf(asmOutput, "\tleaq %s, %s\n", buffer, registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitElementAddress(struct IrInstr *instr)
+{
+    char buffer[160];
+    struct IrInstr *index = instr->args[1];
+    long long size = instr->ival;
+    int destination = destinationRegister(instr, REG_RAX);
+    loadValue(instr->args[0], REG_R11);
+    if (index->op == IR_CONST)
+    {
+        sprintf(buffer, "%lld(%%r11)", index->ival * size);
+    }
+    else
+    {
+        loadValue(index, REG_RAX);
+        if (size == 1 || size == 2 || size == 4 || size == 8)
+        {
+            sprintf(buffer, "(%%r11,%%rax,%lld)", size);
+        }
+        else
+        {
+            fprintf(asmOutput, "\timulq $%lld, %%rax\n", size);
+            strcpy(buffer, "(%r11,%rax)");
+        }
+    }
+    fprintf(asmOutput, "\tleaq %s, %s\n", buffer, registerNames[destination]);
+    storeValue(instr, destination);
+}
+
+void emitLoad(struct IrInstr *instr)
+{
+    char buffer[160];
+    struct AsmAddress address;
+    int destination = destinationRegister(instr, instr->type == IR_FLOAT ? REG_XMM0 : REG_RAX);
+    resolveAddress(instr->args[0], REG_R11, &address);
+    addressText(&address, 0, buffer);
+    if (instr->type == IR_BOOL)
+    {
+        fprintf(asmOutput, "\tmovzbq %s, %s\n", buffer, registerNames[destination]);
+    }
+    else
+    {
+        fprintf(asmOutput, "\t%s %s, %s\n", instr->type == IR_FLOAT ? "movsd" : "movq", buffer, registerNames[destination]);
+    }
+    storeValue(instr, destination);
+}
+
+void emitStore(struct IrInstr *instr)
+{
+    char buffer[160];
+    char source[160];
+    struct AsmAddress address;
+    struct IrInstr *value = instr->args[1];
+    int reg = valueRegister(value);
+    if (value->type == IR_BOOL)
+    {
+        if (value->op == IR_CONST)
+        {
+            sprintf(source, "$%lld", value->ival);
+        }
+        else
+        {
+            loadValue(value, REG_RAX);
+            strcpy(source, "%al");
+        }
+        resolveAddress(instr->args[0], REG_R11, &address);
+        addressText(&address, 0, buffer);
+        fprintf(asmOutput, "\tmovb %s, %s\n", source, buffer);
+        return;
+    }
+    if (value->type == IR_FLOAT)
+    {
+        if (reg < 0)
+        {
+            reg = REG_XMM0;
+            loadValue(value, reg);
+        }
+        resolveAddress(instr->args[0], REG_R11, &address);
+        addressText(&address, 0, buffer);
+        fprintf(asmOutput, "\tmovsd %s, %s\n", registerNames[reg], buffer);
+        return;
+    }
+    if (value->op == IR_CONST && value->type != IR_STRING && fitsImmediate(value->ival))
+    {
+        sprintf(source, "$%lld", value->ival);
+    }
+    else if (reg >= 0)
+    {
+        strcpy(source, registerNames[reg]);
+    }
+    else
+    {
+        loadValue(value, REG_RAX);
+        strcpy(source, "%rax");
+    }
+    resolveAddress(instr->args[0], REG_R11, &address);
+    addressText(&address, 0, buffer);
+    fprintf(asmOutput, "\tmovq %s, %s\n", source, buffer);
+}
+
+void emitBlockOperation(struct IrInstr *instr)
+{
+    char destination[160];
+    char source[160];
+    struct AsmAddress target;
+    struct AsmAddress from;
+    long long size = instr->ival;
+    long long k = 0;
+    if (size > INLINE_COPY_LIMIT)
+    {
+        resolveAddress(instr->args[0], REG_R11, &target);
+        addressText(&target, 0, destination);
+        fprintf(asmOutput, "\tleaq %s, %%rax\n", destination);
+        if (instr->op == IR_COPY)
+        {
+            resolveAddress(instr->args[1], REG_R11, &from);
+            addressText(&from, 0, source);
+            fprintf(asmOutput, "\tleaq %s, %%rsi\n", source);
+        }
+        else
+        {
+            fprintf(asmOutput, "\txorl %%esi, %%esi\n");
+        }
+        fprintf(asmOutput, "\tmovq %%rax, %%rdi\n\tmovq $%lld, %%rdx\n", size);
+        emitCallTo(instr->op == IR_COPY ? "memmove@PLT" : "memset@PLT");
+        return;
+    }
+    resolveAddress(instr->args[0], REG_R11, &target);
+    if (instr->op == IR_COPY)
+    {
+        resolveAddress(instr->args[1], REG_RDX, &from);
+    }
+    for (k = 0; k < size; k += k + 8 <= size ? 8 : 1)
+    {
+        int wide = k + 8 <= size;
+        addressText(&target, k, destination);
+        if (instr->op == IR_ZERO)
+        {
+            fprintf(asmOutput, "\t%s $0, %s\n", wide ? "movq" : "movb", destination);
+            continue;
+        }
+        addressText(&from, k, source);
+        fprintf(asmOutput, wide ? "\tmovq %s, %%rax\n\tmovq %%rax, %s\n" : "\tmovb %s, %%al\n\tmovb %%al, %s\n", source, destination);
+    }
+}
+
+void emitBoundsCheck(struct IrInstr *instr)
+{
+    struct IrInstr *index = instr->args[0];
+    if (index->op == IR_CONST && index->ival >= 0 && index->ival < instr->ival)
+    {
+        return;
+    }
+    if (numberOfAsmIndexPanics == asmIndexPanicCapacity)
+    {
+        asmIndexPanicCapacity = asmIndexPanicCapacity == 0 ? 8 : asmIndexPanicCapacity * 2;
+        asmIndexPanics = realloc(asmIndexPanics, asmIndexPanicCapacity * sizeof(struct AsmIndexPanic));
+    }
+    struct AsmIndexPanic *panic = &asmIndexPanics[numberOfAsmIndexPanics++];
+    panic->label = newAsmLabel();
+    panic->length = instr->ival;
+    // one unsigned compare catches negative indexes too
+    loadValue(index, REG_RAX);
+    fprintf(asmOutput, "\tcmpq $%lld, %%rax\n\tjae .L%d\n", instr->ival, panic->label);
+}
+
+void emitCall(struct IrInstr *instr)
+{
+    int argumentRegisters[16];
+    int numberOfIntegers = 0;
+    int numberOfFloats = 0;
+    int conflict = 0;
+    int i = 0;
+    int j = 0;
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        if (instr->args[i]->type == IR_FLOAT)
+        {
+            if (numberOfFloats == 8)
+            {
+                codegenError("more than 8 float64 arguments");
+            }
+            argumentRegisters[i] = REG_XMM0 + numberOfFloats++;
+        }
+        else
+        {
+            if (numberOfIntegers == 6)
+            {
+                codegenError("more than 6 integer arguments");
+            }
+            argumentRegisters[i] = integerArgumentRegisters[numberOfIntegers++];
+        }
+    }
+    // an operand already sitting in an argument register could be overwritten before it is read
+    for (i = 0; i < instr->numberOfArgs && !conflict; i++)
+    {
+        for (j = 0; j < instr->numberOfArgs; j++)
+        {
+            if (valueRegister(instr->args[i]) == argumentRegisters[j] && i != j)
+            {
+                conflict = 1;
+            }
+        }
+    }
+    if (conflict)
+    {
+        for (i = 0; i < instr->numberOfArgs; i++)
+        {
+            loadValue(instr->args[i], REG_RAX);
+            fprintf(asmOutput, "\tmovq %%rax, %d(%%rsp)\n", 8 * i);
+        }
+        for (i = 0; i < instr->numberOfArgs; i++)
+        {
+            fprintf(asmOutput, "\t%s %d(%%rsp), %s\n", isXmmRegister(argumentRegisters[i]) ? "movsd" : "movq", 8 * i,
+                    registerNames[argumentRegisters[i]]);
+        }
+    }
+    else
+    {
+        for (i = 0; i < instr->numberOfArgs; i++)
+        {
+            loadValue(instr->args[i], argumentRegisters[i]);
+        }
+    }
+    fprintf(asmOutput, "\tcall vgo_%s\n", instr->sval);
+    if (instr->type != IR_VOID)
+    {
+        storeValue(instr, instr->type == IR_FLOAT ? REG_XMM0 : REG_RAX);
+    }
+}
+
+void emitPrint(struct IrInstr *instr)
+{
+    // operands are staged as (kind, bits) pairs, the kinds are the IR value types
+    int i = 0;
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        loadValue(instr->args[i], REG_RAX);
+        fprintf(asmOutput, "\tmovq $%d, %d(%%rsp)\n\tmovq %%rax, %d(%%rsp)\n", instr->args[i]->type, 16 * i, 16 * i + 8);
+    }
+    fprintf(asmOutput, "\tmovq $%d, %%rdi\n\tmovq %%rsp, %%rsi\n", instr->numberOfArgs);
+    emitCallTo("vgoPrintln");
+}
+
+void emitPhiMoves(struct IrBlock *from, struct IrBlock *to)
+{
+    // the phis of the target read their operands at once, so the copies are ordered to respect that
+    struct Location sources[64];
+    struct Location destinations[64];
+    int pending = 0;
+    int predIndex = 0;
+    struct IrInstr *phi = NULL;
+    while (to->preds[predIndex] != from)
+    {
+        predIndex++;
+    }
+    for (phi = to->first; phi != NULL && phi->op == IR_PHI; phi = phi->next)
+    {
+        struct IrInstr *source = phi->args[predIndex];
+        if (source == NULL || isIrRematerialized(source) || sameLocation(valueLocation(source), valueLocation(phi)))
+        {
+            continue;
+        }
+        if (pending == 64)
+        {
+            codegenError("more than 64 phis in a block");
+        }
+        sources[pending] = *valueLocation(source);
+        destinations[pending] = *valueLocation(phi);
+        pending++;
+    }
+    while (pending > 0)
+    {
+        int progress = 0;
+        int i = 0;
+        int j = 0;
+        for (i = 0; i < pending; i++)
+        {
+            int blocked = 0;
+            for (j = 0; j < pending && !blocked; j++)
+            {
+                blocked = j != i && sameLocation(&sources[j], &destinations[i]);
+            }
+            if (!blocked)
+            {
+                emitMove(&sources[i], &destinations[i]);
+                pending--;
+                sources[i] = sources[pending];
+                destinations[i] = destinations[pending];
+                progress = 1;
+                i--;
+            }
+        }
+        if (!progress)
+        {
+            // only cycles are left, park one destination in r11 to break one
+            struct Location parked = {LOCATION_REGISTER, REG_R11, 0};
+            emitMove(&destinations[0], &parked);
+            for (j = 0; j < pending; j++)
+            {
+                if (sameLocation(&sources[j], &destinations[0]))
+                {
+                    sources[j] = parked;
+                }
+            }
+        }
+    }
+    // constants and addresses cannot be overwritten by the copies, so they go last
+    for (phi = to->first; phi != NULL && phi->op == IR_PHI; phi = phi->next)
+    {
+        struct IrInstr *source = phi->args[predIndex];
+        if (source == NULL || !isIrRematerialized(source))
+        {
+            continue;
+        }
+        int reg = valueRegister(phi);
+        if (reg >= 0)
+        {
+            loadValue(source, reg);
+        }
+        else
+        {
+            loadValue(source, REG_RAX);
+            storeValue(phi, REG_RAX);
+        }
+    }
+}
+
+struct IrBlock *nextAsmBlock()
+{
+    if (asmBlockIndex + 1 < asmAllocation.numberOfBlocks)
+    {
+        return asmAllocation.order[asmBlockIndex + 1];
+    }
+    return NULL;
+}
+
+void emitJumpTo(struct IrBlock *target)
+{
+    if (target != nextAsmBlock())
+    {
+        fprintf(asmOutput, "\tjmp .Lb%d_%d\n", asmFunctionIndex, target->id);
+    }
+}
+
+void emitBranch(struct IrInstr *instr)
+{
+    struct IrInstr *condition = instr->args[0];
+    struct IrBlock *whenTrue = instr->target[0];
+    struct IrBlock *whenFalse = instr->target[1];
+    char *code = "ne";
+    char *inverse = "e";
+    if (asmAllocation.fused[condition->id])
+    {
+        int index = emitCompareFlags(condition);
+        code = conditionCodes[index];
+        inverse = inverseConditionCodes[index];
+    }
+    else
+    {
+        char operand[160];
+        int reg = valueRegister(condition);
+        if (reg >= 0)
+        {
+            fprintf(asmOutput, "\ttestq %s, %s\n", registerNames[reg], registerNames[reg]);
+        }
+        else
+        {
+            operandText(condition, REG_RAX, operand);
+            if (operand[0] == '$')
+            {
+                loadValue(condition, REG_RAX);
+                strcpy(operand, "%rax");
+            }
+            fprintf(asmOutput, "\tcmpq $0, %s\n", operand);
+        }
+    }
+    if (whenFalse == nextAsmBlock())
+    {
+        fprintf(asmOutput, "\tj%s .Lb%d_%d\n", code, asmFunctionIndex, whenTrue->id);
+    }
+    else if (whenTrue == nextAsmBlock())
+    {
+        fprintf(asmOutput, "\tj%s .Lb%d_%d\n", inverse, asmFunctionIndex, whenFalse->id);
+    }
+    else
+    {
+        fprintf(asmOutput, "\tj%s .Lb%d_%d\n", code, asmFunctionIndex, whenTrue->id);
+        fprintf(asmOutput, "\tjmp .Lb%d_%d\n", asmFunctionIndex, whenFalse->id);
+    }
+}
+
+void emitInstr(struct IrInstr *instr)
+{
+    switch (instr->op)
+    {
+    case IR_CONST:
+    case IR_SLOT:
+    case IR_GLOBAL:
+    case IR_PHI:
+        return;
+
+    case IR_PARAM:
+    {
+        struct Location home = {LOCATION_STACK, -1, -(asmSavedBytes + 8 * ((int)instr->ival + 1))};
+        emitMove(&home, valueLocation(instr));
+        return;
+    }
+
+    case IR_ADD:
+        if (instr->type == IR_STRING)
+        {
+            emitRuntimeCall2(instr->args[0], instr->args[1], "vgoConcatStrings");
+            storeValue(instr, REG_RAX);
+        }
+        else if (instr->type == IR_FLOAT)
+        {
+            emitFloatArithmetic(instr, "addsd");
+        }
+        else
+        {
+            emitIntegerArithmetic(instr, "addq");
+        }
+        return;
+
+    case IR_SUB:
+        if (instr->type == IR_FLOAT)
+        {
+            emitFloatArithmetic(instr, "subsd");
+        }
+        else
+        {
+            emitIntegerArithmetic(instr, "subq");
+        }
+        return;
+
+    case IR_MUL:
+        if (instr->type == IR_FLOAT)
+        {
+            emitFloatArithmetic(instr, "mulsd");
+        }
+        else
+        {
+            emitIntegerArithmetic(instr, "imulq");
+        }
+        return;
+
+    case IR_DIV:
+    case IR_MOD:
+        if (instr->type == IR_FLOAT)
+        {
+            emitFloatArithmetic(instr, "divsd");
+        }
+        else
+        {
+            emitDivision(instr);
+        }
+        return;
+
+    case IR_NEG:
+    case IR_NOT:
+        emitUnary(instr);
+        return;
+
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        emitCompare(instr);
+        return;
+
+    case IR_ITOF:
+    case IR_FTOI:
+        emitConversion(instr);
+        return;
+
+    case IR_FIELD:
+        if (!isIrRematerialized(instr))
+        {
+            emitFieldAddress(instr);
+        }
+        return;
+
+    case IR_ELEM:
+        emitElementAddress(instr);
+        return;
+
+    case IR_LOAD:
+        emitLoad(instr);
+        return;
+
+    case IR_STORE:
+        emitStore(instr);
+        return;
+
+    case IR_ZERO:
+    case IR_COPY:
+        emitBlockOperation(instr);
+        return;
+
+    case IR_CALL:
+        emitCall(instr);
+        return;
+
+    case IR_PRINT:
+        emitPrint(instr);
+        return;
+
+    case IR_NOW:
+        emitCallTo("vgoNow");
+        storeValue(instr, REG_RAX);
+        return;
+
+    case IR_RANDN:
+        loadValue(instr->args[0], REG_RDI);
+        emitCallTo("vgoRandIntn");
+        storeValue(instr, REG_RAX);
+        return;
+
+    case IR_BOUNDS:
+        emitBoundsCheck(instr);
+        return;
+
+    case IR_JUMP:
+        if (instr->target[0]->first != NULL && instr->target[0]->first->op == IR_PHI)
+        {
+            emitPhiMoves(instr->block, instr->target[0]);
+        }
+        emitJumpTo(instr->target[0]);
+        return;
+
+    case IR_BRANCH:
+        emitBranch(instr);
+        return;
+
+    case IR_RETURN:
+        if (instr->numberOfArgs > 0)
+        {
+            loadValue(instr->args[0], instr->args[0]->type == IR_FLOAT ? REG_XMM0 : REG_RAX);
+        }
+        if (nextAsmBlock() != NULL)
+        {
+            fprintf(asmOutput, "\tjmp .Lreturn%d\n", asmFunctionIndex);
+        }
+        return;
+
+    default:
+        codegenError("unknown instruction");
+    }
+}
+
+/*
+ * functions and module
+ */
+
+int layoutFrame(struct IrFunction *function)
+{
+    int offset = 0;
+    int outgoing = 0;
+    int i = 0;
+    asmSavedBytes = 0;
+    for (i = 0; i < 16; i++)
+    {
+        if (asmAllocation.usedCalleeSaved & (1 << i))
+        {
+            asmSavedBytes += 8;
+        }
+    }
+    offset = asmSavedBytes + 8 * function->numberOfParams;
+    asmSlotOffsets = calloc(function->nextValueId + 1, sizeof(int));
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = function->blocks[i]->first;
+        for (; instr != NULL; instr = instr->next)
+        {
+            if (instr->op == IR_SLOT)
+            {
+                offset += (int)((instr->ival + 7) & ~7LL);
+                asmSlotOffsets[instr->id] = -offset;
+            }
+            else if (instr->op == IR_CALL && 8 * instr->numberOfArgs > outgoing)
+            {
+                outgoing = 8 * instr->numberOfArgs;
+            }
+            else if (instr->op == IR_PRINT && 16 * instr->numberOfArgs > outgoing)
+            {
+                outgoing = 16 * instr->numberOfArgs;
+            }
+        }
+    }
+    for (i = 0; i < function->nextValueId; i++)
+    {
+        struct Location *location = &asmAllocation.locations[i];
+        if (location->kind == LOCATION_STACK)
+        {
+            location->offset = -(offset + 8 * (location->offset + 1));
+        }
+    }
+    offset += 8 * asmAllocation.numberOfSpillSlots;
+    // the return address and saved rbp are 16 bytes, the rest must keep rsp aligned at calls
+    int frame = offset - asmSavedBytes + outgoing;
+    if ((asmSavedBytes + frame) % 16 != 0)
+    {
+        frame += 8;
+    }
+    return frame;
+}
+
+void generateFunction(struct IrFunction *function)
+{
+    int i = 0;
+    asmFunction = function;
+    asmUsesDividePanic = 0;
+    numberOfAsmIndexPanics = 0;
+    splitIrCriticalEdges(function);
+    allocateRegisters(function, &asmAllocation);
+    int frame = layoutFrame(function);
+
+    fprintf(asmOutput, "\t.text\n\t.globl vgo_%s\n\t.type vgo_%s, @function\nvgo_%s:\n", function->name, function->name, function->name);
+    fprintf(asmOutput, "\tpushq %%rbp\n\tmovq %%rsp, %%rbp\n");
+    for (i = 0; i < 16; i++)
+    {
+        if (asmAllocation.usedCalleeSaved & (1 << i))
+        {
+            fprintf(asmOutput, "\tpushq %s\n", registerNames[i]);
+        }
+    }
+    if (frame > 0)
+    {
+        fprintf(asmOutput, "\tsubq $%d, %%rsp\n", frame);
+    }
+    int numberOfIntegers = 0;
+    int numberOfFloats = 0;
+    for (i = 0; i < function->numberOfParams; i++)
+    {
+        int home = -(asmSavedBytes + 8 * (i + 1));
+        if (function->paramTypes[i] == IR_FLOAT)
+        {
+            if (numberOfFloats == 8)
+            {
+                codegenError("more than 8 float64 parameters");
+            }
+            fprintf(asmOutput, "\tmovsd %s, %d(%%rbp)\n", registerNames[REG_XMM0 + numberOfFloats++], home);
+        }
+        else
+        {
+            if (numberOfIntegers == 6)
+            {
+                codegenError("more than 6 integer parameters");
+            }
+            fprintf(asmOutput, "\tmovq %s, %d(%%rbp)\n", registerNames[integerArgumentRegisters[numberOfIntegers++]], home);
+        }
+    }
+
+    for (asmBlockIndex = 0; asmBlockIndex < asmAllocation.numberOfBlocks; asmBlockIndex++)
+    {
+        struct IrBlock *block = asmAllocation.order[asmBlockIndex];
+        struct IrInstr *instr = block->first;
+        fprintf(asmOutput, ".Lb%d_%d:\n", asmFunctionIndex, block->id);
+        for (; instr != NULL; instr = instr->next)
+        {
+            emitInstr(instr);
+        }
+    }
+
+    fprintf(asmOutput, ".Lreturn%d:\n", asmFunctionIndex);
+    if (asmSavedBytes > 0)
+    {
+        fprintf(asmOutput, "\tleaq -%d(%%rbp), %%rsp\n", asmSavedBytes);
+    }
+    else
+    {
+        fprintf(asmOutput, "\tmovq %%rbp, %%rsp\n");
+    }
+    for (i = 15; i >= 0; i--)
+    {
+        if (asmAllocation.usedCalleeSaved & (1 << i))
+        {
+            fprintf(asmOutput, "\tpopq %s\n", registerNames[i]);
+        }
+    }
+    fprintf(asmOutput, "\tpopq %%rbp\n\tret\n");
+    if (asmUsesDividePanic)
+    {
+        fprintf(asmOutput, ".Ldivide%d:\n\tcall vgoPanicDivide\n", asmFunctionIndex);
+    }
+    for (i = 0; i < numberOfAsmIndexPanics; i++)
+    {
+        fprintf(asmOutput, ".L%d:\n\tmovq %%rax, %%rdi\n\tmovq $%lld, %%rsi\n\tcall vgoPanicIndex\n", asmIndexPanics[i].label,
+                asmIndexPanics[i].length);
+    }
+    fprintf(asmOutput, "\t.size vgo_%s, .-vgo_%s\n", function->name, function->name);
+
+    free(asmSlotOffsets);
+    asmSlotOffsets = NULL;
+    freeAllocation(&asmAllocation);
+}
+
+void generateGlobals(struct IrModule *module)
+{
+    struct IrGlobal *global = module->globals;
+    for (; global != NULL; global = global->next)
+    {
+        if (!global->initialized)
+        {
+            fprintf(asmOutput, "\t.bss\n\t.balign 8\nvgo_%s:\n\t.zero %d\n", global->name, global->size > 0 ? global->size : 1);
+            continue;
+        }
+        fprintf(asmOutput, "\t.data\n\t.balign 8\nvgo_%s:\n", global->name);
+        switch (global->type)
+        {
+        case IR_FLOAT:
+            fprintf(asmOutput, "\t.quad %lld\n", floatBits(global->dval));
+            break;
+
+        case IR_BOOL:
+            fprintf(asmOutput, "\t.byte %lld\n", global->ival);
+            break;
+
+        case IR_STRING:
+            fprintf(asmOutput, "\t.quad .LC%d\n", asmConstantLabel(1, 0, global->sval));
+            break;
+
+        default:
+            fprintf(asmOutput, "\t.quad %lld\n", global->ival);
+            break;
+        }
+    }
+}
+
+void generateAssembly(struct IrModule *module, FILE *output)
+{
+    asmOutput = output;
+    asmFunction = NULL;
+    if (irPackageName == NULL && findIrFunction(module, "main") == NULL)
+    {
+        codegenError("missing func main");
+    }
+    struct IrFunction *function = module->functions;
+    for (asmFunctionIndex = 0; function != NULL; asmFunctionIndex++)
+    {
+        generateFunction(function);
+        function = function->next;
+    }
+    asmFunction = NULL;
+    generateGlobals(module);
+    emitAsmConstants();
+    fprintf(asmOutput, "\t.section .note.GNU-stack,\"\",@progbits\n");
+    free(asmIndexPanics);
+    asmIndexPanics = NULL;
+    asmIndexPanicCapacity = 0;
+}
+
+char *findRuntime()
+{
+    // VGO_RUNTIME overrides, otherwise runtime/ next to the vgo executable, prebuilt or as source
+    static char path[PATH_MAX + 32];
+    char *fromEnvironment = getenv("VGO_RUNTIME");
+    if (fromEnvironment != NULL)
+    {
+        return fromEnvironment;
+    }
+    ssize_t length = readlink("/proc/self/exe", path, PATH_MAX);
+    if (length <= 0)
+    {
+        strcpy(path, ".");
+        length = 1;
+    }
+    path[length] = '\0';
+    char *slash = strrchr(path, '/');
+    if (slash != NULL)
+    {
+        *slash = '\0';
+    }
+    size_t directory = strlen(path);
+    strcpy(path + directory, "/runtime/vgort.o");
+    if (access(path, R_OK) == 0)
+    {
+        return path;
+    }
+    strcpy(path + directory, "/runtime/vgort.c");
+    if (access(path, R_OK) == 0)
+    {
+        return path;
+    }
+    printf("Unable to find the vgo runtime, set VGO_RUNTIME to runtime/vgort.c\n");
+    exit(3);
+    return NULL;
+}
+
+char *writeAssemblyFile(struct IrModule *module, char *output)
+{
+    char *assemblyFile = malloc(strlen(output) + 3);
+    sprintf(assemblyFile, "%s.s", output);
+    FILE *file = fopen(assemblyFile, "w");
+    if (file == NULL)
+    {
+        printf("Unable to write %s\n", assemblyFile);
+        exit(3);
+    }
+    generateAssembly(module, file);
+    fclose(file);
+    return assemblyFile;
+}
+
+void buildExecutable(struct IrModule *module, char *output)
+{
+    char *assemblyFile = writeAssemblyFile(module, output);
+    char *runtime = findRuntime();
+    // the objects of packages built with -package, as their export summaries list them
+    char *objects = importedObjects();
+    char *command = malloc(strlen(output) + strlen(assemblyFile) + strlen(runtime) + strlen(objects) + 64);
+    sprintf(command, "cc -O2 -o '%s' '%s'%s '%s'", output, assemblyFile, objects, runtime);
+    if (system(command) != 0)
+    {
+        printf("Unable to assemble and link %s\n", output);
+        exit(3);
+    }
+    if (!keepAssembly)
+    {
+        remove(assemblyFile);
+    }
+    free(objects);
+    free(command);
+    free(assemblyFile);
+}
+
+// a package built with -package is assembled on its own and linked into the programs that import it
+void buildPackageObject(struct IrModule *module, char *output)
+{
+    char *assemblyFile = writeAssemblyFile(module, output);
+    char *command = malloc(strlen(output) + strlen(assemblyFile) + 64);
+    sprintf(command, "cc -c -o '%s' '%s'", output, assemblyFile);
+    if (system(command) != 0)
+    {
+        printf("Unable to assemble %s\n", output);
+        exit(3);
+    }
+    if (!keepAssembly)
+    {
+        remove(assemblyFile);
+    }
+    free(command);
+    free(assemblyFile);
+}
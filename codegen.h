@@ -0,0 +1,86 @@
+#ifndef CODEGEN
+#define CODEGEN
+
+#include "ir.h"
+#include <stdio.h>
+
+/*
+ * x86-64 code generation from the optimized IR (System V ABI, AT&T syntax).
+ * Registers are numbered in hardware encoding order, xmm registers follow.
+ */
+
+#define REG_RAX 0
+#define REG_RCX 1
+#define REG_RDX 2
+#define REG_RBX 3
+#define REG_RSP 4
+#define REG_RBP 5
+#define REG_RSI 6
+#define REG_RDI 7
+#define REG_R8 8
+#define REG_R9 9
+#define REG_R10 10
+#define REG_R11 11
+#define REG_R12 12
+#define REG_R13 13
+#define REG_R14 14
+#define REG_R15 15
+#define REG_XMM0 16
+#define REG_XMM1 17
+#define REG_XMM15 31
+
+#define LOCATION_NONE 0
+#define LOCATION_REGISTER 1
+#define LOCATION_STACK 2
+
+// block copies and clears up to this many bytes are inlined, larger ones call the C library
+#define INLINE_COPY_LIMIT 64
+
+struct Location
+{
+    int kind;
+    int reg;
+    // spill slot index from the allocator, frame offset once the frame is laid out
+    int offset;
+};
+
+struct Allocation
+{
+    // indexed by instruction id
+    struct Location *locations;
+    // compares that are emitted as part of the branch using them
+    char *fused;
+    int numberOfSpillSlots;
+    // bit per register that the function writes and must preserve
+    int usedCalleeSaved;
+    // blocks in emission order
+    int numberOfBlocks;
+    struct IrBlock **order;
+};
+
+extern int naiveCodegen;
+extern int keepAssembly;
+extern char *outputFile;
+extern int emitC;
+
+// regalloc.c
+int isCalleeSavedRegister(int reg);
+int isIrCallPoint(struct IrInstr *instr);
+int isIrRematerialized(struct IrInstr *value);
+int isFusedCompare(struct IrInstr *instr);
+void splitIrCriticalEdges(struct IrFunction *function);
+void orderIrBlocks(struct IrFunction *function, struct Allocation *allocation);
+void allocateRegisters(struct IrFunction *function, struct Allocation *allocation);
+void freeAllocation(struct Allocation *allocation);
+
+// codegen.c
+void generateAssembly(struct IrModule *module, FILE *output);
+char *findRuntime();
+void buildExecutable(struct IrModule *module, char *output);
+void buildPackageObject(struct IrModule *module, char *output);
+
+// emitc.c
+void generateC(struct IrModule *module, FILE *output);
+void buildCExecutable(struct IrModule *module, char *output);
+
+#endif
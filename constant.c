@@ -0,0 +1,589 @@
+#include "constant.h"
+#include "tree.h"
+#include "symboltable.h"
+#include "linkedlist.h"
+#include "vgobison.tab.h"
+#include "nonterminal.h"
+#include "globalutilities.h"
+#include "literal.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Folds constant expressions at compile time. A node whose value is known
+ * gets it in node->constant, so later stages read the folded value instead of
+ * lowering the expression again. Names declared with const carry their value
+ * on the symbol (see handleConst), and reading one folds like a literal.
+ *
+ * Values follow the untyped constant rules loosely: ints and floats mix into
+ * a float, the other operators need both sides of the same type. Overflow of
+ * int64 or float64 and division by a constant zero are compile errors, like go.
+ */
+
+extern struct symboltable *globalSymbolTable;
+extern struct symboltable *currentSymbolTable;
+
+void foldConstantChildren(struct Node *treeHead);
+
+struct Constant *createConstant(int type)
+{
+    struct Constant *value = calloc(1, sizeof(struct Constant));
+    value->type = type;
+    return value;
+}
+
+// the terminal a node was built from, used for error line numbers
+struct Token *findConstantToken(struct Node *treeHead)
+{
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return NULL;
+    }
+    if (treeHead->numberOfChildren == 0)
+    {
+        return treeHead->data;
+    }
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        struct Token *token = findConstantToken(treeHead->children[i]);
+        if (token != NULL)
+        {
+            return token;
+        }
+    }
+    return NULL;
+}
+
+void constantError(struct Node *where, char *message)
+{
+    struct Token *token = findConstantToken(where);
+    if (token != NULL)
+    {
+        printf("%s at %s:%d\n", message, token->filename, token->linenumber);
+    }
+    else
+    {
+        printf("%s\n", message);
+    }
+    exit(3);
+}
+
+char *constantTypeName(int type)
+{
+    switch (type)
+    {
+    case INT:
+        return "int";
+    case FLOAT64:
+        return "float64";
+    case BOOL:
+        return "bool";
+    case STRING:
+        return "string";
+    default:
+        return "Unknown Type";
+    }
+}
+
+struct Constant *checkFloatConstant(struct Constant *value, struct Node *where)
+{
+    if (isinf(value->dval) || isnan(value->dval))
+    {
+        constantError(where, "Constant overflows float64");
+    }
+    return value;
+}
+
+struct Constant *evaluateLiteral(struct Node *leaf)
+{
+    struct Constant *value = NULL;
+    switch (leaf->data->category)
+    {
+    case NUMERICLITERAL:
+    case OCTAL:
+    case HEXADECIMAL:
+    {
+        unsigned long long magnitude = 0;
+        if (decodeIntegerLiteral(leaf->data->text, &magnitude) != LITERAL_OK || magnitude > LLONG_MAX)
+        {
+            constantError(leaf, "Constant overflows int");
+        }
+        value = createConstant(INT);
+        value->ival = (long long)magnitude;
+        return value;
+    }
+
+    case DECIMAL:
+    case SCIENTIFICNUM:
+        value = createConstant(FLOAT64);
+        decodeFloatLiteral(leaf->data->text, &value->dval);
+        return checkFloatConstant(value, leaf);
+
+    case STRINGLIT:
+        value = createConstant(STRING);
+        value->sval = leaf->data->sval;
+        return value;
+
+    case LNAME:
+    {
+        // only names declared const have a value, variables shadow them
+        struct Symbol *symbol = leaf->declaration;
+        if (symbol == NULL)
+        {
+            // a const initializer, evaluated before scopeAnalysis reaches it
+            symbol = findSymbolInTable(currentSymbolTable, leaf->data->text);
+        }
+        if (symbol != NULL && symbol->isConst)
+        {
+            return symbol->constant;
+        }
+        return NULL;
+    }
+
+    default:
+        return NULL;
+    }
+}
+
+struct Constant *convertConstant(struct Constant *value, int type, struct Node *where)
+{
+    struct Constant *converted = NULL;
+    if (value == NULL || value->type == type)
+    {
+        return value;
+    }
+    if (type == FLOAT64 && value->type == INT)
+    {
+        converted = createConstant(FLOAT64);
+        converted->dval = (double)value->ival;
+        return converted;
+    }
+    if (type == INT && value->type == FLOAT64)
+    {
+        // a constant float only converts when nothing is lost
+        if (value->dval != floor(value->dval) || value->dval < -9223372036854775808.0 || value->dval >= 9223372036854775808.0)
+        {
+            constantError(where, "Constant truncated to integer");
+        }
+        converted = createConstant(INT);
+        converted->ival = (long long)value->dval;
+        return converted;
+    }
+    printf("Cannot use constant of type %s as type %s", constantTypeName(value->type), constantTypeName(type));
+    constantError(where, "");
+    return NULL;
+}
+
+struct Constant *evaluateIntegerOperation(int operation, long long left, long long right, struct Node *where)
+{
+    struct Constant *value = createConstant(INT);
+    int overflow = 0;
+    switch (operation)
+    {
+    case PLUS:
+        overflow = __builtin_add_overflow(left, right, &value->ival);
+        break;
+
+    case MINUS:
+        overflow = __builtin_sub_overflow(left, right, &value->ival);
+        break;
+
+    case STAR:
+        overflow = __builtin_mul_overflow(left, right, &value->ival);
+        break;
+
+    case DIVIDE:
+    case MOD:
+        if (right == 0)
+        {
+            constantError(where, "Division by constant zero");
+        }
+        if (left == LLONG_MIN && right == -1)
+        {
+            overflow = operation == DIVIDE;
+            value->ival = 0;
+            break;
+        }
+        value->ival = operation == DIVIDE ? left / right : left % right;
+        break;
+
+    default:
+        return NULL;
+    }
+    if (overflow)
+    {
+        constantError(where, "Constant overflows int");
+    }
+    return value;
+}
+
+struct Constant *evaluateFloatOperation(int operation, double left, double right, struct Node *where)
+{
+    struct Constant *value = createConstant(FLOAT64);
+    switch (operation)
+    {
+    case PLUS:
+        value->dval = left + right;
+        break;
+
+    case MINUS:
+        value->dval = left - right;
+        break;
+
+    case STAR:
+        value->dval = left * right;
+        break;
+
+    case DIVIDE:
+        if (right == 0)
+        {
+            constantError(where, "Division by constant zero");
+        }
+        value->dval = left / right;
+        break;
+
+    default:
+        return NULL;
+    }
+    return checkFloatConstant(value, where);
+}
+
+// -1, 0 or 1 as left is less than, equal to or greater than right
+int compareConstants(struct Constant *left, struct Constant *right)
+{
+    switch (left->type)
+    {
+    case FLOAT64:
+        return left->dval < right->dval ? -1 : left->dval > right->dval;
+
+    case STRING:
+    {
+        int order = strcmp(left->sval, right->sval);
+        return order < 0 ? -1 : order > 0;
+    }
+
+    default:
+        return left->ival < right->ival ? -1 : left->ival > right->ival;
+    }
+}
+
+struct Constant *evaluateComparison(int operation, struct Constant *left, struct Constant *right, struct Node *where)
+{
+    struct Constant *value = createConstant(BOOL);
+    int order = 0;
+    if (left->type == BOOL && operation != LEQ && operation != LNE)
+    {
+        constantError(where, "Bools are not ordered");
+    }
+    order = compareConstants(left, right);
+    switch (operation)
+    {
+    case LEQ:
+        value->ival = order == 0;
+        break;
+    case LNE:
+        value->ival = order != 0;
+        break;
+    case LLT:
+        value->ival = order < 0;
+        break;
+    case LLE:
+        value->ival = order <= 0;
+        break;
+    case LGT:
+        value->ival = order > 0;
+        break;
+    case LGE:
+        value->ival = order >= 0;
+        break;
+    }
+    return value;
+}
+
+struct Constant *evaluateBinary(struct Node *treeHead)
+{
+    // both sides are evaluated so that their constant parts are folded too
+    struct Constant *left = evaluateConstant(treeHead->children[0]);
+    struct Constant *right = evaluateConstant(treeHead->children[2]);
+    int operation = treeHead->children[1]->data->category;
+    if (left == NULL || right == NULL)
+    {
+        return NULL;
+    }
+
+    // an int and a float constant combine as floats
+    if (left->type == FLOAT64 && right->type == INT)
+    {
+        right = convertConstant(right, FLOAT64, treeHead);
+    }
+    else if (left->type == INT && right->type == FLOAT64)
+    {
+        left = convertConstant(left, FLOAT64, treeHead);
+    }
+    if (left->type != right->type)
+    {
+        printf("Error type '%s' != type '%s' in constant operation '%s'", constantTypeName(left->type), constantTypeName(right->type), treeHead->children[1]->data->text);
+        constantError(treeHead, "");
+    }
+
+    switch (operation)
+    {
+    case LEQ:
+    case LNE:
+    case LLT:
+    case LLE:
+    case LGT:
+    case LGE:
+        return evaluateComparison(operation, left, right, treeHead);
+
+    case LANDAND:
+    case LOROR:
+    {
+        if (left->type != BOOL)
+        {
+            constantError(treeHead, "Operator needs bool constants");
+        }
+        struct Constant *value = createConstant(BOOL);
+        value->ival = operation == LANDAND ? left->ival && right->ival : left->ival || right->ival;
+        return value;
+    }
+
+    case PLUS:
+        if (left->type == STRING)
+        {
+            struct Constant *joined = createConstant(STRING);
+            joined->sval = malloc(strlen(left->sval) + strlen(right->sval) + 1);
+            strcpy(joined->sval, left->sval);
+            strcat(joined->sval, right->sval);
+            return joined;
+        }
+        break;
+
+    case MOD:
+        if (left->type == FLOAT64)
+        {
+            constantError(treeHead, "Operator % needs integer constants");
+        }
+        break;
+
+    case MINUS:
+    case STAR:
+    case DIVIDE:
+        break;
+
+    default:
+        // shifts and bit clearing are left to the later stages to reject
+        return NULL;
+    }
+
+    if (left->type == INT)
+    {
+        return evaluateIntegerOperation(operation, left->ival, right->ival, treeHead);
+    }
+    if (left->type == FLOAT64)
+    {
+        return evaluateFloatOperation(operation, left->dval, right->dval, treeHead);
+    }
+    constantError(treeHead, "Operator needs number constants");
+    return NULL;
+}
+
+struct Constant *evaluateUnary(struct Node *treeHead)
+{
+    struct Constant *operand = evaluateConstant(treeHead->children[1]);
+    struct Constant *value = NULL;
+    if (operand == NULL)
+    {
+        return NULL;
+    }
+    switch (treeHead->children[0]->data->category)
+    {
+    case PLUS:
+        if (operand->type != INT && operand->type != FLOAT64)
+        {
+            constantError(treeHead, "Operator needs number constants");
+        }
+        return operand;
+
+    case MINUS:
+        if (operand->type == INT)
+        {
+            return evaluateIntegerOperation(MINUS, 0, operand->ival, treeHead);
+        }
+        if (operand->type == FLOAT64)
+        {
+            value = createConstant(FLOAT64);
+            value->dval = -operand->dval;
+            return value;
+        }
+        constantError(treeHead, "Operator needs number constants");
+        return NULL;
+
+    case EXCLAMATION:
+        if (operand->type != BOOL)
+        {
+            constantError(treeHead, "Operator ! needs a bool constant");
+        }
+        value = createConstant(BOOL);
+        value->ival = !operand->ival;
+        return value;
+
+    default:
+        return NULL;
+    }
+}
+
+struct Constant *evaluateConversion(struct Node *treeHead)
+{
+    // (type, expr) after lowering, only the basic numeric types fold
+    struct Node *typeNode = treeHead->children[0];
+    struct Constant *operand = evaluateConstant(treeHead->children[1]);
+    while (typeNode != NULL && typeNode->numberOfChildren == 1)
+    {
+        typeNode = typeNode->children[0];
+    }
+    if (operand == NULL || typeNode == NULL || typeNode->numberOfChildren > 0)
+    {
+        return NULL;
+    }
+    switch (typeNode->data->category)
+    {
+    case INT:
+    case FLOAT64:
+        if (operand->type != INT && operand->type != FLOAT64)
+        {
+            return NULL;
+        }
+        return convertConstant(operand, typeNode->data->category, treeHead);
+
+    default:
+        return NULL;
+    }
+}
+
+struct Constant *evaluateConstant(struct Node *treeHead)
+{
+    struct Constant *value = NULL;
+    if (treeHead == NULL)
+    {
+        return NULL;
+    }
+    if (treeHead->constant != NULL)
+    {
+        return treeHead->constant;
+    }
+    if (treeHead->numberOfChildren == 0)
+    {
+        value = treeHead->data != NULL ? evaluateLiteral(treeHead) : NULL;
+    }
+    else
+    {
+        switch (treeHead->category)
+        {
+        case expr:
+            if (treeHead->numberOfChildren == 3)
+            {
+                value = evaluateBinary(treeHead);
+            }
+            break;
+
+        case uexpr:
+            value = evaluateUnary(treeHead);
+            break;
+
+        case pexpr:
+        case expr_or_type:
+        case expr_list:
+            // parentheses and single expression wrappers
+            if (treeHead->numberOfChildren == 1)
+            {
+                value = evaluateConstant(treeHead->children[0]);
+            }
+            else if (treeHead->category == pexpr && treeHead->numberOfChildren == 3)
+            {
+                value = evaluateConstant(treeHead->children[1]);
+            }
+            break;
+
+        case pexpr_no_paren:
+            if (treeHead->numberOfChildren == 1)
+            {
+                value = evaluateConstant(treeHead->children[0]);
+            }
+            else if (treeHead->numberOfChildren == 2)
+            {
+                value = evaluateConversion(treeHead);
+            }
+            else
+            {
+                foldConstantChildren(treeHead);
+            }
+            break;
+
+        default:
+            // calls and the like are never constant, but their operands may be
+            foldConstantChildren(treeHead);
+            break;
+        }
+    }
+    treeHead->constant = value;
+    return value;
+}
+
+int isConstantExpression(int category)
+{
+    switch (category)
+    {
+    case expr:
+    case uexpr:
+    case pexpr:
+    case pexpr_no_paren:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+void foldConstantChildren(struct Node *treeHead)
+{
+    int i = 0;
+    if (treeHead->category == pexpr_no_paren && treeHead->numberOfChildren == 3 && treeHead->children[1]->numberOfChildren == 0 &&
+        treeHead->children[1]->data->category == PERIOD)
+    {
+        // a selector, the name after the period is a field and never a constant
+        foldConstants(treeHead->children[0]);
+        return;
+    }
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        foldConstants(treeHead->children[i]);
+    }
+}
+
+void foldConstants(struct Node *treeHead)
+{
+    if (treeHead == NULL || treeHead->numberOfChildren == 0)
+    {
+        return;
+    }
+    if (isConstantExpression(treeHead->category))
+    {
+        // evaluation folds every constant operand on its way down
+        evaluateConstant(treeHead);
+        return;
+    }
+    if (treeHead->category == xfndcl && treeHead->children[1]->category == fndcl && treeHead->children[1]->children[0]->data != NULL)
+    {
+        // names in a body resolve in the function's table, as in type analysis
+        currentSymbolTable = findSymbolTable(treeHead->children[1]->children[0]->data->text);
+        foldConstantChildren(treeHead);
+        currentSymbolTable = globalSymbolTable;
+        return;
+    }
+    foldConstantChildren(treeHead);
+}
@@ -0,0 +1,24 @@
+#ifndef CONSTANT
+#define CONSTANT
+
+#include "tree.h"
+
+/*
+ * Compile-time values of constant expressions. type is the checker's type
+ * category (INT, FLOAT64, BOOL or STRING) and the matching field holds the
+ * value, bools are kept in ival as 0 or 1.
+ */
+struct Constant
+{
+    int type;
+    long long ival;
+    double dval;
+    char *sval;
+};
+
+struct Constant *evaluateConstant(struct Node *treeHead);
+char *constantTypeName(int type);
+struct Constant *convertConstant(struct Constant *value, int type, struct Node *where);
+void foldConstants(struct Node *treeHead);
+
+#endif
@@ -0,0 +1,622 @@
+#include "codegen.h"
+#include "ir.h"
+#include <libgen.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * C99 output for -emit-c. The optimized IR is written out as one C function
+ * per IR function: every SSA value becomes a local, blocks become labels and
+ * phis are assigned through a shadow local at the end of each predecessor.
+ * Structs are declared as C structs with the IR's offsets, struct and array
+ * variables as typed C arrays, and memory is reached with the same address
+ * arithmetic the other backends use. The builtins come from
+ * runtime/vgoc.h and vgort.c, so the system compiler does the rest.
+ */
+
+int emitC = 0;
+
+FILE *cOutput;
+
+// go names that would not be valid as C field names
+char *cKeywords[] = {"auto", "char", "const", "do", "double", "enum", "extern", "float", "inline", "long", "register",
+                     "restrict", "short", "signed", "sizeof", "static", "union", "unsigned", "void", "volatile", "while", NULL};
+
+void cError(char *message)
+{
+    printf("Unable to generate C: %s\n", message);
+    exit(3);
+}
+
+// the type of a value in a C local
+char *cValueType(int type)
+{
+    switch (type)
+    {
+    case IR_FLOAT:
+        return "double";
+    case IR_STRING:
+    case IR_ADDR:
+        return "char *";
+    case IR_VOID:
+        return "void";
+    default:
+        return "long long";
+    }
+}
+
+// the type of a value in memory, bools take one byte
+char *cMemoryType(int type)
+{
+    return type == IR_BOOL ? "unsigned char" : cValueType(type);
+}
+
+// pointer declarators are written against the name
+char *cSeparator(char *type)
+{
+    return type[strlen(type) - 1] == '*' ? "" : " ";
+}
+
+void emitCFieldName(char *name)
+{
+    int i = 0;
+    fprintf(cOutput, "%s", name);
+    for (i = 0; cKeywords[i] != NULL; i++)
+    {
+        if (strcmp(cKeywords[i], name) == 0)
+        {
+            fprintf(cOutput, "_");
+        }
+    }
+}
+
+void emitCString(char *text)
+{
+    // everything but plain printable characters is an octal escape, ? too so no trigraph forms
+    unsigned char *cursor = (unsigned char *)(text != NULL ? text : "");
+    fputc('"', cOutput);
+    for (; *cursor != '\0'; cursor++)
+    {
+        if (*cursor >= ' ' && *cursor < 127 && *cursor != '"' && *cursor != '\\' && *cursor != '?')
+        {
+            fputc(*cursor, cOutput);
+        }
+        else
+        {
+            fprintf(cOutput, "\\%03o", *cursor);
+        }
+    }
+    fputc('"', cOutput);
+}
+
+void emitCFloat(double value)
+{
+    char buffer[64];
+    if (isnan(value))
+    {
+        fprintf(cOutput, "NAN");
+        return;
+    }
+    if (isinf(value))
+    {
+        fprintf(cOutput, value > 0 ? "HUGE_VAL" : "-HUGE_VAL");
+        return;
+    }
+    // 17 significant digits read back as the same double
+    snprintf(buffer, sizeof(buffer), "%.17g", value);
+    fprintf(cOutput, "%s%s", buffer, strpbrk(buffer, ".e") == NULL ? ".0" : "");
+}
+
+void emitCInteger(long long value)
+{
+    if (value == -9223372036854775807LL - 1)
+    {
+        fprintf(cOutput, "(-9223372036854775807LL - 1)");
+        return;
+    }
+    fprintf(cOutput, "%lldLL", value);
+}
+
+/*
+ * declarations
+ */
+
+int isCStructEmitted(struct IrStruct *structType, struct IrStruct **emitted, int count)
+{
+    int i = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (emitted[i] == structType)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void emitCStruct(struct IrStruct *structType, struct IrStruct **emitted, int *count)
+{
+    int i = 0;
+    int offset = 0;
+    int padding = 0;
+    if (isCStructEmitted(structType, emitted, *count))
+    {
+        return;
+    }
+    // nested structs must be complete before they are used as a member
+    for (i = 0; i < structType->numberOfFields; i++)
+    {
+        if (structType->fields[i].structType != NULL)
+        {
+            emitCStruct(structType->fields[i].structType, emitted, count);
+        }
+    }
+    emitted[(*count)++] = structType;
+
+    fprintf(cOutput, "struct vgo_%s\n{\n", structType->name);
+    // members by offset, with explicit padding wherever the layout left a hole
+    while (offset < structType->size)
+    {
+        struct IrField *next = NULL;
+        for (i = 0; i < structType->numberOfFields; i++)
+        {
+            struct IrField *field = &structType->fields[i];
+            if (field->offset >= offset && field->size > 0 && (next == NULL || field->offset < next->offset))
+            {
+                next = field;
+            }
+        }
+        if (next == NULL || next->offset > offset)
+        {
+            int end = next == NULL ? structType->size : next->offset;
+            fprintf(cOutput, "    unsigned char padding%d[%d];\n", padding++, end - offset);
+            offset = end;
+            continue;
+        }
+        if (next->structType != NULL)
+        {
+            fprintf(cOutput, "    struct vgo_%s ", next->structType->name);
+        }
+        else
+        {
+            fprintf(cOutput, "    %s%s", cMemoryType(next->type), cSeparator(cMemoryType(next->type)));
+        }
+        emitCFieldName(next->name);
+        fprintf(cOutput, ";\n");
+        offset = next->offset + next->size;
+    }
+    if (structType->size == 0)
+    {
+        // C has no empty structs, nothing addresses this byte
+        fprintf(cOutput, "    unsigned char empty;\n");
+    }
+    fprintf(cOutput, "};\n");
+    if (structType->size > 0)
+    {
+        // fails to compile if C laid the struct out differently
+        fprintf(cOutput, "typedef char vgo_%s_size[sizeof(struct vgo_%s) == %d ? 1 : -1];\n", structType->name, structType->name, structType->size);
+    }
+    fprintf(cOutput, "\n");
+}
+
+// storage for count elements of a struct or scalar type
+void emitCStorage(char *name, int type, struct IrStruct *structType, int count, int isArray)
+{
+    if (structType != NULL)
+    {
+        fprintf(cOutput, "struct vgo_%s %s", structType->name, name);
+    }
+    else
+    {
+        fprintf(cOutput, "%s%s%s", cMemoryType(type), cSeparator(cMemoryType(type)), name);
+    }
+    if (isArray)
+    {
+        fprintf(cOutput, "[%d]", count > 0 ? count : 1);
+    }
+}
+
+void emitCGlobal(struct IrGlobal *global)
+{
+    char name[256];
+    snprintf(name, sizeof(name), "vgo_%s", global->name);
+    emitCStorage(name, global->type, global->structType, global->arraySize, global->arraySize >= 0);
+    if (global->initialized)
+    {
+        fprintf(cOutput, " = ");
+        switch (global->type)
+        {
+        case IR_FLOAT:
+            emitCFloat(global->dval);
+            break;
+
+        case IR_STRING:
+            emitCString(global->sval);
+            break;
+
+        default:
+            emitCInteger(global->ival);
+            break;
+        }
+    }
+    fprintf(cOutput, ";\n");
+}
+
+void emitCPrototype(struct IrFunction *function)
+{
+    int i = 0;
+    int isMain = strcmp(function->name, "main") == 0;
+    char *returnType = cValueType(function->returnType);
+    fprintf(cOutput, "%s%s%svgo_%s(", isMain ? "" : "static ", returnType, cSeparator(returnType), function->name);
+    for (i = 0; i < function->numberOfParams; i++)
+    {
+        char *type = cValueType(function->paramTypes[i]);
+        fprintf(cOutput, "%s%s%sa%d", i > 0 ? ", " : "", type, cSeparator(type), i);
+    }
+    fprintf(cOutput, "%s)", function->numberOfParams == 0 ? "void" : "");
+}
+
+/*
+ * function bodies
+ */
+
+void emitCBinary(struct IrInstr *instr, char *operator, char *wrapping)
+{
+    int left = instr->args[0]->id;
+    int right = instr->args[1]->id;
+    if (instr->type == IR_INT && wrapping != NULL)
+    {
+        fprintf(cOutput, "    v%d = %s(v%d, v%d);\n", instr->id, wrapping, left, right);
+        return;
+    }
+    fprintf(cOutput, "    v%d = v%d %s v%d;\n", instr->id, left, operator, right);
+}
+
+void emitCCompare(struct IrInstr *instr)
+{
+    static char *operators[] = {"==", "!=", "<", "<=", ">", ">="};
+    char *operator = operators[instr->op - IR_EQ];
+    int left = instr->args[0]->id;
+    int right = instr->args[1]->id;
+    if (instr->args[0]->type == IR_STRING)
+    {
+        fprintf(cOutput, "    v%d = vgoCompareStrings(v%d, v%d) %s 0;\n", instr->id, left, right, operator);
+        return;
+    }
+    fprintf(cOutput, "    v%d = v%d %s v%d;\n", instr->id, left, operator, right);
+}
+
+void emitCCall(struct IrInstr *instr)
+{
+    int i = 0;
+    fprintf(cOutput, "    ");
+    if (instr->type != IR_VOID)
+    {
+        fprintf(cOutput, "v%d = ", instr->id);
+    }
+    fprintf(cOutput, "vgo_%s(", instr->sval);
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        fprintf(cOutput, "%sv%d", i > 0 ? ", " : "", instr->args[i]->id);
+    }
+    fprintf(cOutput, ");\n");
+}
+
+void emitCPrint(struct IrInstr *instr)
+{
+    static char *makers[] = {"vgoPrintInt", "vgoPrintInt", "vgoPrintFloat", "vgoPrintBool", "vgoPrintString"};
+    int i = 0;
+    if (instr->numberOfArgs == 0)
+    {
+        fprintf(cOutput, "    vgoPrintln(0, NULL);\n");
+        return;
+    }
+    fprintf(cOutput, "    {\n        struct VgoPrintOperand operands[] = {");
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        int type = instr->args[i]->type;
+        fprintf(cOutput, "%s%s(v%d)", i > 0 ? ", " : "", makers[type >= IR_INT && type <= IR_STRING ? type : IR_INT], instr->args[i]->id);
+    }
+    fprintf(cOutput, "};\n        vgoPrintln(%d, operands);\n    }\n", instr->numberOfArgs);
+}
+
+void emitCPhiCopies(struct IrBlock *from, struct IrBlock *to)
+{
+    // into the shadows only, the phis themselves change when the block is entered
+    int predIndex = 0;
+    struct IrInstr *phi = NULL;
+    while (to->preds[predIndex] != from)
+    {
+        predIndex++;
+    }
+    for (phi = to->first; phi != NULL && phi->op == IR_PHI; phi = phi->next)
+    {
+        if (phi->args[predIndex] != NULL)
+        {
+            fprintf(cOutput, "    p%d = v%d;\n", phi->id, phi->args[predIndex]->id);
+        }
+    }
+}
+
+void emitCInstr(struct IrInstr *instr)
+{
+    int operand = instr->numberOfArgs > 0 ? instr->args[0]->id : -1;
+    switch (instr->op)
+    {
+    case IR_PARAM:
+        fprintf(cOutput, "    v%d = a%lld;\n", instr->id, instr->ival);
+        return;
+
+    case IR_PHI:
+        fprintf(cOutput, "    v%d = p%d;\n", instr->id, instr->id);
+        return;
+
+    case IR_CONST:
+        fprintf(cOutput, "    v%d = ", instr->id);
+        if (instr->type == IR_FLOAT)
+        {
+            emitCFloat(instr->dval);
+        }
+        else if (instr->type == IR_STRING)
+        {
+            emitCString(instr->sval);
+        }
+        else
+        {
+            emitCInteger(instr->ival);
+        }
+        fprintf(cOutput, ";\n");
+        return;
+
+    case IR_ADD:
+        if (instr->type == IR_STRING)
+        {
+            fprintf(cOutput, "    v%d = vgoConcatStrings(v%d, v%d);\n", instr->id, operand, instr->args[1]->id);
+            return;
+        }
+        emitCBinary(instr, "+", "VGO_ADD");
+        return;
+
+    case IR_SUB:
+        emitCBinary(instr, "-", "VGO_SUB");
+        return;
+
+    case IR_MUL:
+        emitCBinary(instr, "*", "VGO_MUL");
+        return;
+
+    case IR_DIV:
+        emitCBinary(instr, "/", "vgoDivide");
+        return;
+
+    case IR_MOD:
+        emitCBinary(instr, "%", "vgoModulo");
+        return;
+
+    case IR_NEG:
+        if (instr->type == IR_INT)
+        {
+            fprintf(cOutput, "    v%d = VGO_NEG(v%d);\n", instr->id, operand);
+            return;
+        }
+        fprintf(cOutput, "    v%d = -v%d;\n", instr->id, operand);
+        return;
+
+    case IR_NOT:
+        fprintf(cOutput, "    v%d = !v%d;\n", instr->id, operand);
+        return;
+
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        emitCCompare(instr);
+        return;
+
+    case IR_ITOF:
+        fprintf(cOutput, "    v%d = (double)v%d;\n", instr->id, operand);
+        return;
+
+    case IR_FTOI:
+        fprintf(cOutput, "    v%d = vgoFloatToInt(v%d);\n", instr->id, operand);
+        return;
+
+    case IR_SLOT:
+        fprintf(cOutput, "    v%d = (char *)s%d;\n", instr->id, instr->id);
+        return;
+
+    case IR_GLOBAL:
+        fprintf(cOutput, "    v%d = (char *)&vgo_%s;\n", instr->id, instr->sval);
+        return;
+
+    case IR_FIELD:
+        fprintf(cOutput, "    v%d = v%d + %lld;\n", instr->id, operand, instr->ival);
+        return;
+
+    case IR_ELEM:
+        fprintf(cOutput, "    v%d = v%d + v%d * %lld;\n", instr->id, operand, instr->args[1]->id, instr->ival);
+        return;
+
+    case IR_LOAD:
+        fprintf(cOutput, "    v%d = *(%s *)v%d;\n", instr->id, cMemoryType(instr->type), operand);
+        return;
+
+    case IR_STORE:
+        fprintf(cOutput, "    *(%s *)v%d = v%d;\n", cMemoryType(instr->args[1]->type), operand, instr->args[1]->id);
+        return;
+
+    case IR_ZERO:
+        fprintf(cOutput, "    memset(v%d, 0, %lld);\n", operand, instr->ival);
+        return;
+
+    case IR_COPY:
+        fprintf(cOutput, "    memmove(v%d, v%d, %lld);\n", operand, instr->args[1]->id, instr->ival);
+        return;
+
+    case IR_BOUNDS:
+        fprintf(cOutput, "    vgoCheckIndex(v%d, %lld);\n", operand, instr->ival);
+        return;
+
+    case IR_CALL:
+        emitCCall(instr);
+        return;
+
+    case IR_PRINT:
+        emitCPrint(instr);
+        return;
+
+    case IR_NOW:
+        fprintf(cOutput, "    v%d = vgoNow();\n", instr->id);
+        return;
+
+    case IR_RANDN:
+        fprintf(cOutput, "    v%d = vgoRandIntn(v%d);\n", instr->id, operand);
+        return;
+
+    case IR_JUMP:
+        emitCPhiCopies(instr->block, instr->target[0]);
+        fprintf(cOutput, "    goto b%d;\n", instr->target[0]->id);
+        return;
+
+    case IR_BRANCH:
+        emitCPhiCopies(instr->block, instr->target[0]);
+        emitCPhiCopies(instr->block, instr->target[1]);
+        fprintf(cOutput, "    if (v%d)\n        goto b%d;\n    goto b%d;\n", operand, instr->target[0]->id, instr->target[1]->id);
+        return;
+
+    case IR_RETURN:
+        if (operand >= 0)
+        {
+            fprintf(cOutput, "    return v%d;\n", operand);
+            return;
+        }
+        fprintf(cOutput, "    return;\n");
+        return;
+
+    default:
+        cError(irOpName(instr->op));
+    }
+}
+
+void emitCFunction(struct IrFunction *function)
+{
+    int i = 0;
+    struct IrInstr *instr = NULL;
+    emitCPrototype(function);
+    fprintf(cOutput, "\n{\n");
+
+    // every value is declared up front, labels cannot be followed by declarations in C99
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        for (instr = function->blocks[i]->first; instr != NULL; instr = instr->next)
+        {
+            if (instr->op == IR_SLOT)
+            {
+                char name[32];
+                int elementSize = instr->slotStruct != NULL ? instr->slotStruct->size : irTypeSize(instr->slotType);
+                sprintf(name, "s%d", instr->id);
+                fprintf(cOutput, "    ");
+                emitCStorage(name, instr->slotType, instr->slotStruct, elementSize > 0 ? (int)(instr->ival / elementSize) : 1, 1);
+                fprintf(cOutput, ";\n");
+            }
+            if (instr->type != IR_VOID)
+            {
+                fprintf(cOutput, "    %s%sv%d;\n", cValueType(instr->type), cSeparator(cValueType(instr->type)), instr->id);
+            }
+            if (instr->op == IR_PHI)
+            {
+                fprintf(cOutput, "    %s%sp%d;\n", cValueType(instr->type), cSeparator(cValueType(instr->type)), instr->id);
+            }
+        }
+    }
+
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        fprintf(cOutput, "b%d:;\n", block->id);
+        for (instr = block->first; instr != NULL; instr = instr->next)
+        {
+            emitCInstr(instr);
+        }
+    }
+    fprintf(cOutput, "}\n\n");
+}
+
+void generateC(struct IrModule *module, FILE *output)
+{
+    struct IrStruct *structType = NULL;
+    struct IrGlobal *global = NULL;
+    struct IrFunction *function = NULL;
+    struct IrStruct **emitted = NULL;
+    int count = 0;
+    cOutput = output;
+    if (findIrFunction(module, "main") == NULL)
+    {
+        cError("missing func main");
+    }
+
+    fprintf(cOutput, "/* generated by vgo -emit-c */\n#include \"vgoc.h\"\n\n");
+    for (structType = module->structs; structType != NULL; structType = structType->next)
+    {
+        count++;
+    }
+    emitted = calloc(count + 1, sizeof(struct IrStruct *));
+    count = 0;
+    for (structType = module->structs; structType != NULL; structType = structType->next)
+    {
+        emitCStruct(structType, emitted, &count);
+    }
+    free(emitted);
+
+    for (global = module->globals; global != NULL; global = global->next)
+    {
+        emitCGlobal(global);
+    }
+    fprintf(cOutput, "\n");
+    for (function = module->functions; function != NULL; function = function->next)
+    {
+        emitCPrototype(function);
+        fprintf(cOutput, ";\n");
+    }
+    fprintf(cOutput, "\n");
+    for (function = module->functions; function != NULL; function = function->next)
+    {
+        emitCFunction(function);
+    }
+}
+
+void buildCExecutable(struct IrModule *module, char *output)
+{
+    char *sourceFile = malloc(strlen(output) + 3);
+    sprintf(sourceFile, "%s.c", output);
+    FILE *file = fopen(sourceFile, "w");
+    if (file == NULL)
+    {
+        printf("Unable to write %s\n", sourceFile);
+        exit(3);
+    }
+    generateC(module, file);
+    fclose(file);
+
+    // vgoc.h sits next to the runtime
+    char *runtime = findRuntime();
+    char *runtimeDirectory = strdup(runtime);
+    runtimeDirectory = dirname(runtimeDirectory);
+    char *command = malloc(strlen(output) + strlen(sourceFile) + strlen(runtime) + strlen(runtimeDirectory) + 64);
+    sprintf(command, "cc -O2 -I'%s' -o '%s' '%s' '%s'", runtimeDirectory, output, sourceFile, runtime);
+    if (system(command) != 0)
+    {
+        printf("Unable to compile and link %s\n", output);
+        exit(3);
+    }
+    if (!keepAssembly)
+    {
+        remove(sourceFile);
+    }
+    free(command);
+    free(sourceFile);
+}
@@ -2,12 +2,21 @@
 #include "vgobison.tab.h"
 #include "nonterminal.h"
 #include "tree.h"
+#include "probes.h"
+#include "parsedecl.h"
 #include <stdlib.h>
 #include <stdio.h>
 
 int yyerror(char *string)
 {
-    printf("%s\t%s:%d: before '%s' \n", string, currentfile, yylineno, yylval.node->data->text);
+    if (declarationParse != NULL)
+    {
+        // a parse of one declaration on its own, the file is parsed again in order to report the error
+        declarationParse->failed = 1;
+        return 0;
+    }
+    PROBE_ERROR("syntax", scannerLine(), string);
+    printf("%s\t%s:%d: before '%s' \n", string, currentfile, scannerLine(), scannerToken()->data->text);
     exit(2);
 }
 
@@ -21,6 +30,7 @@ char *findTypeName(int typeId)
     case HEXADECIMAL:
         return "int";
 
+    case FLOAT64:
     case DECIMAL:
     case SCIENTIFICNUM:
         return "float64";
@@ -28,6 +38,7 @@ char *findTypeName(int typeId)
     case BOOL:
         return "bool";
 
+    case STRING:
     case CHAR:
     case STRINGLIT:
         return "string";
@@ -54,6 +65,7 @@ int findTypeCategory(int typeId)
     case HEXADECIMAL:
         return INT;
 
+    case FLOAT64:
     case DECIMAL:
     case SCIENTIFICNUM:
         return FLOAT64;
@@ -61,6 +73,7 @@ int findTypeCategory(int typeId)
     case BOOL:
         return BOOL;
 
+    case STRING:
     case CHAR:
     case STRINGLIT:
         return STRING;
@@ -7,15 +7,21 @@
 
 int printCode;
 
-extern int yylineno;
-extern char *yytext;
-extern FILE *yyin;
+// the reentrant scanner in vgolex.l that yyparse reads from, made by createScanner
+extern void *scanner;
+void createScanner();
+int scannerLine();
+struct Node *scannerToken();
+extern void yyrestart(FILE *input, void *scanner);
+extern void yyset_in(FILE *input, void *scanner);
+extern void yyset_lineno(int line, void *scanner);
 extern void *yylast;
 extern int yyprev();
 char *currentfile;
 extern int yylex();
+extern double lexingTime;
+extern long long lexedTokens;
 int yyerror(char *string);
-extern YYSTYPE yylval;
 char *findTypeName(int typeId);
 int findTypeCategory(int typeId);
 int compareLeftAndRightTypes(int leftType, int righttype);
@@ -0,0 +1,423 @@
+#include "intern.h"
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Slots go from NULL to an entry exactly once, so a reader that loads a slot
+ * with acquire order sees the whole entry and a probe only has to stop at the
+ * first empty slot. Growing copies the entries to new slots and publishes
+ * them with one store, see growSlots.
+ */
+
+// closes an empty slot of slots that are being replaced
+#define MOVED_SLOT ((void *)1)
+
+struct Interner *identifierInterner = NULL;
+
+unsigned long long hashIdentifier(char *text, int length)
+{
+    // FNV-1a, then mixed so the low bits used for the slot depend on every byte
+    unsigned long long hash = 14695981039346656037ULL;
+    int i = 0;
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 32;
+    hash *= 0xd6e8feb86659fd93ULL;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+int roundCapacity(int capacity)
+{
+    int rounded = 16;
+    while (rounded < capacity)
+    {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+// more than three quarters full
+int isCrowded(int count, int capacity)
+{
+    return (long long)count * 4 > (long long)capacity * 3;
+}
+
+struct TableSlots *createSlots(int capacity)
+{
+    struct TableSlots *table = calloc(1, sizeof(struct TableSlots) + capacity * sizeof(void *));
+    table->capacity = capacity;
+    return table;
+}
+
+/*
+ * Copies the entries of *current to slots of the given capacity. Each empty
+ * slot is closed with MOVED_SLOT as it is passed, so an insert racing with the
+ * copy either lands first and is copied, or finds MOVED_SLOT and waits for
+ * the new slots. A lookup never waits: an entry that is in the old slots stays
+ * where it is, and one that is not can only be inserted into the new ones.
+ * Only one thread at a time may copy, growSlots sees to that.
+ */
+void moveSlots(struct TableSlots **current, int *count, int shared, int capacity, unsigned long long (*hashOf)(void *entry))
+{
+    struct TableSlots *old = *current;
+    struct TableSlots *table = createSlots(capacity);
+    int mask = capacity - 1;
+    int copied = 0;
+    int i = 0;
+    for (i = 0; i < old->capacity; i++)
+    {
+        void *entry = NULL;
+        if (__atomic_compare_exchange_n(&old->slots[i], &entry, MOVED_SLOT, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+        int slot = (int)(hashOf(entry) & mask);
+        while (table->slots[slot] != NULL)
+        {
+            slot = (slot + 1) & mask;
+        }
+        table->slots[slot] = entry;
+        copied++;
+    }
+    // an insert into the old slots that has not counted itself yet counts once more here, growing a little early
+    __atomic_store_n(count, copied, __ATOMIC_RELAXED);
+    if (shared)
+    {
+        table->replaced = old;
+    }
+    else
+    {
+        table->replaced = old->replaced;
+        free(old);
+    }
+    __atomic_store_n(current, table, __ATOMIC_RELEASE);
+}
+
+/*
+ * Replaces seen with slots twice its size, unless another thread already has.
+ * The thread that crowded the slots grows them without waiting; one that
+ * found them closed or full has to wait for the new slots before it can
+ * insert, so it either does the copy or yields until the copy is published.
+ */
+void growSlots(struct TableSlots **current, int *count, int *growing, int shared, struct TableSlots *seen, unsigned long long (*hashOf)(void *entry),
+               int wait)
+{
+    int idle = 0;
+    if (__atomic_compare_exchange_n(growing, &idle, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        if (__atomic_load_n(current, __ATOMIC_ACQUIRE) == seen)
+        {
+            moveSlots(current, count, shared, seen->capacity * 2, hashOf);
+        }
+        __atomic_store_n(growing, 0, __ATOMIC_RELEASE);
+        return;
+    }
+    while (wait && __atomic_load_n(current, __ATOMIC_ACQUIRE) == seen)
+    {
+        sched_yield();
+    }
+}
+
+void reserveSlots(struct TableSlots **current, int *count, int more, unsigned long long (*hashOf)(void *entry))
+{
+    int capacity = (*current)->capacity;
+    while (isCrowded(*count + more, capacity))
+    {
+        capacity *= 2;
+    }
+    if (capacity != (*current)->capacity)
+    {
+        moveSlots(current, count, 0, capacity, hashOf);
+    }
+}
+
+// once no other thread can be probing them
+void releaseReplacedSlots(struct TableSlots *table)
+{
+    struct TableSlots *replaced = table->replaced;
+    while (replaced != NULL)
+    {
+        struct TableSlots *next = replaced->replaced;
+        free(replaced);
+        replaced = next;
+    }
+    table->replaced = NULL;
+}
+
+/*
+ * identifiers
+ */
+
+struct Interner *createInterner(int capacity)
+{
+    struct Interner *interner = calloc(1, sizeof(struct Interner));
+    interner->table = createSlots(roundCapacity(capacity));
+    return interner;
+}
+
+unsigned long long internEntryHash(void *entry)
+{
+    return ((struct InternEntry *)entry)->hash;
+}
+
+void growInterner(struct Interner *interner, struct TableSlots *seen, int wait)
+{
+    growSlots(&interner->table, &interner->count, &interner->growing, interner->shared, seen, internEntryHash, wait);
+}
+
+void reserveInterner(struct Interner *interner, int more)
+{
+    reserveSlots(&interner->table, &interner->count, more, internEntryHash);
+}
+
+void shareInterner(struct Interner *interner, int shared)
+{
+    interner->shared = shared;
+    if (!shared)
+    {
+        releaseReplacedSlots(interner->table);
+    }
+}
+
+int isInternEntry(struct InternEntry *entry, unsigned long long hash, char *text, int length)
+{
+    return entry->hash == hash && entry->length == length && memcmp(entry->text, text, length) == 0;
+}
+
+char *findInternedText(struct Interner *interner, char *text, int length)
+{
+    unsigned long long hash = hashIdentifier(text, length);
+    struct TableSlots *table = __atomic_load_n(&interner->table, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        int mask = table->capacity - 1;
+        int slot = (int)(hash & mask);
+        int probes = 0;
+        for (probes = 0; probes < table->capacity; probes++)
+        {
+            struct InternEntry *entry = __atomic_load_n(&table->slots[slot], __ATOMIC_ACQUIRE);
+            if (entry == NULL)
+            {
+                return NULL;
+            }
+            if (entry == MOVED_SLOT)
+            {
+                break;
+            }
+            if (isInternEntry(entry, hash, text, length))
+            {
+                return entry->text;
+            }
+            slot = (slot + 1) & mask;
+        }
+        // the slots are being replaced, text interned since then is only in the new ones
+        struct TableSlots *newer = __atomic_load_n(&interner->table, __ATOMIC_ACQUIRE);
+        if (newer == table)
+        {
+            return NULL;
+        }
+        table = newer;
+    }
+}
+
+char *internText(struct Interner *interner, char *text, int length)
+{
+    unsigned long long hash = hashIdentifier(text, length);
+    struct InternEntry *created = NULL;
+    for (;;)
+    {
+        struct TableSlots *table = __atomic_load_n(&interner->table, __ATOMIC_ACQUIRE);
+        int mask = table->capacity - 1;
+        int slot = (int)(hash & mask);
+        int probes = 0;
+        for (probes = 0; probes < table->capacity; probes++)
+        {
+            struct InternEntry *entry = __atomic_load_n(&table->slots[slot], __ATOMIC_ACQUIRE);
+            if (entry == NULL)
+            {
+                if (created == NULL)
+                {
+                    created = malloc(sizeof(struct InternEntry) + length + 1);
+                    created->hash = hash;
+                    created->length = length;
+                    memcpy(created->text, text, length);
+                    created->text[length] = '\0';
+                }
+                if (__atomic_compare_exchange_n(&table->slots[slot], &entry, created, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+                {
+                    int count = __atomic_add_fetch(&interner->count, 1, __ATOMIC_RELAXED);
+                    if (isCrowded(count, table->capacity))
+                    {
+                        growInterner(interner, table, 0);
+                    }
+                    return created->text;
+                }
+                // another thread took the slot first, entry is what it put there
+            }
+            if (entry == MOVED_SLOT)
+            {
+                break;
+            }
+            if (isInternEntry(entry, hash, text, length))
+            {
+                free(created);
+                return entry->text;
+            }
+            slot = (slot + 1) & mask;
+        }
+        // the slots are being replaced, or filled up before the thread that crowded them grew them
+        growInterner(interner, table, 1);
+    }
+}
+
+struct Interner *identifierTable()
+{
+    struct Interner *interner = __atomic_load_n(&identifierInterner, __ATOMIC_ACQUIRE);
+    if (interner == NULL)
+    {
+        struct Interner *created = createInterner(4096);
+        if (__atomic_compare_exchange_n(&identifierInterner, &interner, created, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+        {
+            interner = created;
+        }
+        else
+        {
+            free(created->table);
+            free(created);
+        }
+    }
+    return interner;
+}
+
+char *internIdentifier(char *text)
+{
+    return internText(identifierTable(), text, strlen(text));
+}
+
+/*
+ * global names
+ */
+
+unsigned long long hashInternedName(char *name)
+{
+    return ((struct InternEntry *)(name - offsetof(struct InternEntry, text)))->hash;
+}
+
+struct Registry *createRegistry(int capacity)
+{
+    struct Registry *registry = calloc(1, sizeof(struct Registry));
+    registry->table = createSlots(roundCapacity(capacity));
+    return registry;
+}
+
+unsigned long long registryEntryHash(void *entry)
+{
+    return hashInternedName(((struct RegistryEntry *)entry)->name);
+}
+
+void growRegistry(struct Registry *registry, struct TableSlots *seen, int wait)
+{
+    growSlots(&registry->table, &registry->count, &registry->growing, registry->shared, seen, registryEntryHash, wait);
+}
+
+void reserveRegistry(struct Registry *registry, int more)
+{
+    reserveSlots(&registry->table, &registry->count, more, registryEntryHash);
+}
+
+void shareRegistry(struct Registry *registry, int shared)
+{
+    registry->shared = shared;
+    if (!shared)
+    {
+        releaseReplacedSlots(registry->table);
+    }
+}
+
+void *findRegisteredName(struct Registry *registry, char *name)
+{
+    unsigned long long hash = hashInternedName(name);
+    struct TableSlots *table = __atomic_load_n(&registry->table, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        int mask = table->capacity - 1;
+        int slot = (int)(hash & mask);
+        int probes = 0;
+        for (probes = 0; probes < table->capacity; probes++)
+        {
+            struct RegistryEntry *entry = __atomic_load_n(&table->slots[slot], __ATOMIC_ACQUIRE);
+            if (entry == NULL)
+            {
+                return NULL;
+            }
+            if (entry == MOVED_SLOT)
+            {
+                break;
+            }
+            if (entry->name == name)
+            {
+                return entry->value;
+            }
+            slot = (slot + 1) & mask;
+        }
+        struct TableSlots *newer = __atomic_load_n(&registry->table, __ATOMIC_ACQUIRE);
+        if (newer == table)
+        {
+            return NULL;
+        }
+        table = newer;
+    }
+}
+
+void *registerName(struct Registry *registry, char *name, void *value)
+{
+    unsigned long long hash = hashInternedName(name);
+    struct RegistryEntry *created = NULL;
+    for (;;)
+    {
+        struct TableSlots *table = __atomic_load_n(&registry->table, __ATOMIC_ACQUIRE);
+        int mask = table->capacity - 1;
+        int slot = (int)(hash & mask);
+        int probes = 0;
+        for (probes = 0; probes < table->capacity; probes++)
+        {
+            struct RegistryEntry *entry = __atomic_load_n(&table->slots[slot], __ATOMIC_ACQUIRE);
+            if (entry == NULL)
+            {
+                if (created == NULL)
+                {
+                    created = malloc(sizeof(struct RegistryEntry));
+                    created->name = name;
+                    created->value = value;
+                }
+                if (__atomic_compare_exchange_n(&table->slots[slot], &entry, created, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+                {
+                    int count = __atomic_add_fetch(&registry->count, 1, __ATOMIC_RELAXED);
+                    if (isCrowded(count, table->capacity))
+                    {
+                        growRegistry(registry, table, 0);
+                    }
+                    return value;
+                }
+            }
+            if (entry == MOVED_SLOT)
+            {
+                break;
+            }
+            if (entry->name == name)
+            {
+                free(created);
+                return entry->value;
+            }
+            slot = (slot + 1) & mask;
+        }
+        growRegistry(registry, table, 1);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef INTERN
+#define INTERN
+
+/*
+ * Identifier interning and a registry of global names that several threads
+ * can use at once. Both are open addressing tables of pointers: an insert
+ * claims an empty slot with one compare and swap, a lookup is a plain probe
+ * that never waits. A crowded table is copied to one twice the size, also
+ * while it is shared, see growSlots in intern.c. Entries are never removed or
+ * freed, so a pointer handed out stays valid for the life of the process and
+ * two interned copies of one name are the same pointer.
+ */
+
+// the slots of a table, replaced by a copy twice the size when it grows
+struct TableSlots
+{
+    // a power of two
+    int capacity;
+    // the slots this replaced while the table was shared, another thread may still be probing them
+    struct TableSlots *replaced;
+    void *slots[];
+};
+
+struct InternEntry
+{
+    unsigned long long hash;
+    int length;
+    char text[];
+};
+
+struct Interner
+{
+    // of struct InternEntry
+    struct TableSlots *table;
+    int count;
+    // set while other threads may use the table
+    int shared;
+    // set while one thread copies the entries to a larger table
+    int growing;
+};
+
+struct RegistryEntry
+{
+    // interned, so names compare by pointer
+    char *name;
+    void *value;
+};
+
+struct Registry
+{
+    // of struct RegistryEntry
+    struct TableSlots *table;
+    int count;
+    int shared;
+    int growing;
+};
+
+unsigned long long hashIdentifier(char *text, int length);
+
+struct Interner *createInterner(int capacity);
+// text need not be terminated, the result is
+char *internText(struct Interner *interner, char *text, int length);
+char *findInternedText(struct Interner *interner, char *text, int length);
+// make room for this many more names before handing the table to several threads, so it need not grow while shared
+void reserveInterner(struct Interner *interner, int more);
+void shareInterner(struct Interner *interner, int shared);
+
+struct Registry *createRegistry(int capacity);
+// the value already registered under name, or value when name was new
+void *registerName(struct Registry *registry, char *name, void *value);
+void *findRegisteredName(struct Registry *registry, char *name);
+void reserveRegistry(struct Registry *registry, int more);
+void shareRegistry(struct Registry *registry, int shared);
+
+// the process wide interner for identifiers in the source
+struct Interner *identifierTable();
+char *internIdentifier(char *text);
+
+#endif
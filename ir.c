@@ -0,0 +1,896 @@
+#include "ir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// set by -emit-ir and -ir-stats
+int emitIr = 0;
+int irStats = 0;
+
+struct IrFunction *createIrFunction(char *name, int returnType)
+{
+    struct IrFunction *function = calloc(1, sizeof(struct IrFunction));
+    function->name = strdup(name);
+    function->returnType = returnType;
+    return function;
+}
+
+struct IrBlock *createIrBlock(struct IrFunction *function)
+{
+    struct IrBlock *block = calloc(1, sizeof(struct IrBlock));
+    block->id = function->nextBlockId++;
+    block->function = function;
+    if (function->numberOfBlocks == function->blockCapacity)
+    {
+        function->blockCapacity = function->blockCapacity == 0 ? 8 : function->blockCapacity * 2;
+        function->blocks = realloc(function->blocks, function->blockCapacity * sizeof(struct IrBlock *));
+    }
+    function->blocks[function->numberOfBlocks] = block;
+    function->numberOfBlocks++;
+    return block;
+}
+
+struct IrInstr *createIrInstr(int op, int type)
+{
+    struct IrInstr *instr = calloc(1, sizeof(struct IrInstr));
+    instr->op = op;
+    instr->type = type;
+    instr->id = -1;
+    return instr;
+}
+
+void numberIrInstr(struct IrBlock *block, struct IrInstr *instr)
+{
+    instr->block = block;
+    if (instr->id < 0)
+    {
+        instr->id = block->function->nextValueId++;
+    }
+}
+
+void appendIrInstr(struct IrBlock *block, struct IrInstr *instr)
+{
+    numberIrInstr(block, instr);
+    instr->prev = block->last;
+    instr->next = NULL;
+    if (block->last != NULL)
+    {
+        block->last->next = instr;
+    }
+    else
+    {
+        block->first = instr;
+    }
+    block->last = instr;
+}
+
+void insertIrInstrBefore(struct IrInstr *position, struct IrInstr *instr)
+{
+    struct IrBlock *block = position->block;
+    numberIrInstr(block, instr);
+    instr->next = position;
+    instr->prev = position->prev;
+    if (position->prev != NULL)
+    {
+        position->prev->next = instr;
+    }
+    else
+    {
+        block->first = instr;
+    }
+    position->prev = instr;
+}
+
+void unlinkIrInstr(struct IrInstr *instr)
+{
+    struct IrBlock *block = instr->block;
+    if (instr->prev != NULL)
+    {
+        instr->prev->next = instr->next;
+    }
+    else
+    {
+        block->first = instr->next;
+    }
+    if (instr->next != NULL)
+    {
+        instr->next->prev = instr->prev;
+    }
+    else
+    {
+        block->last = instr->prev;
+    }
+    instr->prev = NULL;
+    instr->next = NULL;
+}
+
+void removeIrUser(struct IrInstr *value, struct IrInstr *user)
+{
+    int i = 0;
+    for (i = 0; i < value->numberOfUsers; i++)
+    {
+        if (value->users[i] == user)
+        {
+            value->users[i] = value->users[value->numberOfUsers - 1];
+            value->numberOfUsers--;
+            return;
+        }
+    }
+}
+
+void addIrUser(struct IrInstr *value, struct IrInstr *user)
+{
+    if (value->numberOfUsers == value->userCapacity)
+    {
+        value->userCapacity = value->userCapacity == 0 ? 4 : value->userCapacity * 2;
+        value->users = realloc(value->users, value->userCapacity * sizeof(struct IrInstr *));
+    }
+    value->users[value->numberOfUsers] = user;
+    value->numberOfUsers++;
+}
+
+void deleteIrInstr(struct IrInstr *instr)
+{
+    // the caller has already redirected every user of this value
+    int i = 0;
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        if (instr->args[i] != NULL)
+        {
+            removeIrUser(instr->args[i], instr);
+        }
+    }
+    if (instr->block != NULL)
+    {
+        unlinkIrInstr(instr);
+    }
+    free(instr->args);
+    free(instr->users);
+    free(instr);
+}
+
+void addIrArg(struct IrInstr *instr, struct IrInstr *value)
+{
+    if (instr->numberOfArgs == instr->argCapacity)
+    {
+        instr->argCapacity = instr->argCapacity == 0 ? 2 : instr->argCapacity * 2;
+        instr->args = realloc(instr->args, instr->argCapacity * sizeof(struct IrInstr *));
+    }
+    instr->args[instr->numberOfArgs] = value;
+    instr->numberOfArgs++;
+    if (value != NULL)
+    {
+        addIrUser(value, instr);
+    }
+}
+
+void setIrArg(struct IrInstr *instr, int index, struct IrInstr *value)
+{
+    if (instr->args[index] != NULL)
+    {
+        removeIrUser(instr->args[index], instr);
+    }
+    instr->args[index] = value;
+    if (value != NULL)
+    {
+        addIrUser(value, instr);
+    }
+}
+
+void replaceIrUses(struct IrInstr *oldValue, struct IrInstr *newValue)
+{
+    while (oldValue->numberOfUsers > 0)
+    {
+        struct IrInstr *user = oldValue->users[oldValue->numberOfUsers - 1];
+        int i = 0;
+        for (i = 0; i < user->numberOfArgs; i++)
+        {
+            if (user->args[i] == oldValue)
+            {
+                setIrArg(user, i, newValue);
+            }
+        }
+    }
+}
+
+void addIrPred(struct IrBlock *block, struct IrBlock *pred)
+{
+    if (block->numberOfPreds == block->predCapacity)
+    {
+        block->predCapacity = block->predCapacity == 0 ? 2 : block->predCapacity * 2;
+        block->preds = realloc(block->preds, block->predCapacity * sizeof(struct IrBlock *));
+    }
+    block->preds[block->numberOfPreds] = pred;
+    block->numberOfPreds++;
+}
+
+void removeIrPred(struct IrBlock *block, struct IrBlock *pred)
+{
+    // phi arguments are kept in the same order as the predecessors
+    int i = 0;
+    for (i = 0; i < block->numberOfPreds; i++)
+    {
+        if (block->preds[i] == pred)
+        {
+            break;
+        }
+    }
+    if (i == block->numberOfPreds)
+    {
+        return;
+    }
+
+    struct IrInstr *instr = block->first;
+    while (instr != NULL && instr->op == IR_PHI)
+    {
+        int j = 0;
+        setIrArg(instr, i, NULL);
+        for (j = i; j < instr->numberOfArgs - 1; j++)
+        {
+            instr->args[j] = instr->args[j + 1];
+        }
+        instr->numberOfArgs--;
+        instr = instr->next;
+    }
+    for (; i < block->numberOfPreds - 1; i++)
+    {
+        block->preds[i] = block->preds[i + 1];
+    }
+    block->numberOfPreds--;
+}
+
+int isIrTerminator(int op)
+{
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN;
+}
+
+int numberOfIrSuccs(struct IrBlock *block)
+{
+    if (block->last == NULL)
+    {
+        return 0;
+    }
+    switch (block->last->op)
+    {
+    case IR_JUMP:
+        return 1;
+
+    case IR_BRANCH:
+        return 2;
+
+    default:
+        return 0;
+    }
+}
+
+struct IrBlock *irSucc(struct IrBlock *block, int index)
+{
+    return block->last->target[index];
+}
+
+int hasIrSideEffects(struct IrInstr *instr)
+{
+    switch (instr->op)
+    {
+    case IR_STORE:
+    case IR_ZERO:
+    case IR_COPY:
+    case IR_CALL:
+    case IR_PRINT:
+    case IR_NOW:
+    case IR_RANDN:
+    case IR_JUMP:
+    case IR_BRANCH:
+    case IR_RETURN:
+        return 1;
+
+    case IR_BOUNDS:
+        // an index known to be in range needs no check
+        return instr->args[0]->op != IR_CONST || instr->args[0]->ival < 0 || instr->args[0]->ival >= instr->ival;
+
+    case IR_DIV:
+    case IR_MOD:
+        // integer division by zero panics at run time, keep it unless the divisor is known
+        if (instr->type == IR_INT)
+        {
+            return instr->args[1]->op != IR_CONST || instr->args[1]->ival == 0;
+        }
+        return 0;
+
+    default:
+        return 0;
+    }
+}
+
+int irTypeSize(int type)
+{
+    // bools are stored as one byte, every other scalar fills a machine word
+    if (type == IR_BOOL)
+    {
+        return 1;
+    }
+    return 8;
+}
+
+int countIrInstrs(struct IrFunction *function)
+{
+    int count = 0;
+    int i = 0;
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = function->blocks[i]->first;
+        while (instr != NULL)
+        {
+            count++;
+            instr = instr->next;
+        }
+    }
+    return count;
+}
+
+void markReachableIrBlocks(struct IrBlock *entry)
+{
+    // iterative depth first search so huge generated functions cannot overflow the stack
+    int capacity = 64;
+    int top = 0;
+    struct IrBlock **stack = malloc(capacity * sizeof(struct IrBlock *));
+    entry->reachable = 1;
+    stack[top++] = entry;
+    while (top > 0)
+    {
+        struct IrBlock *block = stack[--top];
+        int i = 0;
+        for (i = 0; i < numberOfIrSuccs(block); i++)
+        {
+            struct IrBlock *succ = irSucc(block, i);
+            if (!succ->reachable)
+            {
+                succ->reachable = 1;
+                if (top == capacity)
+                {
+                    capacity *= 2;
+                    stack = realloc(stack, capacity * sizeof(struct IrBlock *));
+                }
+                stack[top++] = succ;
+            }
+        }
+    }
+    free(stack);
+}
+
+void removeUnreachableIrBlocks(struct IrFunction *function)
+{
+    int i = 0;
+    int kept = 0;
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        function->blocks[i]->reachable = 0;
+    }
+    markReachableIrBlocks(function->blocks[0]);
+
+    // detach dead blocks from the live ones first so phis stay consistent
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        if (!block->reachable)
+        {
+            int j = 0;
+            for (j = 0; j < numberOfIrSuccs(block); j++)
+            {
+                if (irSucc(block, j)->reachable)
+                {
+                    removeIrPred(irSucc(block, j), block);
+                }
+            }
+        }
+    }
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        if (block->reachable)
+        {
+            function->blocks[kept] = block;
+            kept++;
+        }
+        else
+        {
+            // values in a dead block can only be used by other dead code
+            struct IrInstr *instr = block->first;
+            while (instr != NULL)
+            {
+                struct IrInstr *next = instr->next;
+                int j = 0;
+                for (j = 0; j < instr->numberOfArgs; j++)
+                {
+                    setIrArg(instr, j, NULL);
+                }
+                instr = next;
+            }
+            instr = block->first;
+            while (instr != NULL)
+            {
+                struct IrInstr *next = instr->next;
+                replaceIrUses(instr, NULL);
+                instr->block = NULL;
+                free(instr->args);
+                free(instr->users);
+                free(instr);
+                instr = next;
+            }
+            free(block->preds);
+            free(block);
+        }
+    }
+    function->numberOfBlocks = kept;
+}
+
+/*
+ * Lengauer-Tarjan dominators with path compression, O(E log N), so the passes
+ * that need dominance stay close to linear on large generated functions.
+ */
+struct DominatorState
+{
+    struct IrBlock **vertex;
+    int *semi;
+    int *parent;
+    int *ancestor;
+    int *label;
+    int *idom;
+    int *bucketHead;
+    int *bucketNext;
+    int *path;
+};
+
+int evalDominator(struct DominatorState *state, int v)
+{
+    if (state->ancestor[v] < 0)
+    {
+        return v;
+    }
+    // compress the ancestor path iteratively, nearest the root first
+    int count = 0;
+    int u = v;
+    while (state->ancestor[state->ancestor[u]] >= 0)
+    {
+        state->path[count++] = u;
+        u = state->ancestor[u];
+    }
+    while (count > 0)
+    {
+        int w = state->path[--count];
+        int a = state->ancestor[w];
+        if (state->semi[state->label[a]] < state->semi[state->label[w]])
+        {
+            state->label[w] = state->label[a];
+        }
+        state->ancestor[w] = state->ancestor[a];
+    }
+    return state->label[v];
+}
+
+void computeIrDominators(struct IrFunction *function)
+{
+    int n = function->numberOfBlocks;
+    int i = 0;
+    struct DominatorState state;
+    state.vertex = malloc(n * sizeof(struct IrBlock *));
+    state.semi = malloc(n * sizeof(int));
+    state.parent = malloc(n * sizeof(int));
+    state.ancestor = malloc(n * sizeof(int));
+    state.label = malloc(n * sizeof(int));
+    state.idom = malloc(n * sizeof(int));
+    state.bucketHead = malloc(n * sizeof(int));
+    state.bucketNext = malloc(n * sizeof(int));
+    state.path = malloc(n * sizeof(int));
+
+    for (i = 0; i < n; i++)
+    {
+        function->blocks[i]->preorder = -1;
+        function->blocks[i]->idom = NULL;
+        function->blocks[i]->domChild = NULL;
+        function->blocks[i]->domSibling = NULL;
+        state.bucketHead[i] = -1;
+    }
+
+    // depth first numbering, iterative with an explicit edge cursor
+    int count = 0;
+    int *stackBlock = malloc(n * sizeof(int));
+    int *stackEdge = malloc(n * sizeof(int));
+    int top = 0;
+    struct IrBlock *entry = function->blocks[0];
+    entry->preorder = count;
+    state.vertex[count] = entry;
+    state.parent[count] = -1;
+    count++;
+    stackBlock[top] = 0;
+    stackEdge[top] = 0;
+    top++;
+    while (top > 0)
+    {
+        struct IrBlock *block = state.vertex[stackBlock[top - 1]];
+        if (stackEdge[top - 1] < numberOfIrSuccs(block))
+        {
+            struct IrBlock *succ = irSucc(block, stackEdge[top - 1]);
+            stackEdge[top - 1]++;
+            if (succ->preorder < 0)
+            {
+                succ->preorder = count;
+                state.vertex[count] = succ;
+                state.parent[count] = stackBlock[top - 1];
+                stackBlock[top] = count;
+                stackEdge[top] = 0;
+                top++;
+                count++;
+            }
+        }
+        else
+        {
+            top--;
+        }
+    }
+    free(stackBlock);
+    free(stackEdge);
+
+    for (i = 0; i < count; i++)
+    {
+        state.semi[i] = i;
+        state.ancestor[i] = -1;
+        state.label[i] = i;
+        state.idom[i] = 0;
+    }
+
+    for (i = count - 1; i > 0; i--)
+    {
+        struct IrBlock *block = state.vertex[i];
+        int j = 0;
+        for (j = 0; j < block->numberOfPreds; j++)
+        {
+            int v = block->preds[j]->preorder;
+            if (v < 0)
+            {
+                continue;
+            }
+            int u = evalDominator(&state, v);
+            if (state.semi[u] < state.semi[i])
+            {
+                state.semi[i] = state.semi[u];
+            }
+        }
+        state.bucketNext[i] = state.bucketHead[state.semi[i]];
+        state.bucketHead[state.semi[i]] = i;
+        state.ancestor[i] = state.parent[i];
+
+        int p = state.parent[i];
+        int v = state.bucketHead[p];
+        while (v >= 0)
+        {
+            int next = state.bucketNext[v];
+            int u = evalDominator(&state, v);
+            state.idom[v] = state.semi[u] < state.semi[v] ? u : p;
+            v = next;
+        }
+        state.bucketHead[p] = -1;
+    }
+    for (i = 1; i < count; i++)
+    {
+        if (state.idom[i] != state.semi[i])
+        {
+            state.idom[i] = state.idom[state.idom[i]];
+        }
+    }
+
+    // build child lists in reverse so children end up in preorder
+    for (i = count - 1; i > 0; i--)
+    {
+        struct IrBlock *block = state.vertex[i];
+        struct IrBlock *dominator = state.vertex[state.idom[i]];
+        block->idom = dominator;
+        block->domSibling = dominator->domChild;
+        dominator->domChild = block;
+    }
+
+    free(state.vertex);
+    free(state.semi);
+    free(state.parent);
+    free(state.ancestor);
+    free(state.label);
+    free(state.idom);
+    free(state.bucketHead);
+    free(state.bucketNext);
+    free(state.path);
+}
+
+int irDominates(struct IrBlock *dominator, struct IrBlock *block)
+{
+    while (block != NULL)
+    {
+        if (block == dominator)
+        {
+            return 1;
+        }
+        block = block->idom;
+    }
+    return 0;
+}
+
+char *irOpName(int op)
+{
+    switch (op)
+    {
+    case IR_CONST:
+        return "const";
+    case IR_PARAM:
+        return "param";
+    case IR_PHI:
+        return "phi";
+    case IR_ADD:
+        return "add";
+    case IR_SUB:
+        return "sub";
+    case IR_MUL:
+        return "mul";
+    case IR_DIV:
+        return "div";
+    case IR_MOD:
+        return "mod";
+    case IR_NEG:
+        return "neg";
+    case IR_NOT:
+        return "not";
+    case IR_EQ:
+        return "eq";
+    case IR_NE:
+        return "ne";
+    case IR_LT:
+        return "lt";
+    case IR_LE:
+        return "le";
+    case IR_GT:
+        return "gt";
+    case IR_GE:
+        return "ge";
+    case IR_ITOF:
+        return "itof";
+    case IR_FTOI:
+        return "ftoi";
+    case IR_SLOT:
+        return "slot";
+    case IR_GLOBAL:
+        return "global";
+    case IR_FIELD:
+        return "field";
+    case IR_ELEM:
+        return "elem";
+    case IR_LOAD:
+        return "load";
+    case IR_STORE:
+        return "store";
+    case IR_ZERO:
+        return "zero";
+    case IR_COPY:
+        return "copy";
+    case IR_CALL:
+        return "call";
+    case IR_PRINT:
+        return "println";
+    case IR_NOW:
+        return "now";
+    case IR_RANDN:
+        return "randn";
+    case IR_JUMP:
+        return "jump";
+    case IR_BRANCH:
+        return "branch";
+    case IR_RETURN:
+        return "ret";
+    case IR_BOUNDS:
+        return "bounds";
+    default:
+        return "unknown";
+    }
+}
+
+char *irTypeName(int type)
+{
+    switch (type)
+    {
+    case IR_INT:
+        return "int";
+    case IR_FLOAT:
+        return "float64";
+    case IR_BOOL:
+        return "bool";
+    case IR_STRING:
+        return "string";
+    case IR_ADDR:
+        return "addr";
+    default:
+        return "void";
+    }
+}
+
+void printIrValue(struct IrInstr *value)
+{
+    if (value == NULL)
+    {
+        printf("undef");
+    }
+    else
+    {
+        printf("%%%d", value->id);
+    }
+}
+
+void printIrInstr(struct IrInstr *instr)
+{
+    int i = 0;
+    printf("  ");
+    if (instr->type != IR_VOID)
+    {
+        printf("%%%d = ", instr->id);
+    }
+    printf("%s", irOpName(instr->op));
+    if (instr->type != IR_VOID)
+    {
+        printf(" %s", irTypeName(instr->type));
+    }
+
+    switch (instr->op)
+    {
+    case IR_CONST:
+        if (instr->type == IR_FLOAT)
+        {
+            printf(" %g", instr->dval);
+        }
+        else if (instr->type == IR_STRING)
+        {
+            printf(" \"");
+            char *c = instr->sval;
+            for (; *c != '\0'; c++)
+            {
+                if (*c == '\n')
+                {
+                    printf("\\n");
+                }
+                else if (*c == '\t')
+                {
+                    printf("\\t");
+                }
+                else if (*c == '"' || *c == '\\')
+                {
+                    printf("\\%c", *c);
+                }
+                else
+                {
+                    putchar(*c);
+                }
+            }
+            printf("\"");
+        }
+        else if (instr->type == IR_BOOL)
+        {
+            printf(" %s", instr->ival ? "true" : "false");
+        }
+        else
+        {
+            printf(" %lld", instr->ival);
+        }
+        break;
+
+    case IR_PARAM:
+    case IR_SLOT:
+        printf(" %lld", instr->ival);
+        break;
+
+    case IR_GLOBAL:
+    case IR_CALL:
+        printf(" @%s", instr->sval);
+        break;
+
+    case IR_PHI:
+        for (i = 0; i < instr->numberOfArgs; i++)
+        {
+            printf("%s [", i == 0 ? "" : ",");
+            printIrValue(instr->args[i]);
+            printf(", b%d]", instr->block->preds[i]->id);
+        }
+        printf("\n");
+        return;
+
+    case IR_JUMP:
+        printf(" b%d\n", instr->target[0]->id);
+        return;
+
+    case IR_BRANCH:
+        printf(" ");
+        printIrValue(instr->args[0]);
+        printf(", b%d, b%d\n", instr->target[0]->id, instr->target[1]->id);
+        return;
+
+    default:
+        break;
+    }
+
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        printf("%s", (i == 0 && instr->op != IR_CALL && instr->op != IR_GLOBAL) ? " " : ", ");
+        printIrValue(instr->args[i]);
+    }
+    if (instr->op == IR_FIELD || instr->op == IR_ELEM || instr->op == IR_ZERO || instr->op == IR_COPY ||
+        instr->op == IR_BOUNDS)
+    {
+        printf(", %lld", instr->ival);
+    }
+    printf("\n");
+}
+
+void printIrFunction(struct IrFunction *function)
+{
+    int i = 0;
+    printf("func %s(", function->name);
+    for (i = 0; i < function->numberOfParams; i++)
+    {
+        printf("%s%s", i == 0 ? "" : ", ", irTypeName(function->paramTypes[i]));
+    }
+    printf(") %s\n", irTypeName(function->returnType));
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        int j = 0;
+        printf("b%d:", block->id);
+        if (block->numberOfPreds > 0)
+        {
+            printf("  ; preds");
+            for (j = 0; j < block->numberOfPreds; j++)
+            {
+                printf(" b%d", block->preds[j]->id);
+            }
+        }
+        printf("\n");
+        struct IrInstr *instr = block->first;
+        while (instr != NULL)
+        {
+            printIrInstr(instr);
+            instr = instr->next;
+        }
+    }
+    printf("\n");
+}
+
+void printIrModule(struct IrModule *module)
+{
+    struct IrStruct *structType = module->structs;
+    while (structType != NULL)
+    {
+        int i = 0;
+        printf("struct %s size %d {", structType->name, structType->size);
+        for (i = 0; i < structType->numberOfFields; i++)
+        {
+            struct IrField *field = &structType->fields[i];
+            printf("%s %s %s @%d", i == 0 ? "" : ",", field->name, field->structType != NULL ? field->structType->name : irTypeName(field->type), field->offset);
+        }
+        printf(" }\n");
+        structType = structType->next;
+    }
+    struct IrGlobal *global = module->globals;
+    while (global != NULL)
+    {
+        printf("global @%s %s", global->name, global->structType != NULL ? global->structType->name : irTypeName(global->type));
+        if (global->arraySize >= 0)
+        {
+            printf("[%d]", global->arraySize);
+        }
+        printf(" size %d\n", global->size);
+        global = global->next;
+    }
+    if (module->structs != NULL || module->globals != NULL)
+    {
+        printf("\n");
+    }
+    struct IrFunction *function = module->functions;
+    while (function != NULL)
+    {
+        printIrFunction(function);
+        function = function->next;
+    }
+}
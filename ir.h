@@ -0,0 +1,231 @@
+#ifndef IR
+#define IR
+
+#include "tree.h"
+
+/*
+ * SSA intermediate representation for checked function bodies.
+ *
+ * Every instruction is also the value it defines. Scalar locals live only in
+ * SSA values; struct and array variables live in memory (frame slots or
+ * globals) and are reached through address arithmetic plus load/store.
+ */
+
+// value types
+#define IR_VOID 0
+#define IR_INT 1
+#define IR_FLOAT 2
+#define IR_BOOL 3
+#define IR_STRING 4
+#define IR_ADDR 5
+
+// instructions
+#define IR_CONST 1
+#define IR_PARAM 2
+#define IR_PHI 3
+#define IR_ADD 4
+#define IR_SUB 5
+#define IR_MUL 6
+#define IR_DIV 7
+#define IR_MOD 8
+#define IR_NEG 9
+#define IR_NOT 10
+#define IR_EQ 11
+#define IR_NE 12
+#define IR_LT 13
+#define IR_LE 14
+#define IR_GT 15
+#define IR_GE 16
+#define IR_ITOF 17
+#define IR_FTOI 18
+#define IR_SLOT 19
+#define IR_GLOBAL 20
+#define IR_FIELD 21
+#define IR_ELEM 22
+#define IR_LOAD 23
+#define IR_STORE 24
+#define IR_ZERO 25
+#define IR_COPY 26
+#define IR_CALL 27
+#define IR_PRINT 28
+#define IR_NOW 29
+#define IR_RANDN 30
+#define IR_JUMP 31
+#define IR_BRANCH 32
+#define IR_RETURN 33
+#define IR_BOUNDS 34
+
+struct IrBlock;
+
+struct IrInstr
+{
+    int op;
+    int type;
+    int id;
+    int numberOfArgs;
+    int argCapacity;
+    struct IrInstr **args;
+    int numberOfUsers;
+    int userCapacity;
+    struct IrInstr **users;
+
+    // constants, parameter index, field offset, element or slot size, array length
+    long long ival;
+    double dval;
+    // string constants, global and callee names
+    char *sval;
+    // element type of a slot, for backends that declare typed storage
+    int slotType;
+    struct IrStruct *slotStruct;
+
+    struct IrBlock *block;
+    struct IrInstr *prev;
+    struct IrInstr *next;
+    // jump uses target[0], branch goes to target[0] when true
+    struct IrBlock *target[2];
+    int line;
+    // set when ssa construction folds a trivial phi away
+    struct IrInstr *replacement;
+    // scratch space for the passes
+    int mark;
+    long long lattice;
+    double latticeFloat;
+};
+
+struct IrBlock
+{
+    int id;
+    struct IrInstr *first;
+    struct IrInstr *last;
+    int numberOfPreds;
+    int predCapacity;
+    struct IrBlock **preds;
+    struct IrFunction *function;
+    // dominator tree
+    struct IrBlock *idom;
+    struct IrBlock *domChild;
+    struct IrBlock *domSibling;
+    int preorder;
+    int reachable;
+    int sealed;
+    int mark;
+};
+
+struct IrFunction
+{
+    char *name;
+    int returnType;
+    int numberOfParams;
+    int *paramTypes;
+    int numberOfBlocks;
+    int blockCapacity;
+    struct IrBlock **blocks;
+    int nextValueId;
+    int nextBlockId;
+    struct IrFunction *next;
+};
+
+struct IrField
+{
+    char *name;
+    int type;
+    struct IrStruct *structType;
+    int size;
+    int align;
+    int offset;
+    // selector uses weighted by loop depth, counted for -layout=reorder
+    long long accesses;
+};
+
+struct IrStruct
+{
+    char *name;
+    int size;
+    int align;
+    // what the fields would take in declaration order, for -layout-report
+    int declaredSize;
+    int numberOfFields;
+    struct IrField *fields;
+    struct IrStruct *next;
+};
+
+struct IrGlobal
+{
+    char *name;
+    int type;
+    struct IrStruct *structType;
+    int arraySize;
+    int size;
+    // constant initial value for scalars declared with one
+    int initialized;
+    long long ival;
+    double dval;
+    char *sval;
+    struct IrGlobal *next;
+};
+
+struct IrModule
+{
+    struct IrFunction *functions;
+    struct IrStruct *structs;
+    struct IrGlobal *globals;
+};
+
+// statistics kept by the pass pipeline for -ir-stats
+struct IrPassStats
+{
+    char *name;
+    int changed;
+    int instructionsBefore;
+    int instructionsAfter;
+    double microseconds;
+};
+
+extern int emitIr;
+extern int irStats;
+extern char *irPackageName;
+extern int reorderIrFields;
+extern int layoutReport;
+
+// ir.c
+struct IrFunction *createIrFunction(char *name, int returnType);
+struct IrBlock *createIrBlock(struct IrFunction *function);
+struct IrInstr *createIrInstr(int op, int type);
+void appendIrInstr(struct IrBlock *block, struct IrInstr *instr);
+void insertIrInstrBefore(struct IrInstr *position, struct IrInstr *instr);
+void unlinkIrInstr(struct IrInstr *instr);
+void deleteIrInstr(struct IrInstr *instr);
+void addIrArg(struct IrInstr *instr, struct IrInstr *value);
+void setIrArg(struct IrInstr *instr, int index, struct IrInstr *value);
+void replaceIrUses(struct IrInstr *oldValue, struct IrInstr *newValue);
+void addIrPred(struct IrBlock *block, struct IrBlock *pred);
+void removeIrPred(struct IrBlock *block, struct IrBlock *pred);
+int numberOfIrSuccs(struct IrBlock *block);
+struct IrBlock *irSucc(struct IrBlock *block, int index);
+int isIrTerminator(int op);
+int hasIrSideEffects(struct IrInstr *instr);
+int irTypeSize(int type);
+int countIrInstrs(struct IrFunction *function);
+void removeUnreachableIrBlocks(struct IrFunction *function);
+void computeIrDominators(struct IrFunction *function);
+int irDominates(struct IrBlock *dominator, struct IrBlock *block);
+char *irOpName(int op);
+char *irTypeName(int type);
+void printIrFunction(struct IrFunction *function);
+void printIrModule(struct IrModule *module);
+
+// irbuild.c
+struct IrModule *buildIrModule(struct Node *treeHead);
+struct IrStruct *findIrStruct(struct IrModule *module, char *name);
+struct IrFunction *findIrFunction(struct IrModule *module, char *name);
+
+// layout.c
+void countIrFieldAccesses(struct Node *treeHead);
+void layoutIrStruct(struct IrStruct *structType);
+void printLayoutReport(struct IrModule *module);
+
+// iropt.c
+int foldIrInstr(struct IrInstr *instr, long long *ival, double *dval);
+void optimizeIrModule(struct IrModule *module);
+
+#endif
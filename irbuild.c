@@ -0,0 +1,2462 @@
+#include "ir.h"
+#include "tree.h"
+#include "constant.h"
+#include "vgobison.tab.h"
+#include "nonterminal.h"
+#include "globalutilities.h"
+#include "literal.h"
+#include "package.h"
+#include "linkedlist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Lowers the checked tree into SSA form.
+ *
+ * Scalar locals are renamed on the fly (Braun et al., "Simple and Efficient
+ * Construction of Static Single Assignment Form"): every block remembers the
+ * current value of each variable it assigns, and a read in a block that does
+ * not assign the variable looks through the predecessors, placing a phi where
+ * control flow merges. A block is sealed once all of its predecessors are
+ * known, which the structured statements of VGo make easy to decide.
+ *
+ * Reads walk the predecessor chains with an explicit stack and trivial phis are
+ * removed with a worklist, so deeply nested or very long generated functions do
+ * not recurse once per block.
+ */
+
+// the static type of a variable, field or array element
+struct IrValueType
+{
+    int type;
+    struct IrStruct *structType;
+    int arraySize;
+};
+
+struct IrVariable
+{
+    char *name;
+    int index;
+    struct IrValueType valueType;
+    // frame slot of a struct or array, NULL when the variable lives in SSA values
+    struct IrInstr *slot;
+};
+
+// open hashing by name, used for locals, globals and struct declarations
+struct IrNameTable
+{
+    int size;
+    int count;
+    char **keys;
+    void **values;
+};
+
+// current definition of a variable at the end of a block
+struct IrDefinition
+{
+    long long key;
+    struct IrInstr *value;
+};
+
+// phis placed in a block before it was sealed, filled in when it is
+struct IrPendingPhi
+{
+    int variable;
+    struct IrInstr *phi;
+    struct IrPendingPhi *next;
+};
+
+// a merge phi whose operands are still being read
+struct IrReadFrame
+{
+    struct IrInstr *phi;
+    int variable;
+    int nextPred;
+    int chainBase;
+};
+
+struct IrLoop
+{
+    struct IrBlock *breakTarget;
+    struct IrBlock *continueTarget;
+    struct IrLoop *outer;
+};
+
+struct IrModule *currentIrModule;
+struct IrFunction *currentIrFunction;
+struct IrBlock *currentIrBlock;
+struct IrLoop *currentIrLoop;
+int currentIrLine;
+
+struct IrNameTable irStructDeclarations;
+struct IrNameTable irGlobalNames;
+struct IrNameTable irLocalNames;
+
+int numberOfIrVariables;
+int irVariableCapacity;
+struct IrVariable **irVariables;
+
+int irDefinitionCount;
+int irDefinitionSize;
+struct IrDefinition *irDefinitions;
+
+int irPendingCapacity;
+struct IrPendingPhi **irPendingPhis;
+
+// removed phis stay allocated until the function is done so stale definitions can follow them
+int irRetiredCount;
+int irRetiredCapacity;
+struct IrInstr **irRetiredPhis;
+
+struct IrInstr *irEntryHeader;
+struct IrInstr *irZeroValues[6];
+
+// set when a package other than main is built, its functions and globals are named package.name
+char *irPackageName = NULL;
+
+void lowerIrStatement(struct Node *treeHead);
+struct IrInstr *lowerIrExpression(struct Node *treeHead);
+struct IrInstr *lowerIrCall(struct Node *treeHead, int wantValue);
+struct IrInstr *lowerIrAddress(struct Node *treeHead, struct IrValueType *valueType);
+struct IrStruct *buildIrStruct(char *name, struct Node *treeHead);
+void lowerIrSimpleStatement(struct Node *treeHead);
+
+void irUnsupported(struct Node *treeHead, char *message)
+{
+    int line = currentIrLine;
+    struct Node *current = treeHead;
+    while (current != NULL && current->numberOfChildren > 0)
+    {
+        int i = 0;
+        struct Node *next = NULL;
+        for (i = 0; i < current->numberOfChildren && next == NULL; i++)
+        {
+            next = current->children[i];
+        }
+        current = next;
+    }
+    if (current != NULL && current->data != NULL)
+    {
+        line = current->data->linenumber;
+    }
+    printf("Unable to generate code: %s in file %s at line %d\n", message, currentfile, line);
+    exit(3);
+}
+
+int irNameHash(char *name, int size)
+{
+    unsigned int h = 0;
+    while (*name)
+    {
+        h = h * 31 + (unsigned char)*name;
+        name++;
+    }
+    return h & (size - 1);
+}
+
+void *lookupIrName(struct IrNameTable *table, char *name)
+{
+    if (table->size == 0)
+    {
+        return NULL;
+    }
+    int i = irNameHash(name, table->size);
+    while (table->keys[i] != NULL)
+    {
+        if (strcmp(table->keys[i], name) == 0)
+        {
+            return table->values[i];
+        }
+        i = (i + 1) & (table->size - 1);
+    }
+    return NULL;
+}
+
+void insertIrName(struct IrNameTable *table, char *name, void *value)
+{
+    if (2 * (table->count + 1) > table->size)
+    {
+        struct IrNameTable grown;
+        int i = 0;
+        grown.size = table->size == 0 ? 64 : table->size * 2;
+        grown.count = 0;
+        grown.keys = calloc(grown.size, sizeof(char *));
+        grown.values = calloc(grown.size, sizeof(void *));
+        for (i = 0; i < table->size; i++)
+        {
+            if (table->keys[i] != NULL)
+            {
+                insertIrName(&grown, table->keys[i], table->values[i]);
+            }
+        }
+        free(table->keys);
+        free(table->values);
+        *table = grown;
+    }
+    int i = irNameHash(name, table->size);
+    while (table->keys[i] != NULL)
+    {
+        if (strcmp(table->keys[i], name) == 0)
+        {
+            table->values[i] = value;
+            return;
+        }
+        i = (i + 1) & (table->size - 1);
+    }
+    table->keys[i] = name;
+    table->values[i] = value;
+    table->count++;
+}
+
+void clearIrNames(struct IrNameTable *table)
+{
+    free(table->keys);
+    free(table->values);
+    table->size = 0;
+    table->count = 0;
+    table->keys = NULL;
+    table->values = NULL;
+}
+
+struct IrStruct *findIrStruct(struct IrModule *module, char *name)
+{
+    struct IrStruct *current = module->structs;
+    while (current != NULL)
+    {
+        if (strcmp(current->name, name) == 0)
+        {
+            return current;
+        }
+        current = current->next;
+    }
+    return NULL;
+}
+
+struct IrFunction *findIrFunction(struct IrModule *module, char *name)
+{
+    struct IrFunction *current = module->functions;
+    while (current != NULL)
+    {
+        if (strcmp(current->name, name) == 0)
+        {
+            return current;
+        }
+        current = current->next;
+    }
+    return NULL;
+}
+
+// the symbol for a package level name, which must not clash with the same name in another package
+char *qualifyIrName(char *name)
+{
+    if (irPackageName == NULL)
+    {
+        return name;
+    }
+    char *qualified = malloc(strlen(irPackageName) + strlen(name) + 2);
+    sprintf(qualified, "%s.%s", irPackageName, name);
+    return qualified;
+}
+
+// skip the wrappers that only group or parenthesize a single expression
+struct Node *unwrapIrExpression(struct Node *treeHead)
+{
+    while (treeHead != NULL && treeHead->numberOfChildren == 1 &&
+           (treeHead->category == expr_list || treeHead->category == expr_or_type || treeHead->category == pexpr ||
+            treeHead->category == oexpr_list || treeHead->category == osimple_stmt || treeHead->category == name_or_type ||
+            treeHead->category == fnret_type || treeHead->category == ntype))
+    {
+        treeHead = treeHead->children[0];
+    }
+    // a parenthesized expression keeps only its contents after lowering
+    while (treeHead != NULL && treeHead->category == pexpr && treeHead->numberOfChildren > 0)
+    {
+        treeHead = unwrapIrExpression(treeHead->children[treeHead->numberOfChildren == 3 ? 1 : 0]);
+    }
+    return treeHead;
+}
+
+int isIrLeaf(struct Node *treeHead, int category)
+{
+    return treeHead != NULL && treeHead->numberOfChildren == 0 && treeHead->data != NULL && treeHead->data->category == category;
+}
+
+// name of a plain identifier expression, or NULL
+char *irIdentifierName(struct Node *treeHead)
+{
+    treeHead = unwrapIrExpression(treeHead);
+    if (treeHead != NULL && treeHead->category == pexpr_no_paren && treeHead->numberOfChildren == 1)
+    {
+        treeHead = treeHead->children[0];
+    }
+    if (isIrLeaf(treeHead, LNAME))
+    {
+        return treeHead->data->text;
+    }
+    return NULL;
+}
+
+int irValueTypeSize(struct IrValueType *valueType)
+{
+    int size = valueType->structType != NULL ? valueType->structType->size : irTypeSize(valueType->type);
+    if (valueType->arraySize >= 0)
+    {
+        size *= valueType->arraySize;
+    }
+    return size;
+}
+
+int irValueTypeAlign(struct IrValueType *valueType)
+{
+    if (valueType->structType != NULL)
+    {
+        return valueType->structType->align;
+    }
+    return irTypeSize(valueType->type);
+}
+
+int isIrAggregate(struct IrValueType *valueType)
+{
+    return valueType->structType != NULL || valueType->arraySize >= 0;
+}
+
+// the IR type of a value folded by the constant evaluator
+int irConstantType(struct Constant *value)
+{
+    switch (value->type)
+    {
+    case INT:
+        return IR_INT;
+    case FLOAT64:
+        return IR_FLOAT;
+    case BOOL:
+        return IR_BOOL;
+    default:
+        return IR_STRING;
+    }
+}
+
+// the folded value of an expression, or NULL when it is not constant
+struct Constant *irConstant(struct Node *treeHead)
+{
+    treeHead = unwrapIrExpression(treeHead);
+    return treeHead != NULL ? treeHead->constant : NULL;
+}
+
+void parseIrType(struct Node *treeHead, struct IrValueType *valueType)
+{
+    treeHead = unwrapIrExpression(treeHead);
+    valueType->type = IR_VOID;
+    valueType->structType = NULL;
+    valueType->arraySize = -1;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (treeHead->numberOfChildren == 0)
+    {
+        switch (treeHead->data->category)
+        {
+        case INT:
+            valueType->type = IR_INT;
+            return;
+
+        case FLOAT64:
+            valueType->type = IR_FLOAT;
+            return;
+
+        case BOOL:
+            valueType->type = IR_BOOL;
+            return;
+
+        case STRING:
+            valueType->type = IR_STRING;
+            return;
+
+        case LNAME:
+            valueType->type = IR_ADDR;
+            valueType->structType = buildIrStruct(treeHead->data->text, lookupIrName(&irStructDeclarations, treeHead->data->text));
+            return;
+
+        default:
+            break;
+        }
+    }
+    else if (treeHead->category == othertype && treeHead->numberOfChildren == 3 && isIrLeaf(treeHead->children[0], LSQUAREBRACE))
+    {
+        struct Constant *size = irConstant(treeHead->children[1]);
+        if (size == NULL || size->type != INT || size->ival < 0 || size->ival > 0x7fffffff)
+        {
+            irUnsupported(treeHead, "array size must be a non-negative integer constant");
+        }
+        parseIrType(treeHead->children[2], valueType);
+        if (valueType->arraySize >= 0)
+        {
+            irUnsupported(treeHead, "nested arrays are not supported");
+        }
+        valueType->arraySize = (int)size->ival;
+        return;
+    }
+    irUnsupported(treeHead, "unsupported type");
+}
+
+struct IrStruct *buildIrStruct(char *name, struct Node *treeHead)
+{
+    // treeHead is the structtype node of the declaration
+    struct IrStruct *structType = findIrStruct(currentIrModule, name);
+    if (structType == NULL && treeHead == NULL)
+    {
+        irUnsupported(NULL, "unknown type");
+    }
+    if (structType != NULL)
+    {
+        if (structType->size < 0)
+        {
+            irUnsupported(treeHead, "recursive struct types are not supported");
+        }
+        return structType;
+    }
+    structType = calloc(1, sizeof(struct IrStruct));
+    structType->name = strdup(name);
+    structType->size = -1;
+    structType->align = 1;
+    // prepend so nested types can find the declaration in progress, reordered by the caller
+    structType->next = currentIrModule->structs;
+    currentIrModule->structs = structType;
+
+    struct Node *list = treeHead->numberOfChildren > 1 ? treeHead->children[1] : NULL;
+    int capacity = 0;
+    int i = 0;
+    int numberOfDeclarations = list == NULL ? 0 : (list->category == structdcl_list ? list->numberOfChildren : 1);
+    for (i = 0; i < numberOfDeclarations; i++)
+    {
+        struct Node *declaration = list->category == structdcl_list ? list->children[i] : list;
+        if (declaration->category != structdcl || declaration->children[0] == NULL || declaration->children[0]->category != new_name_list)
+        {
+            irUnsupported(declaration, "embedded struct fields are not supported");
+        }
+        struct IrValueType fieldType;
+        parseIrType(declaration->children[1], &fieldType);
+        if (fieldType.arraySize >= 0)
+        {
+            irUnsupported(declaration, "array fields are not supported");
+        }
+        struct Node *names = declaration->children[0];
+        int j = 0;
+        for (j = 0; j < names->numberOfChildren; j++)
+        {
+            if (structType->numberOfFields == capacity)
+            {
+                capacity = capacity == 0 ? 4 : capacity * 2;
+                structType->fields = realloc(structType->fields, capacity * sizeof(struct IrField));
+            }
+            struct IrField *field = &structType->fields[structType->numberOfFields];
+            field->name = names->children[j]->children[0]->data->text;
+            field->type = fieldType.type;
+            field->structType = fieldType.structType;
+            field->size = irValueTypeSize(&fieldType);
+            field->align = irValueTypeAlign(&fieldType);
+            field->offset = 0;
+            field->accesses = 0;
+            structType->numberOfFields++;
+        }
+    }
+    // offsets, alignment and size are the layout engine's
+    layoutIrStruct(structType);
+    return structType;
+}
+
+struct IrField *findIrField(struct IrStruct *structType, char *name)
+{
+    int i = 0;
+    for (i = 0; i < structType->numberOfFields; i++)
+    {
+        if (strcmp(structType->fields[i].name, name) == 0)
+        {
+            return &structType->fields[i];
+        }
+    }
+    return NULL;
+}
+
+// a selector's field by the slot handleSelector bound it to, by name when it was not bound
+struct IrField *findIrSelectorField(struct IrStruct *structType, struct Node *name)
+{
+    struct Symbol *field = name->declaration;
+    if (field != NULL && field->slot >= 0 && field->slot < structType->numberOfFields &&
+        strcmp(structType->fields[field->slot].name, name->data->text) == 0)
+    {
+        return &structType->fields[field->slot];
+    }
+    return findIrField(structType, name->data->text);
+}
+
+/*
+ * instruction helpers
+ */
+
+struct IrInstr *resolveIrValue(struct IrInstr *value)
+{
+    while (value != NULL && value->replacement != NULL)
+    {
+        value = value->replacement;
+    }
+    return value;
+}
+
+struct IrInstr *emitIr0(int op, int type)
+{
+    struct IrInstr *instr = createIrInstr(op, type);
+    instr->line = currentIrLine;
+    appendIrInstr(currentIrBlock, instr);
+    return instr;
+}
+
+struct IrInstr *emitIr1(int op, int type, struct IrInstr *a)
+{
+    struct IrInstr *instr = createIrInstr(op, type);
+    instr->line = currentIrLine;
+    addIrArg(instr, resolveIrValue(a));
+    appendIrInstr(currentIrBlock, instr);
+    return instr;
+}
+
+struct IrInstr *emitIr2(int op, int type, struct IrInstr *a, struct IrInstr *b)
+{
+    struct IrInstr *instr = createIrInstr(op, type);
+    instr->line = currentIrLine;
+    addIrArg(instr, resolveIrValue(a));
+    addIrArg(instr, resolveIrValue(b));
+    appendIrInstr(currentIrBlock, instr);
+    return instr;
+}
+
+struct IrInstr *emitIrInt(long long value)
+{
+    struct IrInstr *instr = emitIr0(IR_CONST, IR_INT);
+    instr->ival = value;
+    return instr;
+}
+
+// parameters, slots and undefined values go to the top of the entry block
+void insertIrEntryInstr(struct IrInstr *instr)
+{
+    struct IrBlock *entry = currentIrFunction->blocks[0];
+    if (irEntryHeader == NULL)
+    {
+        if (entry->first == NULL)
+        {
+            appendIrInstr(entry, instr);
+        }
+        else
+        {
+            insertIrInstrBefore(entry->first, instr);
+        }
+    }
+    else if (irEntryHeader->next == NULL)
+    {
+        appendIrInstr(entry, instr);
+    }
+    else
+    {
+        insertIrInstrBefore(irEntryHeader->next, instr);
+    }
+    irEntryHeader = instr;
+}
+
+struct IrInstr *zeroIrValue(int type)
+{
+    // the value of a variable read before any assignment on some path
+    if (irZeroValues[type] == NULL)
+    {
+        struct IrInstr *instr = createIrInstr(IR_CONST, type);
+        if (type == IR_STRING)
+        {
+            instr->sval = "";
+        }
+        insertIrEntryInstr(instr);
+        irZeroValues[type] = instr;
+    }
+    return irZeroValues[type];
+}
+
+void jumpIr(struct IrBlock *target)
+{
+    if (currentIrBlock != NULL)
+    {
+        struct IrInstr *instr = emitIr0(IR_JUMP, IR_VOID);
+        instr->target[0] = target;
+        addIrPred(target, currentIrBlock);
+        currentIrBlock = NULL;
+    }
+}
+
+void branchIr(struct IrInstr *condition, struct IrBlock *whenTrue, struct IrBlock *whenFalse)
+{
+    struct IrInstr *instr = emitIr1(IR_BRANCH, IR_VOID, condition);
+    instr->target[0] = whenTrue;
+    instr->target[1] = whenFalse;
+    addIrPred(whenTrue, currentIrBlock);
+    addIrPred(whenFalse, currentIrBlock);
+    currentIrBlock = NULL;
+}
+
+/*
+ * ssa construction
+ */
+
+long long irDefinitionKey(int variable, struct IrBlock *block)
+{
+    return ((long long)variable << 32) | (unsigned int)block->id;
+}
+
+int irDefinitionSlot(long long key)
+{
+    unsigned long long h = (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+    return (int)(h >> 40) & (irDefinitionSize - 1);
+}
+
+void writeIrVariable(int variable, struct IrBlock *block, struct IrInstr *value)
+{
+    if (2 * (irDefinitionCount + 1) > irDefinitionSize)
+    {
+        struct IrDefinition *old = irDefinitions;
+        int oldSize = irDefinitionSize;
+        int i = 0;
+        irDefinitionSize = irDefinitionSize == 0 ? 256 : irDefinitionSize * 2;
+        irDefinitions = calloc(irDefinitionSize, sizeof(struct IrDefinition));
+        irDefinitionCount = 0;
+        for (i = 0; i < oldSize; i++)
+        {
+            if (old[i].value != NULL)
+            {
+                int slot = irDefinitionSlot(old[i].key);
+                while (irDefinitions[slot].value != NULL)
+                {
+                    slot = (slot + 1) & (irDefinitionSize - 1);
+                }
+                irDefinitions[slot] = old[i];
+                irDefinitionCount++;
+            }
+        }
+        free(old);
+    }
+    long long key = irDefinitionKey(variable, block);
+    int slot = irDefinitionSlot(key);
+    while (irDefinitions[slot].value != NULL && irDefinitions[slot].key != key)
+    {
+        slot = (slot + 1) & (irDefinitionSize - 1);
+    }
+    if (irDefinitions[slot].value == NULL)
+    {
+        irDefinitionCount++;
+    }
+    irDefinitions[slot].key = key;
+    irDefinitions[slot].value = value;
+}
+
+struct IrInstr *findIrDefinition(int variable, struct IrBlock *block)
+{
+    if (irDefinitionSize == 0)
+    {
+        return NULL;
+    }
+    long long key = irDefinitionKey(variable, block);
+    int slot = irDefinitionSlot(key);
+    while (irDefinitions[slot].value != NULL)
+    {
+        if (irDefinitions[slot].key == key)
+        {
+            return resolveIrValue(irDefinitions[slot].value);
+        }
+        slot = (slot + 1) & (irDefinitionSize - 1);
+    }
+    return NULL;
+}
+
+struct IrInstr *createIrPhi(struct IrBlock *block, int type)
+{
+    struct IrInstr *phi = createIrInstr(IR_PHI, type);
+    phi->line = currentIrLine;
+    // phis stay ahead of every other instruction of the block
+    struct IrInstr *position = block->first;
+    while (position != NULL && position->op == IR_PHI)
+    {
+        position = position->next;
+    }
+    if (position == NULL)
+    {
+        appendIrInstr(block, phi);
+    }
+    else
+    {
+        insertIrInstrBefore(position, phi);
+    }
+    // operands are still being collected
+    phi->mark = 1;
+    return phi;
+}
+
+void retireIrPhi(struct IrInstr *phi, struct IrInstr *value)
+{
+    int i = 0;
+    replaceIrUses(phi, value);
+    for (i = 0; i < phi->numberOfArgs; i++)
+    {
+        setIrArg(phi, i, NULL);
+    }
+    unlinkIrInstr(phi);
+    phi->block = NULL;
+    phi->replacement = value;
+    if (irRetiredCount == irRetiredCapacity)
+    {
+        irRetiredCapacity = irRetiredCapacity == 0 ? 64 : irRetiredCapacity * 2;
+        irRetiredPhis = realloc(irRetiredPhis, irRetiredCapacity * sizeof(struct IrInstr *));
+    }
+    irRetiredPhis[irRetiredCount++] = phi;
+}
+
+struct IrInstr *removeTrivialIrPhi(struct IrInstr *phi)
+{
+    // a phi whose operands are all one value (or itself) is that value
+    int capacity = 16;
+    int top = 0;
+    struct IrInstr **worklist = malloc(capacity * sizeof(struct IrInstr *));
+    phi->mark = 0;
+    worklist[top++] = phi;
+    while (top > 0)
+    {
+        struct IrInstr *current = worklist[--top];
+        struct IrInstr *same = NULL;
+        int trivial = 1;
+        int i = 0;
+        if (current->block == NULL || current->mark)
+        {
+            continue;
+        }
+        for (i = 0; i < current->numberOfArgs; i++)
+        {
+            struct IrInstr *operand = current->args[i];
+            if (operand == same || operand == current)
+            {
+                continue;
+            }
+            if (same != NULL)
+            {
+                trivial = 0;
+                break;
+            }
+            same = operand;
+        }
+        if (!trivial)
+        {
+            continue;
+        }
+        if (same == NULL)
+        {
+            // only reachable through itself, or not at all
+            same = zeroIrValue(current->type);
+        }
+        for (i = 0; i < current->numberOfUsers; i++)
+        {
+            struct IrInstr *user = current->users[i];
+            if (user != current && user->op == IR_PHI)
+            {
+                if (top == capacity)
+                {
+                    capacity *= 2;
+                    worklist = realloc(worklist, capacity * sizeof(struct IrInstr *));
+                }
+                worklist[top++] = user;
+            }
+        }
+        retireIrPhi(current, same);
+    }
+    free(worklist);
+    return resolveIrValue(phi);
+}
+
+void addIrPendingPhi(struct IrBlock *block, int variable, struct IrInstr *phi)
+{
+    if (block->id >= irPendingCapacity)
+    {
+        int oldCapacity = irPendingCapacity;
+        irPendingCapacity = block->id * 2 + 16;
+        irPendingPhis = realloc(irPendingPhis, irPendingCapacity * sizeof(struct IrPendingPhi *));
+        memset(irPendingPhis + oldCapacity, 0, (irPendingCapacity - oldCapacity) * sizeof(struct IrPendingPhi *));
+    }
+    struct IrPendingPhi *pending = malloc(sizeof(struct IrPendingPhi));
+    pending->variable = variable;
+    pending->phi = phi;
+    pending->next = irPendingPhis[block->id];
+    irPendingPhis[block->id] = pending;
+}
+
+struct IrInstr *readIrVariable(int variable, struct IrBlock *block)
+{
+    struct IrInstr *value = findIrDefinition(variable, block);
+    if (value != NULL)
+    {
+        return value;
+    }
+
+    // blocks walked through on the way to a definition, each gets that definition
+    int chainCapacity = 16;
+    int chainTop = 0;
+    struct IrBlock **chain = malloc(chainCapacity * sizeof(struct IrBlock *));
+    int frameCapacity = 4;
+    int frameTop = 0;
+    struct IrReadFrame *frames = malloc(frameCapacity * sizeof(struct IrReadFrame));
+    int type = irVariables[variable]->valueType.type;
+    int walkBase = 0;
+    struct IrBlock *current = block;
+
+    for (;;)
+    {
+        // follow single predecessors until a definition or a merge point
+        value = NULL;
+        for (;;)
+        {
+            value = findIrDefinition(variable, current);
+            if (value != NULL)
+            {
+                break;
+            }
+            if (!current->sealed)
+            {
+                value = createIrPhi(current, type);
+                addIrPendingPhi(current, variable, value);
+                writeIrVariable(variable, current, value);
+                break;
+            }
+            if (current->numberOfPreds == 0)
+            {
+                value = zeroIrValue(type);
+                writeIrVariable(variable, current, value);
+                break;
+            }
+            if (current->numberOfPreds > 1)
+            {
+                // the phi breaks cycles through loops before its operands are read
+                struct IrInstr *phi = createIrPhi(current, type);
+                writeIrVariable(variable, current, phi);
+                if (frameTop == frameCapacity)
+                {
+                    frameCapacity *= 2;
+                    frames = realloc(frames, frameCapacity * sizeof(struct IrReadFrame));
+                }
+                frames[frameTop].phi = phi;
+                frames[frameTop].variable = variable;
+                frames[frameTop].nextPred = 0;
+                frames[frameTop].chainBase = walkBase;
+                frameTop++;
+                walkBase = chainTop;
+                current = current->preds[0];
+                continue;
+            }
+            if (chainTop == chainCapacity)
+            {
+                chainCapacity *= 2;
+                chain = realloc(chain, chainCapacity * sizeof(struct IrBlock *));
+            }
+            chain[chainTop++] = current;
+            current = current->preds[0];
+        }
+
+        // hand the value up through the chain and the waiting phis
+        for (;;)
+        {
+            int i = 0;
+            for (i = walkBase; i < chainTop; i++)
+            {
+                writeIrVariable(variable, chain[i], value);
+            }
+            chainTop = walkBase;
+            if (frameTop == 0)
+            {
+                free(chain);
+                free(frames);
+                return resolveIrValue(value);
+            }
+            struct IrReadFrame *frame = &frames[frameTop - 1];
+            addIrArg(frame->phi, resolveIrValue(value));
+            frame->nextPred++;
+            if (frame->nextPred < frame->phi->block->numberOfPreds)
+            {
+                current = frame->phi->block->preds[frame->nextPred];
+                walkBase = chainTop;
+                break;
+            }
+            value = removeTrivialIrPhi(frame->phi);
+            walkBase = frame->chainBase;
+            frameTop--;
+        }
+    }
+}
+
+void sealIrBlock(struct IrBlock *block)
+{
+    if (block->id < irPendingCapacity)
+    {
+        struct IrPendingPhi *pending = irPendingPhis[block->id];
+        irPendingPhis[block->id] = NULL;
+        while (pending != NULL)
+        {
+            struct IrPendingPhi *next = pending->next;
+            int i = 0;
+            for (i = 0; i < block->numberOfPreds; i++)
+            {
+                addIrArg(pending->phi, readIrVariable(pending->variable, block->preds[i]));
+            }
+            removeTrivialIrPhi(pending->phi);
+            free(pending);
+            pending = next;
+        }
+    }
+    block->sealed = 1;
+}
+
+struct IrBlock *createSealedIrBlock()
+{
+    struct IrBlock *block = createIrBlock(currentIrFunction);
+    block->sealed = 1;
+    return block;
+}
+
+/*
+ * variables
+ */
+
+struct IrVariable *declareIrVariable(struct Node *nameNode, struct IrValueType *valueType)
+{
+    if (lookupIrName(&irLocalNames, nameNode->data->text) != NULL)
+    {
+        irUnsupported(nameNode, "redeclared local variable");
+    }
+    struct IrVariable *variable = calloc(1, sizeof(struct IrVariable));
+    variable->name = nameNode->data->text;
+    variable->valueType = *valueType;
+    variable->index = numberOfIrVariables;
+    if (numberOfIrVariables == irVariableCapacity)
+    {
+        irVariableCapacity = irVariableCapacity == 0 ? 16 : irVariableCapacity * 2;
+        irVariables = realloc(irVariables, irVariableCapacity * sizeof(struct IrVariable *));
+    }
+    irVariables[numberOfIrVariables++] = variable;
+    insertIrName(&irLocalNames, variable->name, variable);
+
+    if (isIrAggregate(valueType))
+    {
+        variable->slot = createIrInstr(IR_SLOT, IR_ADDR);
+        variable->slot->ival = irValueTypeSize(valueType);
+        variable->slot->sval = variable->name;
+        variable->slot->slotType = valueType->type;
+        variable->slot->slotStruct = valueType->structType;
+        insertIrEntryInstr(variable->slot);
+    }
+    return variable;
+}
+
+struct IrInstr *coerceIrValue(struct IrInstr *value, int type, struct Node *treeHead)
+{
+    // untyped integer constants take the type of the other side
+    if (value->type == IR_INT && type == IR_FLOAT && value->op == IR_CONST)
+    {
+        struct IrInstr *converted = emitIr0(IR_CONST, IR_FLOAT);
+        converted->dval = (double)value->ival;
+        return converted;
+    }
+    if (value->type != type)
+    {
+        irUnsupported(treeHead, "mismatched types");
+    }
+    return value;
+}
+
+struct IrInstr *readIrNamedValue(struct Node *nameNode)
+{
+    char *name = nameNode->data->text;
+    struct IrVariable *variable = lookupIrName(&irLocalNames, name);
+    if (variable != NULL)
+    {
+        if (variable->slot != NULL)
+        {
+            irUnsupported(nameNode, "struct and array values can only be copied by assignment");
+        }
+        return readIrVariable(variable->index, currentIrBlock);
+    }
+    struct IrGlobal *global = lookupIrName(&irGlobalNames, name);
+    if (global != NULL)
+    {
+        if (global->structType != NULL || global->arraySize >= 0)
+        {
+            irUnsupported(nameNode, "struct and array values can only be copied by assignment");
+        }
+        struct IrInstr *address = emitIr0(IR_GLOBAL, IR_ADDR);
+        address->sval = global->name;
+        return emitIr1(IR_LOAD, global->type, address);
+    }
+    irUnsupported(nameNode, "undeclared name");
+    return NULL;
+}
+
+/*
+ * expressions
+ */
+
+struct IrInstr *lowerIrConstant(struct Constant *value)
+{
+    struct IrInstr *instr = emitIr0(IR_CONST, irConstantType(value));
+    switch (value->type)
+    {
+    case FLOAT64:
+        instr->dval = value->dval;
+        break;
+
+    case STRING:
+        instr->sval = value->sval;
+        break;
+
+    default:
+        instr->ival = value->ival;
+        break;
+    }
+    return instr;
+}
+
+struct IrInstr *lowerIrLiteral(struct Node *leaf)
+{
+    struct IrInstr *instr = NULL;
+    switch (leaf->data->category)
+    {
+    case NUMERICLITERAL:
+    case OCTAL:
+    case HEXADECIMAL:
+    {
+        // the checker already rejected literals that do not fit
+        unsigned long long magnitude = 0;
+        decodeIntegerLiteral(leaf->data->text, &magnitude);
+        instr = emitIr0(IR_CONST, IR_INT);
+        instr->ival = (long long)magnitude;
+        return instr;
+    }
+
+    case DECIMAL:
+    case SCIENTIFICNUM:
+        instr = emitIr0(IR_CONST, IR_FLOAT);
+        decodeFloatLiteral(leaf->data->text, &instr->dval);
+        return instr;
+
+    case STRINGLIT:
+        instr = emitIr0(IR_CONST, IR_STRING);
+        instr->sval = leaf->data->sval;
+        return instr;
+
+    case CHAR:
+    {
+        // the checker types character literals as strings, drop the quotes
+        char *text = leaf->data->sval;
+        int length = strlen(text);
+        instr = emitIr0(IR_CONST, IR_STRING);
+        if (length >= 2 && text[0] == '\'' && text[length - 1] == '\'')
+        {
+            instr->sval = strndup(text + 1, length - 2);
+        }
+        else
+        {
+            instr->sval = text;
+        }
+        return instr;
+    }
+
+    case LNAME:
+        return readIrNamedValue(leaf);
+
+    default:
+        irUnsupported(leaf, "unsupported literal");
+        return NULL;
+    }
+}
+
+int irBinaryOp(int category)
+{
+    switch (category)
+    {
+    case PLUS:
+        return IR_ADD;
+    case MINUS:
+        return IR_SUB;
+    case STAR:
+        return IR_MUL;
+    case DIVIDE:
+        return IR_DIV;
+    case MOD:
+        return IR_MOD;
+    case LEQ:
+        return IR_EQ;
+    case LNE:
+        return IR_NE;
+    case LLT:
+        return IR_LT;
+    case LLE:
+        return IR_LE;
+    case LGT:
+        return IR_GT;
+    case LGE:
+        return IR_GE;
+    default:
+        return 0;
+    }
+}
+
+struct IrInstr *lowerIrShortCircuit(struct Node *treeHead, int isAnd)
+{
+    struct IrInstr *left = coerceIrValue(lowerIrExpression(treeHead->children[0]), IR_BOOL, treeHead);
+    // the value when the right side is skipped, defined before the branch
+    struct IrInstr *skipped = emitIr0(IR_CONST, IR_BOOL);
+    skipped->ival = isAnd ? 0 : 1;
+    struct IrBlock *rightBlock = createSealedIrBlock();
+    struct IrBlock *join = createIrBlock(currentIrFunction);
+    if (isAnd)
+    {
+        branchIr(left, rightBlock, join);
+    }
+    else
+    {
+        branchIr(left, join, rightBlock);
+    }
+    currentIrBlock = rightBlock;
+    struct IrInstr *right = coerceIrValue(lowerIrExpression(treeHead->children[2]), IR_BOOL, treeHead);
+    jumpIr(join);
+    sealIrBlock(join);
+    currentIrBlock = join;
+    struct IrInstr *phi = createIrPhi(join, IR_BOOL);
+    addIrArg(phi, skipped);
+    addIrArg(phi, resolveIrValue(right));
+    phi->mark = 0;
+    return phi;
+}
+
+struct IrInstr *lowerIrBinary(struct Node *treeHead)
+{
+    int category = treeHead->children[1]->data->category;
+    if (category == LANDAND || category == LOROR)
+    {
+        return lowerIrShortCircuit(treeHead, category == LANDAND);
+    }
+    int op = irBinaryOp(category);
+    if (op == 0)
+    {
+        irUnsupported(treeHead, "unsupported operator");
+    }
+    struct IrInstr *left = lowerIrExpression(treeHead->children[0]);
+    struct IrInstr *right = lowerIrExpression(treeHead->children[2]);
+    if (left->type == IR_FLOAT)
+    {
+        right = coerceIrValue(right, IR_FLOAT, treeHead);
+    }
+    else if (right->type == IR_FLOAT)
+    {
+        left = coerceIrValue(left, IR_FLOAT, treeHead);
+    }
+    else
+    {
+        right = coerceIrValue(right, left->type, treeHead);
+    }
+
+    int type = left->type;
+    switch (op)
+    {
+    case IR_EQ:
+    case IR_NE:
+        return emitIr2(op, IR_BOOL, left, right);
+
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        if (type == IR_BOOL)
+        {
+            irUnsupported(treeHead, "bools are not ordered");
+        }
+        return emitIr2(op, IR_BOOL, left, right);
+
+    case IR_ADD:
+        if (type != IR_INT && type != IR_FLOAT && type != IR_STRING)
+        {
+            irUnsupported(treeHead, "operator needs numbers or strings");
+        }
+        return emitIr2(op, type, left, right);
+
+    case IR_MOD:
+        if (type != IR_INT)
+        {
+            irUnsupported(treeHead, "operator needs integers");
+        }
+        return emitIr2(op, type, left, right);
+
+    default:
+        if (type != IR_INT && type != IR_FLOAT)
+        {
+            irUnsupported(treeHead, "operator needs numbers");
+        }
+        return emitIr2(op, type, left, right);
+    }
+}
+
+struct IrInstr *lowerIrUnary(struct Node *treeHead)
+{
+    struct IrInstr *operand = lowerIrExpression(treeHead->children[1]);
+    switch (treeHead->children[0]->data->category)
+    {
+    case PLUS:
+        return operand;
+
+    case MINUS:
+        if (operand->type != IR_INT && operand->type != IR_FLOAT)
+        {
+            irUnsupported(treeHead, "operator needs numbers");
+        }
+        return emitIr1(IR_NEG, operand->type, operand);
+
+    case EXCLAMATION:
+        return emitIr1(IR_NOT, IR_BOOL, coerceIrValue(operand, IR_BOOL, treeHead));
+
+    default:
+        irUnsupported(treeHead, "unsupported operator");
+        return NULL;
+    }
+}
+
+struct IrInstr *lowerIrConversion(struct Node *treeHead)
+{
+    struct IrValueType target;
+    parseIrType(treeHead->children[0], &target);
+    struct IrInstr *value = lowerIrExpression(treeHead->children[1]);
+    if (target.type == value->type && !isIrAggregate(&target))
+    {
+        return value;
+    }
+    if (target.type == IR_FLOAT && value->type == IR_INT)
+    {
+        return emitIr1(IR_ITOF, IR_FLOAT, value);
+    }
+    if (target.type == IR_INT && value->type == IR_FLOAT)
+    {
+        return emitIr1(IR_FTOI, IR_INT, value);
+    }
+    irUnsupported(treeHead, "unsupported conversion");
+    return NULL;
+}
+
+struct IrInstr *lowerIrExpression(struct Node *treeHead)
+{
+    treeHead = unwrapIrExpression(treeHead);
+    if (treeHead == NULL)
+    {
+        irUnsupported(NULL, "missing expression");
+    }
+    if (treeHead->constant != NULL)
+    {
+        // folded by the checker, nothing left to compute
+        return lowerIrConstant(treeHead->constant);
+    }
+    if (treeHead->numberOfChildren == 0)
+    {
+        return lowerIrLiteral(treeHead);
+    }
+    switch (treeHead->category)
+    {
+    case expr:
+        return lowerIrBinary(treeHead);
+
+    case uexpr:
+        return lowerIrUnary(treeHead);
+
+    case pexpr_no_paren:
+        if (treeHead->numberOfChildren == 1)
+        {
+            if (treeHead->children[0]->category == pseudocall)
+            {
+                return lowerIrCall(treeHead->children[0], 1);
+            }
+            return lowerIrExpression(treeHead->children[0]);
+        }
+        if (treeHead->numberOfChildren == 2)
+        {
+            return lowerIrConversion(treeHead);
+        }
+        if (treeHead->numberOfChildren == 3 && (isIrLeaf(treeHead->children[1], PERIOD) || isIrLeaf(treeHead->children[1], LSQUAREBRACE)))
+        {
+            struct IrValueType valueType;
+            struct IrInstr *address = lowerIrAddress(treeHead, &valueType);
+            if (isIrAggregate(&valueType))
+            {
+                irUnsupported(treeHead, "struct and array values can only be copied by assignment");
+            }
+            return emitIr1(IR_LOAD, valueType.type, address);
+        }
+        break;
+
+    default:
+        break;
+    }
+    irUnsupported(treeHead, "unsupported expression");
+    return NULL;
+}
+
+struct IrInstr *lowerIrAddress(struct Node *treeHead, struct IrValueType *valueType)
+{
+    treeHead = unwrapIrExpression(treeHead);
+    char *name = irIdentifierName(treeHead);
+    if (name != NULL)
+    {
+        struct IrVariable *variable = lookupIrName(&irLocalNames, name);
+        if (variable != NULL)
+        {
+            if (variable->slot == NULL)
+            {
+                irUnsupported(treeHead, "scalar locals have no address");
+            }
+            *valueType = variable->valueType;
+            return variable->slot;
+        }
+        struct IrGlobal *global = lookupIrName(&irGlobalNames, name);
+        if (global == NULL)
+        {
+            irUnsupported(treeHead, "undeclared name");
+        }
+        valueType->type = global->type;
+        valueType->structType = global->structType;
+        valueType->arraySize = global->arraySize;
+        struct IrInstr *address = emitIr0(IR_GLOBAL, IR_ADDR);
+        address->sval = global->name;
+        return address;
+    }
+    if (treeHead->category == pexpr_no_paren && treeHead->numberOfChildren == 3 && isIrLeaf(treeHead->children[1], PERIOD))
+    {
+        struct IrInstr *base = lowerIrAddress(treeHead->children[0], valueType);
+        if (valueType->structType == NULL || valueType->arraySize >= 0)
+        {
+            irUnsupported(treeHead, "field selector on a value that is not a struct");
+        }
+        struct IrField *field = findIrSelectorField(valueType->structType, treeHead->children[2]);
+        if (field == NULL)
+        {
+            irUnsupported(treeHead, "unknown struct field");
+        }
+        valueType->type = field->type;
+        valueType->structType = field->structType;
+        valueType->arraySize = -1;
+        if (field->offset == 0)
+        {
+            return base;
+        }
+        struct IrInstr *address = emitIr1(IR_FIELD, IR_ADDR, base);
+        address->ival = field->offset;
+        address->sval = field->name;
+        return address;
+    }
+    if (treeHead->category == pexpr_no_paren && treeHead->numberOfChildren == 3 && isIrLeaf(treeHead->children[1], LSQUAREBRACE))
+    {
+        struct IrInstr *base = lowerIrAddress(treeHead->children[0], valueType);
+        if (valueType->arraySize < 0)
+        {
+            irUnsupported(treeHead, "index on a value that is not an array");
+        }
+        struct IrInstr *index = coerceIrValue(lowerIrExpression(treeHead->children[2]), IR_INT, treeHead);
+        if (index->op == IR_CONST && (index->ival < 0 || index->ival >= valueType->arraySize))
+        {
+            irUnsupported(treeHead, "constant index out of range");
+        }
+        struct IrInstr *check = emitIr1(IR_BOUNDS, IR_VOID, index);
+        check->ival = valueType->arraySize;
+        valueType->arraySize = -1;
+        struct IrInstr *address = emitIr2(IR_ELEM, IR_ADDR, base, index);
+        address->ival = irValueTypeSize(valueType);
+        return address;
+    }
+    irUnsupported(treeHead, "expression is not addressable");
+    return NULL;
+}
+
+int irImportedType(char *typeName, struct Node *treeHead)
+{
+    if (typeName[0] == '\0')
+    {
+        return IR_VOID;
+    }
+    if (strcmp(typeName, "int") == 0)
+    {
+        return IR_INT;
+    }
+    if (strcmp(typeName, "float64") == 0)
+    {
+        return IR_FLOAT;
+    }
+    if (strcmp(typeName, "bool") == 0)
+    {
+        return IR_BOOL;
+    }
+    if (strcmp(typeName, "string") == 0)
+    {
+        return IR_STRING;
+    }
+    irUnsupported(treeHead, "struct and array parameters are not supported");
+    return IR_VOID;
+}
+
+// a call of a function from a package built with -package, typed by its export summary
+struct IrInstr *lowerIrImportedCall(struct Node *treeHead, struct ExportSummary *summary, char *member)
+{
+    struct Node *arguments = treeHead->numberOfChildren > 1 ? treeHead->children[1] : NULL;
+    int numberOfArguments = arguments == NULL ? 0 : (arguments->category == expr_or_type_list ? arguments->numberOfChildren : 1);
+    struct ExportFunction *exported = findExportedFunction(summary, member);
+    int i = 0;
+    if (exported == NULL)
+    {
+        irUnsupported(treeHead, "call of a name the package does not export");
+    }
+    if ((int)exported->numberOfParameters != numberOfArguments)
+    {
+        irUnsupported(treeHead, "wrong number of arguments");
+    }
+    struct IrInstr **values = malloc((numberOfArguments + 1) * sizeof(struct IrInstr *));
+    for (i = 0; i < numberOfArguments; i++)
+    {
+        struct Node *argument = arguments->category == expr_or_type_list ? arguments->children[i] : arguments;
+        int type = irImportedType(exportString(summary, exportedVariable(summary, exported->firstParameter + i)->typeName), argument);
+        values[i] = coerceIrValue(lowerIrExpression(argument), type, argument);
+    }
+    struct IrInstr *call = createIrInstr(IR_CALL, irImportedType(exportString(summary, exported->resultType), treeHead));
+    call->sval = malloc(strlen(exportString(summary, summary->header->packageName)) + strlen(member) + 2);
+    sprintf(call->sval, "%s.%s", exportString(summary, summary->header->packageName), member);
+    call->line = currentIrLine;
+    for (i = 0; i < numberOfArguments; i++)
+    {
+        addIrArg(call, resolveIrValue(values[i]));
+    }
+    free(values);
+    appendIrInstr(currentIrBlock, call);
+    return call;
+}
+
+struct IrInstr *lowerIrCall(struct Node *treeHead, int wantValue)
+{
+    struct Node *callee = unwrapIrExpression(treeHead->children[0]);
+    struct Node *arguments = treeHead->numberOfChildren > 1 ? treeHead->children[1] : NULL;
+    int numberOfArguments = arguments == NULL ? 0 : (arguments->category == expr_or_type_list ? arguments->numberOfChildren : 1);
+    struct IrInstr *call = NULL;
+    int i = 0;
+
+    if (treeHead->numberOfChildren > 2)
+    {
+        irUnsupported(treeHead, "variadic calls are not supported");
+    }
+    char *name = irIdentifierName(callee);
+    if (name != NULL)
+    {
+        struct IrFunction *irFunction = findIrFunction(currentIrModule, qualifyIrName(name));
+        if (irFunction == NULL)
+        {
+            irUnsupported(treeHead, "call of an undeclared function");
+        }
+        if (irFunction->numberOfParams != numberOfArguments)
+        {
+            irUnsupported(treeHead, "wrong number of arguments");
+        }
+        struct IrInstr **values = malloc((numberOfArguments + 1) * sizeof(struct IrInstr *));
+        for (i = 0; i < numberOfArguments; i++)
+        {
+            struct Node *argument = arguments->category == expr_or_type_list ? arguments->children[i] : arguments;
+            values[i] = coerceIrValue(lowerIrExpression(argument), irFunction->paramTypes[i], argument);
+        }
+        call = createIrInstr(IR_CALL, irFunction->returnType);
+        call->sval = irFunction->name;
+        call->line = currentIrLine;
+        for (i = 0; i < numberOfArguments; i++)
+        {
+            addIrArg(call, resolveIrValue(values[i]));
+        }
+        free(values);
+        appendIrInstr(currentIrBlock, call);
+    }
+    else if (callee->category == pexpr_no_paren && callee->numberOfChildren == 3 && isIrLeaf(callee->children[1], PERIOD) &&
+             irIdentifierName(callee->children[0]) != NULL && findImportedPackage(irIdentifierName(callee->children[0])) != NULL)
+    {
+        call = lowerIrImportedCall(treeHead, findImportedPackage(irIdentifierName(callee->children[0])), callee->children[2]->data->text);
+    }
+    else if (callee->category == pexpr_no_paren && callee->numberOfChildren == 3 && isIrLeaf(callee->children[1], PERIOD) &&
+             irIdentifierName(callee->children[0]) != NULL)
+    {
+        char *packageName = irIdentifierName(callee->children[0]);
+        char *member = callee->children[2]->data->text;
+        int op = 0;
+        int type = IR_VOID;
+        if (strcmp(packageName, "fmt") == 0 && strcmp(member, "Println") == 0)
+        {
+            op = IR_PRINT;
+        }
+        else if (strcmp(packageName, "time") == 0 && strcmp(member, "Now") == 0 && numberOfArguments == 0)
+        {
+            op = IR_NOW;
+            type = IR_INT;
+        }
+        else if (strcmp(packageName, "rand") == 0 && strcmp(member, "Intn") == 0 && numberOfArguments == 1)
+        {
+            op = IR_RANDN;
+            type = IR_INT;
+        }
+        else
+        {
+            irUnsupported(treeHead, "unsupported library call");
+        }
+        struct IrInstr **values = malloc((numberOfArguments + 1) * sizeof(struct IrInstr *));
+        for (i = 0; i < numberOfArguments; i++)
+        {
+            struct Node *argument = arguments->category == expr_or_type_list ? arguments->children[i] : arguments;
+            values[i] = lowerIrExpression(argument);
+            if (op == IR_RANDN)
+            {
+                values[i] = coerceIrValue(values[i], IR_INT, argument);
+            }
+        }
+        call = createIrInstr(op, type);
+        call->line = currentIrLine;
+        for (i = 0; i < numberOfArguments; i++)
+        {
+            addIrArg(call, resolveIrValue(values[i]));
+        }
+        free(values);
+        appendIrInstr(currentIrBlock, call);
+    }
+    else
+    {
+        irUnsupported(treeHead, "unsupported call");
+    }
+
+    if (wantValue && call->type == IR_VOID)
+    {
+        irUnsupported(treeHead, "function without a result used as a value");
+    }
+    return call;
+}
+
+/*
+ * statements
+ */
+
+int irStatementLine(struct Node *treeHead)
+{
+    while (treeHead != NULL && treeHead->numberOfChildren > 0)
+    {
+        int i = 0;
+        struct Node *next = NULL;
+        for (i = 0; i < treeHead->numberOfChildren && next == NULL; i++)
+        {
+            next = treeHead->children[i];
+        }
+        treeHead = next;
+    }
+    if (treeHead != NULL && treeHead->data != NULL)
+    {
+        return treeHead->data->linenumber;
+    }
+    return currentIrLine;
+}
+
+// where an assignment stores its value
+struct IrTarget
+{
+    struct IrVariable *variable;
+    struct IrInstr *address;
+    struct IrValueType valueType;
+};
+
+void lowerIrTarget(struct Node *treeHead, struct IrTarget *target)
+{
+    char *name = irIdentifierName(treeHead);
+    target->variable = NULL;
+    target->address = NULL;
+    if (name != NULL)
+    {
+        struct IrVariable *variable = lookupIrName(&irLocalNames, name);
+        if (variable != NULL && variable->slot == NULL)
+        {
+            target->variable = variable;
+            target->valueType = variable->valueType;
+            return;
+        }
+    }
+    target->address = lowerIrAddress(treeHead, &target->valueType);
+}
+
+void storeIrTarget(struct IrTarget *target, struct IrInstr *value, struct Node *treeHead)
+{
+    value = coerceIrValue(value, target->valueType.type, treeHead);
+    if (target->variable != NULL)
+    {
+        writeIrVariable(target->variable->index, currentIrBlock, value);
+    }
+    else
+    {
+        emitIr2(IR_STORE, IR_VOID, target->address, value);
+    }
+}
+
+struct IrInstr *loadIrTarget(struct IrTarget *target)
+{
+    if (target->variable != NULL)
+    {
+        return readIrVariable(target->variable->index, currentIrBlock);
+    }
+    return emitIr1(IR_LOAD, target->valueType.type, target->address);
+}
+
+int countIrListItems(struct Node *treeHead, int category)
+{
+    if (treeHead == NULL)
+    {
+        return 0;
+    }
+    return treeHead->category == category ? treeHead->numberOfChildren : 1;
+}
+
+struct Node *irListItem(struct Node *treeHead, int category, int index)
+{
+    return treeHead->category == category ? treeHead->children[index] : treeHead;
+}
+
+void lowerIrAssignment(struct Node *left, struct Node *right, struct Node *treeHead)
+{
+    int count = countIrListItems(left, expr_list);
+    int i = 0;
+    if (count != countIrListItems(right, expr_list))
+    {
+        irUnsupported(treeHead, "assignment count mismatch");
+    }
+    struct IrTarget *targets = malloc(count * sizeof(struct IrTarget));
+    struct IrInstr **values = malloc(count * sizeof(struct IrInstr *));
+    for (i = 0; i < count; i++)
+    {
+        lowerIrTarget(irListItem(left, expr_list, i), &targets[i]);
+    }
+    if (count == 1 && isIrAggregate(&targets[0].valueType))
+    {
+        // whole struct or array assignment copies the memory
+        struct IrValueType sourceType;
+        struct IrInstr *source = lowerIrAddress(irListItem(right, expr_list, 0), &sourceType);
+        if (sourceType.structType != targets[0].valueType.structType || sourceType.arraySize != targets[0].valueType.arraySize ||
+            sourceType.type != targets[0].valueType.type)
+        {
+            irUnsupported(treeHead, "mismatched types");
+        }
+        struct IrInstr *copy = emitIr2(IR_COPY, IR_VOID, targets[0].address, source);
+        copy->ival = irValueTypeSize(&sourceType);
+    }
+    else
+    {
+        // every right hand side is evaluated before anything is assigned
+        for (i = 0; i < count; i++)
+        {
+            if (isIrAggregate(&targets[i].valueType))
+            {
+                irUnsupported(treeHead, "struct and array values can only be copied by assignment");
+            }
+            values[i] = lowerIrExpression(irListItem(right, expr_list, i));
+        }
+        for (i = 0; i < count; i++)
+        {
+            storeIrTarget(&targets[i], resolveIrValue(values[i]), treeHead);
+        }
+    }
+    free(targets);
+    free(values);
+}
+
+void initializeIrVariable(struct IrVariable *variable, struct IrInstr *value, struct Node *treeHead)
+{
+    if (variable->slot != NULL)
+    {
+        struct IrInstr *zero = emitIr1(IR_ZERO, IR_VOID, variable->slot);
+        zero->ival = variable->slot->ival;
+    }
+    else
+    {
+        if (value == NULL)
+        {
+            value = emitIr0(IR_CONST, variable->valueType.type);
+            if (variable->valueType.type == IR_STRING)
+            {
+                value->sval = "";
+            }
+        }
+        writeIrVariable(variable->index, currentIrBlock, coerceIrValue(value, variable->valueType.type, treeHead));
+    }
+}
+
+void lowerIrShortDeclaration(struct Node *treeHead)
+{
+    struct Node *left = treeHead->children[0];
+    struct Node *right = treeHead->children[2];
+    int count = countIrListItems(left, expr_list);
+    int i = 0;
+    if (count != countIrListItems(right, expr_list))
+    {
+        irUnsupported(treeHead, "assignment count mismatch");
+    }
+    struct IrInstr **values = malloc(count * sizeof(struct IrInstr *));
+    for (i = 0; i < count; i++)
+    {
+        values[i] = lowerIrExpression(irListItem(right, expr_list, i));
+    }
+    for (i = 0; i < count; i++)
+    {
+        struct Node *name = unwrapIrExpression(irListItem(left, expr_list, i));
+        if (irIdentifierName(name) == NULL)
+        {
+            irUnsupported(treeHead, "non-name on left side of :=");
+        }
+        if (name->category == pexpr_no_paren)
+        {
+            name = name->children[0];
+        }
+        struct IrValueType valueType;
+        valueType.type = values[i]->type;
+        valueType.structType = NULL;
+        valueType.arraySize = -1;
+        initializeIrVariable(declareIrVariable(name, &valueType), resolveIrValue(values[i]), treeHead);
+    }
+    free(values);
+}
+
+void lowerIrSimpleStatement(struct Node *treeHead)
+{
+    treeHead = unwrapIrExpression(treeHead);
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (treeHead->category != simple_stmt)
+    {
+        irUnsupported(treeHead, "unsupported statement");
+    }
+    if (treeHead->numberOfChildren == 1)
+    {
+        struct Node *expression = unwrapIrExpression(treeHead->children[0]);
+        if (expression != NULL && expression->category == pexpr_no_paren && expression->numberOfChildren == 1 &&
+            expression->children[0] != NULL && expression->children[0]->category == pseudocall)
+        {
+            lowerIrCall(expression->children[0], 0);
+        }
+        else
+        {
+            lowerIrExpression(expression);
+        }
+    }
+    else if (treeHead->numberOfChildren == 2)
+    {
+        // x++ and x--
+        struct IrTarget target;
+        lowerIrTarget(treeHead->children[0], &target);
+        if (target.valueType.type != IR_INT && target.valueType.type != IR_FLOAT)
+        {
+            irUnsupported(treeHead, "operator needs numbers");
+        }
+        struct IrInstr *one = NULL;
+        if (target.valueType.type == IR_FLOAT)
+        {
+            one = emitIr0(IR_CONST, IR_FLOAT);
+            one->dval = 1;
+        }
+        else
+        {
+            one = emitIrInt(1);
+        }
+        int op = treeHead->children[1]->data->category == LINC ? IR_ADD : IR_SUB;
+        storeIrTarget(&target, emitIr2(op, target.valueType.type, loadIrTarget(&target), one), treeHead);
+    }
+    else
+    {
+        switch (treeHead->children[1]->data->category)
+        {
+        case EQUAL:
+            lowerIrAssignment(treeHead->children[0], treeHead->children[2], treeHead);
+            break;
+
+        case LCOLAS:
+            lowerIrShortDeclaration(treeHead);
+            break;
+
+        case LASOP:
+        {
+            struct IrTarget target;
+            lowerIrTarget(treeHead->children[0], &target);
+            if (target.valueType.type != IR_INT && target.valueType.type != IR_FLOAT &&
+                !(target.valueType.type == IR_STRING && treeHead->children[1]->data->text[0] == '+'))
+            {
+                irUnsupported(treeHead, "operator needs numbers");
+            }
+            struct IrInstr *current = loadIrTarget(&target);
+            struct IrInstr *value = coerceIrValue(lowerIrExpression(treeHead->children[2]), target.valueType.type, treeHead);
+            int op = treeHead->children[1]->data->text[0] == '+' ? IR_ADD : IR_SUB;
+            storeIrTarget(&target, emitIr2(op, target.valueType.type, current, value), treeHead);
+            break;
+        }
+
+        default:
+            irUnsupported(treeHead, "unsupported statement");
+            break;
+        }
+    }
+}
+
+void lowerIrVariableDeclaration(struct Node *treeHead)
+{
+    // vardcl and constdcl: (names, type), (names, type, =, values) or (names, =, values)
+    struct Node *names = treeHead->children[0];
+    struct Node *typeNode = NULL;
+    struct Node *values = NULL;
+    int count = countIrListItems(names, dcl_name_list);
+    int i = 0;
+    if (treeHead->numberOfChildren == 2)
+    {
+        typeNode = treeHead->children[1];
+    }
+    else if (treeHead->numberOfChildren == 4)
+    {
+        typeNode = treeHead->children[1];
+        values = treeHead->children[3];
+    }
+    else
+    {
+        values = treeHead->children[2];
+    }
+    if (values != NULL && countIrListItems(values, expr_list) != count)
+    {
+        irUnsupported(treeHead, "assignment count mismatch");
+    }
+
+    struct IrValueType valueType;
+    if (typeNode != NULL)
+    {
+        parseIrType(typeNode, &valueType);
+    }
+    struct IrInstr **initial = calloc(count, sizeof(struct IrInstr *));
+    for (i = 0; i < count && values != NULL; i++)
+    {
+        if (typeNode != NULL && isIrAggregate(&valueType))
+        {
+            irUnsupported(treeHead, "struct and array values can only be copied by assignment");
+        }
+        initial[i] = lowerIrExpression(irListItem(values, expr_list, i));
+    }
+    for (i = 0; i < count; i++)
+    {
+        struct Node *name = irListItem(names, dcl_name_list, i)->children[0];
+        if (typeNode == NULL)
+        {
+            valueType.type = initial[i]->type;
+            valueType.structType = NULL;
+            valueType.arraySize = -1;
+        }
+        initializeIrVariable(declareIrVariable(name, &valueType), resolveIrValue(initial[i]), treeHead);
+    }
+    free(initial);
+}
+
+void lowerIrDeclaration(struct Node *treeHead)
+{
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    switch (treeHead->category)
+    {
+    case vardcl:
+    case constdcl:
+        lowerIrVariableDeclaration(treeHead);
+        break;
+
+    case vardcl_list:
+        for (i = 0; i < treeHead->numberOfChildren; i++)
+        {
+            lowerIrDeclaration(treeHead->children[i]);
+        }
+        break;
+
+    case typedcl:
+    case typedcl_list:
+        // struct layouts are module wide and were built up front
+        break;
+
+    default:
+        if (treeHead->numberOfChildren == 0)
+        {
+            // the var, const or type keyword
+            break;
+        }
+        irUnsupported(treeHead, "unsupported declaration");
+        break;
+    }
+}
+
+void lowerIrReturn(struct Node *treeHead)
+{
+    struct Node *value = treeHead->numberOfChildren > 1 ? unwrapIrExpression(treeHead->children[1]) : NULL;
+    if (value == NULL)
+    {
+        if (currentIrFunction->returnType != IR_VOID)
+        {
+            irUnsupported(treeHead, "missing return value");
+        }
+        emitIr0(IR_RETURN, IR_VOID);
+    }
+    else
+    {
+        if (value->category == expr_list && value->numberOfChildren > 1)
+        {
+            irUnsupported(treeHead, "multiple return values are not supported");
+        }
+        if (currentIrFunction->returnType == IR_VOID)
+        {
+            irUnsupported(treeHead, "return value in a function without a result");
+        }
+        emitIr1(IR_RETURN, IR_VOID, coerceIrValue(lowerIrExpression(value), currentIrFunction->returnType, treeHead));
+    }
+    currentIrBlock = NULL;
+}
+
+void lowerIrFor(struct Node *treeHead)
+{
+    struct Node *header = treeHead->children[1]->children[0];
+    struct Node *body = treeHead->children[1]->children[1];
+    struct Node *init = NULL;
+    struct Node *condition = NULL;
+    struct Node *post = NULL;
+    if (header != NULL && header->numberOfChildren == 3)
+    {
+        init = header->children[0];
+        condition = header->children[1];
+        post = header->children[2];
+    }
+    else if (header != NULL)
+    {
+        if (header->children[0] != NULL && header->children[0]->category == range_stmt)
+        {
+            irUnsupported(header, "range loops are not supported");
+        }
+        condition = header->children[0];
+    }
+
+    lowerIrSimpleStatement(init);
+    struct IrBlock *loopHeader = createIrBlock(currentIrFunction);
+    struct IrBlock *loopBody = createSealedIrBlock();
+    struct IrBlock *loopPost = createIrBlock(currentIrFunction);
+    struct IrBlock *exit = createIrBlock(currentIrFunction);
+    jumpIr(loopHeader);
+
+    currentIrBlock = loopHeader;
+    condition = unwrapIrExpression(condition);
+    if (condition != NULL && condition->category == simple_stmt && condition->numberOfChildren == 1)
+    {
+        branchIr(coerceIrValue(lowerIrExpression(condition->children[0]), IR_BOOL, condition), loopBody, exit);
+    }
+    else if (condition != NULL)
+    {
+        irUnsupported(condition, "loop condition must be an expression");
+    }
+    else
+    {
+        jumpIr(loopBody);
+    }
+
+    struct IrLoop loop;
+    loop.breakTarget = exit;
+    loop.continueTarget = loopPost;
+    loop.outer = currentIrLoop;
+    currentIrLoop = &loop;
+    currentIrBlock = loopBody;
+    lowerIrStatement(body);
+    jumpIr(loopPost);
+    currentIrLoop = loop.outer;
+
+    sealIrBlock(loopPost);
+    currentIrBlock = loopPost;
+    lowerIrSimpleStatement(post);
+    jumpIr(loopHeader);
+    sealIrBlock(loopHeader);
+    sealIrBlock(exit);
+    currentIrBlock = exit;
+}
+
+void lowerIrIf(struct Node *treeHead)
+{
+    struct Node *header = treeHead->children[1];
+    struct Node *condition = header->children[header->numberOfChildren - 1];
+    struct Node *elsePart = treeHead->numberOfChildren > 4 ? treeHead->children[4] : NULL;
+    if (treeHead->numberOfChildren > 3 && treeHead->children[3] != NULL)
+    {
+        irUnsupported(treeHead->children[3], "else if is not supported");
+    }
+    if (header->numberOfChildren == 2)
+    {
+        lowerIrSimpleStatement(header->children[0]);
+    }
+    condition = unwrapIrExpression(condition);
+    if (condition == NULL || condition->category != simple_stmt || condition->numberOfChildren != 1)
+    {
+        irUnsupported(header, "if condition must be an expression");
+    }
+
+    struct IrInstr *value = coerceIrValue(lowerIrExpression(condition->children[0]), IR_BOOL, condition);
+    struct IrBlock *thenBlock = createSealedIrBlock();
+    struct IrBlock *elseBlock = elsePart != NULL ? createSealedIrBlock() : NULL;
+    struct IrBlock *join = createIrBlock(currentIrFunction);
+    branchIr(value, thenBlock, elseBlock != NULL ? elseBlock : join);
+
+    currentIrBlock = thenBlock;
+    lowerIrStatement(treeHead->children[2]);
+    jumpIr(join);
+    if (elseBlock != NULL)
+    {
+        currentIrBlock = elseBlock;
+        lowerIrStatement(elsePart->children[elsePart->numberOfChildren - 1]);
+        jumpIr(join);
+    }
+    sealIrBlock(join);
+    currentIrBlock = join;
+}
+
+void lowerIrStatement(struct Node *treeHead)
+{
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (currentIrBlock == NULL)
+    {
+        // code after return, break or continue still gets lowered, then removed as unreachable
+        currentIrBlock = createSealedIrBlock();
+    }
+    switch (treeHead->category)
+    {
+    case stmt_list:
+        for (i = 0; i < treeHead->numberOfChildren; i++)
+        {
+            lowerIrStatement(treeHead->children[i]);
+        }
+        return;
+
+    case compound_stmt:
+    case loop_body:
+    case fnbody:
+        lowerIrStatement(treeHead->children[0]);
+        return;
+
+    case common_dcl:
+        for (i = 1; i < treeHead->numberOfChildren; i++)
+        {
+            lowerIrDeclaration(treeHead->children[i]);
+        }
+        return;
+
+    case simple_stmt:
+        currentIrLine = irStatementLine(treeHead);
+        lowerIrSimpleStatement(treeHead);
+        return;
+
+    case for_stmt:
+        currentIrLine = irStatementLine(treeHead);
+        lowerIrFor(treeHead);
+        return;
+
+    case if_stmt:
+        currentIrLine = irStatementLine(treeHead);
+        lowerIrIf(treeHead);
+        return;
+
+    case non_dcl_stmt:
+        currentIrLine = irStatementLine(treeHead);
+        if (treeHead->children[0] != NULL && treeHead->children[0]->numberOfChildren > 0)
+        {
+            lowerIrStatement(treeHead->children[0]);
+            return;
+        }
+        if (isIrLeaf(treeHead->children[0], LRETURN))
+        {
+            lowerIrReturn(treeHead);
+            return;
+        }
+        if ((isIrLeaf(treeHead->children[0], LBREAK) || isIrLeaf(treeHead->children[0], LCONTINUE)) &&
+            (treeHead->numberOfChildren < 2 || treeHead->children[1] == NULL))
+        {
+            if (currentIrLoop == NULL)
+            {
+                irUnsupported(treeHead, "break or continue outside a loop");
+            }
+            jumpIr(isIrLeaf(treeHead->children[0], LBREAK) ? currentIrLoop->breakTarget : currentIrLoop->continueTarget);
+            return;
+        }
+        break;
+
+    default:
+        break;
+    }
+    irUnsupported(treeHead, "unsupported statement");
+}
+
+/*
+ * module
+ */
+
+void collectIrStructs(struct Node *treeHead)
+{
+    // typedcl: (name, structtype) possibly inside a typedcl_list
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (treeHead->category == typedcl)
+    {
+        struct Node *type = treeHead->children[1];
+        if (type == NULL || type->category != structtype)
+        {
+            irUnsupported(treeHead, "only struct types can be declared");
+        }
+        insertIrName(&irStructDeclarations, treeHead->children[0]->data->text, type);
+    }
+    else if (treeHead->category == typedcl_list || treeHead->category == common_dcl)
+    {
+        for (i = 0; i < treeHead->numberOfChildren; i++)
+        {
+            collectIrStructs(treeHead->children[i]);
+        }
+    }
+}
+
+int evaluateIrConstant(struct Node *treeHead, struct IrGlobal *global)
+{
+    // package level initializers must be constants, the checker folded them
+    struct Constant *value = irConstant(treeHead);
+    if (value == NULL)
+    {
+        return 0;
+    }
+    switch (value->type)
+    {
+    case INT:
+        if (global->type == IR_FLOAT)
+        {
+            global->dval = (double)value->ival;
+            return 1;
+        }
+        global->ival = value->ival;
+        return global->type == IR_INT;
+
+    case FLOAT64:
+        global->dval = value->dval;
+        return global->type == IR_FLOAT;
+
+    case BOOL:
+        global->ival = value->ival;
+        return global->type == IR_BOOL;
+
+    default:
+        global->sval = value->sval;
+        return global->type == IR_STRING;
+    }
+}
+
+int irLiteralType(struct Node *treeHead)
+{
+    struct Constant *value = irConstant(treeHead);
+    return value != NULL ? irConstantType(value) : IR_VOID;
+}
+
+void collectIrGlobals(struct Node *treeHead, struct IrGlobal ***tail)
+{
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (treeHead->category == vardcl || treeHead->category == constdcl)
+    {
+        struct Node *names = treeHead->children[0];
+        struct Node *typeNode = treeHead->numberOfChildren == 3 ? NULL : treeHead->children[1];
+        struct Node *values = treeHead->numberOfChildren == 2 ? NULL : treeHead->children[treeHead->numberOfChildren - 1];
+        int count = countIrListItems(names, dcl_name_list);
+        currentIrLine = irStatementLine(treeHead);
+        if (values != NULL && countIrListItems(values, expr_list) != count)
+        {
+            irUnsupported(treeHead, "assignment count mismatch");
+        }
+        for (i = 0; i < count; i++)
+        {
+            struct Node *name = irListItem(names, dcl_name_list, i)->children[0];
+            struct IrValueType valueType;
+            if (typeNode != NULL)
+            {
+                parseIrType(typeNode, &valueType);
+            }
+            else
+            {
+                valueType.type = irLiteralType(irListItem(values, expr_list, i));
+                valueType.structType = NULL;
+                valueType.arraySize = -1;
+            }
+            struct IrGlobal *global = calloc(1, sizeof(struct IrGlobal));
+            global->name = qualifyIrName(name->data->text);
+            global->type = valueType.type;
+            global->structType = valueType.structType;
+            global->arraySize = valueType.arraySize;
+            global->size = irValueTypeSize(&valueType);
+            if (values != NULL)
+            {
+                if (isIrAggregate(&valueType) || !evaluateIrConstant(irListItem(values, expr_list, i), global))
+                {
+                    irUnsupported(treeHead, "package level initializers must be constants");
+                }
+                global->initialized = 1;
+            }
+            if (lookupIrName(&irGlobalNames, name->data->text) != NULL)
+            {
+                irUnsupported(name, "redeclared global");
+            }
+            insertIrName(&irGlobalNames, name->data->text, global);
+            **tail = global;
+            *tail = &global->next;
+        }
+    }
+    else if (treeHead->category == common_dcl || treeHead->category == vardcl_list)
+    {
+        for (i = 0; i < treeHead->numberOfChildren; i++)
+        {
+            collectIrGlobals(treeHead->children[i], tail);
+        }
+    }
+}
+
+void collectIrParameters(struct IrFunction *irFunction, struct Node *treeHead)
+{
+    // oarg_type_list_ocomma(arg_type_list(arg_type...)); "a, b int" leaves the type off the first names
+    struct Node *list = treeHead == NULL || treeHead->numberOfChildren == 0 ? NULL : treeHead->children[0];
+    int count = countIrListItems(list, arg_type_list);
+    int i = 0;
+    irFunction->numberOfParams = count;
+    irFunction->paramTypes = calloc(count + 1, sizeof(int));
+    for (i = count - 1; i >= 0; i--)
+    {
+        struct Node *argument = irListItem(list, arg_type_list, i);
+        if (argument->numberOfChildren == 2 && argument->children[1] != NULL && argument->children[1]->category == name_or_type)
+        {
+            struct IrValueType valueType;
+            parseIrType(argument->children[1], &valueType);
+            if (isIrAggregate(&valueType))
+            {
+                irUnsupported(argument, "struct and array parameters are not supported");
+            }
+            irFunction->paramTypes[i] = valueType.type;
+        }
+        else if (argument->numberOfChildren == 1 && i + 1 < count)
+        {
+            irFunction->paramTypes[i] = irFunction->paramTypes[i + 1];
+        }
+        else
+        {
+            irUnsupported(argument, "unsupported parameter");
+        }
+    }
+}
+
+struct Node *irParameterName(struct Node *argument)
+{
+    if (argument->numberOfChildren == 2)
+    {
+        return argument->children[0];
+    }
+    // a bare name parsed as name_or_type
+    struct Node *name = unwrapIrExpression(argument->children[0]);
+    if (!isIrLeaf(name, LNAME))
+    {
+        irUnsupported(argument, "unnamed parameter");
+    }
+    return name;
+}
+
+void collectIrFunction(struct Node *treeHead, struct IrFunction ***tail)
+{
+    struct Node *declaration = treeHead->children[1];
+    struct Node *result = declaration->numberOfChildren > 2 ? declaration->children[2] : NULL;
+    currentIrLine = irStatementLine(treeHead);
+    char *name = qualifyIrName(declaration->children[0]->data->text);
+    if (findIrFunction(currentIrModule, name) != NULL)
+    {
+        irUnsupported(declaration, "redeclared function");
+    }
+    int returnType = IR_VOID;
+    if (result != NULL)
+    {
+        struct IrValueType valueType;
+        if (result->category == fnres)
+        {
+            irUnsupported(result, "multiple results are not supported");
+        }
+        parseIrType(result, &valueType);
+        if (isIrAggregate(&valueType))
+        {
+            irUnsupported(result, "struct and array results are not supported");
+        }
+        returnType = valueType.type;
+    }
+    struct IrFunction *irFunction = createIrFunction(name, returnType);
+    collectIrParameters(irFunction, declaration->children[1]);
+    **tail = irFunction;
+    *tail = &irFunction->next;
+}
+
+void lowerIrFunction(struct Node *treeHead, struct IrFunction *irFunction)
+{
+    struct Node *declaration = treeHead->children[1];
+    struct Node *list = declaration->children[1] == NULL || declaration->children[1]->numberOfChildren == 0 ? NULL : declaration->children[1]->children[0];
+    int i = 0;
+
+    currentIrFunction = irFunction;
+    currentIrLoop = NULL;
+    irEntryHeader = NULL;
+    memset(irZeroValues, 0, sizeof(irZeroValues));
+    numberOfIrVariables = 0;
+    irDefinitionCount = 0;
+    if (irDefinitionSize > 0)
+    {
+        memset(irDefinitions, 0, irDefinitionSize * sizeof(struct IrDefinition));
+    }
+    clearIrNames(&irLocalNames);
+
+    currentIrBlock = createSealedIrBlock();
+    currentIrLine = irStatementLine(treeHead);
+    for (i = 0; i < irFunction->numberOfParams; i++)
+    {
+        struct IrValueType valueType;
+        valueType.type = irFunction->paramTypes[i];
+        valueType.structType = NULL;
+        valueType.arraySize = -1;
+        struct IrVariable *variable = declareIrVariable(irParameterName(irListItem(list, arg_type_list, i)), &valueType);
+        struct IrInstr *param = createIrInstr(IR_PARAM, valueType.type);
+        param->ival = i;
+        param->line = currentIrLine;
+        insertIrEntryInstr(param);
+        writeIrVariable(variable->index, currentIrBlock, param);
+    }
+
+    lowerIrStatement(treeHead->children[2]);
+    if (currentIrBlock != NULL)
+    {
+        // falling off the end; only reachable for functions without a result in checked code
+        if (irFunction->returnType == IR_VOID)
+        {
+            emitIr0(IR_RETURN, IR_VOID);
+        }
+        else
+        {
+            emitIr1(IR_RETURN, IR_VOID, zeroIrValue(irFunction->returnType));
+        }
+        currentIrBlock = NULL;
+    }
+
+    for (i = 0; i < numberOfIrVariables; i++)
+    {
+        free(irVariables[i]);
+    }
+    for (i = 0; i < irRetiredCount; i++)
+    {
+        free(irRetiredPhis[i]->args);
+        free(irRetiredPhis[i]->users);
+        free(irRetiredPhis[i]);
+    }
+    irRetiredCount = 0;
+    for (i = 0; i < irFunction->numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = irFunction->blocks[i]->first;
+        while (instr != NULL)
+        {
+            instr->mark = 0;
+            instr = instr->next;
+        }
+    }
+}
+
+struct IrModule *buildIrModule(struct Node *treeHead)
+{
+    struct IrModule *module = calloc(1, sizeof(struct IrModule));
+    struct Node *declarations = treeHead->children[2];
+    int count = countIrListItems(declarations, xdcl_list);
+    struct IrGlobal **globalTail = &module->globals;
+    struct IrFunction **functionTail = &module->functions;
+    int i = 0;
+    currentIrModule = module;
+
+    for (i = 0; i < count; i++)
+    {
+        collectIrStructs(irListItem(declarations, xdcl_list, i));
+    }
+    if (reorderIrFields)
+    {
+        // which fields are used together decides their order, so count before laying out
+        countIrFieldAccesses(treeHead);
+    }
+    for (i = 0; i < count; i++)
+    {
+        struct Node *declaration = irListItem(declarations, xdcl_list, i);
+        if (declaration != NULL && declaration->category == common_dcl && declaration->children[1] != NULL &&
+            declaration->children[1]->category == typedcl)
+        {
+            struct IrValueType valueType;
+            parseIrType(declaration->children[1]->children[0], &valueType);
+        }
+    }
+    // structs were prepended as they were laid out, list them in declaration order
+    struct IrStruct *reversed = NULL;
+    while (module->structs != NULL)
+    {
+        struct IrStruct *next = module->structs->next;
+        module->structs->next = reversed;
+        reversed = module->structs;
+        module->structs = next;
+    }
+    module->structs = reversed;
+
+    for (i = 0; i < count; i++)
+    {
+        collectIrGlobals(irListItem(declarations, xdcl_list, i), &globalTail);
+    }
+    for (i = 0; i < count; i++)
+    {
+        struct Node *declaration = irListItem(declarations, xdcl_list, i);
+        if (declaration != NULL && declaration->category == xfndcl)
+        {
+            collectIrFunction(declaration, &functionTail);
+        }
+    }
+    struct IrFunction *irFunction = module->functions;
+    for (i = 0; i < count; i++)
+    {
+        struct Node *declaration = irListItem(declarations, xdcl_list, i);
+        if (declaration != NULL && declaration->category == xfndcl)
+        {
+            if (declaration->children[2] == NULL)
+            {
+                irUnsupported(declaration, "function declarations without a body are not supported");
+            }
+            lowerIrFunction(declaration, irFunction);
+            irFunction = irFunction->next;
+        }
+    }
+    clearIrNames(&irLocalNames);
+    return module;
+}
@@ -0,0 +1,1182 @@
+#include "ir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * The optimization pipeline. Each pass works on one function at a time and
+ * stays linear (or n log n) in the size of the function:
+ *   constfold  folds instructions whose operands are constants, simple
+ *              algebraic identities and branches on constants
+ *   sccp       sparse conditional constant propagation (Wegman and Zadeck),
+ *              which also finds constants flowing around loops
+ *   gvn        hash based value numbering scoped by the dominator tree
+ *   licm       moves loop invariant pure instructions into the preheader
+ *   dce        removes unused pure instructions and merges straight line blocks
+ */
+
+#define IR_TOP 0
+#define IR_CONSTANT 1
+#define IR_BOTTOM 2
+
+int isIrFoldable(int op)
+{
+    return (op >= IR_ADD && op <= IR_FTOI);
+}
+
+int isIrCommutative(int op)
+{
+    return op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE;
+}
+
+// pure instructions that compute the same value whenever their operands are the same
+int isIrPure(int op)
+{
+    switch (op)
+    {
+    case IR_CONST:
+    case IR_GLOBAL:
+    case IR_FIELD:
+    case IR_ELEM:
+        return 1;
+
+    default:
+        return isIrFoldable(op);
+    }
+}
+
+int foldIrValues(int op, int type, int operandType, long long a, double ad, long long b, double bd, long long *ival, double *dval)
+{
+    // integers wrap around like Go's int, so the arithmetic is done unsigned
+    unsigned long long ua = (unsigned long long)a;
+    unsigned long long ub = (unsigned long long)b;
+    *ival = 0;
+    *dval = 0;
+    if (operandType == IR_STRING || type == IR_STRING)
+    {
+        return 0;
+    }
+    switch (op)
+    {
+    case IR_ADD:
+        if (type == IR_FLOAT)
+        {
+            *dval = ad + bd;
+        }
+        else
+        {
+            *ival = (long long)(ua + ub);
+        }
+        return 1;
+
+    case IR_SUB:
+        if (type == IR_FLOAT)
+        {
+            *dval = ad - bd;
+        }
+        else
+        {
+            *ival = (long long)(ua - ub);
+        }
+        return 1;
+
+    case IR_MUL:
+        if (type == IR_FLOAT)
+        {
+            *dval = ad * bd;
+        }
+        else
+        {
+            *ival = (long long)(ua * ub);
+        }
+        return 1;
+
+    case IR_DIV:
+        if (type == IR_FLOAT)
+        {
+            *dval = ad / bd;
+            return 1;
+        }
+        // division by zero is left for the run time panic
+        if (b == 0)
+        {
+            return 0;
+        }
+        *ival = b == -1 ? (long long)(0ULL - ua) : a / b;
+        return 1;
+
+    case IR_MOD:
+        if (type == IR_FLOAT || b == 0)
+        {
+            return 0;
+        }
+        *ival = b == -1 ? 0 : a % b;
+        return 1;
+
+    case IR_NEG:
+        if (type == IR_FLOAT)
+        {
+            *dval = -ad;
+        }
+        else
+        {
+            *ival = (long long)(0ULL - ua);
+        }
+        return 1;
+
+    case IR_NOT:
+        *ival = !a;
+        return 1;
+
+    case IR_EQ:
+        *ival = operandType == IR_FLOAT ? ad == bd : a == b;
+        return 1;
+
+    case IR_NE:
+        *ival = operandType == IR_FLOAT ? ad != bd : a != b;
+        return 1;
+
+    case IR_LT:
+        *ival = operandType == IR_FLOAT ? ad < bd : a < b;
+        return 1;
+
+    case IR_LE:
+        *ival = operandType == IR_FLOAT ? ad <= bd : a <= b;
+        return 1;
+
+    case IR_GT:
+        *ival = operandType == IR_FLOAT ? ad > bd : a > b;
+        return 1;
+
+    case IR_GE:
+        *ival = operandType == IR_FLOAT ? ad >= bd : a >= b;
+        return 1;
+
+    case IR_ITOF:
+        *dval = (double)a;
+        return 1;
+
+    case IR_FTOI:
+        // out of range conversions are left to the target
+        if (!(ad > -9223372036854775808.0 && ad < 9223372036854775808.0))
+        {
+            return 0;
+        }
+        *ival = (long long)ad;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+int foldIrInstr(struct IrInstr *instr, long long *ival, double *dval)
+{
+    int i = 0;
+    if (!isIrFoldable(instr->op))
+    {
+        return 0;
+    }
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        if (instr->args[i] == NULL || instr->args[i]->op != IR_CONST)
+        {
+            return 0;
+        }
+    }
+    struct IrInstr *a = instr->args[0];
+    struct IrInstr *b = instr->numberOfArgs > 1 ? instr->args[1] : instr->args[0];
+    if (a->type == IR_STRING && (instr->op == IR_EQ || instr->op == IR_NE))
+    {
+        int equal = strcmp(a->sval, b->sval) == 0;
+        *ival = instr->op == IR_EQ ? equal : !equal;
+        *dval = 0;
+        return 1;
+    }
+    return foldIrValues(instr->op, instr->type, a->type, a->ival, a->dval, b->ival, b->dval, ival, dval);
+}
+
+/*
+ * shared rewriting helpers
+ */
+
+// instructions removed while a pass still holds pointers to them, freed when it ends
+struct IrGraveyard
+{
+    int count;
+    int capacity;
+    struct IrInstr **instrs;
+};
+
+void buryIrInstr(struct IrGraveyard *graveyard, struct IrInstr *instr, struct IrInstr *replacement)
+{
+    int i = 0;
+    if (replacement != NULL)
+    {
+        replaceIrUses(instr, replacement);
+    }
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        setIrArg(instr, i, NULL);
+    }
+    unlinkIrInstr(instr);
+    instr->block = NULL;
+    if (graveyard->count == graveyard->capacity)
+    {
+        graveyard->capacity = graveyard->capacity == 0 ? 64 : graveyard->capacity * 2;
+        graveyard->instrs = realloc(graveyard->instrs, graveyard->capacity * sizeof(struct IrInstr *));
+    }
+    graveyard->instrs[graveyard->count++] = instr;
+}
+
+void emptyIrGraveyard(struct IrGraveyard *graveyard)
+{
+    int i = 0;
+    for (i = 0; i < graveyard->count; i++)
+    {
+        deleteIrInstr(graveyard->instrs[i]);
+    }
+    free(graveyard->instrs);
+    graveyard->instrs = NULL;
+    graveyard->count = 0;
+    graveyard->capacity = 0;
+}
+
+struct IrInstr *insertIrConstant(struct IrInstr *position, int type, long long ival, double dval)
+{
+    // constants never go between the phis at the top of a block
+    struct IrBlock *block = position->block;
+    while (position != NULL && position->op == IR_PHI)
+    {
+        position = position->next;
+    }
+    struct IrInstr *constant = createIrInstr(IR_CONST, type);
+    constant->ival = ival;
+    constant->dval = dval;
+    constant->line = block->last != NULL ? block->last->line : 0;
+    if (position == NULL)
+    {
+        appendIrInstr(block, constant);
+    }
+    else
+    {
+        insertIrInstrBefore(position, constant);
+    }
+    return constant;
+}
+
+void jumpIrBranch(struct IrBlock *block, int taken)
+{
+    // a branch whose condition is known becomes a jump to the taken side
+    struct IrInstr *branch = block->last;
+    struct IrBlock *kept = branch->target[taken ? 0 : 1];
+    struct IrBlock *dropped = branch->target[taken ? 1 : 0];
+    removeIrPred(dropped, block);
+    setIrArg(branch, 0, NULL);
+    branch->numberOfArgs = 0;
+    branch->op = IR_JUMP;
+    branch->target[0] = kept;
+    branch->target[1] = NULL;
+}
+
+struct IrInstrStack
+{
+    int top;
+    int capacity;
+    struct IrInstr **instrs;
+};
+
+void pushIrInstr(struct IrInstrStack *stack, struct IrInstr *instr)
+{
+    if (stack->top == stack->capacity)
+    {
+        stack->capacity = stack->capacity == 0 ? 64 : stack->capacity * 2;
+        stack->instrs = realloc(stack->instrs, stack->capacity * sizeof(struct IrInstr *));
+    }
+    stack->instrs[stack->top++] = instr;
+}
+
+void pushIrUsers(struct IrInstrStack *stack, struct IrInstr *instr)
+{
+    int i = 0;
+    for (i = 0; i < instr->numberOfUsers; i++)
+    {
+        pushIrInstr(stack, instr->users[i]);
+    }
+}
+
+/*
+ * constfold
+ */
+
+// the value an instruction reduces to without computing anything new, or NULL
+struct IrInstr *simplifyIrInstr(struct IrInstr *instr)
+{
+    int i = 0;
+    if (instr->op == IR_PHI)
+    {
+        struct IrInstr *same = NULL;
+        for (i = 0; i < instr->numberOfArgs; i++)
+        {
+            if (instr->args[i] == same || instr->args[i] == instr)
+            {
+                continue;
+            }
+            if (same != NULL)
+            {
+                return NULL;
+            }
+            same = instr->args[i];
+        }
+        return same;
+    }
+    if (instr->type != IR_INT || instr->numberOfArgs != 2)
+    {
+        return NULL;
+    }
+    struct IrInstr *a = instr->args[0];
+    struct IrInstr *b = instr->args[1];
+    int aIsZero = a->op == IR_CONST && a->ival == 0;
+    int bIsZero = b->op == IR_CONST && b->ival == 0;
+    int aIsOne = a->op == IR_CONST && a->ival == 1;
+    int bIsOne = b->op == IR_CONST && b->ival == 1;
+    switch (instr->op)
+    {
+    case IR_ADD:
+        return bIsZero ? a : (aIsZero ? b : NULL);
+
+    case IR_SUB:
+        return bIsZero ? a : NULL;
+
+    case IR_MUL:
+        return bIsOne ? a : (aIsOne ? b : NULL);
+
+    case IR_DIV:
+        return bIsOne ? a : NULL;
+
+    default:
+        return NULL;
+    }
+}
+
+int foldIrFunction(struct IrFunction *function)
+{
+    struct IrInstrStack worklist = {0, 0, NULL};
+    struct IrGraveyard graveyard = {0, 0, NULL};
+    int changed = 0;
+    int i = 0;
+    for (i = function->numberOfBlocks - 1; i >= 0; i--)
+    {
+        struct IrInstr *instr = function->blocks[i]->last;
+        while (instr != NULL)
+        {
+            pushIrInstr(&worklist, instr);
+            instr = instr->prev;
+        }
+    }
+    while (worklist.top > 0)
+    {
+        struct IrInstr *instr = worklist.instrs[--worklist.top];
+        long long ival = 0;
+        double dval = 0;
+        if (instr->block == NULL)
+        {
+            continue;
+        }
+        if (instr->op == IR_BRANCH && instr->args[0]->op == IR_CONST)
+        {
+            // the dropped edge takes an operand away from the phis of its target
+            struct IrBlock *dropped = instr->target[instr->args[0]->ival ? 1 : 0];
+            jumpIrBranch(instr->block, instr->args[0]->ival);
+            struct IrInstr *phi = dropped->first;
+            while (phi != NULL && phi->op == IR_PHI)
+            {
+                pushIrInstr(&worklist, phi);
+                phi = phi->next;
+            }
+            changed++;
+            continue;
+        }
+        if (foldIrInstr(instr, &ival, &dval))
+        {
+            struct IrInstr *constant = insertIrConstant(instr, instr->type, ival, dval);
+            pushIrUsers(&worklist, instr);
+            buryIrInstr(&graveyard, instr, constant);
+            changed++;
+            continue;
+        }
+        struct IrInstr *simpler = simplifyIrInstr(instr);
+        if (simpler != NULL && simpler != instr)
+        {
+            pushIrUsers(&worklist, instr);
+            buryIrInstr(&graveyard, instr, simpler);
+            changed++;
+        }
+    }
+    free(worklist.instrs);
+    emptyIrGraveyard(&graveyard);
+    removeUnreachableIrBlocks(function);
+    return changed;
+}
+
+/*
+ * sccp
+ */
+
+struct IrEdge
+{
+    struct IrBlock *block;
+    int pred;
+};
+
+struct IrPropagation
+{
+    int *predOffset;
+    char *edgeExecutable;
+    char *blockExecutable;
+    int flowTop;
+    int flowCapacity;
+    struct IrEdge *flow;
+    struct IrInstrStack values;
+};
+
+int irPredIndex(struct IrBlock *block, struct IrBlock *pred)
+{
+    int i = 0;
+    for (i = 0; i < block->numberOfPreds; i++)
+    {
+        if (block->preds[i] == pred)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void pushIrEdge(struct IrPropagation *state, struct IrBlock *from, struct IrBlock *to)
+{
+    if (state->flowTop == state->flowCapacity)
+    {
+        state->flowCapacity = state->flowCapacity == 0 ? 64 : state->flowCapacity * 2;
+        state->flow = realloc(state->flow, state->flowCapacity * sizeof(struct IrEdge));
+    }
+    state->flow[state->flowTop].block = to;
+    state->flow[state->flowTop].pred = from == NULL ? -1 : irPredIndex(to, from);
+    state->flowTop++;
+}
+
+void lowerIrLattice(struct IrPropagation *state, struct IrInstr *instr, int level, long long ival, double dval)
+{
+    // values only ever move down the lattice: top, one constant, bottom
+    if (instr->mark == IR_BOTTOM || level == IR_TOP)
+    {
+        return;
+    }
+    if (instr->mark == IR_CONSTANT && level == IR_CONSTANT)
+    {
+        if (instr->lattice == ival && memcmp(&instr->latticeFloat, &dval, sizeof(double)) == 0)
+        {
+            return;
+        }
+        level = IR_BOTTOM;
+    }
+    instr->mark = level;
+    instr->lattice = ival;
+    instr->latticeFloat = dval;
+    pushIrUsers(&state->values, instr);
+}
+
+void visitIrInstr(struct IrPropagation *state, struct IrInstr *instr)
+{
+    int i = 0;
+    struct IrBlock *block = instr->block;
+    switch (instr->op)
+    {
+    case IR_PHI:
+    {
+        int level = IR_TOP;
+        long long ival = 0;
+        double dval = 0;
+        for (i = 0; i < instr->numberOfArgs && level != IR_BOTTOM; i++)
+        {
+            struct IrInstr *arg = instr->args[i];
+            if (!state->edgeExecutable[state->predOffset[block->mark] + i] || arg->mark == IR_TOP)
+            {
+                continue;
+            }
+            if (arg->mark == IR_BOTTOM)
+            {
+                level = IR_BOTTOM;
+            }
+            else if (level == IR_TOP)
+            {
+                level = IR_CONSTANT;
+                ival = arg->lattice;
+                dval = arg->latticeFloat;
+            }
+            else if (ival != arg->lattice || memcmp(&dval, &arg->latticeFloat, sizeof(double)) != 0)
+            {
+                level = IR_BOTTOM;
+            }
+        }
+        lowerIrLattice(state, instr, level, ival, dval);
+        return;
+    }
+
+    case IR_JUMP:
+        pushIrEdge(state, block, instr->target[0]);
+        return;
+
+    case IR_BRANCH:
+        if (instr->args[0]->mark == IR_CONSTANT)
+        {
+            pushIrEdge(state, block, instr->target[instr->args[0]->lattice ? 0 : 1]);
+        }
+        else if (instr->args[0]->mark == IR_BOTTOM)
+        {
+            pushIrEdge(state, block, instr->target[0]);
+            pushIrEdge(state, block, instr->target[1]);
+        }
+        return;
+
+    case IR_CONST:
+        lowerIrLattice(state, instr, instr->type == IR_STRING ? IR_BOTTOM : IR_CONSTANT, instr->ival, instr->dval);
+        return;
+
+    default:
+        break;
+    }
+
+    if (!isIrFoldable(instr->op) || instr->type == IR_STRING || instr->args[0]->type == IR_STRING)
+    {
+        lowerIrLattice(state, instr, IR_BOTTOM, 0, 0);
+        return;
+    }
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        if (instr->args[i]->mark == IR_BOTTOM)
+        {
+            lowerIrLattice(state, instr, IR_BOTTOM, 0, 0);
+            return;
+        }
+        if (instr->args[i]->mark == IR_TOP)
+        {
+            return;
+        }
+    }
+    struct IrInstr *a = instr->args[0];
+    struct IrInstr *b = instr->numberOfArgs > 1 ? instr->args[1] : a;
+    long long ival = 0;
+    double dval = 0;
+    if (foldIrValues(instr->op, instr->type, a->type, a->lattice, a->latticeFloat, b->lattice, b->latticeFloat, &ival, &dval))
+    {
+        lowerIrLattice(state, instr, IR_CONSTANT, ival, dval);
+    }
+    else
+    {
+        lowerIrLattice(state, instr, IR_BOTTOM, 0, 0);
+    }
+}
+
+int propagateIrConstants(struct IrFunction *function)
+{
+    struct IrPropagation state;
+    struct IrGraveyard graveyard = {0, 0, NULL};
+    int n = function->numberOfBlocks;
+    int total = 0;
+    int changed = 0;
+    int i = 0;
+    memset(&state, 0, sizeof(state));
+    state.predOffset = malloc((n + 1) * sizeof(int));
+    state.blockExecutable = calloc(n + 1, 1);
+    for (i = 0; i < n; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        struct IrInstr *instr = block->first;
+        block->mark = i;
+        state.predOffset[i] = total;
+        total += block->numberOfPreds;
+        while (instr != NULL)
+        {
+            instr->mark = IR_TOP;
+            instr = instr->next;
+        }
+    }
+    state.edgeExecutable = calloc(total + 1, 1);
+
+    pushIrEdge(&state, NULL, function->blocks[0]);
+    while (state.flowTop > 0 || state.values.top > 0)
+    {
+        while (state.flowTop > 0)
+        {
+            struct IrEdge edge = state.flow[--state.flowTop];
+            struct IrBlock *block = edge.block;
+            if (edge.pred >= 0)
+            {
+                if (state.edgeExecutable[state.predOffset[block->mark] + edge.pred])
+                {
+                    continue;
+                }
+                state.edgeExecutable[state.predOffset[block->mark] + edge.pred] = 1;
+            }
+            // a block seen before only needs its phis looked at again for the new edge
+            int firstVisit = !state.blockExecutable[block->mark];
+            state.blockExecutable[block->mark] = 1;
+            struct IrInstr *instr = block->first;
+            while (instr != NULL && (firstVisit || instr->op == IR_PHI))
+            {
+                visitIrInstr(&state, instr);
+                instr = instr->next;
+            }
+        }
+        while (state.values.top > 0 && state.flowTop == 0)
+        {
+            struct IrInstr *instr = state.values.instrs[--state.values.top];
+            if (instr->block != NULL && state.blockExecutable[instr->block->mark])
+            {
+                visitIrInstr(&state, instr);
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        if (!state.blockExecutable[i])
+        {
+            continue;
+        }
+        struct IrInstr *instr = block->first;
+        while (instr != NULL)
+        {
+            struct IrInstr *next = instr->next;
+            if (instr->mark == IR_CONSTANT && instr->op != IR_CONST && instr->type != IR_VOID)
+            {
+                struct IrInstr *constant = insertIrConstant(instr, instr->type, instr->lattice, instr->latticeFloat);
+                // the branch rewrite below reads the condition's lattice, which may now be this constant
+                constant->mark = IR_CONSTANT;
+                constant->lattice = instr->lattice;
+                constant->latticeFloat = instr->latticeFloat;
+                buryIrInstr(&graveyard, instr, constant);
+                changed++;
+            }
+            instr = next;
+        }
+        if (block->last != NULL && block->last->op == IR_BRANCH && block->last->args[0]->mark == IR_CONSTANT)
+        {
+            jumpIrBranch(block, block->last->args[0]->lattice != 0);
+            changed++;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        struct IrInstr *instr = function->blocks[i]->first;
+        while (instr != NULL)
+        {
+            instr->mark = 0;
+            instr = instr->next;
+        }
+    }
+    emptyIrGraveyard(&graveyard);
+    removeUnreachableIrBlocks(function);
+    free(state.predOffset);
+    free(state.blockExecutable);
+    free(state.edgeExecutable);
+    free(state.flow);
+    free(state.values.instrs);
+    return changed;
+}
+
+/*
+ * gvn
+ */
+
+struct IrValueEntry
+{
+    struct IrInstr *instr;
+    int next;
+    int bucket;
+};
+
+struct IrInstr *irOperand(struct IrInstr *instr, int index)
+{
+    // commutative operands are compared in a canonical order
+    if (isIrCommutative(instr->op) && instr->numberOfArgs == 2 && instr->args[0]->id > instr->args[1]->id)
+    {
+        return instr->args[1 - index];
+    }
+    return instr->args[index];
+}
+
+unsigned int hashIrInstr(struct IrInstr *instr)
+{
+    unsigned long long h = (unsigned long long)instr->op * 31 + instr->type;
+    unsigned long long bits = 0;
+    int i = 0;
+    memcpy(&bits, &instr->dval, sizeof(double));
+    h = h * 1000003 + (unsigned long long)instr->ival;
+    h = h * 1000003 + bits;
+    if (instr->sval != NULL)
+    {
+        char *c = instr->sval;
+        for (; *c != '\0'; c++)
+        {
+            h = h * 31 + (unsigned char)*c;
+        }
+    }
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        h = h * 1000003 + (unsigned long long)irOperand(instr, i)->id;
+    }
+    return (unsigned int)(h ^ (h >> 29));
+}
+
+int sameIrValue(struct IrInstr *a, struct IrInstr *b)
+{
+    int i = 0;
+    if (a->op != b->op || a->type != b->type || a->ival != b->ival || a->numberOfArgs != b->numberOfArgs ||
+        memcmp(&a->dval, &b->dval, sizeof(double)) != 0)
+    {
+        return 0;
+    }
+    if ((a->sval == NULL) != (b->sval == NULL) || (a->sval != NULL && strcmp(a->sval, b->sval) != 0))
+    {
+        return 0;
+    }
+    for (i = 0; i < a->numberOfArgs; i++)
+    {
+        if (irOperand(a, i) != irOperand(b, i))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int numberIrValues(struct IrFunction *function)
+{
+    int capacity = 1;
+    int count = countIrInstrs(function);
+    int changed = 0;
+    int i = 0;
+    while (capacity < 2 * count + 2)
+    {
+        capacity *= 2;
+    }
+    int *buckets = malloc(capacity * sizeof(int));
+    struct IrValueEntry *entries = malloc((count + 1) * sizeof(struct IrValueEntry));
+    int numberOfEntries = 0;
+    for (i = 0; i < capacity; i++)
+    {
+        buckets[i] = -1;
+    }
+    computeIrDominators(function);
+
+    // preorder walk of the dominator tree; the table holds exactly the values of the dominating blocks
+    struct IrBlock **stack = malloc((function->numberOfBlocks + 1) * sizeof(struct IrBlock *));
+    int *scope = malloc((function->numberOfBlocks + 1) * sizeof(int));
+    int top = 0;
+    stack[top] = function->blocks[0];
+    scope[top] = -1;
+    top++;
+    while (top > 0)
+    {
+        struct IrBlock *block = stack[top - 1];
+        if (scope[top - 1] >= 0)
+        {
+            // leaving the subtree, forget its values
+            while (numberOfEntries > scope[top - 1])
+            {
+                numberOfEntries--;
+                buckets[entries[numberOfEntries].bucket] = entries[numberOfEntries].next;
+            }
+            top--;
+            continue;
+        }
+        scope[top - 1] = numberOfEntries;
+
+        struct IrInstr *instr = block->first;
+        while (instr != NULL)
+        {
+            struct IrInstr *next = instr->next;
+            if (isIrPure(instr->op))
+            {
+                int bucket = hashIrInstr(instr) & (capacity - 1);
+                int entry = buckets[bucket];
+                while (entry >= 0 && !sameIrValue(entries[entry].instr, instr))
+                {
+                    entry = entries[entry].next;
+                }
+                if (entry >= 0)
+                {
+                    replaceIrUses(instr, entries[entry].instr);
+                    deleteIrInstr(instr);
+                    changed++;
+                }
+                else
+                {
+                    entries[numberOfEntries].instr = instr;
+                    entries[numberOfEntries].bucket = bucket;
+                    entries[numberOfEntries].next = buckets[bucket];
+                    buckets[bucket] = numberOfEntries;
+                    numberOfEntries++;
+                }
+            }
+            instr = next;
+        }
+        struct IrBlock *child = block->domChild;
+        while (child != NULL)
+        {
+            stack[top] = child;
+            scope[top] = -1;
+            top++;
+            child = child->domSibling;
+        }
+    }
+    free(stack);
+    free(scope);
+    free(buckets);
+    free(entries);
+    return changed;
+}
+
+/*
+ * licm
+ */
+
+int hoistIrLoopInvariants(struct IrFunction *function)
+{
+    int n = function->numberOfBlocks;
+    int changed = 0;
+    int i = 0;
+    computeIrDominators(function);
+
+    // dominator tree preorder and subtree ends make dominance checks constant time
+    struct IrBlock **order = malloc((n + 1) * sizeof(struct IrBlock *));
+    int *subtreeEnd = malloc((n + 1) * sizeof(int));
+    struct IrBlock **stack = malloc((n + 1) * sizeof(struct IrBlock *));
+    int *visited = calloc(n + 1, sizeof(int));
+    int count = 0;
+    int top = 0;
+    stack[top++] = function->blocks[0];
+    while (top > 0)
+    {
+        struct IrBlock *block = stack[top - 1];
+        if (visited[top - 1])
+        {
+            subtreeEnd[block->preorder] = count - 1;
+            top--;
+            continue;
+        }
+        visited[top - 1] = 1;
+        block->preorder = count;
+        order[count++] = block;
+        struct IrBlock *child = block->domChild;
+        while (child != NULL)
+        {
+            visited[top] = 0;
+            stack[top++] = child;
+            child = child->domSibling;
+        }
+    }
+    for (i = 0; i < n; i++)
+    {
+        function->blocks[i]->mark = 0;
+    }
+
+    struct IrBlock **loop = malloc((n + 1) * sizeof(struct IrBlock *));
+    int stamp = 0;
+    // inner loop headers sit deeper in the dominator tree, so they come first backwards
+    for (i = count - 1; i >= 0; i--)
+    {
+        struct IrBlock *header = order[i];
+        int size = 0;
+        int j = 0;
+        stamp++;
+        header->mark = stamp;
+        loop[size++] = header;
+        for (j = 0; j < header->numberOfPreds; j++)
+        {
+            struct IrBlock *pred = header->preds[j];
+            if (pred->preorder >= header->preorder && pred->preorder <= subtreeEnd[header->preorder] && pred->mark != stamp)
+            {
+                pred->mark = stamp;
+                loop[size++] = pred;
+            }
+        }
+        if (size == 1)
+        {
+            continue;
+        }
+        // the loop body is everything that reaches a latch without passing the header
+        for (j = 1; j < size; j++)
+        {
+            int k = 0;
+            for (k = 0; k < loop[j]->numberOfPreds; k++)
+            {
+                struct IrBlock *pred = loop[j]->preds[k];
+                if (pred->mark != stamp && pred->preorder >= 0)
+                {
+                    pred->mark = stamp;
+                    loop[size++] = pred;
+                }
+            }
+        }
+
+        struct IrBlock *preheader = NULL;
+        int outside = 0;
+        for (j = 0; j < header->numberOfPreds; j++)
+        {
+            if (header->preds[j]->mark != stamp)
+            {
+                preheader = header->preds[j];
+                outside++;
+            }
+        }
+        if (outside != 1 || preheader->last == NULL || preheader->last->op != IR_JUMP)
+        {
+            continue;
+        }
+
+        // visit the body in dominator order so operands are hoisted before their users
+        int k = 0;
+        for (j = 1; j < size; j++)
+        {
+            struct IrBlock *current = loop[j];
+            for (k = j; k > 0 && loop[k - 1]->preorder > current->preorder; k--)
+            {
+                loop[k] = loop[k - 1];
+            }
+            loop[k] = current;
+        }
+        for (j = 0; j < size; j++)
+        {
+            struct IrInstr *instr = loop[j]->first;
+            while (instr != NULL)
+            {
+                struct IrInstr *next = instr->next;
+                int invariant = isIrPure(instr->op) && !hasIrSideEffects(instr);
+                for (k = 0; k < instr->numberOfArgs && invariant; k++)
+                {
+                    invariant = instr->args[k]->block->mark != stamp;
+                }
+                if (invariant)
+                {
+                    unlinkIrInstr(instr);
+                    insertIrInstrBefore(preheader->last, instr);
+                    changed++;
+                }
+                instr = next;
+            }
+        }
+    }
+    free(order);
+    free(subtreeEnd);
+    free(stack);
+    free(visited);
+    free(loop);
+    return changed;
+}
+
+/*
+ * dce
+ */
+
+int mergeIrBlocks(struct IrFunction *function)
+{
+    int merged = 0;
+    int kept = 0;
+    int i = 0;
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        function->blocks[i]->mark = 0;
+    }
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        while (block->mark == 0 && block->last != NULL && block->last->op == IR_JUMP)
+        {
+            struct IrBlock *succ = block->last->target[0];
+            int j = 0;
+            if (succ == block || succ->numberOfPreds != 1 || succ == function->blocks[0])
+            {
+                break;
+            }
+            // the successor's phis have a single operand
+            while (succ->first != NULL && succ->first->op == IR_PHI)
+            {
+                struct IrInstr *phi = succ->first;
+                replaceIrUses(phi, phi->args[0]);
+                deleteIrInstr(phi);
+            }
+            deleteIrInstr(block->last);
+            while (succ->first != NULL)
+            {
+                struct IrInstr *instr = succ->first;
+                unlinkIrInstr(instr);
+                appendIrInstr(block, instr);
+            }
+            for (j = 0; j < numberOfIrSuccs(block); j++)
+            {
+                struct IrBlock *next = irSucc(block, j);
+                int k = 0;
+                for (k = 0; k < next->numberOfPreds; k++)
+                {
+                    if (next->preds[k] == succ)
+                    {
+                        next->preds[k] = block;
+                    }
+                }
+            }
+            succ->mark = 1;
+            succ->numberOfPreds = 0;
+            merged++;
+        }
+    }
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        if (block->mark)
+        {
+            free(block->preds);
+            free(block);
+        }
+        else
+        {
+            function->blocks[kept++] = block;
+        }
+    }
+    function->numberOfBlocks = kept;
+    return merged;
+}
+
+int eliminateIrDeadCode(struct IrFunction *function)
+{
+    struct IrInstrStack worklist = {0, 0, NULL};
+    int changed = 0;
+    int i = 0;
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = function->blocks[i]->first;
+        while (instr != NULL)
+        {
+            instr->mark = hasIrSideEffects(instr);
+            if (instr->mark)
+            {
+                pushIrInstr(&worklist, instr);
+            }
+            instr = instr->next;
+        }
+    }
+    while (worklist.top > 0)
+    {
+        struct IrInstr *instr = worklist.instrs[--worklist.top];
+        for (i = 0; i < instr->numberOfArgs; i++)
+        {
+            if (instr->args[i] != NULL && !instr->args[i]->mark)
+            {
+                instr->args[i]->mark = 1;
+                pushIrInstr(&worklist, instr->args[i]);
+            }
+        }
+    }
+    free(worklist.instrs);
+
+    // dead values are only used by other dead values, so cut those uses first
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = function->blocks[i]->first;
+        while (instr != NULL)
+        {
+            if (!instr->mark)
+            {
+                int j = 0;
+                for (j = 0; j < instr->numberOfArgs; j++)
+                {
+                    setIrArg(instr, j, NULL);
+                }
+            }
+            instr = instr->next;
+        }
+    }
+    for (i = 0; i < function->numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = function->blocks[i]->first;
+        while (instr != NULL)
+        {
+            struct IrInstr *next = instr->next;
+            if (!instr->mark)
+            {
+                deleteIrInstr(instr);
+                changed++;
+            }
+            else
+            {
+                instr->mark = 0;
+            }
+            instr = next;
+        }
+    }
+    return changed + mergeIrBlocks(function);
+}
+
+/*
+ * pipeline
+ */
+
+int removeIrUnreachable(struct IrFunction *function)
+{
+    int before = function->numberOfBlocks;
+    removeUnreachableIrBlocks(function);
+    return before - function->numberOfBlocks;
+}
+
+double irMicroseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+void optimizeIrModule(struct IrModule *module)
+{
+    struct IrPassStats stats[] = {
+        {"unreachable", 0, 0, 0, 0},
+        {"constfold", 0, 0, 0, 0},
+        {"sccp", 0, 0, 0, 0},
+        {"gvn", 0, 0, 0, 0},
+        {"licm", 0, 0, 0, 0},
+        {"dce", 0, 0, 0, 0},
+    };
+    int (*passes[])(struct IrFunction *) = {removeIrUnreachable, foldIrFunction, propagateIrConstants, numberIrValues, hoistIrLoopInvariants,
+                                             eliminateIrDeadCode};
+    int numberOfPasses = sizeof(passes) / sizeof(passes[0]);
+    int i = 0;
+
+    struct IrFunction *function = module->functions;
+    while (function != NULL)
+    {
+        for (i = 0; i < numberOfPasses; i++)
+        {
+            int before = irStats ? countIrInstrs(function) : 0;
+            double start = irMicroseconds();
+            stats[i].changed += passes[i](function);
+            stats[i].microseconds += irMicroseconds() - start;
+            stats[i].instructionsBefore += before;
+            stats[i].instructionsAfter += irStats ? countIrInstrs(function) : 0;
+        }
+        function = function->next;
+    }
+
+    if (irStats)
+    {
+        printf("%-12s %8s %8s %8s %10s\n", "pass", "changed", "before", "after", "time(us)");
+        for (i = 0; i < numberOfPasses; i++)
+        {
+            printf("%-12s %8d %8d %8d %10.1f\n", stats[i].name, stats[i].changed, stats[i].instructionsBefore, stats[i].instructionsAfter,
+                   stats[i].microseconds);
+        }
+    }
+}
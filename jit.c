@@ -0,0 +1,692 @@
+#include "vm.h"
+#include "codegen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+/*
+ * Baseline template jit for -run -jit. Each bytecode instruction expands to
+ * a fixed x86-64 sequence that reads and writes the frame registers in
+ * memory (rbx holds the register window, r12 the slot area), so there is no
+ * register allocation and compiled and interpreted calls mix freely.
+ * Compiled callers reach every callee through its entry pointer, which stays
+ * on vmEnterFunction until the callee has machine code of its own.
+ * Machine code goes into one mmap'd region that is only writable while a
+ * function is copied in.
+ */
+
+#define JIT_REGION_BYTES (16 << 20)
+
+// condition code nibbles for jcc and setcc
+#define CC_B 0x2
+#define CC_AE 0x3
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_BE 0x6
+#define CC_A 0x7
+#define CC_P 0xA
+#define CC_NP 0xB
+#define CC_L 0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G 0xF
+#define CC_ALWAYS -1
+
+// set by -jit, a function is compiled on this call, 0 keeps everything interpreted
+int vmJitThreshold = 0;
+
+struct JitFixup
+{
+    // rel32 field in the machine code and the bytecode offset it jumps to
+    int position;
+    int target;
+};
+
+unsigned char *jitRegion;
+int jitRegionUsed;
+// machine code of the function being compiled, copied into the region when done
+unsigned char *jitCode;
+int jitLength;
+int jitCapacity;
+// machine code offset of each bytecode offset
+int *jitOffsets;
+int numberOfJitFixups;
+int jitFixupCapacity;
+struct JitFixup *jitFixups;
+
+// signed conditions of eq, ne, lt, le, gt, ge
+int jitConditions[] = {CC_E, CC_NE, CC_L, CC_LE, CC_G, CC_GE};
+
+void jitByte(int value)
+{
+    if (jitLength == jitCapacity)
+    {
+        jitCapacity = jitCapacity == 0 ? 4096 : jitCapacity * 2;
+        jitCode = realloc(jitCode, jitCapacity);
+    }
+    jitCode[jitLength++] = (unsigned char)value;
+}
+
+void jitInt32(int value)
+{
+    int i = 0;
+    for (i = 0; i < 4; i++)
+    {
+        jitByte((unsigned)value >> (8 * i));
+    }
+}
+
+void jitInt64(long long value)
+{
+    jitInt32((int)value);
+    jitInt32((int)((unsigned long long)value >> 32));
+}
+
+void jitPatch(int position, int value)
+{
+    memcpy(jitCode + position, &value, sizeof(int));
+}
+
+void jitPrefix(int prefix, int wide, int reg, int rm, int escape, int opcode)
+{
+    // legacy prefix, REX, 0x0f escape and opcode; REX is left out when no bit of it is needed
+    int rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+    if (prefix != 0)
+    {
+        jitByte(prefix);
+    }
+    if (rex != 0x40)
+    {
+        jitByte(rex);
+    }
+    if (escape)
+    {
+        jitByte(0x0F);
+    }
+    jitByte(opcode);
+}
+
+// an instruction whose r/m operand is [base + displacement]
+void jitMemory(int prefix, int wide, int escape, int opcode, int reg, int base, int displacement)
+{
+    jitPrefix(prefix, wide, reg, base, escape, opcode);
+    jitByte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == REG_RSP)
+    {
+        // rsp and r12 as a base need a SIB byte
+        jitByte(0x24);
+    }
+    jitInt32(displacement);
+}
+
+// an instruction whose r/m operand is a register
+void jitRegister(int prefix, int wide, int escape, int opcode, int reg, int rm)
+{
+    jitPrefix(prefix, wide, reg, rm, escape, opcode);
+    jitByte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+void jitLoad(int reg, int vmRegister)
+{
+    jitMemory(0, 1, 0, 0x8B, reg, REG_RBX, 8 * vmRegister);
+}
+
+void jitStore(int vmRegister, int reg)
+{
+    jitMemory(0, 1, 0, 0x89, reg, REG_RBX, 8 * vmRegister);
+}
+
+void jitMoveImmediate(int reg, long long value)
+{
+    // movabs
+    jitPrefix(0, 1, 0, reg, 0, 0xB8 + (reg & 7));
+    jitInt64(value);
+}
+
+void jitMoveImmediate32(int reg, int value)
+{
+    jitPrefix(0, 0, 0, reg, 0, 0xB8 + (reg & 7));
+    jitInt32(value);
+}
+
+void jitCall(void *address)
+{
+    jitMoveImmediate(REG_RAX, (long long)(size_t)address);
+    jitRegister(0, 0, 0, 0xFF, 2, REG_RAX);
+}
+
+// a jump over code emitted next, jitLand fills in the distance
+int jitForward(int condition)
+{
+    if (condition == CC_ALWAYS)
+    {
+        jitByte(0xE9);
+    }
+    else
+    {
+        jitByte(0x0F);
+        jitByte(0x80 + condition);
+    }
+    jitInt32(0);
+    return jitLength - 4;
+}
+
+void jitLand(int position)
+{
+    jitPatch(position, jitLength - (position + 4));
+}
+
+void jitJump(int condition, int target)
+{
+    if (numberOfJitFixups == jitFixupCapacity)
+    {
+        jitFixupCapacity = jitFixupCapacity == 0 ? 64 : jitFixupCapacity * 2;
+        jitFixups = realloc(jitFixups, jitFixupCapacity * sizeof(struct JitFixup));
+    }
+    jitFixups[numberOfJitFixups].position = jitForward(condition);
+    jitFixups[numberOfJitFixups].target = target;
+    numberOfJitFixups++;
+}
+
+void jitSetCondition(int condition, int reg)
+{
+    jitRegister(0, 0, 1, 0x90 + condition, 0, reg);
+}
+
+void jitStoreFlag(int vmRegister)
+{
+    // movzx eax, al clears the rest of rax
+    jitRegister(0, 0, 1, 0xB6, REG_RAX, REG_RAX);
+    jitStore(vmRegister, REG_RAX);
+}
+
+void jitFloatOp(int opcode, int reg, int vmRegister)
+{
+    jitMemory(0xF2, 0, 1, opcode, reg, REG_RBX, 8 * vmRegister);
+}
+
+void jitCallDepth(int adjust)
+{
+    // add or sub dword [vmCallDepth], 1
+    jitMoveImmediate(REG_RCX, (long long)(size_t)&vmCallDepth);
+    jitMemory(0, 0, 0, 0x83, adjust > 0 ? 0 : 5, REG_RCX, 0);
+    jitByte(1);
+}
+
+void jitPrologue()
+{
+    int skip = 0;
+    jitByte(0x55);
+    jitRegister(0, 1, 0, 0x89, REG_RSP, REG_RBP);
+    jitByte(0x53);
+    jitPrefix(0, 0, 0, REG_R12, 0, 0x50 + (REG_R12 & 7));
+    jitRegister(0, 1, 0, 0x89, REG_RDI, REG_RBX);
+    jitRegister(0, 1, 0, 0x89, REG_RSI, REG_R12);
+    jitCallDepth(1);
+    jitMemory(0, 0, 0, 0x81, 7, REG_RCX, 0);
+    jitInt32(VM_MAX_CALL_DEPTH);
+    skip = jitForward(CC_L);
+    jitCall((void *)vmStackOverflow);
+    jitLand(skip);
+}
+
+void jitEpilogue()
+{
+    jitCallDepth(-1);
+    jitPrefix(0, 0, 0, REG_R12, 0, 0x58 + (REG_R12 & 7));
+    jitByte(0x5B);
+    jitByte(0x5D);
+    jitByte(0xC3);
+}
+
+void jitDivision(int *pc, int isModulo)
+{
+    // Go defines the quotient of the most negative int by -1 as itself, idiv would trap
+    int skip = 0;
+    int divide = 0;
+    int done = 0;
+    jitLoad(REG_RCX, pc[3]);
+    jitRegister(0, 1, 0, 0x85, REG_RCX, REG_RCX);
+    skip = jitForward(CC_NE);
+    jitCall((void *)vgoPanicDivide);
+    jitLand(skip);
+    jitLoad(REG_RAX, pc[2]);
+    jitRegister(0, 1, 0, 0x83, 7, REG_RCX);
+    jitByte(0xFF);
+    divide = jitForward(CC_NE);
+    if (isModulo)
+    {
+        jitRegister(0, 0, 0, 0x31, REG_RDX, REG_RDX);
+    }
+    else
+    {
+        jitRegister(0, 1, 0, 0xF7, 3, REG_RAX);
+    }
+    done = jitForward(CC_ALWAYS);
+    jitLand(divide);
+    jitByte(0x48);
+    jitByte(0x99);
+    jitRegister(0, 1, 0, 0xF7, 7, REG_RCX);
+    jitLand(done);
+    jitStore(pc[1], isModulo ? REG_RDX : REG_RAX);
+}
+
+void jitFloatCompare(int *pc, int comparison)
+{
+    // ucomisd reports unordered as equal and below, lt and le swap operands so NaN fails them too
+    int swapped = comparison == 2 || comparison == 3;
+    jitFloatOp(0x10, 0, swapped ? pc[3] : pc[2]);
+    jitMemory(0x66, 0, 1, 0x2E, 0, REG_RBX, 8 * (swapped ? pc[2] : pc[3]));
+    switch (comparison)
+    {
+    case 0:
+        jitSetCondition(CC_E, REG_RAX);
+        jitSetCondition(CC_NP, REG_RCX);
+        jitRegister(0, 0, 0, 0x20, REG_RCX, REG_RAX);
+        break;
+
+    case 1:
+        jitSetCondition(CC_NE, REG_RAX);
+        jitSetCondition(CC_P, REG_RCX);
+        jitRegister(0, 0, 0, 0x08, REG_RCX, REG_RAX);
+        break;
+
+    case 2:
+    case 4:
+        jitSetCondition(CC_A, REG_RAX);
+        break;
+
+    default:
+        jitSetCondition(CC_AE, REG_RAX);
+        break;
+    }
+    jitStoreFlag(pc[1]);
+}
+
+void jitCallFunction(int *pc, struct VmFunction *caller)
+{
+    struct VmProgram *program = activeVmProgram;
+    int index = pc[0] == VM_CALL ? findVmFunction(program, program->names[pc[2]]) : pc[2];
+    struct VmFunction *callee = &program->functions[index];
+    int window = 8 * caller->numberOfRegisters;
+    int skip = 0;
+    int i = 0;
+    // the callee's registers and slots must fit on the interpreter's stacks
+    jitMemory(0, 1, 0, 0x8D, REG_RAX, REG_RBX, window + 8 * callee->numberOfRegisters);
+    jitMoveImmediate(REG_RCX, (long long)(size_t)&vmRegisterLimit);
+    jitMemory(0, 1, 0, 0x3B, REG_RAX, REG_RCX, 0);
+    skip = jitForward(CC_BE);
+    jitCall((void *)vmStackOverflow);
+    jitLand(skip);
+    jitMemory(0, 1, 0, 0x8D, REG_RAX, REG_R12, caller->frameSize + callee->frameSize);
+    jitMoveImmediate(REG_RCX, (long long)(size_t)&vmSlotLimit);
+    jitMemory(0, 1, 0, 0x3B, REG_RAX, REG_RCX, 0);
+    skip = jitForward(CC_BE);
+    jitCall((void *)vmStackOverflow);
+    jitLand(skip);
+
+    for (i = 0; i < pc[3]; i++)
+    {
+        jitLoad(REG_RAX, pc[4 + i]);
+        jitMemory(0, 1, 0, 0x89, REG_RAX, REG_RBX, window + 8 * i);
+    }
+    jitMemory(0, 1, 0, 0x8D, REG_RDI, REG_RBX, window);
+    jitMemory(0, 1, 0, 0x8D, REG_RSI, REG_R12, caller->frameSize);
+    jitMoveImmediate(REG_RDX, (long long)(size_t)callee);
+    jitMemory(0, 0, 0, 0xFF, 2, REG_RDX, (int)offsetof(struct VmFunction, entry));
+    if (pc[1] >= 0)
+    {
+        jitStore(pc[1], REG_RAX);
+    }
+}
+
+void jitPrint(int *pc)
+{
+    int i = 0;
+    jitMoveImmediate(REG_RCX, (long long)(size_t)vmPrintOperands);
+    for (i = 0; i < pc[1]; i++)
+    {
+        jitMemory(0, 1, 0, 0xC7, 0, REG_RCX, 16 * i);
+        jitInt32(pc[2 + 2 * i]);
+        jitLoad(REG_RAX, pc[3 + 2 * i]);
+        jitMemory(0, 1, 0, 0x89, REG_RAX, REG_RCX, 16 * i + 8);
+    }
+    jitMoveImmediate32(REG_RDI, pc[1]);
+    jitRegister(0, 1, 0, 0x89, REG_RCX, REG_RSI);
+    jitCall((void *)vgoPrintln);
+}
+
+// emits one instruction and returns its length in code words
+int jitInstruction(int *pc, struct VmFunction *function)
+{
+    int skip = 0;
+    switch (pc[0])
+    {
+    case VM_CONST:
+        jitMoveImmediate(REG_RAX, (long long)(((unsigned long long)(unsigned)pc[3] << 32) | (unsigned)pc[2]));
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_MOVE:
+        jitLoad(REG_RAX, pc[2]);
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    case VM_ADD:
+    case VM_SUB:
+        jitLoad(REG_RAX, pc[2]);
+        jitMemory(0, 1, 0, pc[0] == VM_ADD ? 0x03 : 0x2B, REG_RAX, REG_RBX, 8 * pc[3]);
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_MUL:
+        jitLoad(REG_RAX, pc[2]);
+        jitMemory(0, 1, 1, 0xAF, REG_RAX, REG_RBX, 8 * pc[3]);
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_DIV:
+    case VM_MOD:
+        jitDivision(pc, pc[0] == VM_MOD);
+        return 4;
+
+    case VM_ADDI:
+    case VM_SUBI:
+        jitLoad(REG_RAX, pc[2]);
+        jitRegister(0, 1, 0, 0x81, pc[0] == VM_ADDI ? 0 : 5, REG_RAX);
+        jitInt32(pc[3]);
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_MULI:
+        jitLoad(REG_RAX, pc[2]);
+        jitRegister(0, 1, 0, 0x69, REG_RAX, REG_RAX);
+        jitInt32(pc[3]);
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_DIVI:
+    case VM_MODI:
+        // the literal is neither 0 nor -1
+        jitLoad(REG_RAX, pc[2]);
+        jitRegister(0, 1, 0, 0xC7, 0, REG_RCX);
+        jitInt32(pc[3]);
+        jitByte(0x48);
+        jitByte(0x99);
+        jitRegister(0, 1, 0, 0xF7, 7, REG_RCX);
+        jitStore(pc[1], pc[0] == VM_MODI ? REG_RDX : REG_RAX);
+        return 4;
+
+    case VM_NEG:
+        jitLoad(REG_RAX, pc[2]);
+        jitRegister(0, 1, 0, 0xF7, 3, REG_RAX);
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    case VM_NOT:
+        jitLoad(REG_RAX, pc[2]);
+        jitRegister(0, 1, 0, 0x83, 6, REG_RAX);
+        jitByte(1);
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    case VM_ADDF:
+    case VM_SUBF:
+    case VM_MULF:
+    case VM_DIVF:
+    {
+        int opcodes[] = {0x58, 0x5C, 0x59, 0x5E};
+        jitFloatOp(0x10, 0, pc[2]);
+        jitFloatOp(opcodes[pc[0] - VM_ADDF], 0, pc[3]);
+        jitFloatOp(0x11, 0, pc[1]);
+        return 4;
+    }
+
+    case VM_NEGF:
+        jitLoad(REG_RAX, pc[2]);
+        jitMoveImmediate(REG_RCX, LLONG_MIN);
+        jitRegister(0, 1, 0, 0x31, REG_RCX, REG_RAX);
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    case VM_CONCAT:
+        jitLoad(REG_RDI, pc[2]);
+        jitLoad(REG_RSI, pc[3]);
+        jitCall((void *)vgoConcatStrings);
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_EQ:
+    case VM_NE:
+    case VM_LT:
+    case VM_LE:
+    case VM_GT:
+    case VM_GE:
+        jitLoad(REG_RAX, pc[2]);
+        jitMemory(0, 1, 0, 0x3B, REG_RAX, REG_RBX, 8 * pc[3]);
+        jitSetCondition(jitConditions[pc[0] - VM_EQ], REG_RAX);
+        jitStoreFlag(pc[1]);
+        return 4;
+
+    case VM_EQF:
+    case VM_NEF:
+    case VM_LTF:
+    case VM_LEF:
+    case VM_GTF:
+    case VM_GEF:
+        jitFloatCompare(pc, pc[0] - VM_EQF);
+        return 4;
+
+    case VM_COMPARES:
+        jitLoad(REG_RDI, pc[2]);
+        jitLoad(REG_RSI, pc[3]);
+        jitCall((void *)vgoCompareStrings);
+        jitRegister(0, 1, 0, 0x83, 7, REG_RAX);
+        jitByte(0);
+        jitSetCondition(jitConditions[pc[4] - VM_EQ], REG_RAX);
+        jitStoreFlag(pc[1]);
+        return 5;
+
+    case VM_ITOF:
+        jitMemory(0xF2, 1, 1, 0x2A, 0, REG_RBX, 8 * pc[2]);
+        jitFloatOp(0x11, 0, pc[1]);
+        return 3;
+
+    case VM_FTOI:
+        jitMemory(0xF2, 1, 1, 0x2C, REG_RAX, REG_RBX, 8 * pc[2]);
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    case VM_JUMP:
+        jitJump(CC_ALWAYS, pc[1]);
+        return 2;
+
+    case VM_JTRUE:
+    case VM_JFALSE:
+        jitMemory(0, 1, 0, 0x83, 7, REG_RBX, 8 * pc[1]);
+        jitByte(0);
+        jitJump(pc[0] == VM_JTRUE ? CC_NE : CC_E, pc[2]);
+        return 3;
+
+    case VM_JEQ:
+    case VM_JNE:
+    case VM_JLT:
+    case VM_JLE:
+    case VM_JGT:
+    case VM_JGE:
+        jitLoad(REG_RAX, pc[1]);
+        jitMemory(0, 1, 0, 0x3B, REG_RAX, REG_RBX, 8 * pc[2]);
+        jitJump(jitConditions[pc[0] - VM_JEQ], pc[3]);
+        return 4;
+
+    case VM_JEQI:
+    case VM_JNEI:
+    case VM_JLTI:
+    case VM_JLEI:
+    case VM_JGTI:
+    case VM_JGEI:
+        jitMemory(0, 1, 0, 0x81, 7, REG_RBX, 8 * pc[1]);
+        jitInt32(pc[2]);
+        jitJump(jitConditions[pc[0] - VM_JEQI], pc[3]);
+        return 4;
+
+    case VM_SLOT:
+        jitMemory(0, 1, 0, 0x8D, REG_RAX, REG_R12, pc[2]);
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    case VM_GLOBAL:
+        jitMoveImmediate(REG_RAX, (long long)(size_t)(activeVmProgram->globals + pc[2]));
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    case VM_ELEM:
+        jitLoad(REG_RAX, pc[3]);
+        jitRegister(0, 1, 0, 0x69, REG_RAX, REG_RAX);
+        jitInt32(pc[4]);
+        jitMemory(0, 1, 0, 0x03, REG_RAX, REG_RBX, 8 * pc[2]);
+        jitStore(pc[1], REG_RAX);
+        return 5;
+
+    case VM_LOAD:
+        jitLoad(REG_RCX, pc[2]);
+        jitMemory(0, 1, 0, 0x8B, REG_RAX, REG_RCX, pc[3]);
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_LOADB:
+        jitLoad(REG_RCX, pc[2]);
+        jitMemory(0, 0, 1, 0xB6, REG_RAX, REG_RCX, pc[3]);
+        jitStore(pc[1], REG_RAX);
+        return 4;
+
+    case VM_STORE:
+    case VM_STOREB:
+        jitLoad(REG_RCX, pc[1]);
+        jitLoad(REG_RAX, pc[3]);
+        jitMemory(0, pc[0] == VM_STORE, 0, pc[0] == VM_STORE ? 0x89 : 0x88, REG_RAX, REG_RCX, pc[2]);
+        return 4;
+
+    case VM_ZERO:
+        jitLoad(REG_RDI, pc[1]);
+        jitRegister(0, 0, 0, 0x31, REG_RSI, REG_RSI);
+        jitMoveImmediate32(REG_RDX, pc[2]);
+        jitCall((void *)memset);
+        return 3;
+
+    case VM_COPY:
+        jitLoad(REG_RDI, pc[1]);
+        jitLoad(REG_RSI, pc[2]);
+        jitMoveImmediate32(REG_RDX, pc[3]);
+        jitCall((void *)memmove);
+        return 4;
+
+    case VM_BOUNDS:
+        jitLoad(REG_RAX, pc[1]);
+        jitRegister(0, 1, 0, 0x81, 7, REG_RAX);
+        jitInt32(pc[2]);
+        skip = jitForward(CC_B);
+        jitRegister(0, 1, 0, 0x89, REG_RAX, REG_RDI);
+        jitMoveImmediate32(REG_RSI, pc[2]);
+        jitCall((void *)vgoPanicIndex);
+        jitLand(skip);
+        return 3;
+
+    case VM_CALL:
+    case VM_CALLCACHED:
+        jitCallFunction(pc, function);
+        return 4 + pc[3];
+
+    case VM_RETURN:
+        jitLoad(REG_RAX, pc[1]);
+        jitEpilogue();
+        return 2;
+
+    case VM_RETURNVOID:
+        jitRegister(0, 0, 0, 0x31, REG_RAX, REG_RAX);
+        jitEpilogue();
+        return 1;
+
+    case VM_PRINT:
+        jitPrint(pc);
+        return 2 + 2 * pc[1];
+
+    case VM_NOW:
+        jitCall((void *)vgoNow);
+        jitStore(pc[1], REG_RAX);
+        return 2;
+
+    case VM_RANDN:
+        jitLoad(REG_RDI, pc[2]);
+        jitCall((void *)vgoRandIntn);
+        jitStore(pc[1], REG_RAX);
+        return 3;
+
+    default:
+        return -1;
+    }
+}
+
+int installJitCode()
+{
+    // returns the offset of the code in the region, or -1 when it does not fit
+    int start = (jitRegionUsed + 15) & ~15;
+    if (jitRegion == NULL)
+    {
+        jitRegion = mmap(NULL, JIT_REGION_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (jitRegion == MAP_FAILED)
+        {
+            jitRegion = NULL;
+            return -1;
+        }
+    }
+    if (start + jitLength > JIT_REGION_BYTES)
+    {
+        return -1;
+    }
+    mprotect(jitRegion, JIT_REGION_BYTES, PROT_READ | PROT_WRITE);
+    memcpy(jitRegion + start, jitCode, jitLength);
+    mprotect(jitRegion, JIT_REGION_BYTES, PROT_READ | PROT_EXEC);
+    jitRegionUsed = start + jitLength;
+    return start;
+}
+
+void compileJitFunction(struct VmFunction *function)
+{
+    int position = 0;
+    int start = 0;
+    int i = 0;
+    jitLength = 0;
+    numberOfJitFixups = 0;
+    jitOffsets = realloc(jitOffsets, (function->codeLength + 1) * sizeof(int));
+    jitPrologue();
+    while (position < function->codeLength)
+    {
+        int length = 0;
+        jitOffsets[position] = jitLength;
+        length = jitInstruction(function->code + position, function);
+        if (length < 0)
+        {
+            // stays interpreted, the counter can never reach the threshold again
+            function->calls = INT_MIN;
+            return;
+        }
+        position += length;
+    }
+    for (i = 0; i < numberOfJitFixups; i++)
+    {
+        int target = jitOffsets[jitFixups[i].target];
+        jitPatch(jitFixups[i].position, target - (jitFixups[i].position + 4));
+    }
+    start = installJitCode();
+    if (start < 0)
+    {
+        function->calls = INT_MIN;
+        return;
+    }
+    function->native = (long long (*)(union VmValue *, char *))(jitRegion + start);
+    function->entry = (long long (*)(union VmValue *, char *, struct VmFunction *))(jitRegion + start);
+}
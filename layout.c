@@ -0,0 +1,273 @@
+#include "ir.h"
+#include "tree.h"
+#include "vgobison.tab.h"
+#include "nonterminal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Struct layout. buildIrStruct collects the fields with their sizes and
+ * alignments and layoutIrStruct gives them offsets. By default fields keep
+ * their declaration order at their natural alignment, like go. With
+ * -layout=reorder they are ordered by decreasing alignment, which leaves no
+ * padding between fields (every size is a multiple of its alignment), and
+ * within an alignment fields that are used in the same functions are kept
+ * next to each other so they share cache lines.
+ */
+
+#define CACHE_LINE_SIZE 64
+
+int reorderIrFields = 0;
+int layoutReport = 0;
+
+// the selector names one function body uses, weighted by loop depth
+struct IrFieldUses
+{
+    char **names;
+    long long *weights;
+    int count;
+    int capacity;
+};
+
+struct IrFieldUses *irFieldUses = NULL;
+int numberOfIrFieldUses = 0;
+
+void addIrFieldUse(struct IrFieldUses *uses, char *name, long long weight)
+{
+    int i = 0;
+    for (i = 0; i < uses->count; i++)
+    {
+        if (strcmp(uses->names[i], name) == 0)
+        {
+            uses->weights[i] += weight;
+            return;
+        }
+    }
+    if (uses->count == uses->capacity)
+    {
+        uses->capacity = uses->capacity == 0 ? 8 : uses->capacity * 2;
+        uses->names = realloc(uses->names, uses->capacity * sizeof(char *));
+        uses->weights = realloc(uses->weights, uses->capacity * sizeof(long long));
+    }
+    uses->names[uses->count] = name;
+    uses->weights[uses->count] = weight;
+    uses->count++;
+}
+
+void countIrFieldUses(struct Node *treeHead, struct IrFieldUses *uses, long long weight)
+{
+    int i = 0;
+    if (treeHead == NULL || treeHead->numberOfChildren == 0)
+    {
+        return;
+    }
+    if (treeHead->category == for_stmt && weight < (1LL << 40))
+    {
+        // a loop body runs more often than the code around it
+        weight *= 8;
+    }
+    if (treeHead->category == pexpr_no_paren && treeHead->numberOfChildren == 3 && treeHead->children[1]->numberOfChildren == 0 &&
+        treeHead->children[1]->data->category == PERIOD && treeHead->children[2]->numberOfChildren == 0)
+    {
+        // the base's type is not known here, a name counts for every struct with such a field
+        addIrFieldUse(uses, treeHead->children[2]->data->text, weight);
+    }
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        countIrFieldUses(treeHead->children[i], uses, weight);
+    }
+}
+
+void countIrFieldAccesses(struct Node *treeHead)
+{
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (treeHead->category == xfndcl)
+    {
+        irFieldUses = realloc(irFieldUses, (numberOfIrFieldUses + 1) * sizeof(struct IrFieldUses));
+        memset(&irFieldUses[numberOfIrFieldUses], 0, sizeof(struct IrFieldUses));
+        countIrFieldUses(treeHead, &irFieldUses[numberOfIrFieldUses], 1);
+        numberOfIrFieldUses++;
+        return;
+    }
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        countIrFieldAccesses(treeHead->children[i]);
+    }
+}
+
+// lays the fields out in the given order, returns the struct size
+int placeIrFields(struct IrStruct *structType, int *order, int assign)
+{
+    int offset = 0;
+    int i = 0;
+    for (i = 0; i < structType->numberOfFields; i++)
+    {
+        struct IrField *field = &structType->fields[order[i]];
+        offset = (offset + field->align - 1) / field->align * field->align;
+        if (assign)
+        {
+            field->offset = offset;
+        }
+        offset += field->size;
+    }
+    return (offset + structType->align - 1) / structType->align * structType->align;
+}
+
+void orderIrFieldsByAffinity(struct IrStruct *structType, int *order)
+{
+    int n = structType->numberOfFields;
+    long long *affinity = calloc(n * n, sizeof(long long));
+    long long *weights = calloc(n, sizeof(long long));
+    char *placed = calloc(n, 1);
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    // two fields used in one function are as close as their lighter use
+    for (k = 0; k < numberOfIrFieldUses; k++)
+    {
+        struct IrFieldUses *uses = &irFieldUses[k];
+        for (i = 0; i < n; i++)
+        {
+            weights[i] = 0;
+            for (j = 0; j < uses->count; j++)
+            {
+                if (strcmp(uses->names[j], structType->fields[i].name) == 0)
+                {
+                    weights[i] = uses->weights[j];
+                }
+            }
+            structType->fields[i].accesses += weights[i];
+        }
+        for (i = 0; i < n; i++)
+        {
+            for (j = 0; j < n; j++)
+            {
+                if (i != j && weights[i] > 0 && weights[j] > 0)
+                {
+                    affinity[i * n + j] += weights[i] < weights[j] ? weights[i] : weights[j];
+                }
+            }
+        }
+    }
+
+    // start from the hottest field and keep adding the one closest to those placed
+    for (k = 0; k < n; k++)
+    {
+        int best = -1;
+        long long bestScore = -1;
+        for (i = 0; i < n; i++)
+        {
+            long long score = 0;
+            if (placed[i])
+            {
+                continue;
+            }
+            for (j = 0; j < k; j++)
+            {
+                score += affinity[i * n + order[j]];
+            }
+            if (best < 0 || score > bestScore || (score == bestScore && structType->fields[i].accesses > structType->fields[best].accesses))
+            {
+                best = i;
+                bestScore = score;
+            }
+        }
+        order[k] = best;
+        placed[best] = 1;
+    }
+
+    // stable by alignment, so only the tail can need padding
+    for (i = 1; i < n; i++)
+    {
+        int field = order[i];
+        for (j = i; j > 0 && structType->fields[order[j - 1]].align < structType->fields[field].align; j--)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = field;
+    }
+    free(affinity);
+    free(weights);
+    free(placed);
+}
+
+void layoutIrStruct(struct IrStruct *structType)
+{
+    int *order = malloc((structType->numberOfFields + 1) * sizeof(int));
+    int i = 0;
+    structType->align = 1;
+    for (i = 0; i < structType->numberOfFields; i++)
+    {
+        order[i] = i;
+        if (structType->fields[i].align > structType->align)
+        {
+            structType->align = structType->fields[i].align;
+        }
+    }
+    structType->declaredSize = placeIrFields(structType, order, 0);
+    if (reorderIrFields)
+    {
+        orderIrFieldsByAffinity(structType, order);
+    }
+    structType->size = placeIrFields(structType, order, 1);
+    free(order);
+}
+
+void printLayoutReport(struct IrModule *module)
+{
+    struct IrStruct *structType = module->structs;
+    for (; structType != NULL; structType = structType->next)
+    {
+        int used = 0;
+        int offset = 0;
+        int i = 0;
+        for (i = 0; i < structType->numberOfFields; i++)
+        {
+            used += structType->fields[i].size;
+        }
+        printf("struct %s size %d align %d, %d bytes wasted", structType->name, structType->size, structType->align, structType->size - used);
+        if (structType->declaredSize != structType->size)
+        {
+            printf(" (%d in declaration order)", structType->declaredSize - used);
+        }
+        if (structType->size > 0)
+        {
+            printf(", %.2f per %d byte cache line", (double)CACHE_LINE_SIZE / structType->size, CACHE_LINE_SIZE);
+        }
+        printf("\n");
+
+        // fields by offset, with the holes between them
+        while (offset < structType->size)
+        {
+            struct IrField *next = NULL;
+            for (i = 0; i < structType->numberOfFields; i++)
+            {
+                struct IrField *field = &structType->fields[i];
+                if (field->offset >= offset && field->size > 0 && (next == NULL || field->offset < next->offset))
+                {
+                    next = field;
+                }
+            }
+            if (next == NULL || next->offset > offset)
+            {
+                int end = next == NULL ? structType->size : next->offset;
+                printf("    @%-4d padding %d\n", offset, end - offset);
+                offset = end;
+                continue;
+            }
+            printf("    @%-4d %s %s", next->offset, next->name, next->structType != NULL ? next->structType->name : irTypeName(next->type));
+            if (reorderIrFields)
+            {
+                printf(" used %lld", next->accesses);
+            }
+            printf("\n");
+            offset = next->offset + next->size;
+        }
+    }
+}
@@ -2,10 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include "linkedlist.h"
+#include "memreport.h"
 
 struct LinkedListNode *addToFront(struct Symbol *newData, struct LinkedListNode *head)
 {
     struct LinkedListNode *newLinkedListNode = malloc(sizeof(struct LinkedListNode));
+    countAllocation(MEM_LIST_NODE, sizeof(struct LinkedListNode));
     newLinkedListNode->data = newData;
     if (head == NULL)
     {
@@ -23,6 +25,7 @@ struct LinkedListNode *addToEnd(struct Symbol *newData, struct LinkedListNode *h
 {
     struct LinkedListNode *currentNode = head;
     struct LinkedListNode *newNode = malloc(sizeof(struct LinkedListNode));
+    countAllocation(MEM_LIST_NODE, sizeof(struct LinkedListNode));
     newNode->data = newData;
     newNode->next = NULL;
     if (head == NULL)
@@ -227,4 +230,17 @@ char *findTypeNameInLinkedList(char *variableName, struct LinkedListNode *head)
     printf("Table with name %s is not found\n", variableName);
     exit(3);
     return "";
-}
\ No newline at end of file
+}
+struct Symbol *findSymbolInLinkedList(char *variableName, struct LinkedListNode *head)
+{
+    struct LinkedListNode *current = head;
+    while (current != NULL)
+    {
+        if (strcmp(current->data->name, variableName) == 0)
+        {
+            return current->data;
+        }
+        current = current->next;
+    }
+    return NULL;
+}
@@ -18,6 +18,13 @@ struct Symbol
     char *typeName;
     int isConst;
     int arraySize;
+    // value of a const, set by handleConst
+    struct Constant *constant;
+    // GLOBALSCOPE or FUNCTIONSCOPE, how many scopes in from the global one and
+    // the order it was declared in among the names of its scope
+    int scopeKind;
+    int depth;
+    int slot;
 };
 
 struct LinkedListNode *addToFront(struct Symbol *newData, struct LinkedListNode *head);
@@ -30,5 +37,6 @@ int isVariableInLinkedList(char *variableName, struct LinkedListNode *head);
 int findTypeInLinkedList(char *variableName, struct LinkedListNode *head);
 int compareLinkedLists(struct LinkedListNode *typeList, struct LinkedListNode *paramList);
 char *findTypeNameInLinkedList(char *variableName, struct LinkedListNode *head);
+struct Symbol *findSymbolInLinkedList(char *variableName, struct LinkedListNode *head);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef LITERAL
+#define LITERAL
+
+/*
+ * Decoding of numeric literal text. Integers take the go prefixes (0x, 0o,
+ * 0b, or a leading 0 for octal) and underscores between digits and are kept
+ * in 64 bits. Floats are decimal with an optional exponent and are rounded
+ * exactly, independent of the C locale.
+ */
+
+#define LITERAL_OK 0
+#define LITERAL_OVERFLOW 1
+#define LITERAL_MALFORMED 2
+
+int decodeIntegerLiteral(char *text, unsigned long long *value);
+int decodeFloatLiteral(char *text, double *value);
+
+#endif
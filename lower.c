@@ -0,0 +1,234 @@
+#include "lower.h"
+#include "tree.h"
+#include "vgobison.tab.h"
+#include "nonterminal.h"
+#include "memreport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Lowers the parse tree built by the grammar actions into the tree used by the
+ * semantic passes. Punctuation leaves (including the semicolons inserted by the
+ * lexer) are dropped and freed, and the left leaning list chains such as
+ * xdcl_list(xdcl_list(xdcl_list(a), b), c) become one n-ary list node (a, b, c).
+ *
+ * Everything else keeps its position, including NULL children for optional
+ * parts, so a node's shape only depends on its category and arity:
+ *   for_header    (init, condition, post) or (condition)
+ *   if_header     (init, condition) or (condition)
+ *   pseudocall    (function) or (function, arguments)
+ *   compound_stmt, loop_body, fnbody  (stmt_list)
+ *   pexpr_no_paren index  (pexpr, [, expr)
+ */
+
+struct Node *lowerNode(struct Node *treeHead);
+
+int isPunctuation(struct Node *treeHead)
+{
+    if (treeHead == NULL || treeHead->numberOfChildren > 0 || treeHead->data == NULL)
+    {
+        return 0;
+    }
+    switch (treeHead->data->category)
+    {
+    case SEMICOLON:
+    case COMA:
+    case LPAREN:
+    case RPAREN:
+    case LBRACKET:
+    case RBRACKET:
+    case RSQUAREBRACE:
+    case COLON:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+int isListCategory(int category)
+{
+    switch (category)
+    {
+    case imports:
+    case import_stmt_list:
+    case xdcl_list:
+    case vardcl_list:
+    case typedcl_list:
+    case structdcl_list:
+    case interfacedcl_list:
+    case arg_type_list:
+    case stmt_list:
+    case new_name_list:
+    case dcl_name_list:
+    case expr_list:
+    case expr_or_type_list:
+    case keyval_list:
+    case elseif_list:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+// position of an optional trailing osemi/ocomma, which is NULL when it was left out
+int optionalPunctuationIndex(struct Node *treeHead)
+{
+    switch (treeHead->category)
+    {
+    case import:
+    case structtype:
+    case interfacetype:
+        return treeHead->numberOfChildren == 5 ? 3 : -1;
+
+    case common_dcl:
+        if (treeHead->numberOfChildren == 5)
+        {
+            return 3;
+        }
+        return treeHead->numberOfChildren == 7 ? 5 : -1;
+
+    case pseudocall:
+        if (treeHead->numberOfChildren == 5)
+        {
+            return 3;
+        }
+        return treeHead->numberOfChildren == 6 ? 4 : -1;
+
+    case pexpr_no_paren:
+        // convtype ( expr ocomma )
+        if (treeHead->numberOfChildren == 5 && isPunctuation(treeHead->children[1]))
+        {
+            return 3;
+        }
+        return -1;
+
+    case braced_keyval_list:
+    case oarg_type_list_ocomma:
+        return treeHead->numberOfChildren == 2 ? 1 : -1;
+
+    default:
+        return -1;
+    }
+}
+
+void freeLeaf(struct Node *treeHead)
+{
+    // semicolons inserted by the lexer share insertedSemicolon, identifiers are interned
+    if (treeHead->data->text != insertedSemicolon && treeHead->data->category != LNAME)
+    {
+        countRelease(MEM_TOKEN_TEXT, strlen(treeHead->data->text) + 1);
+        free(treeHead->data->text);
+    }
+    countRelease(MEM_TOKEN_TEXT, strlen(treeHead->data->filename) + 1);
+    countRelease(MEM_TOKEN, sizeof(struct Token));
+    countRelease(MEM_TREE_NODE, sizeof(struct Node));
+    free(treeHead->data->filename);
+    free(treeHead->data);
+    free(treeHead);
+}
+
+void freeShell(struct Node *treeHead)
+{
+    countRelease(MEM_TREE_NODE, sizeof(struct Node));
+    countRelease(MEM_TREE_NAME, strlen(treeHead->categoryName) + 1);
+    countRelease(MEM_TREE_CHILDREN, treeHead->numberOfChildren * sizeof(struct Node *));
+    free(treeHead->categoryName);
+    free(treeHead->children);
+    free(treeHead);
+}
+
+void appendListItems(struct Node *list, struct Node *treeHead, int *capacity)
+{
+    int i = 0;
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        struct Node *child = treeHead->children[i];
+        if (child == NULL)
+        {
+            // empty statement or the start of the chain
+        }
+        else if (isPunctuation(child))
+        {
+            freeLeaf(child);
+        }
+        else if (child->category == treeHead->category && child->numberOfChildren > 0)
+        {
+            // the left leaning part of the chain
+            appendListItems(list, child, capacity);
+            freeShell(child);
+        }
+        else
+        {
+            if (list->numberOfChildren == *capacity)
+            {
+                *capacity = *capacity * 2;
+                list->children = realloc(list->children, *capacity * sizeof(struct Node *));
+            }
+            list->children[list->numberOfChildren] = lowerNode(child);
+            list->numberOfChildren++;
+        }
+    }
+}
+
+struct Node *lowerList(struct Node *treeHead)
+{
+    int capacity = 4;
+    struct Node *list = createTree(treeHead->category, treeHead->categoryName, 0);
+    list->children = malloc(capacity * sizeof(struct Node *));
+
+    appendListItems(list, treeHead, &capacity);
+    freeShell(treeHead);
+
+    if (list->numberOfChildren == 0)
+    {
+        // only empty statements, nothing for the semantic passes to look at
+        freeShell(list);
+        return NULL;
+    }
+    list->children = realloc(list->children, list->numberOfChildren * sizeof(struct Node *));
+    countAllocation(MEM_TREE_CHILDREN, list->numberOfChildren * sizeof(struct Node *));
+    return list;
+}
+
+struct Node *lowerNode(struct Node *treeHead)
+{
+    if (treeHead == NULL || treeHead->numberOfChildren == 0)
+    {
+        return treeHead;
+    }
+    if (isListCategory(treeHead->category))
+    {
+        return lowerList(treeHead);
+    }
+
+    int optionalIndex = optionalPunctuationIndex(treeHead);
+    int kept = 0;
+    int i = 0;
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        struct Node *child = treeHead->children[i];
+        if (isPunctuation(child))
+        {
+            freeLeaf(child);
+        }
+        else if (i == optionalIndex)
+        {
+            // osemi/ocomma left out by the programmer
+        }
+        else
+        {
+            treeHead->children[kept] = lowerNode(child);
+            kept++;
+        }
+    }
+    treeHead->numberOfChildren = kept;
+    return treeHead;
+}
+
+struct Node *lowerTree(struct Node *treeHead)
+{
+    return lowerNode(treeHead);
+}
@@ -0,0 +1,8 @@
+#ifndef LOWER
+#define LOWER
+
+#include "tree.h"
+
+struct Node *lowerTree(struct Node *treeHead);
+
+#endif
@@ -0,0 +1,77 @@
+#include "memreport.h"
+#include "intern.h"
+#include "tree.h"
+#include "symboltable.h"
+#include <stdio.h>
+#include <sys/resource.h>
+
+int memReport = 0;
+int memCounting = 0;
+
+struct MemCounter
+{
+    long long allocations;
+    long long bytes;
+    long long releases;
+    long long releasedBytes;
+};
+
+struct MemCounter memCounters[MEM_CATEGORIES];
+
+char *memCategoryNames[MEM_CATEGORIES] = {"token", "token text", "tree node", "tree name", "tree children", "symbol table", "symbol", "list node"};
+
+extern struct symboltable *globalSymbolTable;
+
+void countAllocation(int category, size_t size)
+{
+    if (memCounting)
+    {
+        __atomic_add_fetch(&memCounters[category].allocations, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&memCounters[category].bytes, (long long)size, __ATOMIC_RELAXED);
+    }
+}
+
+void countRelease(int category, size_t size)
+{
+    if (memCounting)
+    {
+        __atomic_add_fetch(&memCounters[category].releases, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&memCounters[category].releasedBytes, (long long)size, __ATOMIC_RELAXED);
+    }
+}
+
+long long liveAllocations(int category)
+{
+    return __atomic_load_n(&memCounters[category].allocations, __ATOMIC_RELAXED) - __atomic_load_n(&memCounters[category].releases, __ATOMIC_RELAXED);
+}
+
+void printMemReport()
+{
+    struct MemCounter total = {0, 0, 0, 0};
+    struct rusage usage;
+    int i = 0;
+    printf("%-14s %10s %12s %10s %12s\n", "category", "count", "bytes", "live", "live bytes");
+    for (i = 0; i < MEM_CATEGORIES; i++)
+    {
+        struct MemCounter *counter = &memCounters[i];
+        printf("%-14s %10lld %12lld %10lld %12lld\n", memCategoryNames[i], counter->allocations, counter->bytes, counter->allocations - counter->releases,
+               counter->bytes - counter->releasedBytes);
+        total.allocations += counter->allocations;
+        total.bytes += counter->bytes;
+        total.releases += counter->releases;
+        total.releasedBytes += counter->releasedBytes;
+    }
+    printf("%-14s %10lld %12lld %10lld %12lld\n", "total", total.allocations, total.bytes, total.allocations - total.releases, total.bytes - total.releasedBytes);
+
+    // interned identifier text is not counted per allocation, the table knows its size
+    struct Interner *identifiers = identifierTable();
+    printf("identifiers: %d interned in %d slots\n", identifiers->count, identifiers->table->capacity);
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        printf("peak rss: %ld KB\n", usage.ru_maxrss);
+    }
+    if (globalSymbolTable != NULL)
+    {
+        printSymbolTableHealth(globalSymbolTable);
+    }
+}
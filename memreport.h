@@ -0,0 +1,33 @@
+#ifndef MEMREPORT
+#define MEMREPORT
+
+#include <stddef.h>
+
+/*
+ * Allocation accounting for -mem-report. The front end's allocation sites
+ * count what they take and the lowering pass counts what it gives back, so
+ * the report shows both the total allocated and what is still live.
+ */
+
+#define MEM_TOKEN 0
+#define MEM_TOKEN_TEXT 1
+#define MEM_TREE_NODE 2
+#define MEM_TREE_NAME 3
+#define MEM_TREE_CHILDREN 4
+#define MEM_SYMBOL_TABLE 5
+#define MEM_SYMBOL 6
+#define MEM_LIST_NODE 7
+#define MEM_CATEGORIES 8
+
+extern int memReport;
+// set by -mem-report and -trace, without it the counters stay at zero and counting costs one test
+extern int memCounting;
+
+// safe to call from several threads
+void countAllocation(int category, size_t size);
+void countRelease(int category, size_t size);
+// allocated and not yet released
+long long liveAllocations(int category);
+void printMemReport();
+
+#endif
@@ -0,0 +1,566 @@
+#include "package.h"
+#include "tree.h"
+#include "symboltable.h"
+#include "linkedlist.h"
+#include "vgobison.tab.h"
+#include "nonterminal.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int packageBuild = 0;
+
+char **importDirectories = NULL;
+int numberOfImportDirectories = 0;
+
+// every summary loaded so far, in import order
+struct ExportSummary *importedPackages = NULL;
+
+// the summary being written, grown in place
+struct ExportBuffer
+{
+    unsigned char *bytes;
+    unsigned int length;
+    unsigned int capacity;
+};
+
+void addImportDirectory(char *directory)
+{
+    importDirectories = realloc(importDirectories, (numberOfImportDirectories + 1) * sizeof(char *));
+    importDirectories[numberOfImportDirectories] = directory;
+    numberOfImportDirectories++;
+}
+
+int isExportedName(char *name)
+{
+    return name[0] >= 'A' && name[0] <= 'Z';
+}
+
+char *exportString(struct ExportSummary *summary, unsigned int offset)
+{
+    return (char *)summary->base + offset;
+}
+
+struct ExportFunction *exportedFunction(struct ExportSummary *summary, int index)
+{
+    return (struct ExportFunction *)(summary->base + summary->header->functions) + index;
+}
+
+struct ExportStruct *exportedStruct(struct ExportSummary *summary, int index)
+{
+    return (struct ExportStruct *)(summary->base + summary->header->structs) + index;
+}
+
+struct ExportVariable *exportedVariable(struct ExportSummary *summary, int index)
+{
+    return (struct ExportVariable *)(summary->base + summary->header->variables) + index;
+}
+
+unsigned int *exportedObject(struct ExportSummary *summary, int index)
+{
+    return (unsigned int *)(summary->base + summary->header->objects) + index;
+}
+
+/*
+ * reading
+ */
+
+int checkExportArray(struct ExportHeader *header, unsigned int offset, unsigned int count, unsigned int size)
+{
+    return offset % 4 == 0 && offset <= header->size && count <= (header->size - offset) / size;
+}
+
+// every offset and count in the summary stays inside the mapping
+int checkExportSummary(struct ExportSummary *summary, size_t size)
+{
+    struct ExportHeader *header = summary->header;
+    unsigned int i = 0;
+    if (size < sizeof(struct ExportHeader) || memcmp(header->magic, EXPORT_MAGIC, 4) != 0 || header->version != EXPORT_VERSION ||
+        header->size != size || summary->base[size - 1] != '\0')
+    {
+        return 0;
+    }
+    if (!checkExportArray(header, header->functions, header->numberOfFunctions, sizeof(struct ExportFunction)) ||
+        !checkExportArray(header, header->structs, header->numberOfStructs, sizeof(struct ExportStruct)) ||
+        !checkExportArray(header, header->variables, header->numberOfVariables, sizeof(struct ExportVariable)) ||
+        !checkExportArray(header, header->objects, header->numberOfObjects, sizeof(unsigned int)) || header->packageName >= size)
+    {
+        return 0;
+    }
+    // the last byte is a NUL, so any string offset inside the file is terminated
+    for (i = 0; i < header->numberOfFunctions; i++)
+    {
+        struct ExportFunction *exported = exportedFunction(summary, i);
+        if (exported->name >= size || exported->resultType >= size || exported->firstParameter > header->numberOfVariables ||
+            exported->numberOfParameters > header->numberOfVariables - exported->firstParameter)
+        {
+            return 0;
+        }
+    }
+    for (i = 0; i < header->numberOfStructs; i++)
+    {
+        struct ExportStruct *structType = exportedStruct(summary, i);
+        if (structType->name >= size || structType->firstField > header->numberOfVariables ||
+            structType->numberOfFields > header->numberOfVariables - structType->firstField)
+        {
+            return 0;
+        }
+    }
+    for (i = 0; i < header->numberOfVariables; i++)
+    {
+        if (exportedVariable(summary, i)->name >= size || exportedVariable(summary, i)->typeName >= size)
+        {
+            return 0;
+        }
+    }
+    for (i = 0; i < header->numberOfObjects; i++)
+    {
+        if (*exportedObject(summary, i) >= size)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+struct ExportSummary *mapExportSummary(char *path)
+{
+    struct stat status;
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0)
+    {
+        return NULL;
+    }
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+    {
+        close(descriptor);
+        return NULL;
+    }
+    void *base = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    struct ExportSummary *summary = calloc(1, sizeof(struct ExportSummary));
+    summary->path = strdup(path);
+    summary->base = base;
+    summary->header = base;
+    if (!checkExportSummary(summary, status.st_size))
+    {
+        printf("%s is not a VGo export summary or was written by another version\n", path);
+        exit(3);
+    }
+    return summary;
+}
+
+struct ExportSummary *importPackage(char *importPath)
+{
+    struct ExportSummary *summary = importedPackages;
+    struct ExportSummary **tail = &importedPackages;
+    int i = 0;
+    for (; summary != NULL; summary = summary->next)
+    {
+        if (strcmp(summary->importPath, importPath) == 0)
+        {
+            return summary;
+        }
+        tail = &summary->next;
+    }
+    // the current directory when no -I was given
+    for (i = 0; i < (numberOfImportDirectories == 0 ? 1 : numberOfImportDirectories) && summary == NULL; i++)
+    {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s.vgox", numberOfImportDirectories == 0 ? "." : importDirectories[i], importPath);
+        summary = mapExportSummary(path);
+    }
+    if (summary != NULL)
+    {
+        summary->importPath = strdup(importPath);
+        *tail = summary;
+    }
+    return summary;
+}
+
+struct ExportSummary *findImportedPackage(char *packageName)
+{
+    struct ExportSummary *summary = importedPackages;
+    for (; summary != NULL; summary = summary->next)
+    {
+        if (strcmp(exportString(summary, summary->header->packageName), packageName) == 0)
+        {
+            return summary;
+        }
+    }
+    return NULL;
+}
+
+struct ExportFunction *findExportedFunction(struct ExportSummary *summary, char *name)
+{
+    // sorted by name when written
+    int low = 0;
+    int high = (int)summary->header->numberOfFunctions - 1;
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+        int order = strcmp(name, exportString(summary, exportedFunction(summary, middle)->name));
+        if (order == 0)
+        {
+            return exportedFunction(summary, middle);
+        }
+        if (order < 0)
+        {
+            high = middle - 1;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+struct ExportStruct *findExportedStruct(struct ExportSummary *summary, char *name)
+{
+    unsigned int i = 0;
+    for (i = 0; i < summary->header->numberOfStructs; i++)
+    {
+        if (strcmp(name, exportString(summary, exportedStruct(summary, i)->name)) == 0)
+        {
+            return exportedStruct(summary, i);
+        }
+    }
+    return NULL;
+}
+
+int hasImportedPackages()
+{
+    return importedPackages != NULL;
+}
+
+char *importedObjects()
+{
+    struct ExportSummary *summary = importedPackages;
+    size_t length = 1;
+    char *objects = NULL;
+    unsigned int i = 0;
+    for (; summary != NULL; summary = summary->next)
+    {
+        for (i = 0; i < summary->header->numberOfObjects; i++)
+        {
+            length += strlen(exportString(summary, *exportedObject(summary, i))) + 3;
+        }
+    }
+    objects = calloc(length, 1);
+    for (summary = importedPackages; summary != NULL; summary = summary->next)
+    {
+        for (i = 0; i < summary->header->numberOfObjects; i++)
+        {
+            char *object = exportString(summary, *exportedObject(summary, i));
+            char *found = strstr(objects, object);
+            // packages imported along more than one path are linked once
+            if (found == NULL || found[-1] != '\'' || found[strlen(object)] != '\'')
+            {
+                sprintf(objects + strlen(objects), " '%s'", object);
+            }
+        }
+    }
+    return objects;
+}
+
+/*
+ * merging the files of a packageTree
+ */
+
+char *packageNameOf(struct Node *tree)
+{
+    return tree->children[0]->children[1]->data->text;
+}
+
+// appends the items of a lowered list to another, which may not exist yet
+struct Node *appendListNode(struct Node *list, struct Node *more)
+{
+    int i = 0;
+    if (more == NULL)
+    {
+        return list;
+    }
+    if (list == NULL)
+    {
+        return more;
+    }
+    list->children = realloc(list->children, (list->numberOfChildren + more->numberOfChildren) * sizeof(struct Node *));
+    for (i = 0; i < more->numberOfChildren; i++)
+    {
+        list->children[list->numberOfChildren++] = more->children[i];
+    }
+    return list;
+}
+
+struct Node *mergePackageFile(struct Node *packageTree, struct Node *fileTree)
+{
+    if (packageTree == NULL)
+    {
+        return fileTree;
+    }
+    if (strcmp(packageNameOf(packageTree), packageNameOf(fileTree)) != 0)
+    {
+        printf("Found package %s in %s but the other files are package %s\n", packageNameOf(fileTree), fileTree->children[0]->children[1]->data->filename,
+               packageNameOf(packageTree));
+        exit(3);
+    }
+    packageTree->children[1] = appendListNode(packageTree->children[1], fileTree->children[1]);
+    packageTree->children[2] = appendListNode(packageTree->children[2], fileTree->children[2]);
+    return packageTree;
+}
+
+/*
+ * writing
+ */
+
+unsigned int reserveExport(struct ExportBuffer *buffer, unsigned int size)
+{
+    unsigned int offset = (buffer->length + 3) & ~3u;
+    if (offset + size > buffer->capacity)
+    {
+        buffer->capacity = (offset + size) * 2;
+        buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+    }
+    memset(buffer->bytes + buffer->length, 0, offset + size - buffer->length);
+    buffer->length = offset + size;
+    return offset;
+}
+
+unsigned int writeExportString(struct ExportBuffer *buffer, char *text)
+{
+    unsigned int length = strlen(text) + 1;
+    unsigned int offset = reserveExport(buffer, length);
+    memcpy(buffer->bytes + offset, text, length);
+    return offset;
+}
+
+int compareFunctionNames(const void *left, const void *right)
+{
+    struct Node *a = *(struct Node **)left;
+    struct Node *b = *(struct Node **)right;
+    return strcmp(a->children[1]->children[0]->data->text, b->children[1]->children[0]->data->text);
+}
+
+// the exported function and struct declarations, functions sorted by name
+int collectExports(struct Node *packageTree, struct Node **functions, int *numberOfFunctions, struct Node **structs)
+{
+    struct Node *declarations = packageTree->children[2];
+    int numberOfStructs = 0;
+    int i = 0;
+    *numberOfFunctions = 0;
+    for (i = 0; declarations != NULL && i < declarations->numberOfChildren; i++)
+    {
+        struct Node *declaration = declarations->children[i];
+        if (declaration == NULL)
+        {
+            continue;
+        }
+        if (declaration->category == xfndcl && declaration->children[1]->category == fndcl &&
+            isExportedName(declaration->children[1]->children[0]->data->text))
+        {
+            functions[(*numberOfFunctions)++] = declaration;
+        }
+        else if (declaration->category == common_dcl && declaration->children[1] != NULL && declaration->children[1]->category == typedcl &&
+                 declaration->children[1]->numberOfChildren == 2 && isExportedName(declaration->children[1]->children[0]->data->text))
+        {
+            structs[numberOfStructs++] = declaration->children[1];
+        }
+    }
+    qsort(functions, *numberOfFunctions, sizeof(struct Node *), compareFunctionNames);
+    return numberOfStructs;
+}
+
+unsigned int countStructFields(struct Node *treeHead)
+{
+    unsigned int count = 0;
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return 0;
+    }
+    if (treeHead->category == structdcl)
+    {
+        return treeHead->children[0]->numberOfChildren;
+    }
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        count += countStructFields(treeHead->children[i]);
+    }
+    return count;
+}
+
+// fields in declaration order, typed from the struct's symbol table
+void writeStructFields(struct ExportBuffer *buffer, struct Node *treeHead, struct symboltable *table, unsigned int *next)
+{
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (treeHead->category != structdcl)
+    {
+        for (i = 0; i < treeHead->numberOfChildren; i++)
+        {
+            writeStructFields(buffer, treeHead->children[i], table, next);
+        }
+        return;
+    }
+    for (i = 0; i < treeHead->children[0]->numberOfChildren; i++)
+    {
+        struct Symbol *symbol = findSymbolInTable(table, treeHead->children[0]->children[i]->children[0]->data->text);
+        unsigned int name = writeExportString(buffer, symbol->name);
+        unsigned int typeName = writeExportString(buffer, symbol->typeName);
+        struct ExportHeader *header = (struct ExportHeader *)buffer->bytes;
+        struct ExportVariable *field = (struct ExportVariable *)(buffer->bytes + header->variables) + *next;
+        field->name = name;
+        field->typeName = typeName;
+        field->arraySize = symbol->arraySize > 0 ? symbol->arraySize : -1;
+        (*next)++;
+    }
+}
+
+// rewritten only when the contents change, so importers that depend on it are not rebuilt for nothing
+void replaceExportFile(char *path, unsigned char *bytes, unsigned int length)
+{
+    FILE *summary = fopen(path, "rb");
+    if (summary != NULL)
+    {
+        unsigned char *old = malloc(length + 1);
+        size_t read = fread(old, 1, length + 1, summary);
+        fclose(summary);
+        int same = read == length && memcmp(old, bytes, length) == 0;
+        free(old);
+        if (same)
+        {
+            return;
+        }
+    }
+    summary = fopen(path, "wb");
+    if (summary == NULL || fwrite(bytes, 1, length, summary) != length || fclose(summary) != 0)
+    {
+        printf("Unable to write %s\n", path);
+        exit(3);
+    }
+}
+
+void writeExportSummary(struct Node *packageTree, char *summaryPath, char *objectPath)
+{
+    struct ExportBuffer buffer = {NULL, 0, 0};
+    int count = packageTree->children[2] == NULL ? 0 : packageTree->children[2]->numberOfChildren;
+    struct Node **functions = malloc((count + 1) * sizeof(struct Node *));
+    struct Node **structs = malloc((count + 1) * sizeof(struct Node *));
+    int numberOfFunctions = 0;
+    int numberOfStructs = collectExports(packageTree, functions, &numberOfFunctions, structs);
+    unsigned int numberOfVariables = 0;
+    unsigned int numberOfObjects = 1;
+    unsigned int next = 0;
+    struct ExportSummary *imported = NULL;
+    char object[PATH_MAX];
+    int i = 0;
+    unsigned int j = 0;
+
+    if (realpath(objectPath, object) == NULL)
+    {
+        printf("Unable to find %s\n", objectPath);
+        exit(3);
+    }
+    for (i = 0; i < numberOfFunctions; i++)
+    {
+        struct LinkedListNode *parameter = findSymbolTable(functions[i]->children[1]->children[0]->data->text)->declarationPropertyList;
+        for (; parameter != NULL; parameter = parameter->next)
+        {
+            numberOfVariables++;
+        }
+    }
+    for (i = 0; i < numberOfStructs; i++)
+    {
+        numberOfVariables += countStructFields(structs[i]->children[1]);
+    }
+    for (imported = importedPackages; imported != NULL; imported = imported->next)
+    {
+        numberOfObjects += imported->header->numberOfObjects;
+    }
+
+    // the fixed size parts first, the strings after them
+    unsigned int header = reserveExport(&buffer, sizeof(struct ExportHeader));
+    unsigned int functionArray = reserveExport(&buffer, numberOfFunctions * sizeof(struct ExportFunction));
+    unsigned int structArray = reserveExport(&buffer, numberOfStructs * sizeof(struct ExportStruct));
+    unsigned int variableArray = reserveExport(&buffer, numberOfVariables * sizeof(struct ExportVariable));
+    unsigned int objectArray = reserveExport(&buffer, numberOfObjects * sizeof(unsigned int));
+    struct ExportHeader *summary = (struct ExportHeader *)(buffer.bytes + header);
+    memcpy(summary->magic, EXPORT_MAGIC, 4);
+    summary->version = EXPORT_VERSION;
+    summary->functions = functionArray;
+    summary->structs = structArray;
+    summary->variables = variableArray;
+    summary->objects = objectArray;
+    summary->numberOfFunctions = numberOfFunctions;
+    summary->numberOfStructs = numberOfStructs;
+    summary->numberOfVariables = numberOfVariables;
+    summary->numberOfObjects = numberOfObjects;
+    // the buffer moves as strings are added, so every record is found again by offset
+    unsigned int packageName = writeExportString(&buffer, packageNameOf(packageTree));
+    ((struct ExportHeader *)buffer.bytes)->packageName = packageName;
+
+    for (i = 0; i < numberOfFunctions; i++)
+    {
+        struct symboltable *table = findSymbolTable(functions[i]->children[1]->children[0]->data->text);
+        struct LinkedListNode *parameter = table->declarationPropertyList;
+        unsigned int name = writeExportString(&buffer, table->tablename);
+        unsigned int resultType = writeExportString(&buffer, table->returnType == VOID ? "" : table->returnTypeName);
+        struct ExportFunction *exported = (struct ExportFunction *)(buffer.bytes + functionArray) + i;
+        exported->name = name;
+        exported->resultType = resultType;
+        exported->firstParameter = next;
+        for (; parameter != NULL; parameter = parameter->next)
+        {
+            unsigned int parameterName = writeExportString(&buffer, parameter->data->name);
+            unsigned int typeName = writeExportString(&buffer, parameter->data->typeName);
+            struct ExportVariable *variable = (struct ExportVariable *)(buffer.bytes + variableArray) + next;
+            variable->name = parameterName;
+            variable->typeName = typeName;
+            variable->arraySize = -1;
+            next++;
+            ((struct ExportFunction *)(buffer.bytes + functionArray) + i)->numberOfParameters++;
+        }
+    }
+    for (i = 0; i < numberOfStructs; i++)
+    {
+        unsigned int name = writeExportString(&buffer, structs[i]->children[0]->data->text);
+        unsigned int firstField = next;
+        writeStructFields(&buffer, structs[i]->children[1], findStructTable(structs[i]->children[0]->data->text), &next);
+        struct ExportStruct *structType = (struct ExportStruct *)(buffer.bytes + structArray) + i;
+        structType->name = name;
+        structType->firstField = firstField;
+        structType->numberOfFields = next - firstField;
+    }
+    next = 0;
+    unsigned int objectName = writeExportString(&buffer, object);
+    ((unsigned int *)(buffer.bytes + objectArray))[next++] = objectName;
+    for (imported = importedPackages; imported != NULL; imported = imported->next)
+    {
+        for (j = 0; j < imported->header->numberOfObjects; j++)
+        {
+            objectName = writeExportString(&buffer, exportString(imported, *exportedObject(imported, j)));
+            ((unsigned int *)(buffer.bytes + objectArray))[next++] = objectName;
+        }
+    }
+    // ends in a NUL, which the reader relies on
+    reserveExport(&buffer, 1);
+    ((struct ExportHeader *)buffer.bytes)->size = buffer.length;
+
+    replaceExportFile(summaryPath, buffer.bytes, buffer.length);
+    free(buffer.bytes);
+    free(functions);
+    free(structs);
+}
@@ -0,0 +1,102 @@
+#ifndef PACKAGE
+#define PACKAGE
+
+#include "tree.h"
+
+/*
+ * Packages other than main. "vgo -package -o build/geom.o geom/a.go geom/b.go"
+ * checks the files of one package together, compiles them to an object and writes
+ * build/geom.vgox, a summary of what the package exports. A program that
+ * imports "geom" finds geom.vgox on its -I directories, maps it and takes the
+ * exported functions and structs from it, then links the objects it lists;
+ * the sources of geom are never read again.
+ *
+ * The summary is laid out to be used in place once mapped: fixed size
+ * records that refer to NUL terminated strings by their offset in the file,
+ * with the functions sorted by name so a lookup is a binary search.
+ */
+
+#define EXPORT_MAGIC "VGOX"
+#define EXPORT_VERSION 1
+
+struct ExportHeader
+{
+    char magic[4];
+    unsigned int version;
+    // of the whole file, checked against the size of the mapping
+    unsigned int size;
+    // string offsets
+    unsigned int packageName;
+    // offsets of the functions, structs, variables and object path arrays
+    unsigned int functions;
+    unsigned int structs;
+    unsigned int variables;
+    unsigned int objects;
+    unsigned int numberOfFunctions;
+    unsigned int numberOfStructs;
+    unsigned int numberOfVariables;
+    // this package's object first, then those of the packages it imports
+    unsigned int numberOfObjects;
+};
+
+struct ExportFunction
+{
+    unsigned int name;
+    // the empty string for functions without a result
+    unsigned int resultType;
+    unsigned int firstParameter;
+    unsigned int numberOfParameters;
+};
+
+// a parameter or a struct field
+struct ExportVariable
+{
+    unsigned int name;
+    unsigned int typeName;
+    int arraySize;
+};
+
+struct ExportStruct
+{
+    unsigned int name;
+    unsigned int firstField;
+    unsigned int numberOfFields;
+};
+
+struct ExportSummary
+{
+    char *importPath;
+    char *path;
+    unsigned char *base;
+    struct ExportHeader *header;
+    // set once the checker has tables for the exported names
+    int declared;
+    struct ExportSummary *next;
+};
+
+// set by -package, the files given are one package rather than programs
+extern int packageBuild;
+
+void addImportDirectory(char *directory);
+char *exportString(struct ExportSummary *summary, unsigned int offset);
+struct ExportFunction *exportedFunction(struct ExportSummary *summary, int index);
+struct ExportStruct *exportedStruct(struct ExportSummary *summary, int index);
+struct ExportVariable *exportedVariable(struct ExportSummary *summary, int index);
+
+// the summary for an import path, NULL when no -I directory has one
+struct ExportSummary *importPackage(char *importPath);
+// an imported package by the name its files declare
+struct ExportSummary *findImportedPackage(char *packageName);
+struct ExportFunction *findExportedFunction(struct ExportSummary *summary, char *name);
+struct ExportStruct *findExportedStruct(struct ExportSummary *summary, char *name);
+int isExportedName(char *name);
+
+// the lowered trees of a package's files as one, checking they agree on the package
+struct Node *mergePackageFile(struct Node *packageTree, struct Node *fileTree);
+char *packageNameOf(struct Node *tree);
+void writeExportSummary(struct Node *packageTree, char *summaryPath, char *objectPath);
+int hasImportedPackages();
+// quoted object paths of every imported package for the link line
+char *importedObjects();
+
+#endif
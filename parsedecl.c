@@ -0,0 +1,162 @@
+#include "parsedecl.h"
+#include "chunklex.h"
+#include "tree.h"
+#include "vgobison.tab.h"
+#include "globalutilities.h"
+#include "nonterminal.h"
+#include "workpool.h"
+#include <stdlib.h>
+
+// set by -parse-threads=N
+int parseThreads = 0;
+__thread struct DeclarationParse *declarationParse = NULL;
+
+int nextDeclarationToken(struct Node **token)
+{
+    struct DeclarationParse *parse = declarationParse;
+    if (parse->next < 0)
+    {
+        parse->next = 0;
+        *token = NULL;
+        return LDECLARATION;
+    }
+    // after an error the parse only has to stop, the file is parsed again to report it
+    if (parse->failed || parse->next == parse->numberOfTokens)
+    {
+        return -1;
+    }
+    *token = parse->tokens[parse->next];
+    parse->next++;
+    return (*token)->category;
+}
+
+int bracketDepth(int category)
+{
+    switch (category)
+    {
+    case LPAREN:
+    case LBRACKET:
+    case LSQUAREBRACE:
+        return 1;
+    case RPAREN:
+    case RBRACKET:
+    case RSQUAREBRACE:
+        return -1;
+    }
+    return 0;
+}
+
+int isDeclarationStart(int category)
+{
+    return category == LFUNC || category == LTYPE || category == LVAR || category == LCONST;
+}
+
+void parseDeclaration(int index, void *argument)
+{
+    struct DeclarationParse *parses = argument;
+    declarationParse = &parses[index];
+    if (yyparse() != 0)
+    {
+        parses[index].failed = 1;
+    }
+    declarationParse = NULL;
+}
+
+int parseDeclarations()
+{
+    int numberOfTokens = 0;
+    struct Node **tokens = chunkedTokens(&numberOfTokens);
+    // the package clause has an error of its own that exits, leave it to yyparse
+    if (tokens == NULL || tokens[0]->category != LPACKAGE)
+    {
+        free(tokens);
+        return 0;
+    }
+
+    // the declarations start at the first func, type, var or const outside any brackets
+    int depth = 0;
+    int start = 0;
+    int i = 0;
+    for (i = 1; i < numberOfTokens && start == 0; i++)
+    {
+        depth += bracketDepth(tokens[i - 1]->category);
+        if (depth == 0 && tokens[i - 1]->category == SEMICOLON && isDeclarationStart(tokens[i]->category))
+        {
+            start = i;
+        }
+    }
+    if (start == 0)
+    {
+        free(tokens);
+        return 0;
+    }
+
+    // each ends at the semicolon outside brackets after it, semicolon takes two in a row
+    int capacity = 64;
+    int numberOfDeclarations = 0;
+    struct DeclarationParse *parses = malloc(capacity * sizeof(struct DeclarationParse));
+    depth = 0;
+    i = start;
+    while (i < numberOfTokens)
+    {
+        int first = i;
+        for (; i < numberOfTokens; i++)
+        {
+            depth += bracketDepth(tokens[i]->category);
+            if (depth <= 0 && tokens[i]->category == SEMICOLON)
+            {
+                i++;
+                if (i < numberOfTokens && tokens[i]->category == SEMICOLON)
+                {
+                    i++;
+                }
+                break;
+            }
+        }
+        if (numberOfDeclarations == capacity)
+        {
+            capacity = capacity * 2;
+            parses = realloc(parses, capacity * sizeof(struct DeclarationParse));
+        }
+        struct DeclarationParse *parse = &parses[numberOfDeclarations];
+        parse->tokens = tokens + first;
+        parse->numberOfTokens = i - first;
+        parse->next = -1;
+        parse->failed = 0;
+        parse->declaration = NULL;
+        parse->semicolon = NULL;
+        numberOfDeclarations++;
+        depth = 0;
+    }
+
+    // the package clause and imports make the file, with no declarations yet
+    struct DeclarationParse header = {tokens, start, 0, 0, NULL, NULL};
+    declarationParse = &header;
+    if (yyparse() != 0)
+    {
+        header.failed = 1;
+    }
+    declarationParse = NULL;
+    int failed = header.failed;
+    if (!failed)
+    {
+        runWorkPool(numberOfDeclarations, parseThreads, parseDeclaration, parses);
+        for (i = 0; i < numberOfDeclarations; i++)
+        {
+            failed |= parses[i].failed;
+        }
+    }
+    if (!failed && treeHead != NULL)
+    {
+        // the chain xdcl_list: xdcl_list xdcl semicolon reduces, first declaration innermost
+        struct Node *list = NULL;
+        for (i = 0; i < numberOfDeclarations; i++)
+        {
+            list = createTree(xdcl_list, "xdcl_list", 3, list, parses[i].declaration, parses[i].semicolon);
+        }
+        treeHead->children[2] = list;
+    }
+    free(parses);
+    free(tokens);
+    return !failed;
+}
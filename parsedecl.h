@@ -0,0 +1,38 @@
+#ifndef PARSEDECL
+#define PARSEDECL
+
+/*
+ * -parse-threads=N parses the top-level declarations of a file lexed by
+ * chunklex.c on N threads. A scan of the tokens by bracket depth finds where
+ * each func, type, var and const ends; the package clause and imports are
+ * parsed first, then every declaration on a parser of its own, and their
+ * subtrees are chained into the xdcl_list yyparse would have built. When
+ * any of the parses fails the file is parsed again in order, so syntax
+ * errors are reported exactly as they are without the flag.
+ */
+
+struct Node;
+
+// the tokens one parse reads, after the LDECLARATION that starts it
+struct DeclarationParse
+{
+    struct Node **tokens;
+    int numberOfTokens;
+    // -1 before LDECLARATION has been handed to the parser
+    int next;
+    int failed;
+    // what the LDECLARATION rule of file reduced
+    struct Node *declaration;
+    struct Node *semicolon;
+};
+
+extern int parseThreads;
+// the parse running on this thread, NULL when yyparse reads from the scanner
+extern __thread struct DeclarationParse *declarationParse;
+
+// 1 when the open chunked source was parsed a declaration at a time into treeHead, 0 when it is left to yyparse
+int parseDeclarations();
+// yylex while declarationParse is set
+int nextDeclarationToken(struct Node **token);
+
+#endif
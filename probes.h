@@ -0,0 +1,57 @@
+#ifndef PROBES
+#define PROBES
+
+/*
+ * USDT probes for tracing vgo on a build host, in the sys/sdt.h format that
+ * bpftrace, perf and systemtap read. Each probe is a single nop plus a note
+ * in the binary, so it costs nothing until a tracer attaches to it.
+ *
+ *   bpftrace -l 'usdt:./vgo:vgo:*'
+ *   bpftrace -e 'usdt:./vgo:vgo:lookup__miss { @[str(arg0)] = count(); }'
+ *
+ * provider vgo, probe and arguments:
+ *   token           category, line, text
+ *   node            category, category name, number of children
+ *   symbol__insert  table name, symbol name, type
+ *   lookup__start   table name, symbol name
+ *   lookup__hit     table name, symbol name
+ *   lookup__miss    table name, symbol name
+ *   check__start    function name
+ *   check__done     function name, 1 when the check failed
+ *   error           kind ("lex", "syntax", "scope" or "type"), line or -1, message
+ *
+ * Without the systemtap headers, or built with -DVGO_NO_PROBES, the probes
+ * compile to nothing but their arguments.
+ */
+
+#if !defined(VGO_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define VGO_PROBES 1
+#endif
+#endif
+
+#ifdef VGO_PROBES
+#define PROBE_TOKEN(category, line, text) DTRACE_PROBE3(vgo, token, category, line, text)
+#define PROBE_NODE(category, name, children) DTRACE_PROBE3(vgo, node, category, name, children)
+#define PROBE_SYMBOL_INSERT(table, name, type) DTRACE_PROBE3(vgo, symbol__insert, table, name, type)
+#define PROBE_LOOKUP_START(table, name) DTRACE_PROBE2(vgo, lookup__start, table, name)
+#define PROBE_LOOKUP_HIT(table, name) DTRACE_PROBE2(vgo, lookup__hit, table, name)
+#define PROBE_LOOKUP_MISS(table, name) DTRACE_PROBE2(vgo, lookup__miss, table, name)
+#define PROBE_CHECK_START(function) DTRACE_PROBE1(vgo, check__start, function)
+#define PROBE_CHECK_DONE(function, failed) DTRACE_PROBE2(vgo, check__done, function, failed)
+#define PROBE_ERROR(kind, line, message) DTRACE_PROBE3(vgo, error, kind, line, message)
+#else
+// the arguments are still evaluated and discarded, so a value kept only for a probe is not an unused variable
+#define PROBE_TOKEN(category, line, text) ((void)(category), (void)(line), (void)(text))
+#define PROBE_NODE(category, name, children) ((void)(category), (void)(name), (void)(children))
+#define PROBE_SYMBOL_INSERT(table, name, type) ((void)(table), (void)(name), (void)(type))
+#define PROBE_LOOKUP_START(table, name) ((void)(table), (void)(name))
+#define PROBE_LOOKUP_HIT(table, name) ((void)(table), (void)(name))
+#define PROBE_LOOKUP_MISS(table, name) ((void)(table), (void)(name))
+#define PROBE_CHECK_START(function) ((void)(function))
+#define PROBE_CHECK_DONE(function, failed) ((void)(function), (void)(failed))
+#define PROBE_ERROR(kind, line, message) ((void)(kind), (void)(line), (void)(message))
+#endif
+
+#endif
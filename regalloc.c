@@ -0,0 +1,480 @@
+#include "codegen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Linear scan register allocation (Poletto and Sarkar) over one lifetime
+ * interval per SSA value. Liveness comes from walking backwards from every
+ * use to the definition, so there are no per block bit sets and the cost
+ * follows the size of the live ranges. Values live across a call only get
+ * callee saved registers; with none left the interval ending last is spilled.
+ */
+
+// set by -naive: every value gets its own stack slot, the stack machine style baseline
+int naiveCodegen = 0;
+
+// rax, rcx, rdx and r11 are scratch for the code generator, xmm0, xmm1 and xmm15 likewise
+int calleeSavedRegisters[] = {REG_RBX, REG_R12, REG_R13, REG_R14, REG_R15};
+int callerSavedRegisters[] = {REG_RSI, REG_RDI, REG_R8, REG_R9, REG_R10};
+int numberOfCalleeSaved = 5;
+int numberOfCallerSaved = 5;
+int firstFloatRegister = REG_XMM0 + 2;
+int lastFloatRegister = REG_XMM0 + 14;
+
+struct Interval
+{
+    struct IrInstr *value;
+    int start;
+    int end;
+    int crossesCall;
+    int isFloat;
+};
+
+int isCalleeSavedRegister(int reg)
+{
+    int i = 0;
+    for (i = 0; i < numberOfCalleeSaved; i++)
+    {
+        if (calleeSavedRegisters[i] == reg)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int isIrCallPoint(struct IrInstr *instr)
+{
+    // instructions whose code calls out and clobbers the caller saved registers
+    switch (instr->op)
+    {
+    case IR_CALL:
+    case IR_PRINT:
+    case IR_NOW:
+    case IR_RANDN:
+        return 1;
+
+    case IR_ADD:
+        return instr->type == IR_STRING;
+
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        return instr->args[0]->type == IR_STRING;
+
+    case IR_ZERO:
+    case IR_COPY:
+        return instr->ival > INLINE_COPY_LIMIT;
+
+    default:
+        return 0;
+    }
+}
+
+int isIrRematerialized(struct IrInstr *value)
+{
+    // constants and fixed addresses are recomputed at each use instead of taking a register
+    switch (value->op)
+    {
+    case IR_CONST:
+    case IR_SLOT:
+    case IR_GLOBAL:
+        return 1;
+
+    case IR_FIELD:
+        return isIrRematerialized(value->args[0]);
+
+    default:
+        return 0;
+    }
+}
+
+int isFusedCompare(struct IrInstr *instr)
+{
+    // an integer compare used only by the branch right after it becomes cmp plus a conditional jump
+    if (instr->op < IR_EQ || instr->op > IR_GE || instr->numberOfUsers != 1)
+    {
+        return 0;
+    }
+    if (instr->args[0]->type == IR_FLOAT || instr->args[0]->type == IR_STRING)
+    {
+        return 0;
+    }
+    return instr->next != NULL && instr->next == instr->users[0] && instr->next->op == IR_BRANCH;
+}
+
+void splitIrCriticalEdges(struct IrFunction *function)
+{
+    // phi copies go at the end of the predecessor, so a branch cannot lead straight to phis
+    int count = function->numberOfBlocks;
+    int i = 0;
+    for (i = 0; i < count; i++)
+    {
+        struct IrBlock *block = function->blocks[i];
+        int j = 0;
+        if (block->last == NULL || block->last->op != IR_BRANCH)
+        {
+            continue;
+        }
+        for (j = 0; j < 2; j++)
+        {
+            struct IrBlock *target = block->last->target[j];
+            int k = 0;
+            if (target->first == NULL || target->first->op != IR_PHI)
+            {
+                continue;
+            }
+            struct IrBlock *middle = createIrBlock(function);
+            struct IrInstr *jump = createIrInstr(IR_JUMP, IR_VOID);
+            jump->target[0] = target;
+            jump->line = block->last->line;
+            appendIrInstr(middle, jump);
+            addIrPred(middle, block);
+            for (k = 0; k < target->numberOfPreds; k++)
+            {
+                if (target->preds[k] == block)
+                {
+                    target->preds[k] = middle;
+                    break;
+                }
+            }
+            block->last->target[j] = middle;
+        }
+    }
+}
+
+void orderIrBlocks(struct IrFunction *function, struct Allocation *allocation)
+{
+    // reverse postorder keeps loop bodies together and definitions ahead of uses
+    int n = function->numberOfBlocks;
+    int count = 0;
+    int top = 0;
+    int i = 0;
+    struct IrBlock **stack = malloc(n * sizeof(struct IrBlock *));
+    int *edge = malloc(n * sizeof(int));
+    allocation->order = malloc(n * sizeof(struct IrBlock *));
+    allocation->numberOfBlocks = n;
+    for (i = 0; i < n; i++)
+    {
+        function->blocks[i]->mark = 0;
+    }
+    stack[top] = function->blocks[0];
+    edge[top] = 0;
+    function->blocks[0]->mark = 1;
+    top++;
+    while (top > 0)
+    {
+        struct IrBlock *block = stack[top - 1];
+        if (edge[top - 1] < numberOfIrSuccs(block))
+        {
+            // visit the false side first so the true side ends up right after the branch
+            int index = numberOfIrSuccs(block) - 1 - edge[top - 1];
+            struct IrBlock *succ = irSucc(block, index);
+            edge[top - 1]++;
+            if (!succ->mark)
+            {
+                succ->mark = 1;
+                stack[top] = succ;
+                edge[top] = 0;
+                top++;
+            }
+        }
+        else
+        {
+            count++;
+            allocation->order[n - count] = block;
+            top--;
+        }
+    }
+    // unreachable blocks were removed by the optimizer, so every block was seen
+    for (i = 0; i < n; i++)
+    {
+        allocation->order[i]->mark = i;
+    }
+    free(stack);
+    free(edge);
+}
+
+int compareIntervals(const void *left, const void *right)
+{
+    const struct Interval *a = left;
+    const struct Interval *b = right;
+    if (a->start != b->start)
+    {
+        return a->start < b->start ? -1 : 1;
+    }
+    return a->value->id - b->value->id;
+}
+
+void extendInterval(struct Interval *interval, int position)
+{
+    if (position < interval->start)
+    {
+        interval->start = position;
+    }
+    if (position > interval->end)
+    {
+        interval->end = position;
+    }
+}
+
+void spillInterval(struct Allocation *allocation, struct Interval *interval)
+{
+    struct Location *location = &allocation->locations[interval->value->id];
+    location->kind = LOCATION_STACK;
+    location->reg = -1;
+    location->offset = allocation->numberOfSpillSlots++;
+}
+
+void allocateRegisters(struct IrFunction *function, struct Allocation *allocation)
+{
+    int n = function->nextValueId;
+    int i = 0;
+    allocation->locations = calloc(n + 1, sizeof(struct Location));
+    allocation->fused = calloc(n + 1, 1);
+    allocation->numberOfSpillSlots = 0;
+    allocation->usedCalleeSaved = 0;
+    orderIrBlocks(function, allocation);
+
+    // number the instructions in emission order, two apart
+    int numberOfBlocks = allocation->numberOfBlocks;
+    int *blockStart = malloc(numberOfBlocks * sizeof(int));
+    int *blockEnd = malloc(numberOfBlocks * sizeof(int));
+    int *position = malloc((n + 1) * sizeof(int));
+    int numberOfValues = 0;
+    int next = 0;
+    for (i = 0; i < numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = allocation->order[i]->first;
+        blockStart[i] = next;
+        while (instr != NULL)
+        {
+            position[instr->id] = next;
+            next += 2;
+            if (!naiveCodegen && isFusedCompare(instr))
+            {
+                allocation->fused[instr->id] = 1;
+            }
+            if (instr->type != IR_VOID && !isIrRematerialized(instr) && !allocation->fused[instr->id])
+            {
+                numberOfValues++;
+            }
+            instr = instr->next;
+        }
+        blockEnd[i] = next - 2;
+    }
+    // calls before each position, to ask whether an interval spans one
+    int *callsBefore = calloc(next + 2, sizeof(int));
+    for (i = 0; i < numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = allocation->order[i]->first;
+        while (instr != NULL)
+        {
+            if (isIrCallPoint(instr))
+            {
+                callsBefore[position[instr->id] + 1] = 1;
+            }
+            instr = instr->next;
+        }
+    }
+    for (i = 1; i < next + 2; i++)
+    {
+        callsBefore[i] += callsBefore[i - 1];
+    }
+
+    struct Interval *intervals = malloc((numberOfValues + 1) * sizeof(struct Interval));
+    int count = 0;
+    int *visited = malloc(numberOfBlocks * sizeof(int));
+    struct IrBlock **worklist = malloc((numberOfBlocks + 1) * sizeof(struct IrBlock *));
+    for (i = 0; i < numberOfBlocks; i++)
+    {
+        visited[i] = -1;
+    }
+    for (i = 0; i < numberOfBlocks; i++)
+    {
+        struct IrInstr *value = allocation->order[i]->first;
+        for (; value != NULL; value = value->next)
+        {
+            if (value->type == IR_VOID || isIrRematerialized(value) || allocation->fused[value->id])
+            {
+                continue;
+            }
+            struct Interval *interval = &intervals[count++];
+            int definition = value->block->mark;
+            int top = 0;
+            int u = 0;
+            interval->value = value;
+            interval->start = value->op == IR_PHI ? blockStart[definition] : position[value->id];
+            interval->end = interval->start;
+            interval->isFloat = value->type == IR_FLOAT;
+            if (naiveCodegen)
+            {
+                continue;
+            }
+            for (u = 0; u < value->numberOfUsers; u++)
+            {
+                struct IrInstr *user = value->users[u];
+                int k = 0;
+                if (user->op == IR_PHI)
+                {
+                    // a phi operand is read at the end of the matching predecessor
+                    for (k = 0; k < user->numberOfArgs; k++)
+                    {
+                        struct IrBlock *pred = user->block->preds[k];
+                        if (user->args[k] != value)
+                        {
+                            continue;
+                        }
+                        extendInterval(interval, blockEnd[pred->mark]);
+                        if (pred->mark != definition && visited[pred->mark] != value->id)
+                        {
+                            visited[pred->mark] = value->id;
+                            worklist[top++] = pred;
+                        }
+                    }
+                    continue;
+                }
+                extendInterval(interval, position[user->id]);
+                if (user->block->mark != definition && visited[user->block->mark] != value->id)
+                {
+                    visited[user->block->mark] = value->id;
+                    worklist[top++] = user->block;
+                }
+            }
+            // every block on a path back to the definition has the value live throughout
+            while (top > 0)
+            {
+                struct IrBlock *block = worklist[--top];
+                extendInterval(interval, blockStart[block->mark]);
+                for (u = 0; u < block->numberOfPreds; u++)
+                {
+                    struct IrBlock *pred = block->preds[u];
+                    extendInterval(interval, blockEnd[pred->mark]);
+                    if (pred->mark != definition && visited[pred->mark] != value->id)
+                    {
+                        visited[pred->mark] = value->id;
+                        worklist[top++] = pred;
+                    }
+                }
+            }
+            interval->crossesCall = callsBefore[interval->end] - callsBefore[interval->start + 1] > 0;
+        }
+    }
+    free(visited);
+    free(worklist);
+
+    if (naiveCodegen)
+    {
+        for (i = 0; i < count; i++)
+        {
+            spillInterval(allocation, &intervals[i]);
+        }
+    }
+    else
+    {
+        qsort(intervals, count, sizeof(struct Interval), compareIntervals);
+        struct Interval *active[32];
+        struct Interval *owner[32];
+        int numberOfActive = 0;
+        memset(owner, 0, sizeof(owner));
+        for (i = 0; i < count; i++)
+        {
+            struct Interval *current = &intervals[i];
+            int j = 0;
+            int chosen = -1;
+            // expire intervals that ended before this one starts
+            for (j = 0; j < numberOfActive; j++)
+            {
+                if (active[j]->end < current->start)
+                {
+                    owner[allocation->locations[active[j]->value->id].reg] = NULL;
+                    active[j] = active[--numberOfActive];
+                    j--;
+                }
+            }
+            if (current->isFloat)
+            {
+                // every xmm register is caller saved
+                for (j = firstFloatRegister; j <= lastFloatRegister && !current->crossesCall && chosen < 0; j++)
+                {
+                    if (owner[j] == NULL)
+                    {
+                        chosen = j;
+                    }
+                }
+            }
+            else
+            {
+                // short lived values take the caller saved registers that cost nothing to use
+                for (j = 0; j < numberOfCallerSaved && !current->crossesCall && chosen < 0; j++)
+                {
+                    if (owner[callerSavedRegisters[j]] == NULL)
+                    {
+                        chosen = callerSavedRegisters[j];
+                    }
+                }
+                for (j = 0; j < numberOfCalleeSaved && chosen < 0; j++)
+                {
+                    if (owner[calleeSavedRegisters[j]] == NULL)
+                    {
+                        chosen = calleeSavedRegisters[j];
+                    }
+                }
+            }
+            if (chosen < 0)
+            {
+                // take the register of the usable interval that lives longest, if it outlives this one
+                struct Interval *victim = NULL;
+                int victimIndex = -1;
+                for (j = 0; j < numberOfActive; j++)
+                {
+                    int reg = allocation->locations[active[j]->value->id].reg;
+                    if (active[j]->isFloat != current->isFloat || (current->crossesCall && !isCalleeSavedRegister(reg)))
+                    {
+                        continue;
+                    }
+                    if (victim == NULL || active[j]->end > victim->end)
+                    {
+                        victim = active[j];
+                        victimIndex = j;
+                    }
+                }
+                if (victim == NULL || victim->end <= current->end)
+                {
+                    spillInterval(allocation, current);
+                    continue;
+                }
+                chosen = allocation->locations[victim->value->id].reg;
+                spillInterval(allocation, victim);
+                active[victimIndex] = active[--numberOfActive];
+            }
+            allocation->locations[current->value->id].kind = LOCATION_REGISTER;
+            allocation->locations[current->value->id].reg = chosen;
+            owner[chosen] = current;
+            active[numberOfActive++] = current;
+            if (isCalleeSavedRegister(chosen))
+            {
+                allocation->usedCalleeSaved |= 1 << chosen;
+            }
+        }
+    }
+    free(intervals);
+    free(callsBefore);
+    free(position);
+    free(blockStart);
+    free(blockEnd);
+}
+
+void freeAllocation(struct Allocation *allocation)
+{
+    free(allocation->locations);
+    free(allocation->fused);
+    free(allocation->order);
+    allocation->locations = NULL;
+    allocation->fused = NULL;
+    allocation->order = NULL;
+}
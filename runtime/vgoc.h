@@ -0,0 +1,98 @@
+#ifndef VGOC
+#define VGOC
+
+/*
+ * Support for the C99 that vgo -emit-c writes. The generated file includes
+ * this header and links with vgort.c like native code does. Integer
+ * arithmetic goes through unsigned so it wraps as in Go instead of being
+ * undefined, and division keeps Go's panics and its answer for the most
+ * negative int divided by -1.
+ */
+
+#include "vgort.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VGO_ADD(a, b) ((long long)((unsigned long long)(a) + (unsigned long long)(b)))
+#define VGO_SUB(a, b) ((long long)((unsigned long long)(a) - (unsigned long long)(b)))
+#define VGO_MUL(a, b) ((long long)((unsigned long long)(a) * (unsigned long long)(b)))
+#define VGO_NEG(a) ((long long)(0ULL - (unsigned long long)(a)))
+
+static inline long long vgoDivide(long long left, long long right)
+{
+    if (right == 0)
+    {
+        vgoPanicDivide();
+    }
+    if (right == -1)
+    {
+        return VGO_NEG(left);
+    }
+    return left / right;
+}
+
+static inline long long vgoModulo(long long left, long long right)
+{
+    if (right == 0)
+    {
+        vgoPanicDivide();
+    }
+    if (right == -1)
+    {
+        return 0;
+    }
+    return left % right;
+}
+
+static inline long long vgoFloatToInt(double value)
+{
+    // out of range and NaN give the most negative int, as cvttsd2si does
+    if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0))
+    {
+        return -9223372036854775807LL - 1;
+    }
+    return (long long)value;
+}
+
+static inline void vgoCheckIndex(long long index, long long length)
+{
+    if ((unsigned long long)index >= (unsigned long long)length)
+    {
+        vgoPanicIndex(index, length);
+    }
+}
+
+static inline struct VgoPrintOperand vgoPrintInt(long long value)
+{
+    struct VgoPrintOperand operand;
+    operand.kind = VGO_INT;
+    operand.bits = value;
+    return operand;
+}
+
+static inline struct VgoPrintOperand vgoPrintFloat(double value)
+{
+    struct VgoPrintOperand operand;
+    operand.kind = VGO_FLOAT;
+    memcpy(&operand.bits, &value, sizeof(double));
+    return operand;
+}
+
+static inline struct VgoPrintOperand vgoPrintBool(long long value)
+{
+    struct VgoPrintOperand operand;
+    operand.kind = VGO_BOOL;
+    operand.bits = value != 0;
+    return operand;
+}
+
+static inline struct VgoPrintOperand vgoPrintString(char *value)
+{
+    struct VgoPrintOperand operand;
+    operand.kind = VGO_STRING;
+    operand.bits = (long long)(size_t)value;
+    return operand;
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include "vgort.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// math/rand without a Seed call is deterministic, so is this generator
+unsigned long long vgoRandomState = 1;
+
+#ifndef VGO_EMBEDDED
+// vgo links this file into itself to back -run and leaves main out
+int main(void)
+{
+    static char outputBuffer[1 << 16];
+    setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+    vgo_main();
+    fflush(stdout);
+    return 0;
+}
+#endif
+
+void vgoPanic(const char *message)
+{
+    fflush(stdout);
+    fprintf(stderr, "panic: %s\n", message);
+    exit(2);
+}
+
+void vgoFormatFloat(double value, char *buffer)
+{
+    // the shortest digits that read back as the same value, laid out like Go's %v
+    char digits[48];
+    char mantissa[24];
+    int precision = 1;
+    int length = 0;
+    int i = 0;
+    if (isnan(value))
+    {
+        strcpy(buffer, "NaN");
+        return;
+    }
+    if (isinf(value))
+    {
+        strcpy(buffer, value > 0 ? "+Inf" : "-Inf");
+        return;
+    }
+    if (value == 0)
+    {
+        strcpy(buffer, signbit(value) ? "-0" : "0");
+        return;
+    }
+    for (precision = 1; precision < 17; precision++)
+    {
+        snprintf(digits, sizeof(digits), "%.*e", precision - 1, value);
+        if (strtod(digits, NULL) == value)
+        {
+            break;
+        }
+    }
+    snprintf(digits, sizeof(digits), "%.*e", precision - 1, value);
+
+    char *cursor = digits;
+    if (*cursor == '-')
+    {
+        *buffer++ = '-';
+        cursor++;
+    }
+    for (; *cursor != 'e'; cursor++)
+    {
+        if (*cursor != '.')
+        {
+            mantissa[length++] = *cursor;
+        }
+    }
+    int exponent = atoi(cursor + 1);
+    while (length > 1 && mantissa[length - 1] == '0')
+    {
+        length--;
+    }
+
+    if (exponent < -4 || exponent >= 6)
+    {
+        *buffer++ = mantissa[0];
+        if (length > 1)
+        {
+            *buffer++ = '.';
+            memcpy(buffer, mantissa + 1, length - 1);
+            buffer += length - 1;
+        }
+        sprintf(buffer, "e%c%02d", exponent < 0 ? '-' : '+', exponent < 0 ? -exponent : exponent);
+    }
+    else if (exponent < 0)
+    {
+        *buffer++ = '0';
+        *buffer++ = '.';
+        for (i = 0; i < -exponent - 1; i++)
+        {
+            *buffer++ = '0';
+        }
+        memcpy(buffer, mantissa, length);
+        buffer[length] = '\0';
+    }
+    else
+    {
+        for (i = 0; i <= exponent; i++)
+        {
+            *buffer++ = i < length ? mantissa[i] : '0';
+        }
+        if (length > exponent + 1)
+        {
+            *buffer++ = '.';
+            memcpy(buffer, mantissa + exponent + 1, length - exponent - 1);
+            buffer += length - exponent - 1;
+        }
+        *buffer = '\0';
+    }
+}
+
+void vgoPrintln(long long count, struct VgoPrintOperand *operands)
+{
+    char number[64];
+    long long i = 0;
+    for (i = 0; i < count; i++)
+    {
+        double value = 0;
+        if (i > 0)
+        {
+            putchar(' ');
+        }
+        switch (operands[i].kind)
+        {
+        case VGO_FLOAT:
+            memcpy(&value, &operands[i].bits, sizeof(double));
+            vgoFormatFloat(value, number);
+            fputs(number, stdout);
+            break;
+
+        case VGO_BOOL:
+            fputs(operands[i].bits ? "true" : "false", stdout);
+            break;
+
+        case VGO_STRING:
+            if (operands[i].bits != 0)
+            {
+                fputs((const char *)operands[i].bits, stdout);
+            }
+            break;
+
+        default:
+            printf("%lld", operands[i].bits);
+            break;
+        }
+    }
+    putchar('\n');
+}
+
+long long vgoCompareStrings(const char *left, const char *right)
+{
+    return strcmp(left != NULL ? left : "", right != NULL ? right : "");
+}
+
+char *vgoConcatStrings(const char *left, const char *right)
+{
+    // there is no collector, concatenations live until exit
+    size_t leftLength = left != NULL ? strlen(left) : 0;
+    size_t rightLength = right != NULL ? strlen(right) : 0;
+    char *result = malloc(leftLength + rightLength + 1);
+    if (result == NULL)
+    {
+        vgoPanic("runtime error: out of memory");
+    }
+    memcpy(result, left, leftLength);
+    memcpy(result + leftLength, right, rightLength);
+    result[leftLength + rightLength] = '\0';
+    return result;
+}
+
+long long vgoNow(void)
+{
+    // time.Now as nanoseconds since the epoch
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+unsigned long long vgoRandomNext(void)
+{
+    // splitmix64
+    unsigned long long z = (vgoRandomState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+long long vgoRandIntn(long long n)
+{
+    if (n <= 0)
+    {
+        vgoPanic("invalid argument to Intn");
+    }
+    // reject the top partial range so every result is equally likely
+    unsigned long long limit = ~0ULL - (~0ULL % (unsigned long long)n);
+    unsigned long long draw = vgoRandomNext();
+    while (draw >= limit)
+    {
+        draw = vgoRandomNext();
+    }
+    return (long long)(draw % (unsigned long long)n);
+}
+
+void vgoPanicDivide(void)
+{
+    vgoPanic("runtime error: integer divide by zero");
+}
+
+void vgoPanicIndex(long long index, long long length)
+{
+    char message[96];
+    snprintf(message, sizeof(message), "runtime error: index out of range [%lld] with length %lld", index, length);
+    vgoPanic(message);
+}
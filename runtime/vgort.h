@@ -0,0 +1,32 @@
+#ifndef VGORT
+#define VGORT
+
+/*
+ * Runtime support for programs compiled by vgo. Generated code calls these
+ * with the System V ABI; strings are NUL terminated and NULL is "".
+ */
+
+// print operand kinds, the same numbers as the IR value types
+#define VGO_INT 1
+#define VGO_FLOAT 2
+#define VGO_BOOL 3
+#define VGO_STRING 4
+
+struct VgoPrintOperand
+{
+    long long kind;
+    long long bits;
+};
+
+void vgo_main(void);
+
+void vgoPrintln(long long count, struct VgoPrintOperand *operands);
+void vgoFormatFloat(double value, char *buffer);
+long long vgoCompareStrings(const char *left, const char *right);
+char *vgoConcatStrings(const char *left, const char *right);
+long long vgoNow(void);
+long long vgoRandIntn(long long n);
+void vgoPanicDivide(void);
+void vgoPanicIndex(long long index, long long length);
+
+#endif
@@ -9,6 +9,15 @@
 #include <string.h>
 #include <stdlib.h>
 #include "linkedlist.h"
+#include "constant.h"
+#include "workpool.h"
+#include "package.h"
+#include "trace.h"
+#include "memreport.h"
+#include "probes.h"
+#include "semanticmatch.h"
+#include <setjmp.h>
+#include <stdarg.h>
 
 struct symboltable *globalSymbolTable;
 struct symboltable *currentSymbolTable;
@@ -17,50 +26,334 @@ struct symboltable *fmtSymbolTable;
 struct symboltable *timeSymbolTable;
 struct symboltable *mathSymbolTable;
 
+// threads that type check the top-level declarations, 0 for one per processor
+int typeCheckThreads = 0;
+// identifiers scopeAnalysis could not bind, reported together once it is done
+struct Node **unresolvedNames = NULL;
+int numberOfUnresolvedNames = 0;
+int unresolvedNamesCapacity = 0;
+
+// -check=reachable, only check the bodies of functions main or an exported function can call
+int checkReachableOnly = 0;
+
+/*
+ * One top-level declaration being type checked. The declaration tables are
+ * read only while the checks run, so each declaration can be checked on its
+ * own thread with its own current scope. Diagnostics are kept here and
+ * printed in source order once every check is done; an error stops the
+ * check of its declaration by jumping back to stop.
+ */
+struct TypeContext
+{
+    struct Node *unit;
+    struct symboltable *scope;
+    char *diagnostics;
+    int diagnosticsLength;
+    int failed;
+    // printed after the message of the error
+    struct Node *errorTree;
+    struct LinkedListNode *errorList;
+    jmp_buf stop;
+};
+
 void scopeAnalysis(struct Node *treeHead);
 void checkChildren(struct Node *treeHead);
 void printChildren(struct Node *treeHead);
 void handlePackage(struct Node *treeHead);
 void handleImportPackage(struct Node *treeHead);
+void declareImportedPackage(struct ExportSummary *summary);
 void handleStruct(struct Node *treeHead);
+char *declaredFunctionName(struct Node *treeHead);
 void handleFunctionDeclaration(struct Node *treeHead);
 void handleVariableDeclaration(struct Node *treeHead);
-void handlePotentialStructInstance(struct Node *treeHead);
-void lookForVariableNames(struct Node *treeHead, int type, char *typeName);
+void lookForVariableNames(struct Node *treeHead, int type, char *typeName, int arraySize);
 void lookForParameterNames(struct Node *treeHead);
 void lookForReturnTypes(struct Node *treeHead);
 void handleVariableInstance(struct Node *treeHead);
+void handleSelector(struct Node *treeHead);
+struct Symbol *selectedSymbol(struct Node *treeHead, int *indexed);
+void reportUnresolvedNames();
 void lookForStructVariables(struct Node *treeHead, struct symboltable *currentStruct);
-void findConstName(struct Node *treeHead, int type, char *typeName);
 void handleConst(struct Node *treeHead);
-int typeAnalysis(struct Node *treeHead);
-int checkTypeChildren(struct Node *treeHead);
-int findTerminal(struct Node *treeHead);
+void checkTypes(struct Node *treeHead);
+char *unitFunctionName(struct Node *unit);
+int keepReachableUnits(struct TypeContext *units, int count);
+void typeWarning(struct TypeContext *context, char *format, ...);
+void typeError(struct TypeContext *context, char *format, ...);
+struct symboltable *findTypeScope(struct TypeContext *context, char *functionName);
+int typeAnalysis(struct Node *treeHead, struct TypeContext *context);
+int checkTypeChildren(struct Node *treeHead, struct TypeContext *context);
 char *getTerminalText(struct Node *treeHead);
-void checkTypeFunctionDeclaration(struct Node *treeHead);
-int checkTypeFunctionCall(struct Node *treeHead);
-void checkTypeNonDclStmt(struct Node *treeHead);
-int checkTypeExpression(struct Node *treeHead);
-int checkTypeSimpleStatement(struct Node *treeHead);
-int checkTypepexpr_no_paren(struct Node *treeHead);
-int checkTypeDefault(struct Node *treeHead);
-void checkForHeader(struct Node *treeHead);
-
-struct LinkedListNode *checkParameterTypes(struct symboltable *functionSymbolTable, struct LinkedListNode *listHead, struct Node *treeHead);
-int arraySize = -1;
+void checkTypeFunctionDeclaration(struct Node *treeHead, struct TypeContext *context);
+int checkTypeFunctionCall(struct Node *treeHead, struct TypeContext *context);
+void checkTypeNonDclStmt(struct Node *treeHead, struct TypeContext *context);
+int checkTypeExpression(struct Node *treeHead, struct TypeContext *context);
+int checkTypeUnary(struct Node *treeHead, struct TypeContext *context);
+int checkTypeParenthesized(struct Node *treeHead, struct TypeContext *context);
+int checkTypeSimpleStatement(struct Node *treeHead, struct TypeContext *context);
+int checkTypepexpr_no_paren(struct Node *treeHead, struct TypeContext *context);
+int checkTypeDefault(struct Node *treeHead, struct TypeContext *context);
+void checkForHeader(struct Node *treeHead, struct TypeContext *context);
+
+struct LinkedListNode *checkParameterTypes(struct LinkedListNode *listHead, struct Node *treeHead, struct TypeContext *context);
 
 void beginSemanticAnalysis(struct Node *treeHead)
 {
+    double start = traceEnabled ? traceClock() : 0;
     globalSymbolTable = createSymbolTable("Global Scope", NULL);
     currentSymbolTable = globalSymbolTable;
     scopeAnalysis(treeHead);
+    reportUnresolvedNames();
+    if (traceEnabled)
+    {
+        traceSpan("semantic", "scope analysis", start, NULL);
+        traceCounter("symbols", liveAllocations(MEM_SYMBOL));
+    }
     if (printCode == 3)
     {
         printSymbolTable(globalSymbolTable);
         printFunctionSymbolTable();
         printStructSymbolTable();
     }
-    typeAnalysis(treeHead);
+    start = traceEnabled ? traceClock() : 0;
+    checkTypes(treeHead);
+    if (traceEnabled)
+    {
+        traceSpan("semantic", "type analysis", start, NULL);
+    }
+    start = traceEnabled ? traceClock() : 0;
+    currentSymbolTable = globalSymbolTable;
+    foldConstants(treeHead);
+    if (traceEnabled)
+    {
+        traceSpan("semantic", "constant folding", start, NULL);
+    }
+}
+
+void collectTypeUnits(struct Node *treeHead, struct TypeContext **units, int *count, int *capacity)
+{
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (treeHead->category == file || treeHead->category == xdcl_list)
+    {
+        for (i = 0; i < treeHead->numberOfChildren; i++)
+        {
+            collectTypeUnits(treeHead->children[i], units, count, capacity);
+        }
+        return;
+    }
+    if (*count == *capacity)
+    {
+        *capacity = *capacity == 0 ? 64 : *capacity * 2;
+        *units = realloc(*units, *capacity * sizeof(struct TypeContext));
+    }
+    memset(&(*units)[*count], 0, sizeof(struct TypeContext));
+    (*units)[*count].unit = treeHead;
+    (*units)[*count].scope = globalSymbolTable;
+    (*count)++;
+}
+
+void checkTypeUnit(int index, void *units)
+{
+    struct TypeContext *context = &((struct TypeContext *)units)[index];
+    char *functionName = unitFunctionName(context->unit);
+    if (functionName != NULL)
+    {
+        PROBE_CHECK_START(functionName);
+    }
+    if (setjmp(context->stop) == 0)
+    {
+        typeAnalysis(context->unit, context);
+    }
+    if (functionName != NULL)
+    {
+        PROBE_CHECK_DONE(functionName, context->failed);
+    }
+}
+
+void checkTypes(struct Node *treeHead)
+{
+    struct TypeContext *units = NULL;
+    int count = 0;
+    int capacity = 0;
+    int i = 0;
+    collectTypeUnits(treeHead, &units, &count, &capacity);
+    if (checkReachableOnly)
+    {
+        count = keepReachableUnits(units, count);
+    }
+
+    setSymbolTablesReadOnly(1);
+    runWorkPool(count, typeCheckThreads > 0 ? typeCheckThreads : defaultWorkThreads(), checkTypeUnit, units);
+    setSymbolTablesReadOnly(0);
+
+    // the output a serial check would give: everything up to the first error, then stop
+    for (i = 0; i < count; i++)
+    {
+        struct TypeContext *context = &units[i];
+        if (context->diagnostics != NULL)
+        {
+            fputs(context->diagnostics, stdout);
+        }
+        if (context->failed)
+        {
+            if (context->errorList != NULL)
+            {
+                printLinkedList(context->errorList);
+            }
+            if (context->errorTree != NULL)
+            {
+                treeprint(context->errorTree, 0);
+            }
+            exit(3);
+        }
+        free(context->diagnostics);
+    }
+    free(units);
+}
+
+// the name of a function declaration, NULL for the other top-level declarations
+char *unitFunctionName(struct Node *unit)
+{
+    struct FunctionDeclarationMatch match;
+    if (matchFunctionDeclaration(unit, &match) != 0)
+    {
+        return match.name->data->text;
+    }
+    return NULL;
+}
+
+struct UnitName
+{
+    char *name;
+    int index;
+};
+
+int compareUnitNames(const void *first, const void *second)
+{
+    return strcmp(((struct UnitName *)first)->name, ((struct UnitName *)second)->name);
+}
+
+// mark the functions called in treeHead that are not yet reachable and push them on pending
+void markCalledUnits(struct Node *treeHead, struct UnitName *names, int numberOfNames, char *reachable, int *pending, int *numberOfPending)
+{
+    struct CallMatch call;
+    int i = 0;
+    if (treeHead == NULL)
+    {
+        return;
+    }
+    if (matchCall(treeHead, &call) == CALL_DIRECT)
+    {
+        struct UnitName key;
+        key.name = call.callee->data->text;
+        struct UnitName *callee = bsearch(&key, names, numberOfNames, sizeof(struct UnitName), compareUnitNames);
+        if (callee != NULL && !reachable[callee->index])
+        {
+            reachable[callee->index] = 1;
+            pending[(*numberOfPending)++] = callee->index;
+        }
+    }
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        markCalledUnits(treeHead->children[i], names, numberOfNames, reachable, pending, numberOfPending);
+    }
+}
+
+/*
+ * Drops the functions no check could reach from units, keeping the order of
+ * the rest, and returns how many are left. The calls in each reached body
+ * are the edges of the call graph; main, the exported functions and every
+ * declaration that is not a function (a global may be initialized by a
+ * call) are where the walk starts.
+ */
+int keepReachableUnits(struct TypeContext *units, int count)
+{
+    struct UnitName *names = malloc((count + 1) * sizeof(struct UnitName));
+    char *reachable = calloc(count + 1, 1);
+    int *pending = malloc((count + 1) * sizeof(int));
+    int numberOfNames = 0;
+    int numberOfPending = 0;
+    int kept = 0;
+    int i = 0;
+    for (i = 0; i < count; i++)
+    {
+        char *name = unitFunctionName(units[i].unit);
+        if (name == NULL || strcmp(name, "main") == 0 || isExportedName(name))
+        {
+            reachable[i] = 1;
+            pending[numberOfPending++] = i;
+        }
+        if (name != NULL)
+        {
+            names[numberOfNames].name = name;
+            names[numberOfNames].index = i;
+            numberOfNames++;
+        }
+    }
+    qsort(names, numberOfNames, sizeof(struct UnitName), compareUnitNames);
+
+    while (numberOfPending > 0)
+    {
+        markCalledUnits(units[pending[--numberOfPending]].unit, names, numberOfNames, reachable, pending, &numberOfPending);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (reachable[i])
+        {
+            units[kept++] = units[i];
+        }
+    }
+    fprintf(stderr, "-check=reachable skipped %d of %d function bodies\n", count - kept, numberOfNames);
+    free(names);
+    free(reachable);
+    free(pending);
+    return kept;
+}
+
+void addTypeDiagnostic(struct TypeContext *context, char *format, va_list arguments)
+{
+    va_list measure;
+    va_copy(measure, arguments);
+    int length = vsnprintf(NULL, 0, format, measure);
+    va_end(measure);
+    context->diagnostics = realloc(context->diagnostics, context->diagnosticsLength + length + 1);
+    vsnprintf(context->diagnostics + context->diagnosticsLength, length + 1, format, arguments);
+    context->diagnosticsLength += length;
+}
+
+void typeWarning(struct TypeContext *context, char *format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    addTypeDiagnostic(context, format, arguments);
+    va_end(arguments);
+}
+
+void typeError(struct TypeContext *context, char *format, ...)
+{
+    va_list arguments;
+    int length = context->diagnosticsLength;
+    va_start(arguments, format);
+    addTypeDiagnostic(context, format, arguments);
+    va_end(arguments);
+    PROBE_ERROR("type", -1, context->diagnostics + length);
+    context->failed = 1;
+    longjmp(context->stop, 1);
+}
+
+struct symboltable *findTypeScope(struct TypeContext *context, char *functionName)
+{
+    struct symboltable *table = lookupSymbolTable(functionName);
+    if (table == NULL)
+    {
+        typeError(context, "Unable to find function symbol table '%s'\n", functionName);
+    }
+    return table;
 }
 
 void scopeAnalysis(struct Node *treeHead)
@@ -97,6 +390,10 @@ void scopeAnalysis(struct Node *treeHead)
             handleVariableInstance(treeHead);
             break;
 
+        case pexpr_no_paren:
+            handleSelector(treeHead);
+            break;
+
         default:
             checkChildren(treeHead);
             break;
@@ -104,7 +401,7 @@ void scopeAnalysis(struct Node *treeHead)
     }
 }
 
-int typeAnalysis(struct Node *treeHead)
+int typeAnalysis(struct Node *treeHead, struct TypeContext *context)
 {
 
     if (treeHead != NULL)
@@ -112,35 +409,43 @@ int typeAnalysis(struct Node *treeHead)
         switch (treeHead->category)
         {
         case xfndcl:
-            checkTypeFunctionDeclaration(treeHead);
+            checkTypeFunctionDeclaration(treeHead, context);
             break;
 
         case pseudocall:
-            return checkTypeFunctionCall(treeHead);
+            return checkTypeFunctionCall(treeHead, context);
             break;
 
         case non_dcl_stmt:
-            checkTypeNonDclStmt(treeHead);
+            checkTypeNonDclStmt(treeHead, context);
             break;
 
         case expr:
-            return checkTypeExpression(treeHead);
+            return checkTypeExpression(treeHead, context);
             break;
 
         case simple_stmt:
-            return checkTypeSimpleStatement(treeHead);
+            return checkTypeSimpleStatement(treeHead, context);
             break;
 
         case pexpr_no_paren:
-            checkTypepexpr_no_paren(treeHead);
+            return checkTypepexpr_no_paren(treeHead, context);
+            break;
+
+        case pexpr:
+            return checkTypeParenthesized(treeHead, context);
+            break;
+
+        case uexpr:
+            return checkTypeUnary(treeHead, context);
             break;
 
         case for_header:
-            checkForHeader(treeHead);
+            checkForHeader(treeHead, context);
             break;
 
         default:
-            return checkTypeDefault(treeHead);
+            return checkTypeDefault(treeHead, context);
             break;
         }
     }
@@ -148,39 +453,33 @@ int typeAnalysis(struct Node *treeHead)
     return -1;
 }
 
-struct LinkedListNode *checkParameterTypes(struct symboltable *functionSymbolTable, struct LinkedListNode *listHead, struct Node *treeHead)
+// the type of each argument of a call, in order
+struct LinkedListNode *checkParameterTypes(struct LinkedListNode *listHead, struct Node *treeHead, struct TypeContext *context)
 {
 
     if (treeHead == NULL)
     {
         // do nothing
     }
-    else if (treeHead->numberOfChildren > 0)
+    else if (treeHead->category == expr_or_type_list)
     {
         int i = 0;
         for (i = 0; i < treeHead->numberOfChildren; i++)
         {
 
-            listHead = checkParameterTypes(functionSymbolTable, listHead, treeHead->children[i]);
+            listHead = checkParameterTypes(listHead, treeHead->children[i], context);
         }
     }
-    else if (treeHead->data->category == COMA)
-    {
-        // do nothing we have a ,
-    }
     else
     {
         struct Symbol *newData = calloc(1, sizeof(struct Symbol));
-        if (treeHead->data->category == NUMERICLITERAL)
+        newData->type = typeAnalysis(treeHead, context);
+        if (findTypeCategory(newData->type) > 0)
         {
-            newData->type = INT;
+            // a literal argument has the type of its kind of literal
+            newData->type = findTypeCategory(newData->type);
         }
-        else
-        {
-
-            newData->type = treeHead->data->category;
-        }
-        newData->name = treeHead->data->text;
+        newData->name = getTerminalText(treeHead);
         newData->typeName = findTypeName(newData->type);
         newData->arraySize = -1;
         newData->isConst = 0;
@@ -189,20 +488,20 @@ struct LinkedListNode *checkParameterTypes(struct symboltable *functionSymbolTab
     return listHead;
 }
 
-int checkTypeChildren(struct Node *treeHead)
+int checkTypeChildren(struct Node *treeHead, struct TypeContext *context)
 {
     int i = 0;
     if (treeHead != NULL)
     {
         if (treeHead->numberOfChildren == 1)
         {
-            return typeAnalysis(treeHead->children[0]);
+            return typeAnalysis(treeHead->children[0], context);
         }
         else
         {
             for (i = 0; i < treeHead->numberOfChildren; i++)
             {
-                int currentType = typeAnalysis(treeHead->children[i]);
+                int currentType = typeAnalysis(treeHead->children[i], context);
                 if (currentType > 0)
                 {
                 }
@@ -212,30 +511,6 @@ int checkTypeChildren(struct Node *treeHead)
     return -1;
 }
 
-int findTerminal(struct Node *treeHead)
-{
-    if (treeHead == NULL)
-    {
-        return -1;
-    }
-    else if (treeHead->numberOfChildren > 0)
-    {
-        return findTerminal(treeHead->children[0]);
-    }
-    else if (treeHead->data->category == LNAME)
-    {
-        return findTypeInSymbolTable(currentSymbolTable, treeHead->data->text);
-    }
-    else
-    {
-        if (treeHead->data->category == NUMERICLITERAL)
-        {
-            return INT;
-        }
-        return treeHead->data->category;
-    }
-}
-
 void checkChildren(struct Node *treeHead)
 {
     if (treeHead->numberOfChildren > 0)
@@ -269,17 +544,31 @@ void printChildren(struct Node *treeHead)
 
 void handlePackage(struct Node *treeHead)
 {
-    char *packageName = strdup(treeHead->children[1]->data->text);
-    if (strcmp(packageName, "main") != 0)
+    struct PackageMatch match;
+    if (matchPackage(treeHead, &match) == PACKAGE_NAMED && !packageBuild && strcmp(match.name->data->text, "main") != 0)
     {
-        printf("Package name must be main in VGo instead found '%s' at %s:%d\n", treeHead->children[1]->data->text, currentfile, treeHead->children[1]->data->linenumber);
+        printf("Package name must be main in VGo instead found '%s' at %s:%d\n", match.name->data->text, currentfile, match.name->data->linenumber);
         exit(3);
     }
 }
 
 void handleImportPackage(struct Node *treeHead)
 {
-    if (strcmp(treeHead->children[0]->data->sval, "fmt") == 0)
+    struct ImportMatch match;
+    switch (matchImport(treeHead, &match))
+    {
+    case IMPORT_PATH:
+        break;
+
+    case IMPORT_ALIASED:
+        printf("Import names are not supported in VGo, found one for %s at %s:%d\n", match.path->data->text, currentfile, match.path->data->linenumber);
+        exit(3);
+
+    default:
+        return;
+    }
+    char *path = match.path->data->sval;
+    if (strcmp(path, "fmt") == 0)
     {
         fmtSymbolTable = createStructTable("fmt", globalSymbolTable);
         int index = calculateHashKey("Println");
@@ -290,7 +579,7 @@ void handleImportPackage(struct Node *treeHead)
         newData->typeName = "function";
         fmtSymbolTable->hash[index] = addToFront(newData, fmtSymbolTable->hash[index]);
     }
-    else if (strcmp(treeHead->children[0]->data->sval, "time") == 0)
+    else if (strcmp(path, "time") == 0)
     {
         timeSymbolTable = createStructTable("time", globalSymbolTable);
         int index = calculateHashKey("Now");
@@ -301,7 +590,7 @@ void handleImportPackage(struct Node *treeHead)
         newData->typeName = "function";
         timeSymbolTable->hash[index] = addToFront(newData, timeSymbolTable->hash[index]);
     }
-    else if (strcmp(treeHead->children[0]->data->sval, "math/rand") == 0)
+    else if (strcmp(path, "math/rand") == 0)
     {
         mathSymbolTable = createStructTable("math/rand", globalSymbolTable);
         int index = calculateHashKey("Intn");
@@ -314,110 +603,201 @@ void handleImportPackage(struct Node *treeHead)
     }
     else
     {
-        printf("The following package %s is not supported in VGo\n", treeHead->children[0]->data->text);
-        exit(3);
+        // a package built with -package, known from its export summary
+        struct ExportSummary *summary = importPackage(path);
+        if (summary == NULL)
+        {
+            printf("The following package %s is not supported in VGo\n", match.path->data->text);
+            exit(3);
+        }
+        declareImportedPackage(summary);
     }
 }
 
-void handleStruct(struct Node *treeHead)
+int importedTypeCategory(char *typeName)
 {
-    if (treeHead->numberOfChildren == 2)
+    if (strcmp(typeName, "int") == 0)
+    {
+        return INT;
+    }
+    if (strcmp(typeName, "float64") == 0)
+    {
+        return FLOAT64;
+    }
+    if (strcmp(typeName, "bool") == 0)
     {
-        struct symboltable *currentStructTable = createStructTable(treeHead->children[0]->data->text, globalSymbolTable);
-        lookForStructVariables(treeHead->children[1], currentStructTable);
+        return BOOL;
     }
+    if (strcmp(typeName, "string") == 0)
+    {
+        return STRING;
+    }
+    return LNAME;
 }
 
-void handleFunctionDeclaration(struct Node *treeHead)
+// a struct declared in the package is named package.Name here
+struct Symbol *importedSymbol(struct ExportSummary *summary, struct ExportVariable *variable)
+{
+    struct Symbol *newData = calloc(1, sizeof(struct Symbol));
+    char *typeName = exportString(summary, variable->typeName);
+    newData->name = exportString(summary, variable->name);
+    newData->type = importedTypeCategory(typeName);
+    newData->typeName = typeName;
+    newData->arraySize = variable->arraySize;
+    if (newData->type == LNAME)
+    {
+        newData->typeName = malloc(strlen(exportString(summary, summary->header->packageName)) + strlen(typeName) + 2);
+        sprintf(newData->typeName, "%s.%s", exportString(summary, summary->header->packageName), typeName);
+    }
+    return newData;
+}
+
+void declareImportedPackage(struct ExportSummary *summary)
 {
-    if (treeHead->children[1]->category == fndcl)
+    char *packageName = exportString(summary, summary->header->packageName);
+    char qualifiedName[512];
+    unsigned int i = 0;
+    unsigned int j = 0;
+    if (summary->declared)
     {
-        if (treeHead->children[1]->children[0]->data != NULL)
-        {
-            currentSymbolTable = createSymbolTable(strdup(treeHead->children[1]->children[0]->data->text), currentSymbolTable);
-            addToFunctionList(currentSymbolTable);
+        return;
+    }
+    summary->declared = 1;
 
-            // handle parameters
-            if (treeHead->children[1]->children[1] != NULL)
-            {
+    // the package itself, like fmt, with a function symbol per exported function
+    struct symboltable *packageTable = createStructTable(packageName, globalSymbolTable);
+    for (i = 0; i < summary->header->numberOfFunctions; i++)
+    {
+        struct ExportFunction *exported = exportedFunction(summary, i);
+        struct Symbol *newData = calloc(1, sizeof(struct Symbol));
+        int index = calculateHashKey(exportString(summary, exported->name));
+        newData->name = exportString(summary, exported->name);
+        newData->type = function;
+        newData->typeName = "function";
+        packageTable->hash[index] = addToFront(newData, packageTable->hash[index]);
 
-                if (treeHead->children[1]->children[1]->category == oarg_type_list_ocomma)
-                {
-                    if (treeHead->children[1]->children[1]->children[0] == NULL)
-                    {
-                    }
-                    else
-                    {
-                        lookForParameterNames(treeHead->children[1]->children[1]->children[0]);
-                        handleMissingTypes(currentSymbolTable->declarationPropertyList);
-                        insertDeclarationPropertyList(currentSymbolTable);
-                    }
-                }
-            }
-            if (treeHead->children[1]->numberOfChildren == 3)
-            {
-                lookForReturnTypes(treeHead->children[1]->children[2]);
-                if (currentSymbolTable->returnType == 0)
-                {
-                    currentSymbolTable->returnType = VOID;
-                    currentSymbolTable->returnTypeName = "void";
-                }
-            }
-            else
-            {
-                currentSymbolTable->returnType = VOID;
-                currentSymbolTable->returnTypeName = "void";
-            }
+        // and a function table as a declaration in this file would have, under package.Name
+        snprintf(qualifiedName, sizeof(qualifiedName), "%s.%s", packageName, newData->name);
+        struct symboltable *functionTable = createSymbolTable(qualifiedName, globalSymbolTable);
+        addToFunctionList(functionTable);
+        for (j = 0; j < exported->numberOfParameters; j++)
+        {
+            functionTable->declarationPropertyList =
+                addToEnd(importedSymbol(summary, exportedVariable(summary, exported->firstParameter + j)), functionTable->declarationPropertyList);
+        }
+        insertDeclarationPropertyList(functionTable);
+        functionTable->returnType = VOID;
+        functionTable->returnTypeName = "void";
+        if (exportString(summary, exported->resultType)[0] != '\0')
+        {
+            functionTable->returnType = importedTypeCategory(exportString(summary, exported->resultType));
+            functionTable->returnTypeName = exportString(summary, exported->resultType);
         }
     }
-
-    // continue running on function body if it exists
-    if (treeHead->numberOfChildren == 3)
+    for (i = 0; i < summary->header->numberOfStructs; i++)
     {
-        if (treeHead->children[2]->category == fnbody)
+        struct ExportStruct *exported = exportedStruct(summary, i);
+        snprintf(qualifiedName, sizeof(qualifiedName), "%s.%s", packageName, exportString(summary, exported->name));
+        struct symboltable *structTable = createStructTable(qualifiedName, globalSymbolTable);
+        for (j = 0; j < exported->numberOfFields; j++)
         {
-            scopeAnalysis(treeHead->children[2]);
-            if (currentSymbolTable->parent != NULL)
-            {
-                currentSymbolTable = currentSymbolTable->parent;
-            }
+            struct Symbol *field = importedSymbol(summary, exportedVariable(summary, exported->firstField + j));
+            int index = calculateHashKey(field->name);
+            field->slot = structTable->numberOfSymbols++;
+            structTable->hash[index] = addToFront(field, structTable->hash[index]);
         }
+        buildFieldIndex(structTable);
     }
-    else
+}
+
+void handleStruct(struct Node *treeHead)
+{
+    struct TypeDeclarationMatch match;
+    if (matchTypeDeclaration(treeHead, &match) == TYPEDECLARATION_NAMED)
+    {
+        double start = traceEnabled ? traceClock() : 0;
+        struct symboltable *currentStructTable = createStructTable(match.name->data->text, globalSymbolTable);
+        lookForStructVariables(match.type, currentStructTable);
+        buildFieldIndex(currentStructTable);
+        if (traceEnabled)
+        {
+            traceDeclaration("scope", "struct", match.name->data->text, start);
+        }
+    }
+}
+
+// the name of a function declaration for the trace
+char *declaredFunctionName(struct Node *treeHead)
+{
+    struct FunctionDeclarationMatch match;
+    if (matchFunctionDeclaration(treeHead, &match) != 0)
     {
+        return match.name->data->text;
     }
+    return "(unnamed)";
 }
 
-void lookForVariableNames(struct Node *treeHead, int type, char *typeName)
+void handleFunctionDeclaration(struct Node *treeHead)
 {
-    if (treeHead->children[0]->category == dcl_name_list)
+    struct FunctionDeclarationMatch match;
+    struct ParametersMatch parameters;
+    double start = traceEnabled ? traceClock() : 0;
+    int shape = matchFunctionDeclaration(treeHead, &match);
+    if (shape == 0)
     {
-        lookForVariableNames(treeHead->children[0], type, typeName);
+        return;
     }
-    if (treeHead->children[0] != NULL && treeHead->children[0]->category == dcl_name)
+    currentSymbolTable = createSymbolTable(match.name->data->text, currentSymbolTable);
+    addToFunctionList(currentSymbolTable);
+
+    if (matchParameters(match.parameters, &parameters) == PARAMETERS_LISTED)
     {
-        if (arraySize != -1)
-        {
-            treeHead->children[0]->children[0]->data->ival = arraySize;
-            arraySize = -1;
-        }
-        insertVariableIntoHash(treeHead->children[0]->children[0], type, typeName, currentSymbolTable);
+        lookForParameterNames(parameters.list);
+        handleMissingTypes(currentSymbolTable->declarationPropertyList);
+        insertDeclarationPropertyList(currentSymbolTable);
     }
-    else if (treeHead->children[1] != NULL && treeHead->children[1]->category == dcl_name)
+    lookForReturnTypes(match.result);
+    if (currentSymbolTable->returnType == 0)
     {
-        if (arraySize != -1)
-        {
-            treeHead->children[1]->children[0]->data->ival = arraySize;
+        currentSymbolTable->returnType = VOID;
+        currentSymbolTable->returnTypeName = "void";
+    }
 
-            arraySize = -1;
+    // continue running on function body if it exists
+    if (shape == FUNCTIONDECLARATION_DEFINED)
+    {
+        scopeAnalysis(match.body);
+        if (currentSymbolTable->parent != NULL)
+        {
+            currentSymbolTable = currentSymbolTable->parent;
         }
-        insertVariableIntoHash(treeHead->children[1]->children[0], type, typeName, currentSymbolTable);
     }
-    else
+    if (traceEnabled)
     {
-        printf("Something went wrong here is the tree for debugging\n");
-        treeprint(treeHead, 0);
-        exit(3);
+        traceDeclaration("scope", "func", match.name->data->text, start);
+    }
+}
+
+void lookForVariableNames(struct Node *treeHead, int type, char *typeName, int arraySize)
+{
+    struct DeclaredNameMatch match;
+    int i = 0;
+    for (i = 0; i < treeHead->numberOfChildren; i++)
+    {
+        if (matchDeclaredName(treeHead->children[i], &match) == DECLAREDNAME_NAME)
+        {
+            if (arraySize != -1)
+            {
+                match.name->data->ival = arraySize;
+            }
+            insertVariableIntoHash(match.name, type, typeName, currentSymbolTable);
+        }
+        else
+        {
+            printf("Something went wrong here is the tree for debugging\n");
+            treeprint(treeHead, 0);
+            exit(3);
+        }
     }
 }
 
@@ -450,137 +830,71 @@ void lookForReturnTypes(struct Node *treeHead)
 
 void handleVariableDeclaration(struct Node *treeHead)
 {
-    int type;
-    char *typeName;
+    struct VariableDeclarationMatch match;
+    switch (matchVariableDeclaration(treeHead, &match))
+    {
+    case VARIABLEDECLARATION_TYPED:
+        lookForVariableNames(match.names, match.type->data->category, strdup(match.type->data->text), -1);
+        break;
 
-    if (treeHead->children[1] != NULL && treeHead->children[1]->numberOfChildren == 0)
+    case VARIABLEDECLARATION_UNSIZED:
+        printf("Array declarations need to have a size on line %d\n", match.bracket->data->linenumber);
+        exit(3);
+
+    case VARIABLEDECLARATION_ARRAY:
     {
-        // regular variable declaration
-        type = treeHead->children[1]->data->category;
-        typeName = strdup(treeHead->children[1]->data->text);
-        if (type == LNAME)
+        struct Constant *size = evaluateConstant(match.size);
+        if (size == NULL || size->type != INT)
         {
+            printf("Array size must be a constant integer on line %d\n", match.bracket->data->linenumber);
+            exit(3);
         }
-        lookForVariableNames(treeHead->children[0], type, typeName);
-    }
-    else
-    {
-        // array declaration
-        if (treeHead->children[1]->category == othertype)
+        else if (size->ival < 0 || size->ival > 0x7fffffff)
         {
-            if (treeHead->children[1]->children[1] == NULL)
-            {
-                printf("Array declarations need to have a size on line %d\n", treeHead->children[1]->children[0]->data->linenumber);
-                exit(3);
-            }
-            else
-            {
-                type = treeHead->children[1]->children[treeHead->children[1]->numberOfChildren - 1]->data->category;
-                typeName = strdup(treeHead->children[1]->children[treeHead->children[1]->numberOfChildren - 1]->data->text);
-                if (treeHead->children[1]->children[1]->children[0]->data->category == LNAME)
-                {
-                    printf("Found variable instead of a size in array\n");
-                    exit(3);
-                }
-                else
-                {
-                    arraySize = treeHead->children[1]->children[1]->children[0]->data->ival;
-                    lookForVariableNames(treeHead->children[0], type, typeName);
-                }
-            }
+            printf("Array size %lld out of range on line %d\n", size->ival, match.bracket->data->linenumber);
+            exit(3);
         }
+        lookForVariableNames(match.names, match.element->data->category, strdup(match.element->data->text), (int)size->ival);
+        break;
     }
-}
 
-void handlePotentialStructInstance(struct Node *treeHead)
-{
-    if (treeHead->numberOfChildren >= 3)
-    {
-        if (treeHead->children[1]->data->category == PERIOD)
-        {
-            if (strcmp(treeHead->children[0]->children[0]->data->text, "fmt") == 0)
-            {
-                if (strcmp(treeHead->children[2]->data->text, "Println") != 0)
-                {
-                    printf("That isn't a Println its a %s\n", treeHead->children[1]->data->text);
-                    exit(3);
-                }
-            }
-            else if (strcmp(treeHead->children[0]->children[0]->data->text, "time") == 0)
-            {
-                if (strcmp(treeHead->children[2]->data->text, "Now") != 0)
-                {
-                    printf("That isn't a Now its a %s\n", treeHead->children[1]->data->text);
-                    exit(3);
-                }
-            }
-            else if (strcmp(treeHead->children[0]->children[0]->data->text, "math/rand") == 0)
-            {
-                if (strcmp(treeHead->children[2]->data->text, "Intn") != 0)
-                {
-                    printf("That isn't a Intn its a %s\n", treeHead->children[1]->data->text);
-                    exit(3);
-                }
-            }
-            else
-            {
-                // we found a struct instance
-                // int index = calculateHashKey(treeHead->children[2]->data->text);
-                int typeName = findTypeInSymbolTable(currentSymbolTable, treeHead->children[0]->children[0]->data->text);
-                if (typeName > 0)
-                {
-                    // struct symboltable *variableSymbolTable = findStructTable(typeName);
-                    // int returnIsVariableInTable = isVariableInTable(variableSymbolTable, index, treeHead->children[2]->data->text);
-                    // if (returnIsVariableInTable == 1 || returnIsVariableInTable == 2)
-                    // {
-                    //     // do nothing this is valid
-                    // }
-                    // else
-                    // {
-                    //     printf("%s.%s is not in the current scope\n", treeHead->children[0]->children[0]->data->text, treeHead->children[2]->data->text);
-                    //     exit(3);
-                    // }
-                }
-                else
-                {
-                    printf("%s.%s is not in the current scope\n", treeHead->children[0]->children[0]->data->text, treeHead->children[2]->data->text);
-                    exit(3);
-                }
-            }
-        }
-    }
-    else
-    {
-        checkChildren(treeHead);
+    default:
+        printf("Variable declarations of this type are not supported in VGo\n");
+        treeprint(treeHead, 0);
+        exit(3);
     }
 }
 
 void lookForParameterNames(struct Node *treeHead)
 {
-    if (treeHead->category == arg_type)
+    struct ParameterMatch match;
+    int shape = matchParameter(treeHead, &match);
+    if (shape == PARAMETER_UNTYPED)
     {
-        if (treeHead->numberOfChildren == 1)
-        {
-            struct Symbol *newData = malloc(sizeof(struct Symbol));
-            newData->name = strdup(treeHead->children[0]->children[0]->data->text);
-            newData->type = -1;
-            newData->typeName = NULL;
-            currentSymbolTable->declarationPropertyList = addToEnd(newData, currentSymbolTable->declarationPropertyList);
-        }
-        if (treeHead->numberOfChildren == 2)
-        {
-
-            int type = treeHead->children[1]->children[0]->data->category;
-            char *typeName = treeHead->children[1]->children[0]->data->text;
+        struct Symbol *newData = malloc(sizeof(struct Symbol));
+        newData->name = strdup(match.name->data->text);
+        newData->type = -1;
+        newData->typeName = NULL;
+        currentSymbolTable->declarationPropertyList = addToEnd(newData, currentSymbolTable->declarationPropertyList);
+    }
+    else if (shape == PARAMETER_TYPED)
+    {
+        int type = match.type->data->category;
+        char *typeName = match.type->data->text;
 
-            struct Symbol *newData = malloc(sizeof(struct Symbol));
-            newData->name = strdup(treeHead->children[0]->data->text);
-            newData->type = type;
-            newData->typeName = strdup(typeName);
-            currentSymbolTable->declarationPropertyList = addToEnd(newData, currentSymbolTable->declarationPropertyList);
+        struct Symbol *newData = malloc(sizeof(struct Symbol));
+        newData->name = strdup(match.name->data->text);
+        newData->type = type;
+        newData->typeName = strdup(typeName);
+        currentSymbolTable->declarationPropertyList = addToEnd(newData, currentSymbolTable->declarationPropertyList);
 
-            insertVariableIntoHash(treeHead->children[0], type, typeName, currentSymbolTable);
-        }
+        insertVariableIntoHash(match.name, type, typeName, currentSymbolTable);
+    }
+    else if (shape == PARAMETER_UNSUPPORTED)
+    {
+        printf("Parameters of this type are not supported in VGo\n");
+        treeprint(treeHead, 0);
+        exit(3);
     }
     else
     {
@@ -596,16 +910,108 @@ void lookForParameterNames(struct Node *treeHead)
     }
 }
 
+/*
+ * Binds a use of a name to its declaration in the scope it is used in, so
+ * the type checks and constant folding read the symbol from the node rather
+ * than hashing the name again. This happens as scopeAnalysis walks the tree
+ * since a name is only visible after its declaration. Names that are not
+ * variables, like functions, packages, struct types and fields, stay unbound.
+ */
 void handleVariableInstance(struct Node *treeHead)
 {
+    treeHead->declaration = findSymbolInTable(currentSymbolTable, treeHead->data->text);
+    if (treeHead->declaration != NULL)
+    {
+        return;
+    }
     int index = calculateHashKey(treeHead->data->text);
     if (isVariableInTable(currentSymbolTable, index, treeHead->data->text) == 0)
     {
-        printf("Undeclared variable '%s' at file %s on line %d encountered\n", treeHead->data->text, treeHead->data->filename, treeHead->data->linenumber);
+        if (numberOfUnresolvedNames == unresolvedNamesCapacity)
+        {
+            unresolvedNamesCapacity = unresolvedNamesCapacity == 0 ? 16 : unresolvedNamesCapacity * 2;
+            unresolvedNames = realloc(unresolvedNames, unresolvedNamesCapacity * sizeof(struct Node *));
+        }
+        unresolvedNames[numberOfUnresolvedNames++] = treeHead;
+    }
+}
+
+// the variable or field a selector's operand names, NULL for anything else, indexed is set for an element of it
+struct Symbol *selectedSymbol(struct Node *treeHead, int *indexed)
+{
+    struct SelectedNameMatch match;
+    switch (matchSelectedName(treeHead, &match))
+    {
+    case SELECTEDNAME_NAME:
+        return match.name->declaration;
+
+    case SELECTEDNAME_WRAPPED:
+        return selectedSymbol(match.inner, indexed);
+
+    case SELECTEDNAME_FIELD:
+        return match.field->declaration;
+
+    case SELECTEDNAME_INDEX:
+        *indexed = 1;
+        return selectedSymbol(match.array, indexed);
+    }
+    return NULL;
+}
+
+/*
+ * x.field where x is a struct variable, a field of one or an element of an
+ * array of them, binds the field
+ * name to the field's symbol through the struct's field index. The symbol's
+ * slot is the field's place in the struct for the stages after this one.
+ * Package members like fmt.Println and selectors on anything else are left
+ * to handleVariableInstance as before.
+ */
+void handleSelector(struct Node *treeHead)
+{
+    struct SelectorMatch match;
+    if (matchSelector(treeHead, &match) != SELECTOR_FIELD)
+    {
+        checkChildren(treeHead);
+        return;
+    }
+    scopeAnalysis(match.operand);
+    int indexed = 0;
+    struct Symbol *operand = selectedSymbol(match.operand, &indexed);
+    struct symboltable *structTable = NULL;
+    if (operand != NULL && operand->type == LNAME && (operand->arraySize > 0) == indexed && operand->typeName != NULL)
+    {
+        structTable = lookupStructTable(operand->typeName);
+    }
+    if (structTable == NULL)
+    {
+        scopeAnalysis(match.field);
+        return;
+    }
+    struct Node *field = match.field;
+    field->declaration = findStructField(structTable, field->data->text);
+    if (field->declaration == NULL)
+    {
+        printf("%s has no field '%s' at file %s on line %d\n", operand->typeName, field->data->text, field->data->filename, field->data->linenumber);
         exit(3);
     }
 }
 
+void reportUnresolvedNames()
+{
+    int i = 0;
+    if (numberOfUnresolvedNames == 0)
+    {
+        return;
+    }
+    for (i = 0; i < numberOfUnresolvedNames; i++)
+    {
+        struct Node *name = unresolvedNames[i];
+        PROBE_ERROR("scope", name->data->linenumber, name->data->text);
+        printf("Undeclared variable '%s' at file %s on line %d encountered\n", name->data->text, name->data->filename, name->data->linenumber);
+    }
+    exit(3);
+}
+
 void lookForStructVariables(struct Node *treeHead, struct symboltable *currentStruct)
 {
     if (treeHead == NULL)
@@ -614,10 +1020,26 @@ void lookForStructVariables(struct Node *treeHead, struct symboltable *currentSt
     }
     else if (treeHead->category == structdcl)
     {
-        int type = treeHead->children[1]->data->category;
-        char *typeName = strdup(treeHead->children[1]->data->text);
+        struct FieldDeclarationMatch match;
+        struct FieldNameMatch field;
+        if (matchFieldDeclaration(treeHead, &match) != FIELDDECLARATION_FIELDS)
+        {
+            printf("Struct fields of this type are not supported in VGo\n");
+            treeprint(treeHead, 0);
+            exit(3);
+        }
+        int type = match.type->data->category;
+        char *typeName = strdup(match.type->data->text);
 
-        insertVariableIntoHash(treeHead->children[0]->children[0]->children[0], type, typeName, currentStruct);
+        // every new_name in the field list shares the type
+        int i = 0;
+        for (i = 0; i < match.names->numberOfChildren; i++)
+        {
+            if (matchFieldName(match.names->children[i], &field) == FIELDNAME_NAME)
+            {
+                insertVariableIntoHash(field.name, type, typeName, currentStruct);
+            }
+        }
     }
     else if (treeHead->numberOfChildren > 0)
     {
@@ -631,39 +1053,57 @@ void lookForStructVariables(struct Node *treeHead, struct symboltable *currentSt
 
 void handleConst(struct Node *treeHead)
 {
-    if (treeHead->numberOfChildren == 4)
+    // every value must fold
+    struct ConstantDeclarationMatch match;
+    int type = -1;
+    char *typeName = NULL;
+    int i = 0;
+
+    switch (matchConstantDeclaration(treeHead, &match))
     {
+    case CONSTANTDECLARATION_NAMED:
+    case CONSTANTDECLARATION_COMPOSITE:
+        printf("Constants must have a basic type on line %d\n", match.equal->data->linenumber);
+        exit(3);
 
-        if (treeHead->children[1]->numberOfChildren == 0)
-        {
-            int type;
-            char *typeName;
-            type = treeHead->children[1]->data->category;
-            typeName = strdup(treeHead->children[1]->data->text);
+    case CONSTANTDECLARATION_TYPED:
+        type = match.type->data->category;
+        typeName = strdup(match.type->data->text);
+        break;
 
-            findConstName(treeHead->children[0], type, typeName);
-        }
-    }
-}
+    case CONSTANTDECLARATION_UNTYPED:
+        break;
 
-void findConstName(struct Node *treeHead, int type, char *typeName)
-{
-    if (treeHead == NULL)
-    {
-        // do nothing
+    default:
+        return;
     }
-    else if (treeHead->category == dcl_name)
+    struct Node *names = match.names;
+    struct Node *values = match.values;
+    if (values->category == expr_list && values->numberOfChildren != names->numberOfChildren)
     {
-        treeHead->children[0]->category = lconst;
-        insertVariableIntoHash(treeHead->children[0], type, typeName, currentSymbolTable);
+        printf("Constant declaration has %d names but %d values on line %d\n", names->numberOfChildren, values->numberOfChildren, match.equal->data->linenumber);
+        exit(3);
     }
-    else
+
+    for (i = 0; i < names->numberOfChildren; i++)
     {
-        int i = 0;
-        for (i = 0; i < treeHead->numberOfChildren; i++)
+        struct Node *name = names->children[i]->children[0];
+        struct Constant *value = evaluateConstant(values->category == expr_list ? values->children[i] : values);
+        if (value == NULL)
         {
-            findConstName(treeHead->children[i], type, typeName);
+            printf("Const initializer for '%s' is not a constant at %s:%d\n", name->data->text, name->data->filename, name->data->linenumber);
+            exit(3);
+        }
+        if (type != -1)
+        {
+            value = convertConstant(value, type, values);
         }
+
+        // previously we set the category as a storage place for the isConst flag to keep track
+        name->category = lconst;
+        name->constant = value;
+        insertVariableIntoHash(name, type != -1 ? type : value->type, type != -1 ? typeName : constantTypeName(value->type), currentSymbolTable);
+        findSymbolInTable(currentSymbolTable, name->data->text)->constant = value;
     }
 }
 
@@ -687,258 +1127,325 @@ char *getTerminalText(struct Node *treeHead)
     }
 }
 
-void checkTypeFunctionDeclaration(struct Node *treeHead)
+void checkTypeFunctionDeclaration(struct Node *treeHead, struct TypeContext *context)
 {
-    if (treeHead->children[1]->category == fndcl)
+    struct FunctionDeclarationMatch match;
+    double start = traceEnabled ? traceClock() : 0;
+    int shape = matchFunctionDeclaration(treeHead, &match);
+    if (shape != 0)
     {
-        if (treeHead->children[1]->children[0]->data != NULL)
-        {
-            currentSymbolTable = findSymbolTable(treeHead->children[1]->children[0]->data->text);
-        }
+        context->scope = findTypeScope(context, match.name->data->text);
     }
-    if (treeHead->numberOfChildren == 3)
+    if (shape == FUNCTIONDECLARATION_DEFINED)
     {
-        if (treeHead->children[2]->category == fnbody)
+        checkTypeChildren(match.body, context);
+        if (context->scope->parent != NULL)
         {
-            checkTypeChildren(treeHead->children[2]);
-            if (currentSymbolTable->parent != NULL)
-            {
-                currentSymbolTable = currentSymbolTable->parent;
-            }
+            context->scope = context->scope->parent;
         }
     }
+    if (traceEnabled)
+    {
+        traceDeclaration("types", "func", declaredFunctionName(treeHead), start);
+    }
 }
 
-int checkTypeFunctionCall(struct Node *treeHead)
+int checkTypeFunctionCall(struct Node *treeHead, struct TypeContext *context)
 {
-    if (treeHead->numberOfChildren > 0)
-    {
-        if (treeHead->children[0]->numberOfChildren > 0)
+    struct CallMatch call;
+    char *variableName;
+    // the scope becomes the callee's table, the arguments are still the caller's names
+    struct symboltable *caller = context->scope;
+    struct symboltable *callee = NULL;
+    int returnType = 0;
+    switch (matchCall(treeHead, &call))
+    {
+    case CALL_DIRECT:
+        if (strcmp(call.callee->data->text, "fmt") == 0)
         {
-            if (treeHead->children[0]->children[0]->numberOfChildren == 0)
-            {
-                if (strcmp(treeHead->children[0]->children[0]->data->text, "fmt") == 0)
-                {
-                    // currentSymbolTable = fmtSymbolTable;
-                }
-                else if (strcmp(treeHead->children[0]->children[0]->data->text, "time") == 0)
-                {
-                    // currentSymbolTable = timeSymbolTable;
-                }
-                else if (strcmp(treeHead->children[0]->children[0]->data->text, "Math/rand") == 0)
-                {
-                    // currentSymbolTable = mathSymbolTable;
-                }
-                else
-                {
-                    currentSymbolTable = findSymbolTable(treeHead->children[0]->children[0]->data->text);
-                }
-            }
-            else if (treeHead->children[0]->children[0]->numberOfChildren == 1)
-            {
-                char *variableName = getTerminalText(treeHead->children[0]->children[0]);
-                if (strcmp(variableName, "fmt") == 0)
-                {
-                    // currentSymbolTable = fmtSymbolTable;
-                    return VOID;
-                }
-                else if (strcmp(variableName, "time") == 0)
-                {
-                    // currentSymbolTable = timeSymbolTable;
-                    return INT;
-                }
-                else if (strcmp(variableName, "Math/rand") == 0)
-                {
-                    // currentSymbolTable = mathSymbolTable;
-                    return INT;
-                }
-                else
-                {
-                    checkTypeChildren(treeHead->children[0]->children[0]);
-                }
-            }
-            else
-            {
-                printf("Unable to find function in the following tree\n");
-                treeprint(treeHead, 0);
-                exit(3);
-            }
+            // context->scope = fmtSymbolTable;
+        }
+        else if (strcmp(call.callee->data->text, "time") == 0)
+        {
+            // context->scope = timeSymbolTable;
+        }
+        else if (strcmp(call.callee->data->text, "Math/rand") == 0)
+        {
+            // context->scope = mathSymbolTable;
         }
+        else
+        {
+            context->scope = findTypeScope(context, call.callee->data->text);
+        }
+        break;
+
+    case CALL_MEMBER:
+    case CALL_OPERAND:
+        variableName = getTerminalText(call.operand);
+        if (strcmp(variableName, "fmt") == 0)
+        {
+            // context->scope = fmtSymbolTable;
+            return VOID;
+        }
+        else if (strcmp(variableName, "time") == 0)
+        {
+            // context->scope = timeSymbolTable;
+            return INT;
+        }
+        else if (strcmp(variableName, "Math/rand") == 0)
+        {
+            // context->scope = mathSymbolTable;
+            return INT;
+        }
+        else if (call.member != NULL && findImportedPackage(variableName) != NULL)
+        {
+            // checked against the table declareImportedPackage made for package.Name
+            char qualifiedName[512];
+            snprintf(qualifiedName, sizeof(qualifiedName), "%s.%s", variableName, call.member->data->text);
+            context->scope = findTypeScope(context, qualifiedName);
+        }
+        else
+        {
+            checkTypeChildren(call.operand, context);
+        }
+        break;
+
+    case CALL_UNKNOWN:
+        context->errorTree = treeHead;
+        typeError(context, "Unable to find function in the following tree\n");
+        break;
+
+    case CALL_OTHER:
+        break;
+
+    default:
+        return checkTypeChildren(treeHead, context);
     }
 
     // check parameter list
-    if (currentSymbolTable->declarationPropertyList != NULL)
+    if (context->scope->declarationPropertyList != NULL)
     {
-        if (treeHead->numberOfChildren == 3)
+        if (call.arguments == NULL)
         {
-            printf("There are parameters for function %s but parameters were not provided\n", currentSymbolTable->tablename);
-            exit(3);
+            typeError(context, "There are parameters for function %s but parameters were not provided\n", context->scope->tablename);
         }
         else
         {
-            struct LinkedListNode *paramTypeHead = malloc(sizeof(struct LinkedListNode));
-            paramTypeHead = NULL;
-            paramTypeHead = checkParameterTypes(currentSymbolTable, paramTypeHead, treeHead->children[2]);
-            if (compareLinkedLists(paramTypeHead, currentSymbolTable->declarationPropertyList) == 0)
+            struct LinkedListNode *paramTypeHead = NULL;
+            callee = context->scope;
+            context->scope = caller;
+            paramTypeHead = checkParameterTypes(paramTypeHead, call.arguments, context);
+            context->scope = callee;
+            if (compareLinkedLists(paramTypeHead, context->scope->declarationPropertyList) == 0)
             {
-                printf("Error called function %s called with a the following types\n", currentSymbolTable->tablename);
-                printLinkedList(paramTypeHead);
-                exit(3);
+                context->errorList = paramTypeHead;
+                typeError(context, "Error called function %s called with a the following types\n", context->scope->tablename);
             }
         }
     }
-    else if (treeHead->numberOfChildren == 5 || treeHead->numberOfChildren == 4)
+    else if (call.arguments != NULL)
     {
-        printf("There are no parameters for function %s but parameters were provided\n", currentSymbolTable->tablename);
-        exit(3);
+        typeError(context, "There are no parameters for function %s but parameters were provided\n", context->scope->tablename);
     }
 
     // check return type
-    return currentSymbolTable->returnType;
+    returnType = context->scope->returnType;
+    context->scope = caller;
+    return returnType;
 }
 
-void checkTypeNonDclStmt(struct Node *treeHead)
+void checkTypeNonDclStmt(struct Node *treeHead, struct TypeContext *context)
 {
-    int rightType = 0;
-    if (treeHead->numberOfChildren == 2)
+    struct ReturnMatch match;
+    if (matchReturn(treeHead, &match) == RETURN_VALUES)
     {
-        if (treeHead->children[0]->numberOfChildren == 0)
+        int rightType = checkTypeChildren(match.values, context);
+        // a literal has its own token type, "x" is a STRINGLIT where the result is a STRING
+        if (rightType != context->scope->returnType && compareLeftAndRightTypes(rightType, context->scope->returnType) <= 0)
         {
-            rightType = checkTypeChildren(treeHead->children[1]);
-            if (rightType != currentSymbolTable->returnType)
-            {
-                printf("Return type is not the same as the function return type. Expected %s but got %s\n", findTypeName(currentSymbolTable->returnType), findTypeName(rightType));
-                exit(3);
-            }
+            typeError(context, "Return type is not the same as the function return type. Expected %s but got %s\n", findTypeName(context->scope->returnType), findTypeName(rightType));
         }
     }
-    else
+    else if (treeHead->numberOfChildren != 2)
     {
-        checkTypeChildren(treeHead);
+        checkTypeChildren(treeHead, context);
     }
 }
 
-int checkTypeExpression(struct Node *treeHead)
+int checkTypeExpression(struct Node *treeHead, struct TypeContext *context)
 {
-    int leftType = 0;
-    int rightType = 0;
-    leftType = checkTypeChildren(treeHead->children[0]);
-    rightType = findTerminal(treeHead->children[2]);
+    struct ExpressionMatch match;
+    if (matchExpression(treeHead, &match) != EXPRESSION_BINARY)
+    {
+        return checkTypeChildren(treeHead, context);
+    }
+    int leftType = typeAnalysis(match.left, context);
+    int rightType = typeAnalysis(match.right, context);
     if (leftType == LNAME || rightType == LNAME)
     {
-        printf("Error found type struct on operaion '%s' on line %d\n", treeHead->children[1]->data->text, treeHead->children[1]->data->linenumber);
-        exit(3);
+        typeError(context, "Error found type struct on operaion '%s' on line %d\n", match.operator->data->text, match.operator->data->linenumber);
+    }
+    else if (compareLeftAndRightTypes(leftType, rightType) == 0)
+    {
+        typeError(context, "Error type '%s' != type '%s' in operation '%s' on line %d\n", findTypeName(leftType), findTypeName(rightType), match.operator->data->text, match.operator->data->linenumber);
+    }
+    switch (match.operator->category)
+    {
+    case LEQ:
+    case LNE:
+    case LLT:
+    case LGT:
+    case LLE:
+    case LGE:
+    case LANDAND:
+    case LOROR:
+        return BOOL;
+
+    default:
+        return leftType;
+    }
+}
+
+int checkTypeUnary(struct Node *treeHead, struct TypeContext *context)
+{
+    struct UnaryMatch match;
+    if (matchUnary(treeHead, &match) != UNARY_OPERATOR)
+    {
+        return checkTypeDefault(treeHead, context);
     }
-    else if (compareLeftAndRightTypes(leftType, rightType))
+    int operandType = typeAnalysis(match.operand, context);
+    switch (match.operator->category)
     {
-        switch (treeHead->children[1]->category)
+    case EXCLAMATION:
+        if (findTypeCategory(operandType) != BOOL)
         {
-        case LLT:
-        case LGT:
-        case LLE:
-        case LGE:
-        case LANDAND:
-        case LOROR:
-            return BOOL;
+            typeError(context, "Error type '%s' in operation '%s' on line %d\n", findTypeName(operandType), match.operator->data->text, match.operator->data->linenumber);
+        }
+        return BOOL;
 
-        default:
-            return leftType;
+    case PLUS:
+    case MINUS:
+        if (findTypeCategory(operandType) != INT && findTypeCategory(operandType) != FLOAT64)
+        {
+            typeError(context, "Error type '%s' in operation '%s' on line %d\n", findTypeName(operandType), match.operator->data->text, match.operator->data->linenumber);
         }
+        return operandType;
+
+    default:
+        return -1;
     }
-    else
+}
+
+int checkTypeParenthesized(struct Node *treeHead, struct TypeContext *context)
+{
+    struct ParenthesizedMatch match;
+    if (matchParenthesized(treeHead, &match) != PARENTHESIZED_WRAPPED)
     {
-        printf("Error type '%s' != type '%s' in operation '%s' on line %d\n", findTypeName(leftType), findTypeName(rightType), treeHead->children[1]->data->text, treeHead->children[1]->data->linenumber);
-        exit(3);
+        return checkTypeDefault(treeHead, context);
     }
-    exit(3);
-    return -1;
+    return typeAnalysis(match.inner, context);
 }
 
-int checkTypeSimpleStatement(struct Node *treeHead)
+int checkTypeSimpleStatement(struct Node *treeHead, struct TypeContext *context)
 {
+    struct SimpleStatementMatch match;
     int leftType = 0;
     int rightType = 0;
-    if (treeHead->numberOfChildren == 1)
-    {
-        return checkTypeChildren(treeHead);
-    }
-    else if (treeHead->numberOfChildren == 3)
+    switch (matchSimpleStatement(treeHead, &match))
     {
-        leftType = typeAnalysis(treeHead->children[0]);
-        rightType = typeAnalysis(treeHead->children[2]);
+    case SIMPLESTATEMENT_EXPRESSION:
+        return checkTypeChildren(treeHead, context);
+
+    case SIMPLESTATEMENT_ASSIGNMENT:
+        leftType = typeAnalysis(match.left, context);
+        rightType = typeAnalysis(match.right, context);
         if (compareLeftAndRightTypes(leftType, rightType) == 0)
         {
-            printf("Error type '%s' != type '%s' in operation '%s' on line %d\n", findTypeName(leftType), findTypeName(rightType), treeHead->children[1]->data->text, treeHead->children[1]->data->linenumber);
-            exit(3);
+            typeError(context, "Error type '%s' != type '%s' in operation '%s' on line %d\n", findTypeName(leftType), findTypeName(rightType), match.operator->data->text, match.operator->data->linenumber);
         }
         else
         {
             return leftType;
         }
+        break;
     }
     return -1;
 }
 
-int checkTypepexpr_no_paren(struct Node *treeHead)
+int checkTypepexpr_no_paren(struct Node *treeHead, struct TypeContext *context)
 {
-    if (treeHead->numberOfChildren == 0)
-    {
-        return typeAnalysis(treeHead);
-    }
-    if (treeHead->numberOfChildren == 1)
+    struct OperandMatch match;
+    switch (matchOperand(treeHead, &match))
     {
-        int type = typeAnalysis(treeHead->children[0]);
-        return type;
-    }
-    else if (treeHead->numberOfChildren == 3)
+    case OPERAND_WRAPPED:
+        return typeAnalysis(match.inner, context);
+
+    case OPERAND_INDEX:
     {
-        if (treeHead->children[1]->numberOfChildren == 0)
+        // index expression pexpr [ expr ], an array's symbol has the type of its elements
+        int elementType = typeAnalysis(match.array, context);
+        int indexType = typeAnalysis(match.index, context);
+        if (findTypeCategory(indexType) != INT)
         {
-            if (treeHead->children[1]->data->category == EQUAL)
-            {
-                int leftType = typeAnalysis(treeHead->children[0]);
-                int rightType = typeAnalysis(treeHead->children[2]);
-                if (compareLeftAndRightTypes(leftType, rightType))
-                {
-                    return leftType;
-                }
-                else
-                {
-                    printf("Attempted operation types %s = %s\n", findTypeName(leftType), findTypeName(rightType));
-                    exit(3);
-                }
-            }
-            else
-            {
-                return checkTypeChildren(treeHead);
-            }
+            typeError(context, "Error index of type '%s' on line %d\n", findTypeName(indexType), match.bracket->data->linenumber);
         }
+        return elementType;
     }
-    else if (treeHead->numberOfChildren == 4)
+
+    case OPERAND_CONVERTED:
+        // float64(x) and the like, anything else with this shape is a composite literal
+        if (findTypeCategory(match.type->data->category) != INT && findTypeCategory(match.type->data->category) != FLOAT64)
+        {
+            return checkTypeChildren(treeHead, context);
+        }
+        typeAnalysis(match.value, context);
+        return match.type->data->category;
+
+    case OPERAND_FIELD:
+        if (match.field->declaration == NULL)
+        {
+            return checkTypeChildren(treeHead, context);
+        }
+        // a field bound by handleSelector
+        typeAnalysis(match.operand, context);
+        return match.field->declaration->type;
+
+    case OPERAND_ASSIGNMENT:
     {
-        if (treeHead->children[1]->numberOfChildren == 0 && treeHead->children[1]->data->category == LSQUAREBRACE)
+        int leftType = typeAnalysis(match.left, context);
+        int rightType = typeAnalysis(match.right, context);
+        if (compareLeftAndRightTypes(leftType, rightType))
         {
-            if (typeAnalysis(treeHead->children[0]) != typeAnalysis(treeHead->children[2]))
-            {
-                printf("something bad happened\n");
-            }
+            return leftType;
         }
+        typeError(context, "Attempted operation types %s = %s\n", findTypeName(leftType), findTypeName(rightType));
+        break;
     }
-    else
-    {
-        checkTypeChildren(treeHead);
+
+    case OPERAND_OPERATOR:
+        return checkTypeChildren(treeHead, context);
+
+    case OPERAND_CONVERSION:
+        break;
+
+    default:
+        checkTypeChildren(treeHead, context);
     }
     return -1;
 }
 
-int checkTypeDefault(struct Node *treeHead)
+int checkTypeDefault(struct Node *treeHead, struct TypeContext *context)
 {
     // either return a type of a variable or return a type from the children
     if (treeHead->numberOfChildren == 0)
     {
-        if (treeHead->data->category == LNAME)
+        if (treeHead->declaration != NULL)
+        {
+            return treeHead->declaration->type;
+        }
+        else if (treeHead->data->category == LNAME)
         {
-            int variableType = findTypeInSymbolTable(currentSymbolTable, treeHead->data->text);
+            int variableType = findTypeInSymbolTable(context->scope, treeHead->data->text);
             return variableType;
         }
         else
@@ -948,61 +1455,23 @@ int checkTypeDefault(struct Node *treeHead)
     }
     else if (treeHead->numberOfChildren == 1)
     {
-        return checkTypeChildren(treeHead);
+        return checkTypeChildren(treeHead, context);
     }
     else
     {
-        checkTypeChildren(treeHead);
+        checkTypeChildren(treeHead, context);
     }
     return -1;
 }
 
-void checkForHeader(struct Node *treeHead)
+void checkForHeader(struct Node *treeHead, struct TypeContext *context)
 {
-    if (treeHead->numberOfChildren == 1)
-    {
-        if (treeHead->children[0] == NULL)
-        {
-            // do nothing
-        }
-        else
-        {
-            if (typeAnalysis(treeHead->children[0]) != BOOL)
-            {
-                printf("Error conditional does not have type BOOL instead found the following tree\n");
-                treeprint(treeHead->children[0], 0);
-                exit(3);
-            }
-            else
-            {
-                // do nothing
-            }
-        }
-    }
-    else if (treeHead->children[1]->numberOfChildren == 0 && treeHead->children[1]->data->category == SEMICOLON)
+    // for condition, or init; condition; post
+    struct ForHeaderMatch match;
+    int shape = matchForHeader(treeHead, &match);
+    if ((shape == FORHEADER_CONDITION || shape == FORHEADER_CLAUSES) && typeAnalysis(match.condition, context) != BOOL)
     {
-        if (typeAnalysis(treeHead->children[2]) != BOOL)
-        {
-            printf("Error conditional does not have type BOOL instead found the following tree\n");
-            treeprint(treeHead->children[2], 0);
-            exit(3);
-        }
-        else
-        {
-            // do nothing
-        }
-    }
-    else
-    {
-        if (typeAnalysis(treeHead->children[1]) != BOOL)
-        {
-            printf("Error conditional does not have type BOOL instead found the following tree\n");
-            treeprint(treeHead->children[1], 0);
-            exit(3);
-        }
-        else
-        {
-            // do nothing
-        }
+        context->errorTree = match.condition;
+        typeError(context, "Error conditional does not have type BOOL instead found the following tree\n");
     }
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef SEMANTIC
 #define SEMANTIC
 
+extern int typeCheckThreads;
+extern int checkReachableOnly;
+
 void beginSemanticAnalysis(struct Node *treeHead);
 
 #endif
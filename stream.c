@@ -0,0 +1,51 @@
+#include "stream.h"
+#include "vgobison.tab.h"
+#include "globalutilities.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// set by -stream, makes the lexer take input as soon as it is available
+int streamMode = 0;
+
+int streamRead(FILE *input, char *buffer, int maxSize)
+{
+    // read() returns whatever chunk the writer has produced so far instead of
+    // blocking until the whole flex buffer is full like fread() does on a pipe
+    ssize_t bytesRead;
+    do
+    {
+        bytesRead = read(fileno(input), buffer, maxSize);
+    } while (bytesRead < 0 && errno == EINTR);
+
+    if (bytesRead < 0)
+    {
+        perror("Unable to read from the input stream");
+        exit(1);
+    }
+    return (int)bytesRead;
+}
+
+int streamParse(FILE *input)
+{
+    // drive the push parser one token at a time so each declaration is reduced
+    // while the rest of the program is still being written into the pipe
+    yypstate *parserState = yypstate_new();
+    int status;
+    YYSTYPE value;
+    // only for this input, the files after a - on the command line are read as usual
+    int previousMode = streamMode;
+
+    yyset_in(input, scanner);
+    streamMode = 1;
+    do
+    {
+        int token = yylex(&value);
+        status = yypush_parse(parserState, token, &value);
+    } while (status == YYPUSH_MORE);
+
+    yypstate_delete(parserState);
+    streamMode = previousMode;
+    return status;
+}
@@ -0,0 +1,11 @@
+#ifndef STREAM
+#define STREAM
+
+#include <stdio.h>
+
+extern int streamMode;
+
+int streamRead(FILE *input, char *buffer, int maxSize);
+int streamParse(FILE *input);
+
+#endif
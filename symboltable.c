@@ -5,46 +5,107 @@
 #include <string.h>
 #include <stdlib.h>
 #include "nonterminal.h"
+#include "intern.h"
+#include "memreport.h"
+#include "probes.h"
 
-struct symboltable *functionSymbolTable[100];
+struct symboltable **functionSymbolTable = NULL;
 int functionSymbolTableLastIndex = 0;
-struct symboltable *structSymbolTable[100];
+int functionSymbolTableCapacity = 0;
+struct symboltable **structSymbolTable = NULL;
 int structSymbolTableLastIndex = 0;
+int structSymbolTableCapacity = 0;
+
+// function and struct tables by interned name
+struct Registry *functionRegistry = NULL;
+struct Registry *structRegistry = NULL;
+
+// set while function bodies are type checked, possibly on several threads at once
+int symbolTablesReadOnly = 0;
+
+void setSymbolTablesReadOnly(int readOnly)
+{
+    symbolTablesReadOnly = readOnly;
+    shareInterner(identifierTable(), readOnly);
+    if (functionRegistry != NULL)
+    {
+        shareRegistry(functionRegistry, readOnly);
+    }
+    if (structRegistry != NULL)
+    {
+        shareRegistry(structRegistry, readOnly);
+    }
+}
+
+// the table registered under name, without interning a name that was never seen
+struct symboltable *findRegisteredTable(struct Registry *registry, char *name)
+{
+    char *interned = NULL;
+    if (registry == NULL)
+    {
+        return NULL;
+    }
+    interned = findInternedText(identifierTable(), name, strlen(name));
+    return interned != NULL ? findRegisteredName(registry, interned) : NULL;
+}
+
+void checkSymbolTablesWritable()
+{
+    if (symbolTablesReadOnly)
+    {
+        printf("Symbol tables cannot change while types are checked\n");
+        exit(3);
+    }
+}
+
+struct symboltable **growTableList(struct symboltable **tables, int count, int *capacity)
+{
+    if (count == *capacity)
+    {
+        *capacity = *capacity == 0 ? 64 : *capacity * 2;
+        tables = realloc(tables, *capacity * sizeof(struct symboltable *));
+    }
+    return tables;
+}
 
 struct symboltable *createSymbolTable(char *tableName, struct symboltable *parent)
 {
     struct symboltable *newSymbolTable = calloc(1, sizeof(struct symboltable));
-    newSymbolTable->tablename = strdup(tableName);
+    countAllocation(MEM_SYMBOL_TABLE, sizeof(struct symboltable));
+    newSymbolTable->tablename = internIdentifier(tableName);
     newSymbolTable->parent = parent;
     return newSymbolTable;
 }
 
 int calculateHashKey(char *string)
 {
-    register int h = 0;
+    // unsigned so the multiply wraps instead of overflowing, the buckets are those of the signed magnitude
+    register unsigned int h = 0;
     register char c;
     while ((c = *string++))
     {
         h += c & 0377;
         h *= 37;
     }
-    if (h < 0)
+    if ((int)h < 0)
     {
-        h = -h;
+        h = 0u - h;
     }
     return h % HASHSIZE;
 }
 
 void insertVariableIntoHash(struct Node *terminal, int type, char *typeName, struct symboltable *currentSymbolTable)
 {
+    checkSymbolTablesWritable();
     int index = calculateHashKey(terminal->data->text);
     int whereIsVariableInTable = isVariableInTable(currentSymbolTable, index, terminal->data->text);
     if (whereIsVariableInTable == 0 || whereIsVariableInTable == 2)
     {
-        struct Symbol *newData = malloc(sizeof(struct Symbol));
+        struct Symbol *newData = calloc(1, sizeof(struct Symbol));
         newData->name = strdup(terminal->data->text);
         newData->type = type;
         newData->typeName = strdup(typeName);
+        countAllocation(MEM_SYMBOL, sizeof(struct Symbol) + strlen(newData->name) + strlen(newData->typeName) + 2);
         // previously we set the category as a storage place for the isConst flag to keep track
         if (terminal->category == lconst)
         {
@@ -56,7 +117,23 @@ void insertVariableIntoHash(struct Node *terminal, int type, char *typeName, str
             newData->arraySize = terminal->data->ival;
         }
 
+        newData->slot = currentSymbolTable->numberOfSymbols++;
+        struct symboltable *scope = NULL;
+        for (scope = currentSymbolTable->parent; scope != NULL; scope = scope->parent)
+        {
+            newData->depth++;
+        }
+        if (newData->depth == 0)
+        {
+            newData->scopeKind = GLOBALSCOPE;
+        }
+        else
+        {
+            newData->scopeKind = FUNCTIONSCOPE;
+        }
+
         currentSymbolTable->hash[index] = addToFront(newData, currentSymbolTable->hash[index]);
+        PROBE_SYMBOL_INSERT(currentSymbolTable->tablename, newData->name, type);
     }
     else
     {
@@ -65,7 +142,25 @@ void insertVariableIntoHash(struct Node *terminal, int type, char *typeName, str
     }
 }
 
+int searchVariableInTable(struct symboltable *currentSymbolTable, int index, char *variableName);
+
 int isVariableInTable(struct symboltable *currentSymbolTable, int index, char *variableName)
+{
+    PROBE_LOOKUP_START(currentSymbolTable->tablename, variableName);
+    int found = searchVariableInTable(currentSymbolTable, index, variableName);
+    if (found != 0)
+    {
+        PROBE_LOOKUP_HIT(currentSymbolTable->tablename, variableName);
+    }
+    else
+    {
+        PROBE_LOOKUP_MISS(currentSymbolTable->tablename, variableName);
+    }
+    return found;
+}
+
+// 1 in the current scope, 2 the global one, 3 a struct, 4 a function, 0 nowhere
+int searchVariableInTable(struct symboltable *currentSymbolTable, int index, char *variableName)
 {
     // check current
     if (isVariableInLinkedList(variableName, currentSymbolTable->hash[index]) == 1)
@@ -94,12 +189,9 @@ int isVariableInTable(struct symboltable *currentSymbolTable, int index, char *v
         }
     }
     // check function tables
-    for (i = 0; i < functionSymbolTableLastIndex; i++)
+    if (findRegisteredTable(functionRegistry, variableName) != NULL)
     {
-        if (strcmp(functionSymbolTable[i]->tablename, variableName) == 0)
-        {
-            return 4;
-        }
+        return 4;
     }
 
     // haven't found it anywhere
@@ -108,28 +200,34 @@ int isVariableInTable(struct symboltable *currentSymbolTable, int index, char *v
 
 void addToFunctionList(struct symboltable *currentSymbolTable)
 {
+    checkSymbolTablesWritable();
+    functionSymbolTable = growTableList(functionSymbolTable, functionSymbolTableLastIndex, &functionSymbolTableCapacity);
     functionSymbolTable[functionSymbolTableLastIndex] = currentSymbolTable;
     functionSymbolTableLastIndex++;
-    if (functionSymbolTableLastIndex > 99)
+    if (functionRegistry == NULL)
     {
-        printf("There is a maximum of 100 functions allowed in VGo\n");
-        exit(3);
+        functionRegistry = createRegistry(256);
     }
+    // a redeclared function keeps finding the first table, as the list search did
+    registerName(functionRegistry, currentSymbolTable->tablename, currentSymbolTable);
 }
 
 struct symboltable *createStructTable(char *tableName, struct symboltable *parent)
 {
     struct symboltable *newSymbolTable = calloc(1, sizeof(struct symboltable));
-    newSymbolTable->tablename = strdup(tableName);
+    countAllocation(MEM_SYMBOL_TABLE, sizeof(struct symboltable));
+    newSymbolTable->tablename = internIdentifier(tableName);
     newSymbolTable->parent = parent;
 
+    checkSymbolTablesWritable();
+    structSymbolTable = growTableList(structSymbolTable, structSymbolTableLastIndex, &structSymbolTableCapacity);
     structSymbolTable[structSymbolTableLastIndex] = newSymbolTable;
     structSymbolTableLastIndex++;
-    if (structSymbolTableLastIndex > 99)
+    if (structRegistry == NULL)
     {
-        printf("There is a maximum of 100 structs allowed in VGo\n");
-        exit(3);
+        structRegistry = createRegistry(64);
     }
+    registerName(structRegistry, newSymbolTable->tablename, newSymbolTable);
     return newSymbolTable;
 }
 
@@ -167,8 +265,45 @@ void printStructSymbolTable()
     }
 }
 
+void printScopeHealth(struct symboltable *currentSymbolTable, char *kind)
+{
+    int entries = 0;
+    int longest = 0;
+    int empty = 0;
+    int i = 0;
+    for (i = 0; i < 701; i++)
+    {
+        int length = 0;
+        struct LinkedListNode *current = currentSymbolTable->hash[i];
+        for (; current != NULL; current = current->next)
+        {
+            length++;
+        }
+        entries += length;
+        empty += length == 0;
+        longest = length > longest ? length : longest;
+    }
+    printf("%-8s %-20s %8d %8.4f %8d %8d\n", kind, currentSymbolTable->tablename, entries, entries / 701.0, longest, empty);
+}
+
+void printSymbolTableHealth(struct symboltable *globalScope)
+{
+    int i = 0;
+    printf("%-8s %-20s %8s %8s %8s %8s\n", "scope", "name", "entries", "load", "longest", "empty");
+    printScopeHealth(globalScope, "global");
+    for (i = 0; i < structSymbolTableLastIndex; i++)
+    {
+        printScopeHealth(structSymbolTable[i], "struct");
+    }
+    for (i = 0; i < functionSymbolTableLastIndex; i++)
+    {
+        printScopeHealth(functionSymbolTable[i], "function");
+    }
+}
+
 void insertDeclarationPropertyList(struct symboltable *currentSymbolTable)
 {
+    checkSymbolTablesWritable();
     struct LinkedListNode *current = currentSymbolTable->declarationPropertyList;
     while (current != NULL)
     {
@@ -183,13 +318,10 @@ void insertDeclarationPropertyList(struct symboltable *currentSymbolTable)
 
 struct symboltable *findStructTable(char *variableName)
 {
-    int i = 0;
-    for (i = 0; i < structSymbolTableLastIndex; i++)
+    struct symboltable *table = findRegisteredTable(structRegistry, variableName);
+    if (table != NULL)
     {
-        if (strcmp(structSymbolTable[i]->tablename, variableName) == 0)
-        {
-            return structSymbolTable[i];
-        }
+        return table;
     }
     printf("Unable to find struct symbol table '%s'\n", variableName);
     exit(3);
@@ -197,9 +329,18 @@ struct symboltable *findStructTable(char *variableName)
 
 int findTypeInSymbolTable(struct symboltable *currentSymbolTable, char *variableName)
 {
+    PROBE_LOOKUP_START(currentSymbolTable->tablename, variableName);
     int index = calculateHashKey(variableName);
 
     int typeName = findTypeInLinkedList(variableName, currentSymbolTable->hash[index]);
+    if (typeName != -1)
+    {
+        PROBE_LOOKUP_HIT(currentSymbolTable->tablename, variableName);
+    }
+    else
+    {
+        PROBE_LOOKUP_MISS(currentSymbolTable->tablename, variableName);
+    }
 
     return typeName;
 }
@@ -210,16 +351,131 @@ char *findStructTableNameByVariable(struct symboltable *currentSymbolTable, char
     return findTypeNameInLinkedList(variableName, currentSymbolTable->hash[index]);
 }
 
-struct symboltable *findSymbolTable(char *tableName)
+struct symboltable *lookupStructTable(char *typeName)
+{
+    return findRegisteredTable(structRegistry, typeName);
+}
+
+unsigned int fieldHash(char *name, unsigned int seed)
+{
+    // FNV-1a started from the seed
+    unsigned int h = 2166136261u ^ seed;
+    while (*name != '\0')
+    {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+// place every field in slots, 0 when two land in the same slot
+int placeFields(struct FieldIndex *index)
 {
     int i = 0;
-    for (i = 0; i < functionSymbolTableLastIndex; i++)
+    for (i = 0; i <= (int)index->mask; i++)
+    {
+        index->slots[i] = -1;
+    }
+    for (i = 0; i < index->numberOfFields; i++)
     {
-        if (strcmp(functionSymbolTable[i]->tablename, tableName) == 0)
+        unsigned int slot = fieldHash(index->fields[i]->name, index->seed) & index->mask;
+        if (index->slots[slot] != -1)
         {
-            return functionSymbolTable[i];
+            return 0;
         }
+        index->slots[slot] = i;
     }
-    printf("Unable to find function symbol table '%s'\n", tableName);
-    exit(3);
-}
\ No newline at end of file
+    return 1;
+}
+
+void buildFieldIndex(struct symboltable *structTable)
+{
+    struct FieldIndex *index = calloc(1, sizeof(struct FieldIndex));
+    int i = 0;
+    checkSymbolTablesWritable();
+    index->numberOfFields = structTable->numberOfSymbols;
+    index->fields = calloc(index->numberOfFields + 1, sizeof(struct Symbol *));
+    for (i = 0; i < 701; i++)
+    {
+        struct LinkedListNode *current = NULL;
+        for (current = structTable->hash[i]; current != NULL; current = current->next)
+        {
+            if (current->data->slot >= 0 && current->data->slot < index->numberOfFields)
+            {
+                current->data->scopeKind = STRUCTSCOPE;
+                index->fields[current->data->slot] = current->data;
+            }
+        }
+    }
+
+    // twice as many slots as fields, then a seed that separates every name;
+    // after enough seeds that do not the table doubles
+    index->mask = 1;
+    while ((int)index->mask + 1 < 2 * index->numberOfFields)
+    {
+        index->mask = index->mask * 2 + 1;
+    }
+    index->slots = malloc((index->mask + 1) * sizeof(int));
+    index->seed = 0;
+    while (!placeFields(index))
+    {
+        index->seed++;
+        if (index->seed % 32 == 0)
+        {
+            index->mask = index->mask * 2 + 1;
+            index->slots = realloc(index->slots, (index->mask + 1) * sizeof(int));
+        }
+    }
+    structTable->fieldIndex = index;
+}
+
+struct Symbol *findStructField(struct symboltable *structTable, char *fieldName)
+{
+    struct FieldIndex *index = structTable->fieldIndex;
+    if (index == NULL)
+    {
+        return findSymbolInLinkedList(fieldName, structTable->hash[calculateHashKey(fieldName)]);
+    }
+    int slot = index->slots[fieldHash(fieldName, index->seed) & index->mask];
+    if (slot >= 0 && strcmp(index->fields[slot]->name, fieldName) == 0)
+    {
+        return index->fields[slot];
+    }
+    return NULL;
+}
+
+struct symboltable *lookupSymbolTable(char *tableName)
+{
+    return findRegisteredTable(functionRegistry, tableName);
+}
+
+struct symboltable *findSymbolTable(char *tableName)
+{
+    struct symboltable *table = lookupSymbolTable(tableName);
+    if (table == NULL)
+    {
+        printf("Unable to find function symbol table '%s'\n", tableName);
+        exit(3);
+    }
+    return table;
+}
+struct Symbol *findSymbolInTable(struct symboltable *currentSymbolTable, char *variableName)
+{
+    // the current scope first, then the global one, as isVariableInTable does
+    PROBE_LOOKUP_START(currentSymbolTable->tablename, variableName);
+    int index = calculateHashKey(variableName);
+    struct Symbol *symbol = findSymbolInLinkedList(variableName, currentSymbolTable->hash[index]);
+    if (symbol == NULL && currentSymbolTable->parent != NULL)
+    {
+        symbol = findSymbolInLinkedList(variableName, currentSymbolTable->parent->hash[index]);
+    }
+    if (symbol != NULL)
+    {
+        PROBE_LOOKUP_HIT(currentSymbolTable->tablename, variableName);
+    }
+    else
+    {
+        PROBE_LOOKUP_MISS(currentSymbolTable->tablename, variableName);
+    }
+    return symbol;
+}
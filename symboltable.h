@@ -3,6 +3,21 @@
 
 #define HASHSIZE 701;
 
+/*
+ * The fields of a struct in declaration order, with a perfect hash over their
+ * names built once the struct is declared: a selector costs one hash of the
+ * name, one probe and one compare however many fields there are.
+ */
+struct FieldIndex
+{
+    int numberOfFields;
+    struct Symbol **fields;
+    // slots[fieldHash(name, seed) & mask] is the index of the field, -1 for none
+    int *slots;
+    unsigned int mask;
+    unsigned int seed;
+};
+
 struct symboltable
 {
     char *tablename;
@@ -12,6 +27,10 @@ struct symboltable
     struct LinkedListNode *declarationPropertyList;
     int returnType;
     char *returnTypeName;
+    // names declared in hash, the next slot
+    int numberOfSymbols;
+    // set for struct tables by buildFieldIndex
+    struct FieldIndex *fieldIndex;
 };
 
 struct symboltable *createSymbolTable(char *tableName, struct symboltable *parent);
@@ -21,6 +40,7 @@ void checkStruct(char *typeName);
 void addToFunctionList(struct symboltable *currentSymbolTable);
 void printFunctionSymbolTable();
 void printStructSymbolTable();
+void printSymbolTableHealth(struct symboltable *globalScope);
 struct symboltable *createStructTable(char *tableName, struct symboltable *parent);
 void insertDeclarationPropertyList(struct symboltable *currentSymbolTable);
 int isVariableInTable(struct symboltable *currentSymbolTable, int index, char *variableName);
@@ -28,5 +48,13 @@ void printSymbolTable(struct symboltable *currentSymbolTable);
 struct symboltable *findStructTable(char *variableName);
 int findTypeInSymbolTable(struct symboltable *currentSymbolTable, char *variableName);
 struct symboltable *findSymbolTable(char *tableName);
+struct symboltable *lookupSymbolTable(char *tableName);
+void setSymbolTablesReadOnly(int readOnly);
+struct Symbol *findSymbolInTable(struct symboltable *currentSymbolTable, char *variableName);
+// the struct table of a type name, NULL when it is not a struct
+struct symboltable *lookupStructTable(char *typeName);
+void buildFieldIndex(struct symboltable *structTable);
+// the field of a struct by name, its slot is the index of the field
+struct Symbol *findStructField(struct symboltable *structTable, char *fieldName);
 
 #endif
@@ -0,0 +1,19 @@
+package main
+
+import "fmt"
+
+func main() {
+	var a, b, c int
+	a = 7
+	b = -3
+	c = a*b + 4
+	fmt.Println(c)
+	fmt.Println(a/2, a%2, b/2, b%2)
+	fmt.Println((a+b)*(a-b), a-b-c, -a)
+	c = 1
+	for a = 0; a < 62; a++ {
+		c = c * 2
+	}
+	fmt.Println(c, c*2, c*4)
+	fmt.Println(a < b, a >= 62, a == 62 && b != 0, a < 0 || b < 0)
+}
@@ -0,0 +1,38 @@
+package main
+
+import "fmt"
+
+var primes [20]int
+var seen [100]bool
+
+func main() {
+	var counts [10]int
+	var i, n, count int
+	count = 0
+	for n = 2; count < 20; n++ {
+		var prime bool
+		prime = 1 < 2
+		for i = 0; i < count && primes[i]*primes[i] <= n; i++ {
+			if n%primes[i] == 0 {
+				prime = 1 > 2
+			}
+		}
+		if prime {
+			primes[count] = n
+			count = count + 1
+		}
+	}
+	fmt.Println(primes[0], primes[9], primes[19])
+	for i = 0; i < 20; i++ {
+		counts[primes[i]%10] = counts[primes[i]%10] + 1
+		seen[primes[i]] = primes[i] < 50
+	}
+	fmt.Println(counts[1], counts[3], counts[7], counts[9], counts[2])
+	count = 0
+	for i = 0; i < 100; i++ {
+		if seen[i] {
+			count = count + 1
+		}
+	}
+	fmt.Println(count, seen[47], seen[49])
+}
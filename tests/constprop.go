@@ -0,0 +1,66 @@
+package main
+
+import "fmt"
+
+// values that stay constant around a loop only because the branch that would
+// change them is never taken, so the optimizer can prove conditions both ways
+
+func flags(n int) int {
+	var x, y, i int
+	x = 1
+	y = 0
+	for i = 0; i < n; i++ {
+		if x != 1 {
+			x = 2
+		}
+		if y == 5 {
+			y = 7
+		}
+	}
+	if x == 1 {
+		fmt.Println("x stays", x)
+	}
+	if y != 0 {
+		fmt.Println("y changed", y)
+	} else {
+		fmt.Println("y stays", y)
+	}
+	return x + y + i
+}
+
+func scale(n int) float64 {
+	var f, sum float64
+	var i int
+	f = 0.5
+	sum = 0.0
+	for i = 0; i < n; i++ {
+		if f > 1.0 {
+			f = f * 2.0
+		}
+		sum = sum + f
+	}
+	if f < 1.0 {
+		fmt.Println("f stays", f)
+	}
+	return sum
+}
+
+func main() {
+	var k, total int
+	total = 0
+	for k = 0; k < 3; k++ {
+		total = total + flags(k*4)
+	}
+	fmt.Println("total", total)
+	fmt.Println("sum", scale(6))
+	var done int
+	done = 0
+	for k = 0; k < 5; k++ {
+		if done == 0 {
+			total = total + k
+		}
+	}
+	if done == 0 {
+		fmt.Println("not done", total)
+	}
+}
@@ -0,0 +1,18 @@
+package main
+
+import "fmt"
+
+const size int = 16
+const mask = size - 1
+const scale float64 = 2.5
+const greeting string = "hello"
+
+func main() {
+	var values [size]int
+	var i int
+	for i = 0; i < size; i++ {
+		values[i] = (i * 7) % size
+	}
+	fmt.Println(values[3], values[15], mask, size*size)
+	fmt.Println(scale*4.0, greeting, greeting+", world")
+}
@@ -0,0 +1,42 @@
+package main
+
+import "fmt"
+
+func collatz(n int) int {
+	var steps int
+	steps = 0
+	for n != 1 {
+		if n%2 == 0 {
+			n = n / 2
+		} else {
+			n = 3*n + 1
+		}
+		steps = steps + 1
+	}
+	return steps
+}
+
+func main() {
+	var i, j, total int
+	total = 0
+	for i = 1; i <= 10; i++ {
+		for j = i; j > 0; j-- {
+			if j%3 == 0 {
+				total = total + j
+			} else {
+				if j%3 == 1 {
+					total = total - 1
+				} else {
+					total = total + 2*j
+				}
+			}
+		}
+	}
+	fmt.Println(total)
+	fmt.Println(collatz(27), collatz(97), collatz(1))
+	i = 0
+	for i < 40 {
+		i = i + 7
+	}
+	fmt.Println(i)
+}
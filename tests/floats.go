@@ -0,0 +1,25 @@
+package main
+
+import "fmt"
+
+func sqrt(x float64) float64 {
+	var guess float64
+	var i int
+	guess = x / 2.0
+	for i = 0; i < 20; i++ {
+		guess = (guess + x/guess) / 2.0
+	}
+	return guess
+}
+
+func main() {
+	var sum float64
+	var i int
+	sum = 0.0
+	for i = 1; i <= 100; i++ {
+		sum = sum + 1.0/float64(i*i)
+	}
+	fmt.Println(sum)
+	fmt.Println(sqrt(2.0), sqrt(1e6), 1.5e3/4.0)
+	fmt.Println(int(sqrt(99.0)), float64(7)/2.0, -sum < 0.0)
+}
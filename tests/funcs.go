@@ -0,0 +1,60 @@
+package main
+
+import "fmt"
+
+var calls int
+
+func gcd(a int, b int) int {
+	calls = calls + 1
+	if b == 0 {
+		return a
+	}
+	return gcd(b, a%b)
+}
+
+func ackermann(m int, n int) int {
+	if m == 0 {
+		return n + 1
+	}
+	if n == 0 {
+		return ackermann(m-1, 1)
+	}
+	return ackermann(m-1, ackermann(m, n-1))
+}
+
+func mean(a float64, b float64, c float64) float64 {
+	return (a + b + c) / 3.0
+}
+
+func isEven(n int) bool {
+	return n%2 == 0
+}
+
+func sign(n int) int {
+	if n < 0 {
+		return -1
+	}
+	if n == 0 {
+		return 0
+	}
+	return 1
+}
+
+func parity(n int) string {
+	if isEven(n) {
+		return "even"
+	}
+	return "odd"
+}
+
+func report(label string, value int) {
+	fmt.Println(label, value)
+}
+
+func main() {
+	report("gcd", gcd(1071, 462))
+	report("calls", calls)
+	report("ackermann", ackermann(2, 3))
+	fmt.Println(mean(1.5, 2.5, 6.5), isEven(gcd(48, 18)), isEven(7))
+	fmt.Println(sign(-4), sign(0), sign(9), parity(3), parity(10))
+}
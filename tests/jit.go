@@ -0,0 +1,62 @@
+package main
+
+import "fmt"
+
+type account struct {
+	balance int
+	rate    float64
+}
+
+var accounts [8]account
+var history [64]int
+
+// called far more often than the threshold, so it switches to machine code
+// while its own interpreted calls are still on the stack
+func fib(n int) int {
+	if n < 2 {
+		return n
+	}
+	return fib(n-1) + fib(n-2)
+}
+
+// crosses the threshold in the middle of the loop in main
+func deposit(index int, amount int) int {
+	accounts[index].balance = accounts[index].balance + amount
+	history[(index*7+amount)%64] = history[(index*7+amount)%64] + 1
+	return accounts[index].balance
+}
+
+func interest(index int, years int) float64 {
+	var total float64
+	var i int
+	total = float64(accounts[index].balance)
+	for i = 0; i < years; i++ {
+		total = total * (1.0 + accounts[index].rate)
+	}
+	return total
+}
+
+// called fewer times than the threshold, so compiled callers reach it interpreted
+func audit() int {
+	var i, sum int
+	sum = 0
+	for i = 0; i < 64; i++ {
+		sum = sum + history[i]*i
+	}
+	return sum
+}
+
+func main() {
+	var i, last int
+	for i = 0; i < 8; i++ {
+		accounts[i].rate = float64(i) / 100.0
+	}
+	last = 0
+	for i = 0; i < 1000; i++ {
+		last = deposit(i%8, i%13)
+	}
+	fmt.Println(fib(20), last, audit())
+	for i = 0; i < 8; i++ {
+		fmt.Println(i, accounts[i].balance, interest(i, 10))
+	}
+}
@@ -0,0 +1,49 @@
+#!/bin/sh
+# Build every program here with -emit-c, or the flags given, run it and
+# compare what it prints with the .expected file next to it, which is the
+# output of the go toolchain for the same program. Prints the difference for
+# each one that fails. With -run among the flags the programs run on the
+# bytecode interpreter instead of being built. Without -emit-c they are built
+# by the native backend: -S keeps the assembly next to the binary, -naive
+# skips the register allocator. A program that runs longer than 60 seconds
+# has hung and fails.
+# usage: tests/run.sh [path to vgo] [vgo flags]
+VGO=${1:-./vgo}
+[ $# -gt 0 ] && shift
+FLAGS=${*:--emit-c}
+DIR=$(dirname "$0")
+OUT=${TMPDIR:-/tmp}/vgo-tests
+mkdir -p "$OUT"
+
+case " $FLAGS " in
+*" -run "*) interpret=1 ;;
+*) interpret=0 ;;
+esac
+
+failed=0
+passed=0
+for source in "$DIR"/*.go
+do
+    name=$(basename "$source" .go)
+    if [ $interpret -eq 1 ]
+    then
+        timeout 60 $VGO $FLAGS "$source" > "$OUT/$name.out" 2>&1
+    elif ! $VGO $FLAGS -o "$OUT/$name" "$source" > "$OUT/$name.log" 2>&1
+    then
+        echo "$name: does not compile"
+        cat "$OUT/$name.log"
+        failed=$((failed + 1))
+        continue
+    else
+        timeout 60 "$OUT/$name" > "$OUT/$name.out" 2>&1
+    fi
+    if ! diff "$DIR/$name.expected" "$OUT/$name.out"
+    then
+        echo "$name: output differs from $name.expected"
+        failed=$((failed + 1))
+        continue
+    fi
+    passed=$((passed + 1))
+done
+echo "$FLAGS: $passed passed, $failed failed"
+[ $failed -eq 0 ]
@@ -0,0 +1,36 @@
+package main
+
+import "fmt"
+
+type point struct {
+	x int
+	y int
+}
+
+type segment struct {
+	from   point
+	to     point
+	weight float64
+}
+
+var path [4]point
+
+func main() {
+	var s segment
+	var i, length int
+	s.from.x = 1
+	s.from.y = 2
+	s.to.x = 4
+	s.to.y = 6
+	s.weight = 0.5
+	fmt.Println(s.to.x-s.from.x, s.to.y-s.from.y, s.weight*2.0)
+	for i = 0; i < 4; i++ {
+		path[i].x = i * i
+		path[i].y = 10 - i
+	}
+	length = 0
+	for i = 1; i < 4; i++ {
+		length = length + path[i].x - path[i-1].x + path[i-1].y - path[i].y
+	}
+	fmt.Println(length, path[3].x, path[2].y)
+}
@@ -0,0 +1,1020 @@
+/*
+ * Compiles the tree shapes in a .match file into C functions that match them,
+ * like flex and bison do for the scanner and the grammar.
+ * usage: tools/treematch semantic.match semanticmatch
+ * writes semanticmatch.h and semanticmatch.c
+ *
+ * A file is a list of match sets, each a list of named rules tried in order:
+ *
+ *   # the selector x.f
+ *   match Selector {
+ *       field: pexpr_no_paren($operand, PERIOD, $field:LNAME);
+ *   }
+ *
+ * A pattern is one of
+ *   _                     any child, including a NULL one
+ *   *                     any node
+ *   null                  a NULL child
+ *   leaf                  a node without children, a token
+ *   Category              a node of that category, with any children
+ *   Category(p, ..., p)   a node of that category with exactly these children
+ *   Category(p, ..., ...) at least these children, the rest can be anything
+ *   *(p, ..., p)          a node of any category with these children
+ *   $name                 any child, captured as name
+ *   $name:pattern         a captured pattern
+ * and a trailing child can be marked optional with ?, the node then matches
+ * with or without it and the capture is NULL when it is missing. Categories
+ * are the nonterminals of nonterminal.h and the tokens of vgobison.tab.h, a
+ * token's node has the token's category.
+ *
+ * Each set becomes
+ *   struct SelectorMatch { struct Node *operand; struct Node *field; };
+ *   #define SELECTOR_FIELD 1
+ *   int matchSelector(struct Node *node, struct SelectorMatch *match);
+ * which returns the number of the first rule that matches, or 0, and sets
+ * every capture (NULL for the ones the rule does not have) when one does.
+ * Captures are fields of the struct, so they cannot be the words
+ * nonterminal.h defines, like function or expr.
+ *
+ * The rules of a set are compiled together into one decision tree. Every test
+ * is on one position in the tree: whether it is NULL, its category, its number
+ * of children. The tree takes the first test the first remaining rule still
+ * needs and branches on every value the rules test at that position at once,
+ * so along any path through the function each node is loaded once, its
+ * category and its number of children are each compared once, and no rule
+ * tests a position a rule before it has already decided.
+ */
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CHILDREN 16
+#define MAX_DEPTH 16
+#define MAX_TESTS 96
+#define MAX_CAPTURES 16
+
+#define PATTERN_ANY 0
+#define PATTERN_NODE 1
+#define PATTERN_NULL 2
+#define PATTERN_CATEGORY 3
+
+struct Pattern
+{
+    int kind;
+    // the category of PATTERN_CATEGORY
+    char *category;
+    char *capture;
+    // -1 when the children are not given
+    int numberOfChildren;
+    // the node can have more children than the ones given
+    int open;
+    int optional;
+    struct Pattern *children[MAX_CHILDREN];
+};
+
+// a position in the tree, the child index at each level from the root
+struct Path
+{
+    int depth;
+    int steps[MAX_DEPTH];
+};
+
+#define TEST_NULL 0
+#define TEST_NODE 1
+#define TEST_CATEGORY 2
+#define TEST_ARITY 3
+#define TEST_MINIMUM_ARITY 4
+
+struct Test
+{
+    struct Path path;
+    int kind;
+    char *category;
+    int arity;
+};
+
+struct Capture
+{
+    char *name;
+    struct Path path;
+};
+
+// one way a rule can match; a rule with optional children has several
+struct Row
+{
+    int rule;
+    struct Test tests[MAX_TESTS];
+    int numberOfTests;
+    struct Capture captures[MAX_CAPTURES];
+    int numberOfCaptures;
+    // tests already decided on the way to the current branch
+    char done[MAX_TESTS];
+};
+
+struct Rule
+{
+    char *name;
+    char *text;
+    int line;
+};
+
+struct MatchSet
+{
+    char *name;
+    struct Rule *rules;
+    int numberOfRules;
+    struct Row **rows;
+    int numberOfRows;
+    char *captureNames[MAX_CAPTURES];
+    int numberOfCaptureNames;
+};
+
+char *sourceName;
+char *source;
+char *cursor;
+int line = 1;
+
+struct MatchSet *sets;
+int numberOfSets = 0;
+
+void fail(int errorLine, char *format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    fprintf(stderr, "%s:%d: ", sourceName, errorLine);
+    vfprintf(stderr, format, arguments);
+    fprintf(stderr, "\n");
+    va_end(arguments);
+    exit(1);
+}
+
+void *allocate(size_t size)
+{
+    void *memory = calloc(1, size);
+    if (memory == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+/* the scanner */
+
+void skipSpace()
+{
+    for (;;)
+    {
+        if (*cursor == '\n')
+        {
+            line++;
+            cursor++;
+        }
+        else if (isspace((unsigned char)*cursor))
+        {
+            cursor++;
+        }
+        else if (*cursor == '#')
+        {
+            while (*cursor != '\0' && *cursor != '\n')
+            {
+                cursor++;
+            }
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+int peek(char *text)
+{
+    skipSpace();
+    return strncmp(cursor, text, strlen(text)) == 0;
+}
+
+void expect(char *text)
+{
+    if (!peek(text))
+    {
+        fail(line, "expected '%s'", text);
+    }
+    cursor += strlen(text);
+}
+
+char *identifier()
+{
+    skipSpace();
+    if (!isalpha((unsigned char)*cursor) && *cursor != '_')
+    {
+        fail(line, "expected a name");
+    }
+    char *start = cursor;
+    while (isalnum((unsigned char)*cursor) || *cursor == '_')
+    {
+        cursor++;
+    }
+    char *name = allocate(cursor - start + 1);
+    memcpy(name, start, cursor - start);
+    return name;
+}
+
+/* the parser */
+
+struct Pattern *parsePattern()
+{
+    struct Pattern *pattern = allocate(sizeof(struct Pattern));
+    pattern->numberOfChildren = -1;
+    if (peek("$"))
+    {
+        cursor++;
+        pattern->capture = identifier();
+        if (!peek(":"))
+        {
+            pattern->kind = PATTERN_ANY;
+            return pattern;
+        }
+        cursor++;
+    }
+    if (peek("*"))
+    {
+        cursor++;
+        pattern->kind = PATTERN_NODE;
+    }
+    else
+    {
+        char *name = identifier();
+        if (strcmp(name, "_") == 0)
+        {
+            pattern->kind = PATTERN_ANY;
+            return pattern;
+        }
+        else if (strcmp(name, "null") == 0)
+        {
+            pattern->kind = PATTERN_NULL;
+            return pattern;
+        }
+        else if (strcmp(name, "leaf") == 0)
+        {
+            pattern->kind = PATTERN_NODE;
+            pattern->numberOfChildren = 0;
+            return pattern;
+        }
+        pattern->kind = PATTERN_CATEGORY;
+        pattern->category = name;
+    }
+    if (!peek("("))
+    {
+        return pattern;
+    }
+    cursor++;
+    pattern->numberOfChildren = 0;
+    while (!peek(")"))
+    {
+        if (peek("..."))
+        {
+            cursor += 3;
+            pattern->open = 1;
+            break;
+        }
+        if (pattern->numberOfChildren == MAX_CHILDREN)
+        {
+            fail(line, "more than %d children", MAX_CHILDREN);
+        }
+        struct Pattern *child = parsePattern();
+        if (peek("?"))
+        {
+            cursor++;
+            child->optional = 1;
+        }
+        else if (pattern->numberOfChildren > 0 && pattern->children[pattern->numberOfChildren - 1]->optional)
+        {
+            fail(line, "only trailing children can be optional");
+        }
+        pattern->children[pattern->numberOfChildren++] = child;
+        if (!peek(")"))
+        {
+            expect(",");
+        }
+    }
+    expect(")");
+    return pattern;
+}
+
+/* flattening a pattern into the tests of a row */
+
+void addTest(struct Row *row, struct Path path, int kind, char *category, int arity, int ruleLine)
+{
+    if (row->numberOfTests == MAX_TESTS)
+    {
+        fail(ruleLine, "pattern needs more than %d tests", MAX_TESTS);
+    }
+    struct Test *test = &row->tests[row->numberOfTests++];
+    test->path = path;
+    test->kind = kind;
+    test->category = category;
+    test->arity = arity;
+}
+
+// the nodes with children in a pattern, each has one entry in the choices of its rule
+int countChoiceNodes(struct Pattern *pattern)
+{
+    int count = 0;
+    int i = 0;
+    if (pattern->numberOfChildren < 0 || pattern->kind == PATTERN_ANY || pattern->kind == PATTERN_NULL)
+    {
+        return 0;
+    }
+    for (i = 0; i < pattern->numberOfChildren; i++)
+    {
+        count += countChoiceNodes(pattern->children[i]);
+    }
+    return count + 1;
+}
+
+// the tests of one choice of optional children, choices[i] is how many children the i-th node with children keeps
+void flattenPattern(struct Row *row, struct Pattern *pattern, struct Path path, int *choices, int *choice, int ruleLine)
+{
+    int i = 0;
+    if (pattern->capture != NULL)
+    {
+        if (row->numberOfCaptures == MAX_CAPTURES)
+        {
+            fail(ruleLine, "more than %d captures", MAX_CAPTURES);
+        }
+        row->captures[row->numberOfCaptures].name = pattern->capture;
+        row->captures[row->numberOfCaptures].path = path;
+        row->numberOfCaptures++;
+    }
+    switch (pattern->kind)
+    {
+    case PATTERN_ANY:
+        return;
+
+    case PATTERN_NULL:
+        addTest(row, path, TEST_NULL, NULL, 0, ruleLine);
+        return;
+
+    case PATTERN_NODE:
+        addTest(row, path, TEST_NODE, NULL, 0, ruleLine);
+        break;
+
+    default:
+        addTest(row, path, TEST_CATEGORY, pattern->category, 0, ruleLine);
+        break;
+    }
+    if (pattern->numberOfChildren < 0)
+    {
+        return;
+    }
+    if (path.depth == MAX_DEPTH)
+    {
+        fail(ruleLine, "pattern deeper than %d", MAX_DEPTH);
+    }
+    int kept = choices[(*choice)++];
+    addTest(row, path, pattern->open ? TEST_MINIMUM_ARITY : TEST_ARITY, NULL, kept, ruleLine);
+    for (i = 0; i < kept; i++)
+    {
+        struct Path childPath = path;
+        childPath.steps[childPath.depth++] = i;
+        flattenPattern(row, pattern->children[i], childPath, choices, choice, ruleLine);
+    }
+    for (; i < pattern->numberOfChildren; i++)
+    {
+        *choice += countChoiceNodes(pattern->children[i]);
+    }
+}
+
+// the nodes with children in the order flattenPattern visits them, with how many children each can keep
+void countChoices(struct Pattern *pattern, int *lowest, int *highest, int *count)
+{
+    int i = 0;
+    if (pattern->numberOfChildren < 0 || pattern->kind == PATTERN_ANY || pattern->kind == PATTERN_NULL)
+    {
+        return;
+    }
+    int required = pattern->numberOfChildren;
+    while (required > 0 && pattern->children[required - 1]->optional)
+    {
+        required--;
+    }
+    lowest[*count] = required;
+    highest[*count] = pattern->numberOfChildren;
+    (*count)++;
+    for (i = 0; i < pattern->numberOfChildren; i++)
+    {
+        countChoices(pattern->children[i], lowest, highest, count);
+    }
+}
+
+/*
+ * A rule with optional children becomes one row per way of leaving them out,
+ * the rows with more children first. Leaving out a child also leaves out
+ * anything inside it, so the choices of nodes that were cut are ignored and
+ * the same row can come up more than once; it is kept once.
+ */
+void addRows(struct MatchSet *set, struct Pattern *pattern, int rule, int ruleLine)
+{
+    int lowest[MAX_TESTS];
+    int highest[MAX_TESTS];
+    int choices[MAX_TESTS];
+    int count = 0;
+    int i = 0;
+    countChoices(pattern, lowest, highest, &count);
+    for (i = 0; i < count; i++)
+    {
+        choices[i] = highest[i];
+    }
+    for (;;)
+    {
+        struct Row *row = allocate(sizeof(struct Row));
+        struct Path root;
+        int choice = 0;
+        int duplicate = 0;
+        root.depth = 0;
+        row->rule = rule;
+        flattenPattern(row, pattern, root, choices, &choice, ruleLine);
+        for (i = 0; i < set->numberOfRows && !duplicate; i++)
+        {
+            struct Row *other = set->rows[i];
+            duplicate = other->rule == rule && other->numberOfTests == row->numberOfTests &&
+                        memcmp(other->tests, row->tests, row->numberOfTests * sizeof(struct Test)) == 0;
+        }
+        if (duplicate)
+        {
+            free(row);
+        }
+        else
+        {
+            set->rows = realloc(set->rows, (set->numberOfRows + 1) * sizeof(struct Row *));
+            set->rows[set->numberOfRows++] = row;
+        }
+
+        // the next choice, counting down from the last node
+        for (i = count - 1; i >= 0 && choices[i] == lowest[i]; i--)
+        {
+            choices[i] = highest[i];
+        }
+        if (i < 0)
+        {
+            return;
+        }
+        choices[i]--;
+    }
+}
+
+void addCaptureName(struct MatchSet *set, char *name, int ruleLine)
+{
+    int i = 0;
+    for (i = 0; i < set->numberOfCaptureNames; i++)
+    {
+        if (strcmp(set->captureNames[i], name) == 0)
+        {
+            return;
+        }
+    }
+    if (set->numberOfCaptureNames == MAX_CAPTURES)
+    {
+        fail(ruleLine, "more than %d captures in match %s", MAX_CAPTURES, set->name);
+    }
+    set->captureNames[set->numberOfCaptureNames++] = name;
+}
+
+void parseFile()
+{
+    int i = 0;
+    for (;;)
+    {
+        skipSpace();
+        if (*cursor == '\0')
+        {
+            return;
+        }
+        char *keyword = identifier();
+        if (strcmp(keyword, "match") != 0)
+        {
+            fail(line, "expected 'match', found '%s'", keyword);
+        }
+        sets = realloc(sets, (numberOfSets + 1) * sizeof(struct MatchSet));
+        struct MatchSet *set = &sets[numberOfSets++];
+        memset(set, 0, sizeof(struct MatchSet));
+        set->name = identifier();
+        expect("{");
+        while (!peek("}"))
+        {
+            struct Rule rule;
+            rule.line = line;
+            rule.name = identifier();
+            expect(":");
+            skipSpace();
+            char *start = cursor;
+            struct Pattern *pattern = parsePattern();
+            rule.text = allocate(cursor - start + 1);
+            memcpy(rule.text, start, cursor - start);
+            expect(";");
+            for (i = 0; i < set->numberOfRules; i++)
+            {
+                if (strcmp(set->rules[i].name, rule.name) == 0)
+                {
+                    fail(rule.line, "rule %s is already in match %s", rule.name, set->name);
+                }
+            }
+            set->rules = realloc(set->rules, (set->numberOfRules + 1) * sizeof(struct Rule));
+            set->rules[set->numberOfRules++] = rule;
+            int firstRow = set->numberOfRows;
+            addRows(set, pattern, set->numberOfRules, rule.line);
+            for (i = firstRow; i < set->numberOfRows; i++)
+            {
+                int j = 0;
+                for (j = 0; j < set->rows[i]->numberOfCaptures; j++)
+                {
+                    addCaptureName(set, set->rows[i]->captures[j].name, rule.line);
+                }
+            }
+        }
+        expect("}");
+    }
+}
+
+/* the code */
+
+FILE *output;
+
+void indent(int depth)
+{
+    int i = 0;
+    for (i = 0; i < depth; i++)
+    {
+        fputs("    ", output);
+    }
+}
+
+void emitLine(int depth, char *format, ...)
+{
+    va_list arguments;
+    indent(depth);
+    va_start(arguments, format);
+    vfprintf(output, format, arguments);
+    va_end(arguments);
+    fputc('\n', output);
+}
+
+int samePath(struct Path *first, struct Path *second)
+{
+    return first->depth == second->depth && memcmp(first->steps, second->steps, first->depth * sizeof(int)) == 0;
+}
+
+char *pathName(struct Path *path)
+{
+    static char names[4][MAX_DEPTH * 4 + 8];
+    static int next = 0;
+    char *name = names[next++ % 4];
+    int i = 0;
+    strcpy(name, "node");
+    for (i = 0; i < path->depth; i++)
+    {
+        sprintf(name + strlen(name), "_%d", path->steps[i]);
+    }
+    return name;
+}
+
+// what is known on the way to a branch: the nodes loaded into locals and the ones known not to be NULL
+struct Facts
+{
+    struct Path loaded[MAX_TESTS];
+    int numberOfLoaded;
+    struct Path present[MAX_TESTS];
+    int numberOfPresent;
+};
+
+int isKnown(struct Path *paths, int count, struct Path *path)
+{
+    int i = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (samePath(&paths[i], path))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void load(struct Facts *facts, struct Path *path, int depth)
+{
+    if (path->depth == 0 || isKnown(facts->loaded, facts->numberOfLoaded, path))
+    {
+        return;
+    }
+    struct Path parent = *path;
+    parent.depth--;
+    load(facts, &parent, depth);
+    emitLine(depth, "struct Node *%s = %s->children[%d];", pathName(path), pathName(&parent), path->steps[path->depth - 1]);
+    facts->loaded[facts->numberOfLoaded++] = *path;
+}
+
+int firstTest(struct Row *row)
+{
+    int i = 0;
+    for (i = 0; i < row->numberOfTests; i++)
+    {
+        if (!row->done[i])
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int isCategoryTest(int kind)
+{
+    return kind == TEST_NULL || kind == TEST_NODE || kind == TEST_CATEGORY;
+}
+
+// the row's undecided test of this kind at the path, -1 when it has none
+int findTest(struct Row *row, struct Path *path, int category)
+{
+    int i = 0;
+    for (i = 0; i < row->numberOfTests; i++)
+    {
+        if (!row->done[i] && samePath(&row->tests[i].path, path) && isCategoryTest(row->tests[i].kind) == category)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+struct Row *copyRow(struct Row *row)
+{
+    struct Row *copy = allocate(sizeof(struct Row));
+    memcpy(copy, row, sizeof(struct Row));
+    return copy;
+}
+
+void emitRows(struct MatchSet *set, struct Row **rows, int numberOfRows, struct Facts facts, int depth);
+
+/*
+ * The rows that go on down one branch of a test at path. outcome gives, for a
+ * row's test there, 1 when the branch decides it passed (it is dropped), 0
+ * when it failed (the row is dropped), and -1 when it is still open.
+ */
+#define BRANCH_NULL 0
+#define BRANCH_CATEGORY 1
+#define BRANCH_OTHER_CATEGORY 2
+#define BRANCH_ARITY 3
+#define BRANCH_OTHER_ARITY 4
+#define BRANCH_AT_LEAST 5
+#define BRANCH_LESS_THAN 6
+
+int outcome(struct Test *test, int branch, char *category, int arity)
+{
+    switch (branch)
+    {
+    case BRANCH_NULL:
+        return test->kind == TEST_NULL;
+
+    case BRANCH_CATEGORY:
+        return test->kind == TEST_NODE || (test->kind == TEST_CATEGORY && strcmp(test->category, category) == 0);
+
+    case BRANCH_OTHER_CATEGORY:
+        // none of the categories tested at the path
+        return test->kind == TEST_NODE;
+
+    case BRANCH_ARITY:
+        return test->kind == TEST_ARITY ? test->arity == arity : test->arity <= arity;
+
+    case BRANCH_OTHER_ARITY:
+        // none of the exact numbers tested at the path
+        return test->kind == TEST_ARITY ? 0 : -1;
+
+    case BRANCH_AT_LEAST:
+        return test->arity <= arity ? 1 : -1;
+
+    default:
+        return test->arity < arity ? -1 : 0;
+    }
+}
+
+void emitBranch(struct MatchSet *set, struct Row **rows, int numberOfRows, struct Path *path, int category, int branch, char *value,
+                int arity, struct Facts facts, int depth)
+{
+    struct Row **kept = allocate((numberOfRows + 1) * sizeof(struct Row *));
+    int numberOfKept = 0;
+    int i = 0;
+    for (i = 0; i < numberOfRows; i++)
+    {
+        int index = findTest(rows[i], path, category);
+        int result = index < 0 ? -1 : outcome(&rows[i]->tests[index], branch, value, arity);
+        if (result == 0)
+        {
+            continue;
+        }
+        kept[numberOfKept] = copyRow(rows[i]);
+        if (result == 1)
+        {
+            kept[numberOfKept]->done[index] = 1;
+        }
+        numberOfKept++;
+    }
+    if (branch != BRANCH_NULL && category)
+    {
+        facts.present[facts.numberOfPresent++] = *path;
+    }
+    emitRows(set, kept, numberOfKept, facts, depth);
+    for (i = 0; i < numberOfKept; i++)
+    {
+        free(kept[i]);
+    }
+    free(kept);
+}
+
+void emitCategoryTest(struct MatchSet *set, struct Row **rows, int numberOfRows, struct Path *path, struct Facts facts, int depth)
+{
+    char *categories[MAX_TESTS];
+    int numberOfCategories = 0;
+    int i = 0;
+    int j = 0;
+    char *name = pathName(path);
+    for (i = 0; i < numberOfRows; i++)
+    {
+        int index = findTest(rows[i], path, 1);
+        if (index < 0)
+        {
+            continue;
+        }
+        struct Test *test = &rows[i]->tests[index];
+        for (j = 0; test->kind == TEST_CATEGORY && j < numberOfCategories && strcmp(categories[j], test->category) != 0; j++)
+        {
+        }
+        if (test->kind == TEST_CATEGORY && j == numberOfCategories)
+        {
+            categories[numberOfCategories++] = test->category;
+        }
+    }
+    if (!isKnown(facts.present, facts.numberOfPresent, path))
+    {
+        emitLine(depth, "if (%s == NULL)", name);
+        emitLine(depth, "{");
+        emitBranch(set, rows, numberOfRows, path, 1, BRANCH_NULL, NULL, 0, facts, depth + 1);
+        emitLine(depth, "}");
+    }
+    // past here the node is there, a NULL test fails and a node test passes
+    if (numberOfCategories == 0)
+    {
+        emitBranch(set, rows, numberOfRows, path, 1, BRANCH_OTHER_CATEGORY, NULL, 0, facts, depth);
+        return;
+    }
+    name = pathName(path);
+    if (numberOfCategories == 1)
+    {
+        emitLine(depth, "if (%s->category == %s)", name, categories[0]);
+        emitLine(depth, "{");
+        emitBranch(set, rows, numberOfRows, path, 1, BRANCH_CATEGORY, categories[0], 0, facts, depth + 1);
+        emitLine(depth, "}");
+        emitBranch(set, rows, numberOfRows, path, 1, BRANCH_OTHER_CATEGORY, NULL, 0, facts, depth);
+        return;
+    }
+    emitLine(depth, "switch (%s->category)", name);
+    emitLine(depth, "{");
+    for (i = 0; i < numberOfCategories; i++)
+    {
+        emitLine(depth, "case %s:", categories[i]);
+        emitLine(depth, "{");
+        emitBranch(set, rows, numberOfRows, path, 1, BRANCH_CATEGORY, categories[i], 0, facts, depth + 1);
+        emitLine(depth, "}");
+    }
+    emitLine(depth, "}");
+    emitBranch(set, rows, numberOfRows, path, 1, BRANCH_OTHER_CATEGORY, NULL, 0, facts, depth);
+}
+
+void emitArityTest(struct MatchSet *set, struct Row **rows, int numberOfRows, struct Path *path, struct Test *first, struct Facts facts,
+                   int depth)
+{
+    int arities[MAX_TESTS];
+    int numberOfArities = 0;
+    int i = 0;
+    int j = 0;
+    char *name = pathName(path);
+    for (i = 0; i < numberOfRows; i++)
+    {
+        int index = findTest(rows[i], path, 0);
+        if (index < 0 || rows[i]->tests[index].kind != TEST_ARITY)
+        {
+            continue;
+        }
+        for (j = 0; j < numberOfArities && arities[j] != rows[i]->tests[index].arity; j++)
+        {
+        }
+        if (j == numberOfArities)
+        {
+            arities[numberOfArities++] = rows[i]->tests[index].arity;
+        }
+    }
+    if (numberOfArities == 0)
+    {
+        // only minimums are left, split at the first row's
+        emitLine(depth, "if (%s->numberOfChildren >= %d)", name, first->arity);
+        emitLine(depth, "{");
+        emitBranch(set, rows, numberOfRows, path, 0, BRANCH_AT_LEAST, NULL, first->arity, facts, depth + 1);
+        emitLine(depth, "}");
+        emitBranch(set, rows, numberOfRows, path, 0, BRANCH_LESS_THAN, NULL, first->arity, facts, depth);
+        return;
+    }
+    if (numberOfArities == 1)
+    {
+        emitLine(depth, "if (%s->numberOfChildren == %d)", name, arities[0]);
+        emitLine(depth, "{");
+        emitBranch(set, rows, numberOfRows, path, 0, BRANCH_ARITY, NULL, arities[0], facts, depth + 1);
+        emitLine(depth, "}");
+        emitBranch(set, rows, numberOfRows, path, 0, BRANCH_OTHER_ARITY, NULL, 0, facts, depth);
+        return;
+    }
+    emitLine(depth, "switch (%s->numberOfChildren)", name);
+    emitLine(depth, "{");
+    for (i = 0; i < numberOfArities; i++)
+    {
+        emitLine(depth, "case %d:", arities[i]);
+        emitLine(depth, "{");
+        emitBranch(set, rows, numberOfRows, path, 0, BRANCH_ARITY, NULL, arities[i], facts, depth + 1);
+        emitLine(depth, "}");
+    }
+    emitLine(depth, "}");
+    emitBranch(set, rows, numberOfRows, path, 0, BRANCH_OTHER_ARITY, NULL, 0, facts, depth);
+}
+
+void emitMatch(struct MatchSet *set, struct Row *row, struct Facts facts, int depth)
+{
+    int i = 0;
+    int j = 0;
+    struct Rule *rule = &set->rules[row->rule - 1];
+    emitLine(depth, "// %s: %s", rule->name, rule->text);
+    for (i = 0; i < set->numberOfCaptureNames; i++)
+    {
+        struct Capture *capture = NULL;
+        for (j = 0; j < row->numberOfCaptures; j++)
+        {
+            if (strcmp(row->captures[j].name, set->captureNames[i]) == 0)
+            {
+                capture = &row->captures[j];
+            }
+        }
+        if (capture == NULL)
+        {
+            emitLine(depth, "match->%s = NULL;", set->captureNames[i]);
+        }
+        else
+        {
+            load(&facts, &capture->path, depth);
+            emitLine(depth, "match->%s = %s;", set->captureNames[i], pathName(&capture->path));
+        }
+    }
+    emitLine(depth, "return %d;", row->rule);
+}
+
+void emitRows(struct MatchSet *set, struct Row **rows, int numberOfRows, struct Facts facts, int depth)
+{
+    if (numberOfRows == 0)
+    {
+        emitLine(depth, "return 0;");
+        return;
+    }
+    int index = firstTest(rows[0]);
+    if (index < 0)
+    {
+        emitMatch(set, rows[0], facts, depth);
+        return;
+    }
+    struct Test *test = &rows[0]->tests[index];
+    load(&facts, &test->path, depth);
+    if (isCategoryTest(test->kind))
+    {
+        emitCategoryTest(set, rows, numberOfRows, &test->path, facts, depth);
+    }
+    else
+    {
+        emitArityTest(set, rows, numberOfRows, &test->path, test, facts, depth);
+    }
+}
+
+void upper(char *to, char *from)
+{
+    for (; *from != '\0'; from++)
+    {
+        *to++ = toupper((unsigned char)*from);
+    }
+    *to = '\0';
+}
+
+void writeHeader(char *base)
+{
+    char guard[256];
+    int i = 0;
+    int j = 0;
+    char *slash = strrchr(base, '/');
+    upper(guard, slash != NULL ? slash + 1 : base);
+    fprintf(output, "// generated by tools/treematch from %s, do not edit\n", sourceName);
+    fprintf(output, "#ifndef %s\n#define %s\n\nstruct Node;\n", guard, guard);
+    for (i = 0; i < numberOfSets; i++)
+    {
+        struct MatchSet *set = &sets[i];
+        char setName[256];
+        char ruleName[256];
+        upper(setName, set->name);
+        fprintf(output, "\nstruct %sMatch\n{\n", set->name);
+        for (j = 0; j < set->numberOfCaptureNames; j++)
+        {
+            fprintf(output, "    struct Node *%s;\n", set->captureNames[j]);
+        }
+        if (set->numberOfCaptureNames == 0)
+        {
+            fprintf(output, "    int unused;\n");
+        }
+        fprintf(output, "};\n\n");
+        for (j = 0; j < set->numberOfRules; j++)
+        {
+            upper(ruleName, set->rules[j].name);
+            fprintf(output, "#define %s_%s %d\n", setName, ruleName, j + 1);
+        }
+        fprintf(output, "int match%s(struct Node *node, struct %sMatch *match);\n", set->name, set->name);
+    }
+    fprintf(output, "\n#endif\n");
+}
+
+void writeSource(char *base)
+{
+    int i = 0;
+    char *slash = strrchr(base, '/');
+    fprintf(output, "// generated by tools/treematch from %s, do not edit\n", sourceName);
+    fprintf(output, "#include \"%s.h\"\n#include \"tree.h\"\n#include \"vgobison.tab.h\"\n#include \"nonterminal.h\"\n#include <stddef.h>\n",
+            slash != NULL ? slash + 1 : base);
+    for (i = 0; i < numberOfSets; i++)
+    {
+        struct MatchSet *set = &sets[i];
+        struct Facts facts;
+        memset(&facts, 0, sizeof(facts));
+        fprintf(output, "\nint match%s(struct Node *node, struct %sMatch *match)\n{\n", set->name, set->name);
+        emitRows(set, set->rows, set->numberOfRows, facts, 1);
+        fprintf(output, "}\n");
+    }
+}
+
+char *readFile(char *path)
+{
+    FILE *input = fopen(path, "r");
+    if (input == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    fseek(input, 0, SEEK_END);
+    long size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    char *text = allocate(size + 1);
+    if (fread(text, 1, size, input) != (size_t)size)
+    {
+        perror(path);
+        exit(1);
+    }
+    fclose(input);
+    return text;
+}
+
+int main(int argc, char **argv)
+{
+    char path[1024];
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: treematch file.match output\n");
+        return 1;
+    }
+    sourceName = argv[1];
+    source = readFile(argv[1]);
+    cursor = source;
+    parseFile();
+
+    snprintf(path, sizeof(path), "%s.h", argv[2]);
+    output = fopen(path, "w");
+    if (output == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    writeHeader(argv[2]);
+    fclose(output);
+
+    snprintf(path, sizeof(path), "%s.c", argv[2]);
+    output = fopen(path, "w");
+    if (output == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    writeSource(argv[2]);
+    fclose(output);
+    return 0;
+}
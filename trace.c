@@ -0,0 +1,137 @@
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int traceEnabled = 0;
+
+FILE *traceFile = NULL;
+pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+int traceEvents = 0;
+int traceThreads = 0;
+// the track of the calling thread in the viewer, 0 until it writes its first event
+__thread int traceThread = 0;
+
+double traceClock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+void writeTraceString(char *text)
+{
+    fputc('"', traceFile);
+    for (; *text != '\0'; text++)
+    {
+        if (*text == '"' || *text == '\\')
+        {
+            fputc('\\', traceFile);
+            fputc(*text, traceFile);
+        }
+        else if ((unsigned char)*text < ' ')
+        {
+            fprintf(traceFile, "\\u%04x", (unsigned char)*text);
+        }
+        else
+        {
+            fputc(*text, traceFile);
+        }
+    }
+    fputc('"', traceFile);
+}
+
+// called with traceLock held, starts an event and names the thread's track the first time it writes
+void beginTraceEvent()
+{
+    if (traceThread == 0)
+    {
+        traceThread = ++traceThreads;
+        fprintf(traceFile, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", traceEvents++ > 0 ? "," : "", traceThread);
+        if (traceThread == 1)
+        {
+            writeTraceString("vgo");
+        }
+        else
+        {
+            fprintf(traceFile, "\"checker %d\"", traceThread - 1);
+        }
+        fputs("}}", traceFile);
+    }
+    fprintf(traceFile, "%s\n{", traceEvents++ > 0 ? "," : "");
+}
+
+void openTrace(char *path)
+{
+    traceFile = fopen(path, "w");
+    if (traceFile == NULL)
+    {
+        printf("Unable to write the trace to %s\n", path);
+        exit(3);
+    }
+    traceEnabled = 1;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", traceFile);
+    // a compilation that stops on an error still leaves a trace that opens
+    atexit(closeTrace);
+}
+
+void closeTrace()
+{
+    if (traceFile == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&traceLock);
+    fputs("\n]}\n", traceFile);
+    fclose(traceFile);
+    traceFile = NULL;
+    traceEnabled = 0;
+    pthread_mutex_unlock(&traceLock);
+}
+
+void traceSpan(char *category, char *name, double start, char *arguments)
+{
+    traceSummedSpan(category, name, start, traceClock() - start, arguments);
+}
+
+void traceSummedSpan(char *category, char *name, double start, double duration, char *arguments)
+{
+    pthread_mutex_lock(&traceLock);
+    if (traceFile != NULL)
+    {
+        beginTraceEvent();
+        fputs("\"ph\":\"X\",\"cat\":", traceFile);
+        writeTraceString(category);
+        fputs(",\"name\":", traceFile);
+        writeTraceString(name);
+        fprintf(traceFile, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", traceThread, start, duration);
+        if (arguments != NULL)
+        {
+            fprintf(traceFile, ",\"args\":{%s}", arguments);
+        }
+        fputc('}', traceFile);
+    }
+    pthread_mutex_unlock(&traceLock);
+}
+
+void traceDeclaration(char *category, char *kind, char *name, double start)
+{
+    char label[256];
+    snprintf(label, sizeof(label), "%s %s", kind, name);
+    traceSpan(category, label, start, NULL);
+}
+
+void traceCounter(char *name, long long value)
+{
+    double now = traceClock();
+    pthread_mutex_lock(&traceLock);
+    if (traceFile != NULL)
+    {
+        beginTraceEvent();
+        fputs("\"ph\":\"C\",\"name\":", traceFile);
+        writeTraceString(name);
+        fprintf(traceFile, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"count\":%lld}}", traceThread, now, value);
+    }
+    pthread_mutex_unlock(&traceLock);
+}
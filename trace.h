@@ -0,0 +1,26 @@
+#ifndef TRACE
+#define TRACE
+
+/*
+ * -trace=out.json writes a timeline of the compilation as Chrome trace events,
+ * for chrome://tracing or ui.perfetto.dev. A span is written as one complete
+ * event when it ends, so the type checks on the work pool threads each write
+ * their own without sharing anything but the file. Every call site checks
+ * traceEnabled first, a compilation without the flag only pays that test.
+ */
+
+extern int traceEnabled;
+
+void openTrace(char *path);
+void closeTrace();
+// microseconds on the monotonic clock, read through the vDSO without a system call
+double traceClock();
+// a span from start to now; arguments is the inside of a JSON object or NULL
+void traceSpan(char *category, char *name, double start, char *arguments);
+// time summed over many short intervals, like the scanner's, drawn as one span from start
+void traceSummedSpan(char *category, char *name, double start, double duration, char *arguments);
+// the span of a declaration, named by its kind and name
+void traceDeclaration(char *category, char *kind, char *name, double start);
+void traceCounter(char *name, long long value);
+
+#endif
@@ -3,8 +3,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "nonterminal.h"
+#include "memreport.h"
+#include "probes.h"
 #include <string.h>
 
+int syntaxOnly = 0;
+char insertedSemicolon[] = ";";
+
 int treeprint(struct Node *t, int depth)
 {
   if (t != NULL)
@@ -37,6 +42,11 @@ int treeprint(struct Node *t, int depth)
 
 struct Node *createTree(int category, char *categoryName, int size, ...)
 {
+  PROBE_NODE(category, categoryName, size);
+  if (syntaxOnly)
+  {
+    return NULL;
+  }
   va_list valist;
   va_start(valist, size);
 
@@ -46,6 +56,17 @@ struct Node *createTree(int category, char *categoryName, int size, ...)
   newString = strcpy(newString, categoryName);
   tree->categoryName = newString;
   tree->numberOfChildren = size;
+  tree->children = NULL;
+  tree->data = NULL;
+  tree->constant = NULL;
+  tree->declaration = NULL;
+  countAllocation(MEM_TREE_NODE, sizeof(struct Node));
+  countAllocation(MEM_TREE_NAME, strlen(categoryName) + 1);
+  if (size > 0)
+  {
+    tree->children = malloc(size * sizeof(struct Node *));
+    countAllocation(MEM_TREE_CHILDREN, size * sizeof(struct Node *));
+  }
 
   int i = 0;
   for (i = 0; i < size; i++)
@@ -1,13 +1,17 @@
 #ifndef TREE
 #define TREE
 
+struct Constant;
+struct Symbol;
+
 struct Token
 {
     int category;
     char *text;
     int linenumber;
     char *filename;
-    int ival;
+    // decoded by literal.c, -1 when an integer literal does not fit
+    long long ival;
     double dval;
     char *sval;
 };
@@ -17,10 +21,20 @@ struct Node
     int category;
     char *categoryName;
     int numberOfChildren;
-    struct Node *children[9];
+    struct Node **children;
     struct Token *data;
+    // the folded value when the node is a constant expression, see constant.c
+    struct Constant *constant;
+    // the declaration an identifier was bound to by scopeAnalysis, NULL for the
+    // names that are not variables or constants
+    struct Symbol *declaration;
 };
 
+// set by -syntax-only, files are parsed to find syntax errors and no tree is built
+extern int syntaxOnly;
+// the text of every semicolon the scanner inserts at a newline, shared and never freed
+extern char insertedSemicolon[];
+
 struct Node *createTree(int category, char *categoryName, int size, ...);
 int treeprint(struct Node *t, int depth);
 
@@ -0,0 +1,566 @@
+#include "utf8.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_SSSE3 1
+#endif
+
+// the length of the valid sequence at text, 0 when it is not one or is cut off
+static int sequenceLength(const unsigned char *text, size_t length)
+{
+    unsigned char lead = text[0];
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    size_t size;
+    size_t i;
+    if (lead < 0x80)
+    {
+        return 1;
+    }
+    else if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        size = 2;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        size = 3;
+        // no overlong encodings and no surrogates
+        if (lead == 0xE0)
+        {
+            low = 0xA0;
+        }
+        else if (lead == 0xED)
+        {
+            high = 0x9F;
+        }
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        size = 4;
+        // no overlong encodings and nothing past U+10FFFF
+        if (lead == 0xF0)
+        {
+            low = 0x90;
+        }
+        else if (lead == 0xF4)
+        {
+            high = 0x8F;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+    if (length < size || text[1] < low || text[1] > high)
+    {
+        return 0;
+    }
+    for (i = 2; i < size; i++)
+    {
+        if (text[i] < 0x80 || text[i] > 0xBF)
+        {
+            return 0;
+        }
+    }
+    return size;
+}
+
+long long findInvalidUtf8(const unsigned char *text, size_t length)
+{
+    size_t i = 0;
+    while (i < length)
+    {
+        unsigned long long word;
+        if (i + 8 <= length)
+        {
+            memcpy(&word, text + i, 8);
+            if ((word & 0x8080808080808080ULL) == 0)
+            {
+                i += 8;
+                continue;
+            }
+        }
+        int size = sequenceLength(text + i, length - i);
+        if (size == 0)
+        {
+            return i;
+        }
+        i += size;
+    }
+    return -1;
+}
+
+#ifdef UTF8_SSSE3
+
+/*
+ * Each table is indexed by one nibble and gives the errors that nibble allows,
+ * a byte pair is an error when a bit survives the and of all three. The
+ * lookups are on the high and low nibble of the byte before and the high
+ * nibble of the byte itself.
+ */
+#define TOO_SHORT (1 << 0)
+#define TOO_LONG (1 << 1)
+#define OVERLONG_3 (1 << 2)
+#define TOO_LARGE (1 << 3)
+#define SURROGATE (1 << 4)
+#define OVERLONG_2 (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4 (1 << 6)
+#define TWO_CONTINUATIONS (1 << 7)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTINUATIONS)
+
+static const unsigned char firstHighNibble[16] = {
+    // ASCII
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    // continuation
+    TWO_CONTINUATIONS, TWO_CONTINUATIONS, TWO_CONTINUATIONS, TWO_CONTINUATIONS,
+    // two byte lead, 1100 then 1101
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    // three byte lead
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    // four byte lead
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+
+static const unsigned char firstLowNibble[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000};
+
+static const unsigned char secondHighNibble[16] = {
+    // ASCII
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    // continuation 1000, 1001, then 101x
+    TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+    // lead
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+
+// a block ends in the middle of a sequence when one of its last three bytes is a lead at least this large
+static const unsigned char incompleteMaximum[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF};
+
+struct Utf8Blocks
+{
+    __m128i previous;
+    __m128i previousIncomplete;
+    __m128i error;
+};
+
+__attribute__((target("ssse3"))) static inline void checkUtf8Block(struct Utf8Blocks *blocks, __m128i input)
+{
+    if (_mm_movemask_epi8(input) == 0)
+    {
+        // ASCII, only a sequence the block before left open can be wrong
+        blocks->error = _mm_or_si128(blocks->error, blocks->previousIncomplete);
+        blocks->previousIncomplete = _mm_setzero_si128();
+        blocks->previous = input;
+        return;
+    }
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i previous1 = _mm_alignr_epi8(input, blocks->previous, 15);
+    __m128i firstHigh = _mm_and_si128(_mm_srli_epi16(previous1, 4), nibble);
+    __m128i firstLow = _mm_and_si128(previous1, nibble);
+    __m128i secondHigh = _mm_and_si128(_mm_srli_epi16(input, 4), nibble);
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)firstHighNibble), firstHigh),
+                      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)firstLowNibble), firstLow)),
+        _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)secondHighNibble), secondHigh));
+
+    // the third and fourth bytes of a sequence must be continuations, and only they may follow one
+    __m128i previous2 = _mm_alignr_epi8(input, blocks->previous, 14);
+    __m128i previous3 = _mm_alignr_epi8(input, blocks->previous, 13);
+    __m128i thirdByte = _mm_subs_epu8(previous2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i fourthByte = _mm_subs_epu8(previous3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i mustContinue = _mm_and_si128(_mm_or_si128(thirdByte, fourthByte), _mm_set1_epi8((char)0x80));
+    blocks->error = _mm_or_si128(blocks->error, _mm_xor_si128(mustContinue, special));
+
+    blocks->previousIncomplete = _mm_subs_epu8(input, _mm_loadu_si128((const __m128i *)incompleteMaximum));
+    blocks->previous = input;
+}
+
+__attribute__((target("ssse3"))) static int isValidUtf8Ssse3(const unsigned char *text, size_t length)
+{
+    struct Utf8Blocks blocks;
+    blocks.previous = _mm_setzero_si128();
+    blocks.previousIncomplete = _mm_setzero_si128();
+    blocks.error = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 64 <= length)
+    {
+        __m128i input0 = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i input1 = _mm_loadu_si128((const __m128i *)(text + i + 16));
+        __m128i input2 = _mm_loadu_si128((const __m128i *)(text + i + 32));
+        __m128i input3 = _mm_loadu_si128((const __m128i *)(text + i + 48));
+        // source is nearly all ASCII, so test 64 bytes with one branch first
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(input0, input1), _mm_or_si128(input2, input3))) == 0)
+        {
+            blocks.error = _mm_or_si128(blocks.error, blocks.previousIncomplete);
+            blocks.previousIncomplete = _mm_setzero_si128();
+            blocks.previous = input3;
+        }
+        else
+        {
+            checkUtf8Block(&blocks, input0);
+            checkUtf8Block(&blocks, input1);
+            checkUtf8Block(&blocks, input2);
+            checkUtf8Block(&blocks, input3);
+        }
+        i += 64;
+    }
+    for (; i + 16 <= length; i += 16)
+    {
+        checkUtf8Block(&blocks, _mm_loadu_si128((const __m128i *)(text + i)));
+    }
+    // the rest padded with ASCII, which also shows a sequence cut off at the very end
+    unsigned char last[16];
+    memset(last, 0, sizeof(last));
+    memcpy(last, text + i, length - i);
+    checkUtf8Block(&blocks, _mm_loadu_si128((const __m128i *)last));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(blocks.error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+#endif
+
+int isValidUtf8(const unsigned char *text, size_t length)
+{
+#ifdef UTF8_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        return isValidUtf8Ssse3(text, length);
+    }
+#endif
+    return findInvalidUtf8(text, length) < 0;
+}
+
+long long checkUtf8Chunk(struct Utf8Stream *stream, const unsigned char *chunk, size_t length)
+{
+    long long chunkOffset = stream->offset;
+    size_t start = 0;
+    size_t end = length;
+    size_t k;
+    stream->offset += length;
+
+    if (stream->numberOfPending > 0)
+    {
+        // finish the sequence the last chunk cut, its lead gives its length
+        int size = stream->pending[0] >= 0xF0 ? 4 : stream->pending[0] >= 0xE0 ? 3 : 2;
+        while (stream->numberOfPending < size && start < length)
+        {
+            stream->pending[stream->numberOfPending++] = chunk[start++];
+        }
+        if (stream->numberOfPending < size)
+        {
+            return -1;
+        }
+        if (sequenceLength(stream->pending, size) != size)
+        {
+            return stream->pendingOffset;
+        }
+        stream->numberOfPending = 0;
+    }
+
+    // a lead in the last three bytes whose sequence runs past the end is held back
+    for (k = 1; k <= 3 && k <= length - start; k++)
+    {
+        unsigned char byte = chunk[length - k];
+        if (byte >= 0xC2 && byte <= 0xF4)
+        {
+            size_t size = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : 2;
+            if (size > k)
+            {
+                end = length - k;
+            }
+            break;
+        }
+        if (byte < 0x80 || byte > 0xBF)
+        {
+            break;
+        }
+    }
+
+    if (!isValidUtf8(chunk + start, end - start))
+    {
+        return chunkOffset + start + findInvalidUtf8(chunk + start, end - start);
+    }
+    memcpy(stream->pending, chunk + end, length - end);
+    stream->numberOfPending = length - end;
+    stream->pendingOffset = chunkOffset + end;
+    return -1;
+}
+
+long long finishUtf8Stream(struct Utf8Stream *stream)
+{
+    long long offset = stream->numberOfPending > 0 ? stream->pendingOffset : -1;
+    memset(stream, 0, sizeof(*stream));
+    return offset;
+}
+
+int decodeUtf8(const unsigned char *text, int *codePoint)
+{
+    if (text[0] < 0x80)
+    {
+        *codePoint = text[0];
+        return 1;
+    }
+    else if (text[0] < 0xE0)
+    {
+        *codePoint = (text[0] & 0x1F) << 6 | (text[1] & 0x3F);
+        return 2;
+    }
+    else if (text[0] < 0xF0)
+    {
+        *codePoint = (text[0] & 0x0F) << 12 | (text[1] & 0x3F) << 6 | (text[2] & 0x3F);
+        return 3;
+    }
+    *codePoint = (text[0] & 0x07) << 18 | (text[1] & 0x3F) << 12 | (text[2] & 0x3F) << 6 | (text[3] & 0x3F);
+    return 4;
+}
+
+/*
+ * The letters (categories Lu, Ll, Lt, Lm and Lo) and decimal digits (Nd) above
+ * ASCII in Unicode 14.0, as the first code point of each run and how many
+ * follow it. Generated with python's unicodedata:
+ *   runs of cp in range(0x80, 0x110000) where unicodedata.category(chr(cp)) matches
+ */
+static const unsigned int letterFirst[646] = {
+    0x00AA, 0x00B5, 0x00BA, 0x00C0, 0x00D8, 0x00F8, 0x02C6, 0x02E0,
+    0x02EC, 0x02EE, 0x0370, 0x0376, 0x037A, 0x037F, 0x0386, 0x0388,
+    0x038C, 0x038E, 0x03A3, 0x03F7, 0x048A, 0x0531, 0x0559, 0x0560,
+    0x05D0, 0x05EF, 0x0620, 0x066E, 0x0671, 0x06D5, 0x06E5, 0x06EE,
+    0x06FA, 0x06FF, 0x0710, 0x0712, 0x074D, 0x07B1, 0x07CA, 0x07F4,
+    0x07FA, 0x0800, 0x081A, 0x0824, 0x0828, 0x0840, 0x0860, 0x0870,
+    0x0889, 0x08A0, 0x0904, 0x093D, 0x0950, 0x0958, 0x0971, 0x0985,
+    0x098F, 0x0993, 0x09AA, 0x09B2, 0x09B6, 0x09BD, 0x09CE, 0x09DC,
+    0x09DF, 0x09F0, 0x09FC, 0x0A05, 0x0A0F, 0x0A13, 0x0A2A, 0x0A32,
+    0x0A35, 0x0A38, 0x0A59, 0x0A5E, 0x0A72, 0x0A85, 0x0A8F, 0x0A93,
+    0x0AAA, 0x0AB2, 0x0AB5, 0x0ABD, 0x0AD0, 0x0AE0, 0x0AF9, 0x0B05,
+    0x0B0F, 0x0B13, 0x0B2A, 0x0B32, 0x0B35, 0x0B3D, 0x0B5C, 0x0B5F,
+    0x0B71, 0x0B83, 0x0B85, 0x0B8E, 0x0B92, 0x0B99, 0x0B9C, 0x0B9E,
+    0x0BA3, 0x0BA8, 0x0BAE, 0x0BD0, 0x0C05, 0x0C0E, 0x0C12, 0x0C2A,
+    0x0C3D, 0x0C58, 0x0C5D, 0x0C60, 0x0C80, 0x0C85, 0x0C8E, 0x0C92,
+    0x0CAA, 0x0CB5, 0x0CBD, 0x0CDD, 0x0CE0, 0x0CF1, 0x0D04, 0x0D0E,
+    0x0D12, 0x0D3D, 0x0D4E, 0x0D54, 0x0D5F, 0x0D7A, 0x0D85, 0x0D9A,
+    0x0DB3, 0x0DBD, 0x0DC0, 0x0E01, 0x0E32, 0x0E40, 0x0E81, 0x0E84,
+    0x0E86, 0x0E8C, 0x0EA5, 0x0EA7, 0x0EB2, 0x0EBD, 0x0EC0, 0x0EC6,
+    0x0EDC, 0x0F00, 0x0F40, 0x0F49, 0x0F88, 0x1000, 0x103F, 0x1050,
+    0x105A, 0x1061, 0x1065, 0x106E, 0x1075, 0x108E, 0x10A0, 0x10C7,
+    0x10CD, 0x10D0, 0x10FC, 0x124A, 0x1250, 0x1258, 0x125A, 0x1260,
+    0x128A, 0x1290, 0x12B2, 0x12B8, 0x12C0, 0x12C2, 0x12C8, 0x12D8,
+    0x1312, 0x1318, 0x1380, 0x13A0, 0x13F8, 0x1401, 0x166F, 0x1681,
+    0x16A0, 0x16F1, 0x1700, 0x171F, 0x1740, 0x1760, 0x176E, 0x1780,
+    0x17D7, 0x17DC, 0x1820, 0x1880, 0x1887, 0x18AA, 0x18B0, 0x1900,
+    0x1950, 0x1970, 0x1980, 0x19B0, 0x1A00, 0x1A20, 0x1AA7, 0x1B05,
+    0x1B45, 0x1B83, 0x1BAE, 0x1BBA, 0x1C00, 0x1C4D, 0x1C5A, 0x1C80,
+    0x1C90, 0x1CBD, 0x1CE9, 0x1CEE, 0x1CF5, 0x1CFA, 0x1D00, 0x1E00,
+    0x1F18, 0x1F20, 0x1F48, 0x1F50, 0x1F59, 0x1F5B, 0x1F5D, 0x1F5F,
+    0x1F80, 0x1FB6, 0x1FBE, 0x1FC2, 0x1FC6, 0x1FD0, 0x1FD6, 0x1FE0,
+    0x1FF2, 0x1FF6, 0x2071, 0x207F, 0x2090, 0x2102, 0x2107, 0x210A,
+    0x2115, 0x2119, 0x2124, 0x2126, 0x2128, 0x212A, 0x212F, 0x213C,
+    0x2145, 0x214E, 0x2183, 0x2C00, 0x2CEB, 0x2CF2, 0x2D00, 0x2D27,
+    0x2D2D, 0x2D30, 0x2D6F, 0x2D80, 0x2DA0, 0x2DA8, 0x2DB0, 0x2DB8,
+    0x2DC0, 0x2DC8, 0x2DD0, 0x2DD8, 0x2E2F, 0x3005, 0x3031, 0x303B,
+    0x3041, 0x309D, 0x30A1, 0x30FC, 0x3105, 0x3131, 0x31A0, 0x31F0,
+    0x3400, 0x4E00, 0xA4D0, 0xA500, 0xA610, 0xA62A, 0xA640, 0xA67F,
+    0xA6A0, 0xA717, 0xA722, 0xA78B, 0xA7D0, 0xA7D3, 0xA7D5, 0xA7F2,
+    0xA803, 0xA807, 0xA80C, 0xA840, 0xA882, 0xA8F2, 0xA8FB, 0xA8FD,
+    0xA90A, 0xA930, 0xA960, 0xA984, 0xA9CF, 0xA9E0, 0xA9E6, 0xA9FA,
+    0xAA00, 0xAA40, 0xAA44, 0xAA60, 0xAA7A, 0xAA7E, 0xAAB1, 0xAAB5,
+    0xAAB9, 0xAAC0, 0xAAC2, 0xAADB, 0xAAE0, 0xAAF2, 0xAB01, 0xAB09,
+    0xAB11, 0xAB20, 0xAB28, 0xAB30, 0xAB5C, 0xAB70, 0xAC00, 0xD7B0,
+    0xD7CB, 0xF900, 0xFA70, 0xFB00, 0xFB13, 0xFB1D, 0xFB1F, 0xFB2A,
+    0xFB38, 0xFB3E, 0xFB40, 0xFB43, 0xFB46, 0xFBD3, 0xFD50, 0xFD92,
+    0xFDF0, 0xFE70, 0xFE76, 0xFF21, 0xFF41, 0xFF66, 0xFFC2, 0xFFCA,
+    0xFFD2, 0xFFDA, 0x10000, 0x1000D, 0x10028, 0x1003C, 0x1003F, 0x10050,
+    0x10080, 0x10280, 0x102A0, 0x10300, 0x1032D, 0x10342, 0x10350, 0x10380,
+    0x103A0, 0x103C8, 0x10400, 0x104B0, 0x104D8, 0x10500, 0x10530, 0x10570,
+    0x1057C, 0x1058C, 0x10594, 0x10597, 0x105A3, 0x105B3, 0x105BB, 0x10600,
+    0x10740, 0x10760, 0x10780, 0x10787, 0x107B2, 0x10800, 0x10808, 0x1080A,
+    0x10837, 0x1083C, 0x1083F, 0x10860, 0x10880, 0x108E0, 0x108F4, 0x10900,
+    0x10920, 0x10980, 0x109BE, 0x10A00, 0x10A10, 0x10A15, 0x10A19, 0x10A60,
+    0x10A80, 0x10AC0, 0x10AC9, 0x10B00, 0x10B40, 0x10B60, 0x10B80, 0x10C00,
+    0x10C80, 0x10CC0, 0x10D00, 0x10E80, 0x10EB0, 0x10F00, 0x10F27, 0x10F30,
+    0x10F70, 0x10FB0, 0x10FE0, 0x11003, 0x11071, 0x11075, 0x11083, 0x110D0,
+    0x11103, 0x11144, 0x11147, 0x11150, 0x11176, 0x11183, 0x111C1, 0x111DA,
+    0x111DC, 0x11200, 0x11213, 0x11280, 0x11288, 0x1128A, 0x1128F, 0x1129F,
+    0x112B0, 0x11305, 0x1130F, 0x11313, 0x1132A, 0x11332, 0x11335, 0x1133D,
+    0x11350, 0x1135D, 0x11400, 0x11447, 0x1145F, 0x11480, 0x114C4, 0x114C7,
+    0x11580, 0x115D8, 0x11600, 0x11644, 0x11680, 0x116B8, 0x11700, 0x11740,
+    0x11800, 0x118A0, 0x118FF, 0x11909, 0x1190C, 0x11915, 0x11918, 0x1193F,
+    0x11941, 0x119A0, 0x119AA, 0x119E1, 0x119E3, 0x11A00, 0x11A0B, 0x11A3A,
+    0x11A50, 0x11A5C, 0x11A9D, 0x11AB0, 0x11C00, 0x11C0A, 0x11C40, 0x11C72,
+    0x11D00, 0x11D08, 0x11D0B, 0x11D46, 0x11D60, 0x11D67, 0x11D6A, 0x11D98,
+    0x11EE0, 0x11FB0, 0x12000, 0x12480, 0x12F90, 0x13000, 0x14400, 0x16800,
+    0x16A40, 0x16A70, 0x16AD0, 0x16B00, 0x16B40, 0x16B63, 0x16B7D, 0x16E40,
+    0x16F00, 0x16F50, 0x16F93, 0x16FE0, 0x16FE3, 0x17000, 0x18800, 0x18D00,
+    0x1AFF0, 0x1AFF5, 0x1AFFD, 0x1B000, 0x1B150, 0x1B164, 0x1B170, 0x1BC00,
+    0x1BC70, 0x1BC80, 0x1BC90, 0x1D400, 0x1D456, 0x1D49E, 0x1D4A2, 0x1D4A5,
+    0x1D4A9, 0x1D4AE, 0x1D4BB, 0x1D4BD, 0x1D4C5, 0x1D507, 0x1D50D, 0x1D516,
+    0x1D51E, 0x1D53B, 0x1D540, 0x1D546, 0x1D54A, 0x1D552, 0x1D6A8, 0x1D6C2,
+    0x1D6DC, 0x1D6FC, 0x1D716, 0x1D736, 0x1D750, 0x1D770, 0x1D78A, 0x1D7AA,
+    0x1D7C4, 0x1DF00, 0x1E100, 0x1E137, 0x1E14E, 0x1E290, 0x1E2C0, 0x1E7E0,
+    0x1E7E8, 0x1E7ED, 0x1E7F0, 0x1E800, 0x1E900, 0x1E94B, 0x1EE00, 0x1EE05,
+    0x1EE21, 0x1EE24, 0x1EE27, 0x1EE29, 0x1EE34, 0x1EE39, 0x1EE3B, 0x1EE42,
+    0x1EE47, 0x1EE49, 0x1EE4B, 0x1EE4D, 0x1EE51, 0x1EE54, 0x1EE57, 0x1EE59,
+    0x1EE5B, 0x1EE5D, 0x1EE5F, 0x1EE61, 0x1EE64, 0x1EE67, 0x1EE6C, 0x1EE74,
+    0x1EE79, 0x1EE7E, 0x1EE80, 0x1EE8B, 0x1EEA1, 0x1EEA5, 0x1EEAB, 0x20000,
+    0x2A700, 0x2B740, 0x2B820, 0x2CEB0, 0x2F800, 0x30000,
+};
+static const unsigned short letterSpan[646] = {
+    0, 0, 0, 22, 30, 457, 11, 4,
+    0, 0, 4, 1, 3, 0, 0, 2,
+    0, 19, 82, 138, 165, 37, 0, 40,
+    26, 3, 42, 1, 98, 0, 1, 1,
+    2, 0, 0, 29, 88, 0, 32, 1,
+    0, 21, 0, 0, 0, 24, 10, 23,
+    5, 41, 53, 0, 0, 9, 15, 7,
+    1, 21, 6, 0, 3, 0, 0, 1,
+    2, 1, 0, 5, 1, 21, 6, 1,
+    1, 1, 3, 0, 2, 8, 2, 21,
+    6, 1, 4, 0, 0, 1, 0, 7,
+    1, 21, 6, 1, 4, 0, 1, 2,
+    0, 0, 5, 2, 3, 1, 0, 1,
+    1, 2, 11, 0, 7, 2, 22, 15,
+    0, 2, 0, 1, 0, 7, 2, 22,
+    9, 4, 0, 1, 1, 1, 8, 2,
+    40, 0, 0, 2, 2, 5, 17, 23,
+    8, 0, 6, 47, 1, 6, 1, 0,
+    4, 23, 0, 9, 1, 0, 4, 0,
+    3, 0, 7, 35, 4, 42, 0, 5,
+    3, 0, 1, 2, 12, 0, 37, 0,
+    0, 42, 332, 3, 6, 0, 3, 40,
+    3, 32, 3, 6, 0, 3, 14, 56,
+    3, 66, 15, 85, 5, 619, 16, 25,
+    74, 7, 17, 18, 17, 12, 2, 51,
+    0, 0, 88, 4, 33, 0, 69, 30,
+    29, 4, 43, 25, 22, 52, 0, 46,
+    7, 29, 1, 43, 35, 2, 35, 8,
+    42, 2, 3, 5, 1, 0, 191, 277,
+    5, 37, 5, 7, 0, 0, 0, 30,
+    52, 6, 0, 2, 6, 3, 5, 12,
+    2, 6, 0, 0, 12, 0, 0, 9,
+    0, 4, 0, 0, 0, 3, 10, 3,
+    4, 0, 1, 228, 3, 1, 37, 0,
+    0, 55, 0, 22, 6, 6, 6, 6,
+    6, 6, 6, 6, 0, 1, 4, 1,
+    85, 2, 89, 3, 42, 93, 31, 15,
+    6591, 22156, 45, 268, 15, 1, 46, 30,
+    69, 8, 102, 63, 1, 0, 4, 15,
+    2, 3, 22, 51, 49, 5, 0, 1,
+    27, 22, 28, 46, 0, 4, 9, 4,
+    40, 2, 7, 22, 0, 49, 0, 1,
+    4, 0, 0, 2, 10, 2, 5, 5,
+    5, 6, 6, 42, 13, 114, 11171, 22,
+    48, 365, 105, 6, 4, 0, 9, 12,
+    4, 0, 1, 1, 107, 362, 63, 53,
+    11, 4, 134, 25, 25, 88, 5, 5,
+    5, 2, 11, 25, 18, 1, 14, 13,
+    122, 28, 48, 31, 19, 7, 37, 29,
+    35, 7, 157, 35, 35, 39, 51, 10,
+    14, 6, 1, 10, 14, 6, 1, 310,
+    21, 7, 5, 41, 8, 5, 0, 43,
+    1, 0, 22, 22, 30, 18, 1, 21,
+    25, 55, 1, 0, 3, 2, 28, 28,
+    28, 7, 27, 53, 21, 18, 17, 72,
+    50, 50, 35, 41, 1, 28, 0, 21,
+    17, 20, 22, 52, 1, 0, 44, 24,
+    35, 0, 0, 34, 0, 47, 3, 0,
+    0, 17, 24, 6, 0, 3, 14, 9,
+    46, 7, 1, 21, 6, 1, 4, 0,
+    0, 4, 52, 3, 2, 47, 1, 0,
+    46, 3, 47, 0, 42, 0, 26, 6,
+    43, 63, 7, 0, 7, 1, 23, 0,
+    0, 7, 38, 0, 0, 0, 39, 0,
+    0, 45, 0, 72, 8, 36, 0, 29,
+    6, 1, 37, 0, 5, 1, 31, 0,
+    18, 0, 921, 195, 96, 1070, 582, 568,
+    30, 78, 29, 47, 3, 20, 18, 63,
+    74, 0, 12, 1, 0, 6135, 1237, 8,
+    3, 6, 1, 290, 2, 3, 395, 106,
+    12, 8, 9, 84, 70, 1, 0, 1,
+    3, 11, 0, 6, 64, 3, 7, 6,
+    27, 3, 4, 0, 6, 339, 24, 24,
+    30, 24, 30, 24, 30, 24, 30, 24,
+    7, 30, 44, 6, 0, 29, 43, 6,
+    3, 1, 14, 196, 67, 0, 3, 26,
+    1, 0, 0, 9, 3, 0, 0, 0,
+    0, 0, 0, 2, 1, 0, 0, 0,
+    0, 0, 0, 1, 0, 3, 6, 3,
+    3, 0, 9, 16, 2, 4, 16, 42719,
+    4152, 221, 5761, 7472, 541, 4938,
+};
+
+static const unsigned int digitFirst[61] = {
+    0x0660, 0x06F0, 0x07C0, 0x0966, 0x09E6, 0x0A66, 0x0AE6, 0x0B66,
+    0x0BE6, 0x0C66, 0x0CE6, 0x0D66, 0x0DE6, 0x0E50, 0x0ED0, 0x0F20,
+    0x1040, 0x1090, 0x17E0, 0x1810, 0x1946, 0x19D0, 0x1A80, 0x1A90,
+    0x1B50, 0x1BB0, 0x1C40, 0x1C50, 0xA620, 0xA8D0, 0xA900, 0xA9D0,
+    0xA9F0, 0xAA50, 0xABF0, 0xFF10, 0x104A0, 0x10D30, 0x11066, 0x110F0,
+    0x11136, 0x111D0, 0x112F0, 0x11450, 0x114D0, 0x11650, 0x116C0, 0x11730,
+    0x118E0, 0x11950, 0x11C50, 0x11D50, 0x11DA0, 0x16A60, 0x16AC0, 0x16B50,
+    0x1D7CE, 0x1E140, 0x1E2F0, 0x1E950, 0x1FBF0,
+};
+static const unsigned short digitSpan[61] = {
+    9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9,
+    49, 9, 9, 9, 9,
+};
+
+// binary search for the last run that starts at or before the code point
+static int inRuns(const unsigned int *first, const unsigned short *span, int count, int codePoint)
+{
+    int low = 0;
+    int high = count - 1;
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+        if (first[middle] <= (unsigned int)codePoint)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    return high >= 0 && (unsigned int)codePoint - first[high] <= span[high];
+}
+
+int isUnicodeLetter(int codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        return (codePoint >= 'a' && codePoint <= 'z') || (codePoint >= 'A' && codePoint <= 'Z');
+    }
+    return inRuns(letterFirst, letterSpan, sizeof(letterFirst) / sizeof(letterFirst[0]), codePoint);
+}
+
+int isUnicodeDigit(int codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        return codePoint >= '0' && codePoint <= '9';
+    }
+    return inRuns(digitFirst, digitSpan, sizeof(digitFirst) / sizeof(digitFirst[0]), codePoint);
+}
@@ -0,0 +1,43 @@
+#ifndef UTF8
+#define UTF8
+
+#include <stddef.h>
+
+/*
+ * Go source is UTF-8. The scanner validates every chunk it reads before it
+ * lexes it and takes letters and digits outside ASCII in identifiers, the way
+ * go's unicode.IsLetter and unicode.IsDigit classify them.
+ *
+ * Validation looks at 16 bytes at a time with SSSE3 when the processor has
+ * it: a block with no high bit set is ASCII and only has to be checked for a
+ * sequence cut off at the end of the block before it, anything else is
+ * checked with three table lookups on the nibbles of each byte and the byte
+ * before it (Keiser and Lemire, "Validating UTF-8 in less than one
+ * instruction per byte"). Without SSSE3 it is a byte at a time, skipping
+ * eight ASCII bytes per step.
+ */
+
+// a sequence cut by the end of a chunk is held back and completed by the next
+struct Utf8Stream
+{
+    unsigned char pending[4];
+    int numberOfPending;
+    long long pendingOffset;
+    // bytes seen so far
+    long long offset;
+};
+
+int isValidUtf8(const unsigned char *text, size_t length);
+// the offset of the first byte that is not part of a valid sequence, -1 when there is none
+long long findInvalidUtf8(const unsigned char *text, size_t length);
+// -1 while the stream is valid, otherwise the offset in it of the first bad byte
+long long checkUtf8Chunk(struct Utf8Stream *stream, const unsigned char *chunk, size_t length);
+// the end of the stream, a sequence still held back is cut off; resets the stream
+long long finishUtf8Stream(struct Utf8Stream *stream);
+
+// the code point of a valid sequence and the number of bytes it takes
+int decodeUtf8(const unsigned char *text, int *codePoint);
+int isUnicodeLetter(int codePoint);
+int isUnicodeDigit(int codePoint);
+
+#endif
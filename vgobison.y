@@ -25,6 +25,7 @@
 #include "tree.h"
 #include "globalutilities.h"
 #include "nonterminal.h"
+#include "parsedecl.h"
 
 
 // #define YYDEBUG 1
@@ -33,6 +34,14 @@ int yyparse();
 
 %}
 
+/*
+ * build both the classic yyparse() and a push parser so stream.c can feed
+ * tokens as they arrive on a pipe. Both are pure, the parser state is on the
+ * stack, so parsedecl.c can run one on each thread
+ */
+%define api.push-pull both
+%define api.pure full
+
 %union {
 	struct Node *node;
 }
@@ -51,6 +60,7 @@ int yyparse();
 
 %token <node>		LBRACKET RBRACKET PERIOD COMA SEMICOLON COLON EXCLAMATION PLUS MINUS STAR DIVIDE MOD LPAREN RPAREN LSQUAREBRACE RSQUAREBRACE EQUAL TILDE AT
 %token <node>		LEAF
+%token <node>		LDECLARATION	/* never lexed, starts the parse of one declaration */
 
 
 %type <node>		 import_here
@@ -115,7 +125,7 @@ int yyparse();
  * and annotate the reducing rule accordingly.
  */
 %left		NotPackage
-%left		LPACKAGE
+%left		LPACKAGE LDECLARATION
 
 %left		NotParen
 %left		LPAREN
@@ -124,7 +134,9 @@ int yyparse();
 %left		PreferToRightParen
 
 %%
-file:	package imports xdcl_list { treeHead = createTree(file, "file", 3, $1, $2, $3);}  ;
+file:	package imports xdcl_list { treeHead = createTree(file, "file", 3, $1, $2, $3);}
+|	LDECLARATION xdcl semicolon {declarationParse->declaration = $2; declarationParse->semicolon = $3;}
+	;
 
 package:
 	%prec NotPackage 
@@ -8,6 +8,16 @@
 #include "globalutilities.h"
 #include "tree.h"
 #include "semantic.h"
+#include "stream.h"
+#include "lower.h"
+#include "ir.h"
+#include "codegen.h"
+#include "vm.h"
+#include "memreport.h"
+#include "package.h"
+#include "trace.h"
+#include "chunklex.h"
+#include "parsedecl.h"
 
 // yydebug = 1;
 
@@ -28,8 +38,111 @@ char *sanitizeFile(char *filename)
     }
 }
 
+// the parse of one file, with the time the scanner took within it drawn from its start
+void traceParse(char *fileName, double start)
+{
+    char name[256];
+    char arguments[128];
+    double duration = traceClock() - start;
+    snprintf(arguments, sizeof(arguments), "\"tokens\":%lld,\"lexing ms\":%.3f", lexedTokens, lexingTime / 1000);
+    traceSummedSpan("frontend", "lexing", start, lexingTime, arguments);
+    snprintf(name, sizeof(name), "parse %s", fileName);
+    traceSummedSpan("frontend", name, start, duration, arguments);
+    traceCounter("tree nodes", liveAllocations(MEM_TREE_NODE));
+    lexingTime = 0;
+    lexedTokens = 0;
+}
+
+void generateIr(struct Node *tree)
+{
+    // the ir is only built when it is printed, compiled to a binary or run
+    if (!emitIr && !emitC && !irStats && !layoutReport && outputFile == NULL && !runProgram)
+    {
+        return;
+    }
+    if (hasImportedPackages() && (emitC || runProgram))
+    {
+        printf("Imported packages are linked from their objects, build with -o instead\n");
+        exit(3);
+    }
+    double start = traceEnabled ? traceClock() : 0;
+    struct IrModule *module = buildIrModule(tree);
+    if (traceEnabled)
+    {
+        traceSpan("backend", "ir build", start, NULL);
+    }
+    if (layoutReport)
+    {
+        printLayoutReport(module);
+    }
+    start = traceEnabled ? traceClock() : 0;
+    optimizeIrModule(module);
+    if (traceEnabled)
+    {
+        traceSpan("backend", "optimize", start, NULL);
+    }
+    start = traceEnabled ? traceClock() : 0;
+    if (emitIr)
+    {
+        printIrModule(module);
+    }
+    if (outputFile != NULL && emitC)
+    {
+        buildCExecutable(module, outputFile);
+    }
+    else if (outputFile != NULL)
+    {
+        buildExecutable(module, outputFile);
+    }
+    else if (emitC)
+    {
+        generateC(module, stdout);
+    }
+    if (traceEnabled)
+    {
+        traceSpan("backend", "output", start, NULL);
+    }
+    if (runProgram)
+    {
+        runVmProgram(compileVmProgram(module));
+    }
+}
+
+// the object goes to -o and the export summary next to it, out.o and out.vgox
+void compilePackage(struct Node *tree)
+{
+    if (outputFile == NULL)
+    {
+        printf("-package needs -o for the package object\n");
+        exit(3);
+    }
+    beginSemanticAnalysis(tree);
+    irPackageName = packageNameOf(tree);
+    struct IrModule *module = buildIrModule(tree);
+    optimizeIrModule(module);
+    if (emitIr)
+    {
+        printIrModule(module);
+    }
+    buildPackageObject(module, outputFile);
+
+    size_t length = strlen(outputFile);
+    if (length > 2 && strcmp(outputFile + length - 2, ".o") == 0)
+    {
+        length -= 2;
+    }
+    char *summaryPath = malloc(length + strlen(".vgox") + 1);
+    memcpy(summaryPath, outputFile, length);
+    strcpy(summaryPath + length, ".vgox");
+    writeExportSummary(tree, summaryPath, outputFile);
+    free(summaryPath);
+}
+
 int main(int argc, char **argv)
 {
+    // the files of a -package build, merged as they are parsed
+    struct Node *packageTree = NULL;
+    createScanner();
     if (argc > 1)
     {
         int i;
@@ -43,17 +156,121 @@ int main(int argc, char **argv)
             {
                 printCode = 2;
             }
+            else if (strcmp(argv[i], "-ast") == 0)
+            {
+                printCode = 4;
+            }
+            else if (strcmp(argv[i], "-emit-ir") == 0)
+            {
+                emitIr = 1;
+            }
+            else if (strcmp(argv[i], "-emit-c") == 0)
+            {
+                // c source on stdout, or built with the system compiler under -o
+                emitC = 1;
+            }
+            else if (strcmp(argv[i], "-mem-report") == 0)
+            {
+                // front end allocations, peak rss and symbol table health once the files are done
+                memReport = 1;
+                memCounting = 1;
+            }
+            else if (strcmp(argv[i], "-ir-stats") == 0)
+            {
+                irStats = 1;
+            }
+            else if (strcmp(argv[i], "-layout-report") == 0)
+            {
+                layoutReport = 1;
+            }
+            else if (strcmp(argv[i], "-layout=reorder") == 0)
+            {
+                // order struct fields to minimize padding instead of as declared
+                reorderIrFields = 1;
+            }
+            else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            {
+                i++;
+                outputFile = argv[i];
+            }
+            else if (strcmp(argv[i], "-package") == 0)
+            {
+                // the files that follow are one package, compiled to an object and an export summary
+                packageBuild = 1;
+            }
+            else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc)
+            {
+                // where imported packages' export summaries are looked for
+                i++;
+                addImportDirectory(argv[i]);
+            }
+            else if (strcmp(argv[i], "-S") == 0)
+            {
+                keepAssembly = 1;
+            }
+            else if (strcmp(argv[i], "-run") == 0)
+            {
+                runProgram = 1;
+            }
+            else if (strcmp(argv[i], "-jit") == 0)
+            {
+                // compile each function to machine code on its first call
+                vmJitThreshold = 1;
+            }
+            else if (strncmp(argv[i], "-jit=", 5) == 0)
+            {
+                vmJitThreshold = atoi(argv[i] + 5);
+            }
+            else if (strncmp(argv[i], "-check-threads=", 15) == 0)
+            {
+                // type check function bodies on this many threads
+                typeCheckThreads = atoi(argv[i] + 15);
+            }
+            else if (strncmp(argv[i], "-lex-threads=", 13) == 0)
+            {
+                // lex large files in chunks on this many threads before parsing them
+                lexThreads = atoi(argv[i] + 13);
+            }
+            else if (strncmp(argv[i], "-parse-threads=", 15) == 0)
+            {
+                // parse the top-level declarations of large files on this many threads
+                parseThreads = atoi(argv[i] + 15);
+            }
+            else if (strncmp(argv[i], "-trace=", 7) == 0)
+            {
+                openTrace(argv[i] + 7);
+                // the trace's counters are the live counts
+                memCounting = 1;
+            }
+            else if (strcmp(argv[i], "-syntax-only") == 0)
+            {
+                syntaxOnly = 1;
+            }
+            else if (strcmp(argv[i], "-check=reachable") == 0)
+            {
+                checkReachableOnly = 1;
+            }
+            else if (strcmp(argv[i], "-naive") == 0)
+            {
+                naiveCodegen = 1;
+            }
+            else if (strcmp(argv[i], "-stream") == 0)
+            {
+                streamMode = 1;
+            }
             else
             {
-                char *sanatizedFile = sanitizeFile(argv[i]);
+                // - reads the program from a pipe, parsed while it is still being produced
+                int fromStdin = strcmp(argv[i], "-") == 0;
+                char *sanatizedFile = fromStdin ? "stdin" : sanitizeFile(argv[i]);
                 if (sizeof(sanatizedFile) > 0)
                 {
                     // valid file feel free to continue
 
-                    yyin = fopen(sanatizedFile, "r");
+                    FILE *source = fromStdin ? stdin : fopen(sanatizedFile, "r");
                     currentfile = sanatizedFile;
 
-                    if (yyin == NULL)
+                    if (source == NULL)
                     {
                         // do note that it is possible that this is a valid .go file but the user will resubmit if that happens
                         perror("This is not a .go file\n");
@@ -61,16 +278,75 @@ int main(int argc, char **argv)
                     else
                     {
                         // run flex/bison. They will create a treeHead object we can then use for semantic analysis
-                        while (yyparse() > 0)
+                        double parseStart = traceEnabled ? traceClock() : 0;
+                        yyset_in(source, scanner);
+                        if (packageBuild || syntaxOnly)
+                        {
+                            yyrestart(source, scanner);
+                            yyset_lineno(1, scanner);
+                        }
+                        if (streamMode || fromStdin)
+                        {
+                            streamParse(source);
+                        }
+                        else
                         {
+                            // -syntax-only frees each token as it is scanned, chunks would keep all of them until parsed
+                            if ((lexThreads > 0 || parseThreads > 0) && !syntaxOnly)
+                            {
+                                openChunkedSource(source);
+                            }
+                            if (chunkedSource == NULL || parseThreads == 0 || !parseDeclarations())
+                            {
+                                while (yyparse() > 0)
+                                {
+                                }
+                            }
+                            closeChunkedSource();
+                        }
+                        if (traceEnabled)
+                        {
+                            traceParse(sanatizedFile, parseStart);
+                        }
+                        if (syntaxOnly)
+                        {
+                            // a syntax error has already exited, there is no tree to go on with
+                            if (!fromStdin)
+                            {
+                                fclose(source);
+                            }
+                            continue;
                         }
                         if (printCode == 2)
                         {
                             treeprint(treeHead, 0);
                         }
-                        beginSemanticAnalysis(treeHead);
+                        // drop punctuation and flatten lists before the semantic passes walk the tree
+                        double lowerStart = traceEnabled ? traceClock() : 0;
+                        treeHead = lowerTree(treeHead);
+                        if (traceEnabled)
+                        {
+                            traceSpan("frontend", "lower", lowerStart, NULL);
+                            traceCounter("tree nodes", liveAllocations(MEM_TREE_NODE));
+                        }
+                        if (printCode == 4)
+                        {
+                            treeprint(treeHead, 0);
+                        }
+                        if (packageBuild)
+                        {
+                            packageTree = mergePackageFile(packageTree, treeHead);
+                        }
+                        else
+                        {
+                            beginSemanticAnalysis(treeHead);
+                            generateIr(treeHead);
+                        }
 
-                        fclose(yyin);
+                        if (!fromStdin)
+                        {
+                            fclose(source);
+                        }
                     }
                 }
                 else
@@ -79,6 +355,14 @@ int main(int argc, char **argv)
                 }
             }
         }
+        if (packageTree != NULL)
+        {
+            compilePackage(packageTree);
+        }
+        if (memReport)
+        {
+            printMemReport();
+        }
         return 0;
     }
     else
@@ -0,0 +1,444 @@
+#include "vm.h"
+#include "runtime/vgort.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/*
+ * Threaded interpreter for the register bytecode. Every handler ends by
+ * jumping straight to the handler of the next opcode through a label table
+ * (gcc computed goto), so there is no central switch to return to.
+ * Registers and struct slots of all active calls live on two stacks; a call
+ * pushes the callee's window above the caller's.
+ */
+
+struct VmFrame
+{
+    struct VmFunction *function;
+    // where the caller continues
+    int *pc;
+    union VmValue *registers;
+    char *slots;
+    int destination;
+};
+
+// shared by every interpreter activation and by compiled code
+struct VmProgram *activeVmProgram;
+union VmValue *vmRegisterStack;
+union VmValue *vmRegisterLimit;
+char *vmSlotStack;
+char *vmSlotLimit;
+struct VmFrame *vmFrames;
+int vmCallDepth;
+struct VgoPrintOperand vmPrintOperands[256];
+
+int findVmFunction(struct VmProgram *program, char *name)
+{
+    int i = 0;
+    for (i = 0; i < program->numberOfFunctions; i++)
+    {
+        if (strcmp(program->functions[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void vmStackOverflow(void)
+{
+    fflush(stdout);
+    fprintf(stderr, "runtime: goroutine stack exceeds limit\nfatal error: stack overflow\n");
+    exit(2);
+}
+
+// Go integers wrap around, C signed overflow is undefined, so arithmetic goes through unsigned
+#define WRAP(left, op, right) ((long long)((unsigned long long)(left)op(unsigned long long)(right)))
+
+#define REG(n) registers[pc[n]]
+#define ADDRESS(n) ((char *)(size_t)REG(n).i)
+#define NEXT(size)     \
+    pc += size;        \
+    goto *dispatch[*pc]
+
+long long vmEnterFunction(union VmValue *registers, char *slots, struct VmFunction *function)
+{
+    // compiled code calls through here until the callee has machine code of its own
+    if (function->native == NULL && vmJitThreshold > 0 && ++function->calls >= vmJitThreshold)
+    {
+        compileJitFunction(function);
+    }
+    if (function->native != NULL)
+    {
+        return function->native(registers, slots);
+    }
+    return interpretVmFunction(function, registers, slots);
+}
+
+void runVmProgram(struct VmProgram *program)
+{
+    int i = 0;
+    struct VmFunction *main = &program->functions[program->mainIndex];
+    activeVmProgram = program;
+    for (i = 0; i < program->numberOfFunctions; i++)
+    {
+        program->functions[i].calls = 0;
+        program->functions[i].native = NULL;
+        program->functions[i].entry = vmEnterFunction;
+    }
+    vmRegisterStack = malloc(VM_STACK_REGISTERS * sizeof(union VmValue));
+    vmRegisterLimit = vmRegisterStack + VM_STACK_REGISTERS;
+    vmSlotStack = malloc(VM_STACK_BYTES);
+    vmSlotLimit = vmSlotStack + VM_STACK_BYTES;
+    vmFrames = malloc(VM_MAX_CALL_DEPTH * sizeof(struct VmFrame));
+    vmCallDepth = 0;
+    if (main->numberOfRegisters > VM_STACK_REGISTERS || main->frameSize > VM_STACK_BYTES)
+    {
+        vmStackOverflow();
+    }
+    vmEnterFunction(vmRegisterStack, vmSlotStack, main);
+    fflush(stdout);
+    free(vmRegisterStack);
+    free(vmSlotStack);
+    free(vmFrames);
+}
+
+// runs one call of function and every interpreted call it makes, compiled callees run natively
+long long interpretVmFunction(struct VmFunction *function, union VmValue *registers, char *slots)
+{
+    static void *dispatch[VM_NUMBEROFOPS] = {
+        [VM_CONST] = &&doConst,         [VM_MOVE] = &&doMove,         [VM_ADD] = &&doAdd,
+        [VM_SUB] = &&doSub,             [VM_MUL] = &&doMul,           [VM_DIV] = &&doDiv,
+        [VM_MOD] = &&doMod,             [VM_ADDI] = &&doAddLiteral,   [VM_SUBI] = &&doSubLiteral,
+        [VM_MULI] = &&doMulLiteral,     [VM_DIVI] = &&doDivLiteral,   [VM_MODI] = &&doModLiteral,
+        [VM_NEG] = &&doNeg,             [VM_NOT] = &&doNot,           [VM_ADDF] = &&doAddFloat,
+        [VM_SUBF] = &&doSubFloat,       [VM_MULF] = &&doMulFloat,     [VM_DIVF] = &&doDivFloat,
+        [VM_NEGF] = &&doNegFloat,       [VM_CONCAT] = &&doConcat,     [VM_EQ] = &&doEq,
+        [VM_NE] = &&doNe,               [VM_LT] = &&doLt,             [VM_LE] = &&doLe,
+        [VM_GT] = &&doGt,               [VM_GE] = &&doGe,             [VM_EQF] = &&doEqFloat,
+        [VM_NEF] = &&doNeFloat,         [VM_LTF] = &&doLtFloat,       [VM_LEF] = &&doLeFloat,
+        [VM_GTF] = &&doGtFloat,         [VM_GEF] = &&doGeFloat,       [VM_COMPARES] = &&doCompareStrings,
+        [VM_ITOF] = &&doIntToFloat,     [VM_FTOI] = &&doFloatToInt,   [VM_JUMP] = &&doJump,
+        [VM_JTRUE] = &&doJumpTrue,      [VM_JFALSE] = &&doJumpFalse,  [VM_JEQ] = &&doJumpEq,
+        [VM_JNE] = &&doJumpNe,          [VM_JLT] = &&doJumpLt,        [VM_JLE] = &&doJumpLe,
+        [VM_JGT] = &&doJumpGt,          [VM_JGE] = &&doJumpGe,        [VM_JEQI] = &&doJumpEqLiteral,
+        [VM_JNEI] = &&doJumpNeLiteral,  [VM_JLTI] = &&doJumpLtLiteral, [VM_JLEI] = &&doJumpLeLiteral,
+        [VM_JGTI] = &&doJumpGtLiteral,  [VM_JGEI] = &&doJumpGeLiteral, [VM_SLOT] = &&doSlot,
+        [VM_GLOBAL] = &&doGlobal,       [VM_ELEM] = &&doElem,         [VM_LOAD] = &&doLoad,
+        [VM_LOADB] = &&doLoadBool,      [VM_STORE] = &&doStore,       [VM_STOREB] = &&doStoreBool,
+        [VM_ZERO] = &&doZero,           [VM_COPY] = &&doCopy,         [VM_BOUNDS] = &&doBounds,
+        [VM_CALL] = &&doCall,           [VM_CALLCACHED] = &&doCallCached, [VM_RETURN] = &&doReturn,
+        [VM_RETURNVOID] = &&doReturnVoid, [VM_PRINT] = &&doPrint,     [VM_NOW] = &&doNow,
+        [VM_RANDN] = &&doRandn};
+    struct VmProgram *program = activeVmProgram;
+    union VmValue result;
+    int base = vmCallDepth;
+    int *pc = function->code;
+    long long left = 0;
+    long long right = 0;
+    int i = 0;
+    result.i = 0;
+    NEXT(0);
+
+doConst:
+    REG(1).i = (long long)(((unsigned long long)(unsigned)pc[3] << 32) | (unsigned)pc[2]);
+    NEXT(4);
+doMove:
+    REG(1) = REG(2);
+    NEXT(3);
+
+doAdd:
+    REG(1).i = WRAP(REG(2).i, +, REG(3).i);
+    NEXT(4);
+doSub:
+    REG(1).i = WRAP(REG(2).i, -, REG(3).i);
+    NEXT(4);
+doMul:
+    REG(1).i = WRAP(REG(2).i, *, REG(3).i);
+    NEXT(4);
+doDiv:
+    // the most negative int divided by -1 is itself in Go, the hardware divide would trap
+    right = REG(3).i;
+    if (right == 0)
+    {
+        vgoPanicDivide();
+    }
+    REG(1).i = right == -1 ? WRAP(0, -, REG(2).i) : REG(2).i / right;
+    NEXT(4);
+doMod:
+    right = REG(3).i;
+    if (right == 0)
+    {
+        vgoPanicDivide();
+    }
+    REG(1).i = right == -1 ? 0 : REG(2).i % right;
+    NEXT(4);
+
+doAddLiteral:
+    REG(1).i = WRAP(REG(2).i, +, (long long)pc[3]);
+    NEXT(4);
+doSubLiteral:
+    REG(1).i = WRAP(REG(2).i, -, (long long)pc[3]);
+    NEXT(4);
+doMulLiteral:
+    REG(1).i = WRAP(REG(2).i, *, (long long)pc[3]);
+    NEXT(4);
+doDivLiteral:
+    REG(1).i = REG(2).i / pc[3];
+    NEXT(4);
+doModLiteral:
+    REG(1).i = REG(2).i % pc[3];
+    NEXT(4);
+doNeg:
+    REG(1).i = WRAP(0, -, REG(2).i);
+    NEXT(3);
+doNot:
+    REG(1).i = REG(2).i ^ 1;
+    NEXT(3);
+
+doAddFloat:
+    REG(1).f = REG(2).f + REG(3).f;
+    NEXT(4);
+doSubFloat:
+    REG(1).f = REG(2).f - REG(3).f;
+    NEXT(4);
+doMulFloat:
+    REG(1).f = REG(2).f * REG(3).f;
+    NEXT(4);
+doDivFloat:
+    REG(1).f = REG(2).f / REG(3).f;
+    NEXT(4);
+doNegFloat:
+    REG(1).f = -REG(2).f;
+    NEXT(3);
+doConcat:
+    REG(1).s = vgoConcatStrings(REG(2).s, REG(3).s);
+    NEXT(4);
+
+doEq:
+    REG(1).i = REG(2).i == REG(3).i;
+    NEXT(4);
+doNe:
+    REG(1).i = REG(2).i != REG(3).i;
+    NEXT(4);
+doLt:
+    REG(1).i = REG(2).i < REG(3).i;
+    NEXT(4);
+doLe:
+    REG(1).i = REG(2).i <= REG(3).i;
+    NEXT(4);
+doGt:
+    REG(1).i = REG(2).i > REG(3).i;
+    NEXT(4);
+doGe:
+    REG(1).i = REG(2).i >= REG(3).i;
+    NEXT(4);
+doEqFloat:
+    REG(1).i = REG(2).f == REG(3).f;
+    NEXT(4);
+doNeFloat:
+    REG(1).i = REG(2).f != REG(3).f;
+    NEXT(4);
+doLtFloat:
+    REG(1).i = REG(2).f < REG(3).f;
+    NEXT(4);
+doLeFloat:
+    REG(1).i = REG(2).f <= REG(3).f;
+    NEXT(4);
+doGtFloat:
+    REG(1).i = REG(2).f > REG(3).f;
+    NEXT(4);
+doGeFloat:
+    REG(1).i = REG(2).f >= REG(3).f;
+    NEXT(4);
+doCompareStrings:
+    left = vgoCompareStrings(REG(2).s, REG(3).s);
+    switch (pc[4])
+    {
+    case VM_EQ:
+        REG(1).i = left == 0;
+        break;
+    case VM_NE:
+        REG(1).i = left != 0;
+        break;
+    case VM_LT:
+        REG(1).i = left < 0;
+        break;
+    case VM_LE:
+        REG(1).i = left <= 0;
+        break;
+    case VM_GT:
+        REG(1).i = left > 0;
+        break;
+    default:
+        REG(1).i = left >= 0;
+        break;
+    }
+    NEXT(5);
+
+doIntToFloat:
+    REG(1).f = (double)REG(2).i;
+    NEXT(3);
+doFloatToInt:
+    // out of range and NaN give the most negative int, as cvttsd2si does in compiled code
+    REG(1).i = REG(2).f >= -9223372036854775808.0 && REG(2).f < 9223372036854775808.0 ? (long long)REG(2).f : LLONG_MIN;
+    NEXT(3);
+
+doJump:
+    pc = function->code + pc[1];
+    NEXT(0);
+doJumpTrue:
+    pc = REG(1).i ? function->code + pc[2] : pc + 3;
+    NEXT(0);
+doJumpFalse:
+    pc = REG(1).i ? pc + 3 : function->code + pc[2];
+    NEXT(0);
+doJumpEq:
+    pc = REG(1).i == REG(2).i ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpNe:
+    pc = REG(1).i != REG(2).i ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpLt:
+    pc = REG(1).i < REG(2).i ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpLe:
+    pc = REG(1).i <= REG(2).i ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpGt:
+    pc = REG(1).i > REG(2).i ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpGe:
+    pc = REG(1).i >= REG(2).i ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpEqLiteral:
+    pc = REG(1).i == pc[2] ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpNeLiteral:
+    pc = REG(1).i != pc[2] ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpLtLiteral:
+    pc = REG(1).i < pc[2] ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpLeLiteral:
+    pc = REG(1).i <= pc[2] ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpGtLiteral:
+    pc = REG(1).i > pc[2] ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+doJumpGeLiteral:
+    pc = REG(1).i >= pc[2] ? function->code + pc[3] : pc + 4;
+    NEXT(0);
+
+doSlot:
+    REG(1).i = (long long)(size_t)(slots + pc[2]);
+    NEXT(3);
+doGlobal:
+    REG(1).i = (long long)(size_t)(program->globals + pc[2]);
+    NEXT(3);
+doElem:
+    REG(1).i = REG(2).i + REG(3).i * pc[4];
+    NEXT(5);
+doLoad:
+    memcpy(&REG(1), ADDRESS(2) + pc[3], sizeof(union VmValue));
+    NEXT(4);
+doLoadBool:
+    REG(1).i = *(unsigned char *)(ADDRESS(2) + pc[3]);
+    NEXT(4);
+doStore:
+    memcpy(ADDRESS(1) + pc[2], &REG(3), sizeof(union VmValue));
+    NEXT(4);
+doStoreBool:
+    *(ADDRESS(1) + pc[2]) = (char)REG(3).i;
+    NEXT(4);
+doZero:
+    memset(ADDRESS(1), 0, pc[2]);
+    NEXT(3);
+doCopy:
+    memmove(ADDRESS(1), ADDRESS(2), pc[3]);
+    NEXT(4);
+doBounds:
+    if ((unsigned long long)REG(1).i >= (unsigned long long)pc[2])
+    {
+        vgoPanicIndex(REG(1).i, pc[2]);
+    }
+    NEXT(3);
+
+doCall:
+    // first execution resolves the callee by name and rewrites the call site to use it directly
+    pc[2] = findVmFunction(program, program->names[pc[2]]);
+    pc[0] = VM_CALLCACHED;
+doCallCached:
+{
+    struct VmFunction *callee = &program->functions[pc[2]];
+    union VmValue *calleeRegisters = registers + function->numberOfRegisters;
+    char *calleeSlots = slots + function->frameSize;
+    if (callee->native == NULL && vmJitThreshold > 0 && ++callee->calls >= vmJitThreshold)
+    {
+        compileJitFunction(callee);
+    }
+    if (vmCallDepth + 1 >= VM_MAX_CALL_DEPTH || calleeRegisters + callee->numberOfRegisters > vmRegisterLimit ||
+        calleeSlots + callee->frameSize > vmSlotLimit)
+    {
+        vmStackOverflow();
+    }
+    for (i = 0; i < pc[3]; i++)
+    {
+        calleeRegisters[i] = REG(4 + i);
+    }
+    if (callee->native != NULL)
+    {
+        result.i = callee->native(calleeRegisters, calleeSlots);
+        if (pc[1] >= 0)
+        {
+            REG(1) = result;
+        }
+        NEXT(4 + pc[3]);
+    }
+    vmFrames[vmCallDepth].function = function;
+    vmFrames[vmCallDepth].pc = pc + 4 + pc[3];
+    vmFrames[vmCallDepth].registers = registers;
+    vmFrames[vmCallDepth].slots = slots;
+    vmFrames[vmCallDepth].destination = pc[1];
+    vmCallDepth++;
+    function = callee;
+    registers = calleeRegisters;
+    slots = calleeSlots;
+    pc = callee->code;
+    NEXT(0);
+}
+doReturn:
+    result = REG(1);
+    goto doReturnVoid;
+doReturnVoid:
+    if (vmCallDepth == base)
+    {
+        return result.i;
+    }
+    vmCallDepth--;
+    function = vmFrames[vmCallDepth].function;
+    registers = vmFrames[vmCallDepth].registers;
+    slots = vmFrames[vmCallDepth].slots;
+    pc = vmFrames[vmCallDepth].pc;
+    if (vmFrames[vmCallDepth].destination >= 0)
+    {
+        registers[vmFrames[vmCallDepth].destination] = result;
+    }
+    NEXT(0);
+
+doPrint:
+    for (i = 0; i < pc[1]; i++)
+    {
+        vmPrintOperands[i].kind = pc[2 + 2 * i];
+        vmPrintOperands[i].bits = REG(3 + 2 * i).i;
+    }
+    vgoPrintln(pc[1], vmPrintOperands);
+    NEXT(2 + 2 * pc[1]);
+doNow:
+    REG(1).i = vgoNow();
+    NEXT(2);
+doRandn:
+    REG(1).i = vgoRandIntn(REG(2).i);
+    NEXT(3);
+}
@@ -0,0 +1,149 @@
+#ifndef VM
+#define VM
+
+#include "ir.h"
+#include "runtime/vgort.h"
+
+/*
+ * Register-based bytecode for vgo -run. Every SSA value owns a register in
+ * its function's frame, so operands are frame indexes and nothing is looked
+ * up by name at run time. Code is a stream of ints: an opcode followed by
+ * its operands, d is the destination register and a, b are sources.
+ */
+
+#define VM_CONST 0    // d, low bits, high bits
+#define VM_MOVE 1     // d, a
+#define VM_ADD 2      // d, a, b
+#define VM_SUB 3
+#define VM_MUL 4
+#define VM_DIV 5
+#define VM_MOD 6
+#define VM_ADDI 7     // d, a, literal
+#define VM_SUBI 8
+#define VM_MULI 9
+#define VM_DIVI 10    // literal is neither 0 nor -1
+#define VM_MODI 11
+#define VM_NEG 12     // d, a
+#define VM_NOT 13
+#define VM_ADDF 14    // d, a, b
+#define VM_SUBF 15
+#define VM_MULF 16
+#define VM_DIVF 17
+#define VM_NEGF 18    // d, a
+#define VM_CONCAT 19  // d, a, b
+#define VM_EQ 20      // d, a, b
+#define VM_NE 21
+#define VM_LT 22
+#define VM_LE 23
+#define VM_GT 24
+#define VM_GE 25
+#define VM_EQF 26
+#define VM_NEF 27
+#define VM_LTF 28
+#define VM_LEF 29
+#define VM_GTF 30
+#define VM_GEF 31
+#define VM_COMPARES 32 // d, a, b, comparison opcode VM_EQ..VM_GE
+#define VM_ITOF 33    // d, a
+#define VM_FTOI 34
+#define VM_JUMP 35    // target
+#define VM_JTRUE 36   // a, target
+#define VM_JFALSE 37
+#define VM_JEQ 38     // a, b, target
+#define VM_JNE 39
+#define VM_JLT 40
+#define VM_JLE 41
+#define VM_JGT 42
+#define VM_JGE 43
+#define VM_JEQI 44    // a, literal, target
+#define VM_JNEI 45
+#define VM_JLTI 46
+#define VM_JLEI 47
+#define VM_JGTI 48
+#define VM_JGEI 49
+#define VM_SLOT 50    // d, frame offset
+#define VM_GLOBAL 51  // d, global offset
+#define VM_ELEM 52    // d, base, index, element size
+#define VM_LOAD 53    // d, base, offset
+#define VM_LOADB 54
+#define VM_STORE 55   // base, offset, a
+#define VM_STOREB 56
+#define VM_ZERO 57    // base, size
+#define VM_COPY 58    // base, source base, size
+#define VM_BOUNDS 59  // a, length
+#define VM_CALL 60    // d, function name index, argument count, arguments
+#define VM_CALLCACHED 61 // d, function index, argument count, arguments
+#define VM_RETURN 62  // a
+#define VM_RETURNVOID 63
+#define VM_PRINT 64   // count, then kind and register per operand
+#define VM_NOW 65     // d
+#define VM_RANDN 66   // d, a
+#define VM_NUMBEROFOPS 67
+
+#define VM_STACK_REGISTERS (1 << 20)
+#define VM_STACK_BYTES (1 << 24)
+#define VM_MAX_CALL_DEPTH 100000
+
+// literals that fit in one code word are folded into the instruction
+#define VM_LITERAL_MIN (-2147483647 - 1)
+#define VM_LITERAL_MAX 2147483647
+
+union VmValue
+{
+    long long i;
+    double f;
+    char *s;
+};
+
+struct VmFunction
+{
+    char *name;
+    int numberOfParams;
+    // parameters take the first registers, one spare is kept for phi cycles
+    int numberOfRegisters;
+    // bytes of struct and array slots
+    int frameSize;
+    int *code;
+    int codeLength;
+    int codeCapacity;
+    // calls counted toward -jit, and the machine code once it is compiled
+    int calls;
+    long long (*native)(union VmValue *registers, char *slots);
+    // what compiled callers jump through: vmEnterFunction, then the machine code
+    long long (*entry)(union VmValue *registers, char *slots, struct VmFunction *function);
+};
+
+struct VmProgram
+{
+    int numberOfFunctions;
+    struct VmFunction *functions;
+    // callee names referenced by VM_CALL until the call site is resolved
+    int numberOfNames;
+    char **names;
+    int globalSize;
+    char *globals;
+    int mainIndex;
+};
+
+extern int runProgram;
+extern int vmJitThreshold;
+extern struct VmProgram *activeVmProgram;
+extern union VmValue *vmRegisterLimit;
+extern char *vmSlotLimit;
+extern int vmCallDepth;
+extern struct VgoPrintOperand vmPrintOperands[256];
+
+// vmcompile.c
+struct VmProgram *compileVmProgram(struct IrModule *module);
+
+// vm.c
+int findVmFunction(struct VmProgram *program, char *name);
+void vmStackOverflow(void);
+long long vmEnterFunction(union VmValue *registers, char *slots, struct VmFunction *function);
+long long interpretVmFunction(struct VmFunction *function, union VmValue *registers, char *slots);
+void runVmProgram(struct VmProgram *program);
+
+// jit.c
+void compileJitFunction(struct VmFunction *function);
+
+#endif
@@ -0,0 +1,716 @@
+#include "vm.h"
+#include "codegen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Translation of the optimized IR into register bytecode. Blocks are laid
+ * out in the same order as for native code, phi copies go at the end of
+ * each predecessor and a compare feeding a branch becomes a single jump.
+ */
+
+// set by -run
+int runProgram = 0;
+
+struct VmFixup
+{
+    // code position of a jump target and the block order index it names
+    int position;
+    int block;
+};
+
+struct VmProgram *vmProgram;
+struct IrModule *vmModule;
+struct IrFunction *vmIrFunction;
+struct VmFunction *vmFunction;
+struct Allocation vmLayout;
+// register of each value by instruction id, -1 when it needs none
+int *vmRegisters;
+int *vmBlockStarts;
+int numberOfVmFixups;
+int vmFixupCapacity;
+struct VmFixup *vmFixups;
+
+// operand order swaps and negations of eq, ne, lt, le, gt, ge
+int swappedComparisons[] = {0, 1, 4, 5, 2, 3};
+int inverseComparisons[] = {1, 0, 5, 4, 3, 2};
+
+void vmCompileError(char *message)
+{
+    printf("Unable to compile bytecode: %s in function %s\n", message, vmIrFunction != NULL ? vmIrFunction->name : "?");
+    exit(3);
+}
+
+void emitVm(int word)
+{
+    if (vmFunction->codeLength == vmFunction->codeCapacity)
+    {
+        vmFunction->codeCapacity = vmFunction->codeCapacity == 0 ? 256 : vmFunction->codeCapacity * 2;
+        vmFunction->code = realloc(vmFunction->code, vmFunction->codeCapacity * sizeof(int));
+    }
+    vmFunction->code[vmFunction->codeLength++] = word;
+}
+
+void emitVm1(int op, int a)
+{
+    emitVm(op);
+    emitVm(a);
+}
+
+void emitVm2(int op, int a, int b)
+{
+    emitVm1(op, a);
+    emitVm(b);
+}
+
+void emitVm3(int op, int a, int b, int c)
+{
+    emitVm2(op, a, b);
+    emitVm(c);
+}
+
+void emitVmTarget(struct IrBlock *block)
+{
+    if (numberOfVmFixups == vmFixupCapacity)
+    {
+        vmFixupCapacity = vmFixupCapacity == 0 ? 64 : vmFixupCapacity * 2;
+        vmFixups = realloc(vmFixups, vmFixupCapacity * sizeof(struct VmFixup));
+    }
+    vmFixups[numberOfVmFixups].position = vmFunction->codeLength;
+    vmFixups[numberOfVmFixups].block = block->mark;
+    numberOfVmFixups++;
+    emitVm(0);
+}
+
+int isVmLiteral(struct IrInstr *value)
+{
+    return value->op == IR_CONST && (value->type == IR_INT || value->type == IR_BOOL) && value->ival >= VM_LITERAL_MIN &&
+           value->ival <= VM_LITERAL_MAX;
+}
+
+int isVmFusedCompare(struct IrInstr *instr)
+{
+    return !naiveCodegen && isFusedCompare(instr);
+}
+
+// whether argument index of user is encoded in the instruction instead of read from a register
+int isVmLiteralOperand(struct IrInstr *user, int index)
+{
+    struct IrInstr *left = user->args[0];
+    struct IrInstr *right = user->numberOfArgs > 1 ? user->args[1] : NULL;
+    if (naiveCodegen || right == NULL)
+    {
+        return 0;
+    }
+    switch (user->op)
+    {
+    case IR_ADD:
+    case IR_MUL:
+        if (user->type != IR_INT)
+        {
+            return 0;
+        }
+        // commutative, a literal on the left moves to the right
+        return index == 1 ? isVmLiteral(right) : isVmLiteral(left) && !isVmLiteral(right);
+
+    case IR_SUB:
+        return user->type == IR_INT && index == 1 && isVmLiteral(right);
+
+    case IR_DIV:
+    case IR_MOD:
+        return user->type == IR_INT && index == 1 && isVmLiteral(right) && right->ival != 0 && right->ival != -1;
+
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        if (!isVmFusedCompare(user))
+        {
+            return 0;
+        }
+        return index == 1 ? isVmLiteral(right) : isVmLiteral(left) && !isVmLiteral(right);
+
+    case IR_ELEM:
+        return index == 1 && isVmLiteral(right) && right->ival * user->ival <= VM_LITERAL_MAX;
+
+    default:
+        return 0;
+    }
+}
+
+// field addresses used by loads and stores fold into their displacement
+int isVmFoldedAddress(struct IrInstr *user, int index)
+{
+    if (naiveCodegen || index != 0 || user->args[0]->op != IR_FIELD)
+    {
+        return 0;
+    }
+    return user->op == IR_LOAD || user->op == IR_STORE;
+}
+
+int vmNeedsRegister(struct IrInstr *value)
+{
+    int i = 0;
+    int j = 0;
+    if (value->type == IR_VOID)
+    {
+        return 0;
+    }
+    if (value->op == IR_PARAM || hasIrSideEffects(value))
+    {
+        return 1;
+    }
+    if (isVmFusedCompare(value))
+    {
+        return 0;
+    }
+    for (i = 0; i < value->numberOfUsers; i++)
+    {
+        struct IrInstr *user = value->users[i];
+        for (j = 0; j < user->numberOfArgs; j++)
+        {
+            if (user->args[j] != value || isVmLiteralOperand(user, j) || isVmFoldedAddress(user, j))
+            {
+                continue;
+            }
+            // a field of a field is resolved down to the first computed base
+            if (user->op == IR_FIELD && value->op == IR_FIELD && !naiveCodegen)
+            {
+                continue;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int vmRegister(struct IrInstr *value)
+{
+    if (vmRegisters[value->id] < 0)
+    {
+        vmCompileError("value without a register");
+    }
+    return vmRegisters[value->id];
+}
+
+int vmGlobalOffset(char *name)
+{
+    int offset = 0;
+    struct IrGlobal *global = vmModule->globals;
+    for (; global != NULL; global = global->next)
+    {
+        if (strcmp(global->name, name) == 0)
+        {
+            return offset;
+        }
+        offset += (global->size + 7) & ~7;
+    }
+    vmCompileError("unknown global");
+    return 0;
+}
+
+int vmNameIndex(char *name)
+{
+    int i = 0;
+    for (i = 0; i < vmProgram->numberOfNames; i++)
+    {
+        if (strcmp(vmProgram->names[i], name) == 0)
+        {
+            return i;
+        }
+    }
+    vmProgram->names = realloc(vmProgram->names, (vmProgram->numberOfNames + 1) * sizeof(char *));
+    vmProgram->names[vmProgram->numberOfNames] = name;
+    return vmProgram->numberOfNames++;
+}
+
+// base register and displacement of an address, folding fields of a computed base
+int resolveVmAddress(struct IrInstr *address, int *offset)
+{
+    *offset = 0;
+    while (address->op == IR_FIELD && vmRegisters[address->id] < 0)
+    {
+        *offset += (int)address->ival;
+        address = address->args[0];
+    }
+    return vmRegister(address);
+}
+
+void emitVmConstant(struct IrInstr *instr)
+{
+    unsigned long long bits = (unsigned long long)instr->ival;
+    if (instr->type == IR_FLOAT)
+    {
+        memcpy(&bits, &instr->dval, sizeof(double));
+    }
+    else if (instr->type == IR_STRING)
+    {
+        bits = (unsigned long long)(size_t)instr->sval;
+    }
+    emitVm3(VM_CONST, vmRegister(instr), (int)(unsigned)bits, (int)(unsigned)(bits >> 32));
+}
+
+void emitVmArithmetic(struct IrInstr *instr)
+{
+    // one row per IR op from add to mod: register form, literal form, float form
+    static int forms[][3] = {{VM_ADD, VM_ADDI, VM_ADDF},
+                             {VM_SUB, VM_SUBI, VM_SUBF},
+                             {VM_MUL, VM_MULI, VM_MULF},
+                             {VM_DIV, VM_DIVI, VM_DIVF},
+                             {VM_MOD, VM_MODI, -1}};
+    int *form = forms[instr->op - IR_ADD];
+    struct IrInstr *left = instr->args[0];
+    struct IrInstr *right = instr->args[1];
+    int destination = vmRegister(instr);
+    if (instr->type == IR_STRING)
+    {
+        emitVm3(VM_CONCAT, destination, vmRegister(left), vmRegister(right));
+    }
+    else if (instr->type == IR_FLOAT)
+    {
+        emitVm3(form[2], destination, vmRegister(left), vmRegister(right));
+    }
+    else if (isVmLiteralOperand(instr, 1))
+    {
+        emitVm3(form[1], destination, vmRegister(left), (int)right->ival);
+    }
+    else if (isVmLiteralOperand(instr, 0))
+    {
+        emitVm3(form[1], destination, vmRegister(right), (int)left->ival);
+    }
+    else
+    {
+        emitVm3(form[0], destination, vmRegister(left), vmRegister(right));
+    }
+}
+
+void emitVmCompare(struct IrInstr *instr)
+{
+    int comparison = instr->op - IR_EQ;
+    int left = vmRegister(instr->args[0]);
+    int right = vmRegister(instr->args[1]);
+    if (instr->args[0]->type == IR_STRING)
+    {
+        emitVm3(VM_COMPARES, vmRegister(instr), left, right);
+        emitVm(VM_EQ + comparison);
+    }
+    else if (instr->args[0]->type == IR_FLOAT)
+    {
+        emitVm3(VM_EQF + comparison, vmRegister(instr), left, right);
+    }
+    else
+    {
+        emitVm3(VM_EQ + comparison, vmRegister(instr), left, right);
+    }
+}
+
+void emitVmCall(struct IrInstr *instr)
+{
+    int i = 0;
+    emitVm(VM_CALL);
+    emitVm(instr->type != IR_VOID ? vmRegister(instr) : -1);
+    emitVm(vmNameIndex(instr->sval));
+    emitVm(instr->numberOfArgs);
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        emitVm(vmRegister(instr->args[i]));
+    }
+}
+
+void emitVmPrint(struct IrInstr *instr)
+{
+    int i = 0;
+    if (instr->numberOfArgs > 256)
+    {
+        vmCompileError("more than 256 operands to fmt.Println");
+    }
+    emitVm1(VM_PRINT, instr->numberOfArgs);
+    for (i = 0; i < instr->numberOfArgs; i++)
+    {
+        emitVm(instr->args[i]->type);
+        emitVm(vmRegister(instr->args[i]));
+    }
+}
+
+void emitVmPhiMoves(struct IrBlock *from, struct IrBlock *to)
+{
+    // the phis read their operands at once, so copies wait until no other copy still reads their target
+    int sources[64];
+    int destinations[64];
+    int pending = 0;
+    int predIndex = 0;
+    int spare = vmFunction->numberOfRegisters - 1;
+    struct IrInstr *phi = NULL;
+    while (to->preds[predIndex] != from)
+    {
+        predIndex++;
+    }
+    for (phi = to->first; phi != NULL && phi->op == IR_PHI; phi = phi->next)
+    {
+        if (phi->args[predIndex] == NULL || vmRegister(phi->args[predIndex]) == vmRegister(phi))
+        {
+            continue;
+        }
+        if (pending == 64)
+        {
+            vmCompileError("more than 64 phis in a block");
+        }
+        sources[pending] = vmRegister(phi->args[predIndex]);
+        destinations[pending] = vmRegister(phi);
+        pending++;
+    }
+    while (pending > 0)
+    {
+        int progress = 0;
+        int i = 0;
+        int j = 0;
+        for (i = 0; i < pending; i++)
+        {
+            int blocked = 0;
+            for (j = 0; j < pending && !blocked; j++)
+            {
+                blocked = j != i && sources[j] == destinations[i];
+            }
+            if (!blocked)
+            {
+                emitVm2(VM_MOVE, destinations[i], sources[i]);
+                pending--;
+                sources[i] = sources[pending];
+                destinations[i] = destinations[pending];
+                progress = 1;
+                break;
+            }
+        }
+        if (!progress)
+        {
+            // every copy is part of a cycle, park one target in the spare register
+            emitVm2(VM_MOVE, spare, destinations[0]);
+            for (j = 0; j < pending; j++)
+            {
+                if (sources[j] == destinations[0])
+                {
+                    sources[j] = spare;
+                }
+            }
+        }
+    }
+}
+
+void emitVmBranch(struct IrInstr *instr, int nextBlock)
+{
+    struct IrInstr *condition = instr->args[0];
+    struct IrBlock *onTrue = instr->target[0];
+    struct IrBlock *onFalse = instr->target[1];
+    struct IrBlock *target = onTrue;
+    int trueFollows = onTrue->mark == nextBlock;
+    if (trueFollows)
+    {
+        target = onFalse;
+    }
+    if (isVmFusedCompare(condition))
+    {
+        struct IrInstr *left = condition->args[0];
+        struct IrInstr *right = condition->args[1];
+        int comparison = condition->op - IR_EQ;
+        if (isVmLiteralOperand(condition, 0))
+        {
+            left = condition->args[1];
+            right = condition->args[0];
+            comparison = swappedComparisons[comparison];
+        }
+        if (trueFollows)
+        {
+            comparison = inverseComparisons[comparison];
+        }
+        if (isVmLiteral(right))
+        {
+            emitVm2(VM_JEQI + comparison, vmRegister(left), (int)right->ival);
+        }
+        else
+        {
+            emitVm2(VM_JEQ + comparison, vmRegister(left), vmRegister(right));
+        }
+    }
+    else
+    {
+        emitVm1(trueFollows ? VM_JFALSE : VM_JTRUE, vmRegister(condition));
+    }
+    emitVmTarget(target);
+    if (!trueFollows && onFalse->mark != nextBlock)
+    {
+        emitVm(VM_JUMP);
+        emitVmTarget(onFalse);
+    }
+}
+
+void emitVmInstr(struct IrInstr *instr, int nextBlock)
+{
+    int offset = 0;
+    int base = 0;
+    if (instr->type != IR_VOID && vmRegisters[instr->id] < 0)
+    {
+        // folded into its users
+        return;
+    }
+    switch (instr->op)
+    {
+    case IR_PARAM:
+    case IR_PHI:
+        return;
+
+    case IR_CONST:
+        emitVmConstant(instr);
+        return;
+
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+        emitVmArithmetic(instr);
+        return;
+
+    case IR_NEG:
+        emitVm2(instr->type == IR_FLOAT ? VM_NEGF : VM_NEG, vmRegister(instr), vmRegister(instr->args[0]));
+        return;
+
+    case IR_NOT:
+        emitVm2(VM_NOT, vmRegister(instr), vmRegister(instr->args[0]));
+        return;
+
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        emitVmCompare(instr);
+        return;
+
+    case IR_ITOF:
+    case IR_FTOI:
+        emitVm2(instr->op == IR_ITOF ? VM_ITOF : VM_FTOI, vmRegister(instr), vmRegister(instr->args[0]));
+        return;
+
+    case IR_SLOT:
+        emitVm2(VM_SLOT, vmRegister(instr), (int)instr->lattice);
+        return;
+
+    case IR_GLOBAL:
+        emitVm2(VM_GLOBAL, vmRegister(instr), vmGlobalOffset(instr->sval));
+        return;
+
+    case IR_FIELD:
+        base = resolveVmAddress(instr->args[0], &offset);
+        emitVm3(VM_ADDI, vmRegister(instr), base, offset + (int)instr->ival);
+        return;
+
+    case IR_ELEM:
+        if (isVmLiteralOperand(instr, 1))
+        {
+            emitVm3(VM_ADDI, vmRegister(instr), vmRegister(instr->args[0]), (int)(instr->args[1]->ival * instr->ival));
+            return;
+        }
+        emitVm3(VM_ELEM, vmRegister(instr), vmRegister(instr->args[0]), vmRegister(instr->args[1]));
+        emitVm((int)instr->ival);
+        return;
+
+    case IR_LOAD:
+        base = resolveVmAddress(instr->args[0], &offset);
+        emitVm3(instr->type == IR_BOOL ? VM_LOADB : VM_LOAD, vmRegister(instr), base, offset);
+        return;
+
+    case IR_STORE:
+        base = resolveVmAddress(instr->args[0], &offset);
+        emitVm3(instr->args[1]->type == IR_BOOL ? VM_STOREB : VM_STORE, base, offset, vmRegister(instr->args[1]));
+        return;
+
+    case IR_ZERO:
+        emitVm2(VM_ZERO, vmRegister(instr->args[0]), (int)instr->ival);
+        return;
+
+    case IR_COPY:
+        emitVm3(VM_COPY, vmRegister(instr->args[0]), vmRegister(instr->args[1]), (int)instr->ival);
+        return;
+
+    case IR_BOUNDS:
+        emitVm2(VM_BOUNDS, vmRegister(instr->args[0]), (int)instr->ival);
+        return;
+
+    case IR_CALL:
+        emitVmCall(instr);
+        return;
+
+    case IR_PRINT:
+        emitVmPrint(instr);
+        return;
+
+    case IR_NOW:
+        emitVm1(VM_NOW, vmRegister(instr));
+        return;
+
+    case IR_RANDN:
+        emitVm2(VM_RANDN, vmRegister(instr), vmRegister(instr->args[0]));
+        return;
+
+    case IR_JUMP:
+        emitVmPhiMoves(instr->block, instr->target[0]);
+        if (instr->target[0]->mark != nextBlock)
+        {
+            emitVm(VM_JUMP);
+            emitVmTarget(instr->target[0]);
+        }
+        return;
+
+    case IR_BRANCH:
+        emitVmBranch(instr, nextBlock);
+        return;
+
+    case IR_RETURN:
+        if (instr->numberOfArgs > 0)
+        {
+            emitVm1(VM_RETURN, vmRegister(instr->args[0]));
+        }
+        else
+        {
+            emitVm(VM_RETURNVOID);
+        }
+        return;
+
+    default:
+        vmCompileError("unsupported instruction");
+    }
+}
+
+void compileVmFunction(struct IrFunction *function, struct VmFunction *target)
+{
+    int i = 0;
+    int next = function->numberOfParams;
+    vmIrFunction = function;
+    vmFunction = target;
+    target->name = function->name;
+    target->numberOfParams = function->numberOfParams;
+    splitIrCriticalEdges(function);
+    orderIrBlocks(function, &vmLayout);
+
+    // parameters arrive in the first registers, every other value that is read gets the next one
+    vmRegisters = malloc((function->nextValueId + 1) * sizeof(int));
+    for (i = 0; i <= function->nextValueId; i++)
+    {
+        vmRegisters[i] = -1;
+    }
+    for (i = 0; i < vmLayout.numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = vmLayout.order[i]->first;
+        for (; instr != NULL; instr = instr->next)
+        {
+            if (instr->op == IR_PARAM)
+            {
+                vmRegisters[instr->id] = (int)instr->ival;
+            }
+            else if (vmNeedsRegister(instr))
+            {
+                vmRegisters[instr->id] = next++;
+            }
+            if (instr->op == IR_SLOT)
+            {
+                instr->lattice = target->frameSize;
+                target->frameSize += (int)((instr->ival + 7) & ~7LL);
+            }
+        }
+    }
+    target->numberOfRegisters = next + 1;
+
+    vmBlockStarts = malloc(vmLayout.numberOfBlocks * sizeof(int));
+    numberOfVmFixups = 0;
+    for (i = 0; i < vmLayout.numberOfBlocks; i++)
+    {
+        struct IrInstr *instr = vmLayout.order[i]->first;
+        vmBlockStarts[i] = target->codeLength;
+        for (; instr != NULL; instr = instr->next)
+        {
+            emitVmInstr(instr, i + 1);
+        }
+    }
+    for (i = 0; i < numberOfVmFixups; i++)
+    {
+        target->code[vmFixups[i].position] = vmBlockStarts[vmFixups[i].block];
+    }
+    free(vmRegisters);
+    free(vmBlockStarts);
+    free(vmLayout.order);
+}
+
+void initializeVmGlobals(struct VmProgram *program)
+{
+    int offset = 0;
+    struct IrGlobal *global = vmModule->globals;
+    for (; global != NULL; global = global->next)
+    {
+        offset += (global->size + 7) & ~7;
+    }
+    program->globalSize = offset;
+    program->globals = calloc(offset + 8, 1);
+    offset = 0;
+    for (global = vmModule->globals; global != NULL; global = global->next)
+    {
+        char *address = program->globals + offset;
+        offset += (global->size + 7) & ~7;
+        if (!global->initialized)
+        {
+            continue;
+        }
+        switch (global->type)
+        {
+        case IR_FLOAT:
+            memcpy(address, &global->dval, sizeof(double));
+            break;
+
+        case IR_BOOL:
+            *address = (char)global->ival;
+            break;
+
+        case IR_STRING:
+            memcpy(address, &global->sval, sizeof(char *));
+            break;
+
+        default:
+            memcpy(address, &global->ival, sizeof(long long));
+            break;
+        }
+    }
+}
+
+struct VmProgram *compileVmProgram(struct IrModule *module)
+{
+    int count = 0;
+    int i = 0;
+    struct IrFunction *function = module->functions;
+    struct VmProgram *program = calloc(1, sizeof(struct VmProgram));
+    vmProgram = program;
+    vmModule = module;
+    for (; function != NULL; function = function->next)
+    {
+        count++;
+    }
+    program->numberOfFunctions = count;
+    program->functions = calloc(count, sizeof(struct VmFunction));
+    for (function = module->functions; function != NULL; function = function->next)
+    {
+        compileVmFunction(function, &program->functions[i++]);
+    }
+    vmIrFunction = NULL;
+    program->mainIndex = findVmFunction(program, "main");
+    if (program->mainIndex < 0)
+    {
+        vmCompileError("missing func main");
+    }
+    initializeVmGlobals(program);
+    free(vmFixups);
+    vmFixups = NULL;
+    vmFixupCapacity = 0;
+    return program;
+}
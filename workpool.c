@@ -0,0 +1,154 @@
+#include "workpool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the tasks [begin, end) that one thread has left
+struct WorkShare
+{
+    pthread_mutex_t lock;
+    int begin;
+    int end;
+};
+
+struct WorkPool
+{
+    struct WorkShare *shares;
+    int numberOfThreads;
+    WorkTask task;
+    void *argument;
+};
+
+struct WorkThread
+{
+    struct WorkPool *pool;
+    int index;
+};
+
+int defaultWorkThreads()
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? (int)processors : 1;
+}
+
+// the next task of this thread's own share, -1 when it is empty
+int takeWork(struct WorkShare *share)
+{
+    int task = -1;
+    pthread_mutex_lock(&share->lock);
+    if (share->begin < share->end)
+    {
+        task = share->begin++;
+    }
+    pthread_mutex_unlock(&share->lock);
+    return task;
+}
+
+// the last task of the share with the most left, -1 when every share is empty
+int stealWork(struct WorkPool *pool, int thief)
+{
+    while (1)
+    {
+        int victim = -1;
+        int most = 0;
+        int i = 0;
+        for (i = 0; i < pool->numberOfThreads; i++)
+        {
+            int left = 0;
+            if (i == thief)
+            {
+                continue;
+            }
+            pthread_mutex_lock(&pool->shares[i].lock);
+            left = pool->shares[i].end - pool->shares[i].begin;
+            pthread_mutex_unlock(&pool->shares[i].lock);
+            if (left > most)
+            {
+                victim = i;
+                most = left;
+            }
+        }
+        if (victim < 0)
+        {
+            return -1;
+        }
+        // the victim may have emptied its share since, then look again
+        struct WorkShare *share = &pool->shares[victim];
+        pthread_mutex_lock(&share->lock);
+        int task = share->begin < share->end ? --share->end : -1;
+        pthread_mutex_unlock(&share->lock);
+        if (task >= 0)
+        {
+            return task;
+        }
+    }
+}
+
+void *runWorkThread(void *argument)
+{
+    struct WorkThread *thread = argument;
+    struct WorkPool *pool = thread->pool;
+    int task = 0;
+    while ((task = takeWork(&pool->shares[thread->index])) >= 0 || (task = stealWork(pool, thread->index)) >= 0)
+    {
+        pool->task(task, pool->argument);
+    }
+    return NULL;
+}
+
+void runWorkPool(int numberOfTasks, int numberOfThreads, WorkTask task, void *argument)
+{
+    int i = 0;
+    if (numberOfThreads > numberOfTasks)
+    {
+        numberOfThreads = numberOfTasks;
+    }
+    if (numberOfThreads <= 1)
+    {
+        for (i = 0; i < numberOfTasks; i++)
+        {
+            task(i, argument);
+        }
+        return;
+    }
+
+    struct WorkPool pool;
+    pool.shares = malloc(numberOfThreads * sizeof(struct WorkShare));
+    pool.numberOfThreads = numberOfThreads;
+    pool.task = task;
+    pool.argument = argument;
+    struct WorkThread *threads = malloc(numberOfThreads * sizeof(struct WorkThread));
+    pthread_t *handles = malloc(numberOfThreads * sizeof(pthread_t));
+    for (i = 0; i < numberOfThreads; i++)
+    {
+        pthread_mutex_init(&pool.shares[i].lock, NULL);
+        pool.shares[i].begin = (int)((long long)numberOfTasks * i / numberOfThreads);
+        pool.shares[i].end = (int)((long long)numberOfTasks * (i + 1) / numberOfThreads);
+        threads[i].pool = &pool;
+        threads[i].index = i;
+    }
+
+    // the calling thread works too, as thread 0
+    for (i = 1; i < numberOfThreads; i++)
+    {
+        if (pthread_create(&handles[i], NULL, runWorkThread, &threads[i]) != 0)
+        {
+            printf("Unable to start a worker thread\n");
+            exit(3);
+        }
+    }
+    runWorkThread(&threads[0]);
+    for (i = 1; i < numberOfThreads; i++)
+    {
+        pthread_join(handles[i], NULL);
+    }
+
+    for (i = 0; i < numberOfThreads; i++)
+    {
+        pthread_mutex_destroy(&pool.shares[i].lock);
+    }
+    free(pool.shares);
+    free(threads);
+    free(handles);
+}
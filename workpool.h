@@ -0,0 +1,17 @@
+#ifndef WORKPOOL
+#define WORKPOOL
+
+/*
+ * A fixed set of independent tasks, numbered 0 to numberOfTasks - 1, run on
+ * a pool of threads. Every thread starts with an even share of the tasks and
+ * takes them from the front; a thread that runs out steals from the back of
+ * the busiest share, so a few long tasks do not hold the others up.
+ */
+
+typedef void (*WorkTask)(int index, void *argument);
+
+// one thread per processor
+int defaultWorkThreads();
+void runWorkPool(int numberOfTasks, int numberOfThreads, WorkTask task, void *argument);
+
+#endif